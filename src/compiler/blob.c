@@ -231,6 +231,21 @@ blob_overwrite_intptr (struct blob *blob,
    return blob_overwrite_bytes(blob, offset, &value, sizeof(value));
 }
 
+bool
+blob_write_varint(struct blob *blob, uint64_t value)
+{
+   uint8_t bytes[10];
+   unsigned n = 0;
+
+   while (value >= 0x80) {
+      bytes[n++] = (value & 0x7f) | 0x80;
+      value >>= 7;
+   }
+   bytes[n++] = value;
+
+   return blob_write_bytes(blob, bytes, n);
+}
+
 bool
 blob_write_string(struct blob *blob, const char *str)
 {
@@ -349,6 +364,30 @@ blob_read_intptr(struct blob_reader *blob)
    return ret;
 }
 
+uint64_t
+blob_read_varint(struct blob_reader *blob)
+{
+   uint64_t ret = 0;
+   unsigned shift = 0;
+
+   if (blob->overrun)
+      return 0;
+
+   while (blob->current < blob->end && shift < 64) {
+      uint8_t byte = *blob->current++;
+
+      ret |= (uint64_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+         return ret;
+
+      shift += 7;
+   }
+
+   /* We ran out of data, or the value doesn't fit in 64 bits. */
+   blob->overrun = true;
+   return 0;
+}
+
 char *
 blob_read_string(struct blob_reader *blob)
 {
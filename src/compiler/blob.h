@@ -252,6 +252,18 @@ blob_overwrite_intptr(struct blob *blob,
                       size_t offset,
                       intptr_t value);
 
+/**
+ * Add an unsigned integer to a blob, using as few bytes as its value needs.
+ *
+ * The value is written 7 bits at a time, least significant bits first, with
+ * the high bit of each byte set if more bytes follow, so values below 128
+ * take a single byte.  No alignment padding is added.
+ *
+ * \return True unless allocation failed.
+ */
+bool
+blob_write_varint(struct blob *blob, uint64_t value);
+
 /**
  * Add a NULL-terminated string to a blob, (including the NULL terminator).
  *
@@ -330,6 +342,15 @@ blob_read_uint64(struct blob_reader *blob);
 intptr_t
 blob_read_intptr(struct blob_reader *blob);
 
+/**
+ * Read an unsigned integer written by blob_write_varint from the current
+ * location, (and update the current location to just past it).
+ *
+ * \return The value read
+ */
+uint64_t
+blob_read_varint(struct blob_reader *blob);
+
 /**
  * Read a NULL-terminated string from the current location, (and update the
  * current location to just past this string).
@@ -83,6 +83,7 @@
 #include <math.h>
 #include "builtin_functions.h"
 #include "util/hash_table.h"
+#include "util/set.h"
 
 #define M_PIf   ((float) M_PI)
 #define M_PI_2f ((float) M_PI_2)
@@ -650,8 +651,9 @@ namespace {
  * builtin_builder: A singleton object representing the core of the built-in
  * function module.
  *
- * It generates IR for every built-in function signature, and organizes them
- * into functions.
+ * It generates IR for the built-in function signatures, and organizes them
+ * into functions.  Built-in functions are only generated the first time a
+ * shader looks them up, since most shaders use a handful of them.
  */
 class builtin_builder {
 public:
@@ -662,22 +664,44 @@ public:
    void release();
    ir_function_signature *find(_mesa_glsl_parse_state *state,
                                const char *name, exec_list *actual_parameters);
+   ir_function *get_function(const char *name);
+   void create_all();
 
    /**
     * A shader to hold all the built-in signatures; created by this module.
     *
-    * This includes signatures for every built-in, regardless of version or
-    * enabled extensions.  The availability predicate associated with each
-    * signature allows matching_signature() to filter out the irrelevant ones.
+    * This includes signatures for every built-in that was looked up so far,
+    * regardless of version or enabled extensions.  The availability predicate
+    * associated with each signature allows matching_signature() to filter out
+    * the irrelevant ones.
     */
    gl_shader *shader;
 
 private:
    void *mem_ctx;
 
+   /**
+    * Names of the functions create_builtins() can create, which haven't been
+    * created yet.  Other names are rejected without running it.
+    */
+   struct set *pending_names;
+
+   /**
+    * The function create_builtins() is creating, or NULL to create every
+    * function.
+    */
+   const char *requested_name;
+
+   /**
+    * Whether create_builtins() only collects the names of the functions into
+    * pending_names instead of creating any.
+    */
+   bool collecting_names;
+
    void create_shader();
    void create_intrinsics();
    void create_builtins();
+   bool is_requested(const char *name);
 
    /**
     * IR builder helpers:
@@ -1023,6 +1047,9 @@ builtin_builder::builtin_builder()
    : shader(NULL)
 {
    mem_ctx = NULL;
+   pending_names = NULL;
+   requested_name = NULL;
+   collecting_names = false;
 }
 
 builtin_builder::~builtin_builder()
@@ -1043,7 +1070,7 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
     */
    state->uses_builtin_functions = true;
 
-   ir_function *f = shader->symbols->get_function(name);
+   ir_function *f = get_function(name);
    if (f == NULL)
       return NULL;
 
@@ -1055,6 +1082,42 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
    return sig;
 }
 
+/**
+ * Look up a built-in function by name, generating its signatures if this is
+ * the first time it is requested.
+ */
+ir_function *
+builtin_builder::get_function(const char *name)
+{
+   struct set_entry *entry = _mesa_set_search(pending_names, name);
+
+   if (entry) {
+      _mesa_set_remove(pending_names, entry);
+
+      requested_name = name;
+      create_builtins();
+      requested_name = NULL;
+   }
+
+   return shader->symbols->get_function(name);
+}
+
+/**
+ * Create every built-in function now, replacing the ones created so far.
+ */
+void
+builtin_builder::create_all()
+{
+   release();
+
+   mem_ctx = ralloc_context(NULL);
+   pending_names = _mesa_set_create(mem_ctx, _mesa_key_hash_string,
+                                    _mesa_key_string_equal);
+   create_shader();
+   create_intrinsics();
+   create_builtins();
+}
+
 void
 builtin_builder::initialize()
 {
@@ -1063,9 +1126,17 @@ builtin_builder::initialize()
       return;
 
    mem_ctx = ralloc_context(NULL);
+   pending_names = _mesa_set_create(mem_ctx, _mesa_key_hash_string,
+                                    _mesa_key_string_equal);
    create_shader();
    create_intrinsics();
+
+   /* Only the names are needed to tell built-ins from other functions, and
+    * the names don't depend on the IR the functions are made of.
+    */
+   collecting_names = true;
    create_builtins();
+   collecting_names = false;
 }
 
 void
@@ -1073,6 +1144,7 @@ builtin_builder::release()
 {
    ralloc_free(mem_ctx);
    mem_ctx = NULL;
+   pending_names = NULL;
 
    ralloc_free(shader);
    shader = NULL;
@@ -1089,6 +1161,18 @@ builtin_builder::create_shader()
    shader->symbols = new(mem_ctx) glsl_symbol_table;
 }
 
+bool
+builtin_builder::is_requested(const char *name)
+{
+   if (collecting_names) {
+      /* The names are string literals, so they don't need to be copied. */
+      _mesa_set_add(pending_names, name);
+      return false;
+   }
+
+   return requested_name == NULL || strcmp(name, requested_name) == 0;
+}
+
 /** @} */
 
 /**
@@ -1273,15 +1357,25 @@ builtin_builder::create_intrinsics()
 }
 
 /**
- * Create ir_function and ir_function_signature objects for each built-in.
+ * Create ir_function and ir_function_signature objects for the requested
+ * built-in.
  *
  * Contains a list of every available built-in.
  */
 void
 builtin_builder::create_builtins()
 {
+   /* Generating the signatures is the expensive part, so skip evaluating the
+    * arguments of every other function.
+    */
+#define ADD_FUNCTION(NAME, ...)                 \
+   do {                                         \
+      if (is_requested(NAME))                   \
+         add_function(NAME, __VA_ARGS__);       \
+   } while (0)
+
 #define F(NAME)                                 \
-   add_function(#NAME,                          \
+   ADD_FUNCTION(#NAME,                          \
                 _##NAME(glsl_type::float_type), \
                 _##NAME(glsl_type::vec2_type),  \
                 _##NAME(glsl_type::vec3_type),  \
@@ -1289,7 +1383,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define FD(NAME)                                 \
-   add_function(#NAME,                          \
+   ADD_FUNCTION(#NAME,                          \
                 _##NAME(always_available, glsl_type::float_type), \
                 _##NAME(always_available, glsl_type::vec2_type),  \
                 _##NAME(always_available, glsl_type::vec3_type),  \
@@ -1301,7 +1395,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define FD130(NAME)                                 \
-   add_function(#NAME,                          \
+   ADD_FUNCTION(#NAME,                          \
                 _##NAME(v130, glsl_type::float_type), \
                 _##NAME(v130, glsl_type::vec2_type),  \
                 _##NAME(v130, glsl_type::vec3_type),                  \
@@ -1313,7 +1407,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define FDGS5(NAME)                                 \
-   add_function(#NAME,                          \
+   ADD_FUNCTION(#NAME,                          \
                 _##NAME(gpu_shader5_es, glsl_type::float_type), \
                 _##NAME(gpu_shader5_es, glsl_type::vec2_type),  \
                 _##NAME(gpu_shader5_es, glsl_type::vec3_type),                  \
@@ -1325,7 +1419,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define FI(NAME)                                \
-   add_function(#NAME,                          \
+   ADD_FUNCTION(#NAME,                          \
                 _##NAME(glsl_type::float_type), \
                 _##NAME(glsl_type::vec2_type),  \
                 _##NAME(glsl_type::vec3_type),  \
@@ -1337,7 +1431,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define FI64(NAME)                                \
-   add_function(#NAME,                          \
+   ADD_FUNCTION(#NAME,                          \
                 _##NAME(always_available, glsl_type::float_type), \
                 _##NAME(always_available, glsl_type::vec2_type),  \
                 _##NAME(always_available, glsl_type::vec3_type),  \
@@ -1357,7 +1451,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define FIUD_VEC(NAME)                                            \
-   add_function(#NAME,                                            \
+   ADD_FUNCTION(#NAME,                                            \
                 _##NAME(always_available, glsl_type::vec2_type),  \
                 _##NAME(always_available, glsl_type::vec3_type),  \
                 _##NAME(always_available, glsl_type::vec4_type),  \
@@ -1383,7 +1477,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define IU(NAME)                                \
-   add_function(#NAME,                          \
+   ADD_FUNCTION(#NAME,                          \
                 _##NAME(glsl_type::int_type),   \
                 _##NAME(glsl_type::ivec2_type), \
                 _##NAME(glsl_type::ivec3_type), \
@@ -1396,7 +1490,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define FIUBD_VEC(NAME)                                           \
-   add_function(#NAME,                                            \
+   ADD_FUNCTION(#NAME,                                            \
                 _##NAME(always_available, glsl_type::vec2_type),  \
                 _##NAME(always_available, glsl_type::vec3_type),  \
                 _##NAME(always_available, glsl_type::vec4_type),  \
@@ -1427,7 +1521,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define FIUD2_MIXED(NAME)                                                                 \
-   add_function(#NAME,                                                                   \
+   ADD_FUNCTION(#NAME,                                                                   \
                 _##NAME(always_available, glsl_type::float_type, glsl_type::float_type), \
                 _##NAME(always_available, glsl_type::vec2_type,  glsl_type::float_type), \
                 _##NAME(always_available, glsl_type::vec3_type,  glsl_type::float_type), \
@@ -1487,7 +1581,7 @@ builtin_builder::create_builtins()
    F(asin)
    F(acos)
 
-   add_function("atan",
+   ADD_FUNCTION("atan",
                 _atan(glsl_type::float_type),
                 _atan(glsl_type::vec2_type),
                 _atan(glsl_type::vec3_type),
@@ -1520,7 +1614,7 @@ builtin_builder::create_builtins()
    FD(ceil)
    FD(fract)
 
-   add_function("mod",
+   ADD_FUNCTION("mod",
                 _mod(always_available, glsl_type::float_type, glsl_type::float_type),
                 _mod(always_available, glsl_type::vec2_type,  glsl_type::float_type),
                 _mod(always_available, glsl_type::vec3_type,  glsl_type::float_type),
@@ -1546,7 +1640,7 @@ builtin_builder::create_builtins()
    FIUD2_MIXED(max)
    FIUD2_MIXED(clamp)
 
-   add_function("mix",
+   ADD_FUNCTION("mix",
                 _mix_lrp(always_available, glsl_type::float_type, glsl_type::float_type),
                 _mix_lrp(always_available, glsl_type::vec2_type,  glsl_type::float_type),
                 _mix_lrp(always_available, glsl_type::vec3_type,  glsl_type::float_type),
@@ -1601,7 +1695,7 @@ builtin_builder::create_builtins()
                 _mix_sel(int64, glsl_type::u64vec4_type, glsl_type::bvec4_type),
                 NULL);
 
-   add_function("step",
+   ADD_FUNCTION("step",
                 _step(always_available, glsl_type::float_type, glsl_type::float_type),
                 _step(always_available, glsl_type::float_type, glsl_type::vec2_type),
                 _step(always_available, glsl_type::float_type, glsl_type::vec3_type),
@@ -1620,7 +1714,7 @@ builtin_builder::create_builtins()
                 _step(fp64, glsl_type::dvec4_type,  glsl_type::dvec4_type),
                 NULL);
 
-   add_function("smoothstep",
+   ADD_FUNCTION("smoothstep",
                 _smoothstep(always_available, glsl_type::float_type, glsl_type::float_type),
                 _smoothstep(always_available, glsl_type::float_type, glsl_type::vec2_type),
                 _smoothstep(always_available, glsl_type::float_type, glsl_type::vec3_type),
@@ -1644,79 +1738,79 @@ builtin_builder::create_builtins()
 
    F(floatBitsToInt)
    F(floatBitsToUint)
-   add_function("intBitsToFloat",
+   ADD_FUNCTION("intBitsToFloat",
                 _intBitsToFloat(glsl_type::int_type),
                 _intBitsToFloat(glsl_type::ivec2_type),
                 _intBitsToFloat(glsl_type::ivec3_type),
                 _intBitsToFloat(glsl_type::ivec4_type),
                 NULL);
-   add_function("uintBitsToFloat",
+   ADD_FUNCTION("uintBitsToFloat",
                 _uintBitsToFloat(glsl_type::uint_type),
                 _uintBitsToFloat(glsl_type::uvec2_type),
                 _uintBitsToFloat(glsl_type::uvec3_type),
                 _uintBitsToFloat(glsl_type::uvec4_type),
                 NULL);
 
-   add_function("doubleBitsToInt64",
+   ADD_FUNCTION("doubleBitsToInt64",
                 _doubleBitsToInt64(int64_fp64, glsl_type::double_type),
                 _doubleBitsToInt64(int64_fp64, glsl_type::dvec2_type),
                 _doubleBitsToInt64(int64_fp64, glsl_type::dvec3_type),
                 _doubleBitsToInt64(int64_fp64, glsl_type::dvec4_type),
                 NULL);
 
-   add_function("doubleBitsToUint64",
+   ADD_FUNCTION("doubleBitsToUint64",
                 _doubleBitsToUint64(int64_fp64, glsl_type::double_type),
                 _doubleBitsToUint64(int64_fp64, glsl_type::dvec2_type),
                 _doubleBitsToUint64(int64_fp64, glsl_type::dvec3_type),
                 _doubleBitsToUint64(int64_fp64, glsl_type::dvec4_type),
                 NULL);
 
-   add_function("int64BitsToDouble",
+   ADD_FUNCTION("int64BitsToDouble",
                 _int64BitsToDouble(int64_fp64, glsl_type::int64_t_type),
                 _int64BitsToDouble(int64_fp64, glsl_type::i64vec2_type),
                 _int64BitsToDouble(int64_fp64, glsl_type::i64vec3_type),
                 _int64BitsToDouble(int64_fp64, glsl_type::i64vec4_type),
                 NULL);
 
-   add_function("uint64BitsToDouble",
+   ADD_FUNCTION("uint64BitsToDouble",
                 _uint64BitsToDouble(int64_fp64, glsl_type::uint64_t_type),
                 _uint64BitsToDouble(int64_fp64, glsl_type::u64vec2_type),
                 _uint64BitsToDouble(int64_fp64, glsl_type::u64vec3_type),
                 _uint64BitsToDouble(int64_fp64, glsl_type::u64vec4_type),
                 NULL);
 
-   add_function("packUnorm2x16",   _packUnorm2x16(shader_packing_or_es3_or_gpu_shader5),   NULL);
-   add_function("packSnorm2x16",   _packSnorm2x16(shader_packing_or_es3),                  NULL);
-   add_function("packUnorm4x8",    _packUnorm4x8(shader_packing_or_es31_or_gpu_shader5),   NULL);
-   add_function("packSnorm4x8",    _packSnorm4x8(shader_packing_or_es31_or_gpu_shader5),   NULL);
-   add_function("unpackUnorm2x16", _unpackUnorm2x16(shader_packing_or_es3_or_gpu_shader5), NULL);
-   add_function("unpackSnorm2x16", _unpackSnorm2x16(shader_packing_or_es3),                NULL);
-   add_function("unpackUnorm4x8",  _unpackUnorm4x8(shader_packing_or_es31_or_gpu_shader5), NULL);
-   add_function("unpackSnorm4x8",  _unpackSnorm4x8(shader_packing_or_es31_or_gpu_shader5), NULL);
-   add_function("packHalf2x16",    _packHalf2x16(shader_packing_or_es3),                   NULL);
-   add_function("unpackHalf2x16",  _unpackHalf2x16(shader_packing_or_es3),                 NULL);
-   add_function("packDouble2x32",    _packDouble2x32(fp64),                   NULL);
-   add_function("unpackDouble2x32",  _unpackDouble2x32(fp64),                 NULL);
-
-   add_function("packInt2x32",     _packInt2x32(int64),                    NULL);
-   add_function("unpackInt2x32",   _unpackInt2x32(int64),                  NULL);
-   add_function("packUint2x32",    _packUint2x32(int64),                   NULL);
-   add_function("unpackUint2x32",  _unpackUint2x32(int64),                 NULL);
+   ADD_FUNCTION("packUnorm2x16",   _packUnorm2x16(shader_packing_or_es3_or_gpu_shader5),   NULL);
+   ADD_FUNCTION("packSnorm2x16",   _packSnorm2x16(shader_packing_or_es3),                  NULL);
+   ADD_FUNCTION("packUnorm4x8",    _packUnorm4x8(shader_packing_or_es31_or_gpu_shader5),   NULL);
+   ADD_FUNCTION("packSnorm4x8",    _packSnorm4x8(shader_packing_or_es31_or_gpu_shader5),   NULL);
+   ADD_FUNCTION("unpackUnorm2x16", _unpackUnorm2x16(shader_packing_or_es3_or_gpu_shader5), NULL);
+   ADD_FUNCTION("unpackSnorm2x16", _unpackSnorm2x16(shader_packing_or_es3),                NULL);
+   ADD_FUNCTION("unpackUnorm4x8",  _unpackUnorm4x8(shader_packing_or_es31_or_gpu_shader5), NULL);
+   ADD_FUNCTION("unpackSnorm4x8",  _unpackSnorm4x8(shader_packing_or_es31_or_gpu_shader5), NULL);
+   ADD_FUNCTION("packHalf2x16",    _packHalf2x16(shader_packing_or_es3),                   NULL);
+   ADD_FUNCTION("unpackHalf2x16",  _unpackHalf2x16(shader_packing_or_es3),                 NULL);
+   ADD_FUNCTION("packDouble2x32",    _packDouble2x32(fp64),                   NULL);
+   ADD_FUNCTION("unpackDouble2x32",  _unpackDouble2x32(fp64),                 NULL);
+
+   ADD_FUNCTION("packInt2x32",     _packInt2x32(int64),                    NULL);
+   ADD_FUNCTION("unpackInt2x32",   _unpackInt2x32(int64),                  NULL);
+   ADD_FUNCTION("packUint2x32",    _packUint2x32(int64),                   NULL);
+   ADD_FUNCTION("unpackUint2x32",  _unpackUint2x32(int64),                 NULL);
 
    FD(length)
    FD(distance)
    FD(dot)
 
-   add_function("cross", _cross(always_available, glsl_type::vec3_type),
+   ADD_FUNCTION("cross", _cross(always_available, glsl_type::vec3_type),
                 _cross(fp64, glsl_type::dvec3_type), NULL);
 
    FD(normalize)
-   add_function("ftransform", _ftransform(), NULL);
+   ADD_FUNCTION("ftransform", _ftransform(), NULL);
    FD(faceforward)
    FD(reflect)
    FD(refract)
    // ...
-   add_function("matrixCompMult",
+   ADD_FUNCTION("matrixCompMult",
                 _matrixCompMult(always_available, glsl_type::mat2_type),
                 _matrixCompMult(always_available, glsl_type::mat3_type),
                 _matrixCompMult(always_available, glsl_type::mat4_type),
@@ -1736,7 +1830,7 @@ builtin_builder::create_builtins()
                 _matrixCompMult(fp64, glsl_type::dmat4x2_type),
                 _matrixCompMult(fp64, glsl_type::dmat4x3_type),
                 NULL);
-   add_function("outerProduct",
+   ADD_FUNCTION("outerProduct",
                 _outerProduct(v120, glsl_type::mat2_type),
                 _outerProduct(v120, glsl_type::mat3_type),
                 _outerProduct(v120, glsl_type::mat4_type),
@@ -1756,7 +1850,7 @@ builtin_builder::create_builtins()
                 _outerProduct(fp64, glsl_type::dmat4x2_type),
                 _outerProduct(fp64, glsl_type::dmat4x3_type),
                 NULL);
-   add_function("determinant",
+   ADD_FUNCTION("determinant",
                 _determinant_mat2(v120, glsl_type::mat2_type),
                 _determinant_mat3(v120, glsl_type::mat3_type),
                 _determinant_mat4(v120, glsl_type::mat4_type),
@@ -1765,7 +1859,7 @@ builtin_builder::create_builtins()
                 _determinant_mat4(fp64, glsl_type::dmat4_type),
 
                 NULL);
-   add_function("inverse",
+   ADD_FUNCTION("inverse",
                 _inverse_mat2(v140_or_es3, glsl_type::mat2_type),
                 _inverse_mat3(v140_or_es3, glsl_type::mat3_type),
                 _inverse_mat4(v140_or_es3, glsl_type::mat4_type),
@@ -1773,7 +1867,7 @@ builtin_builder::create_builtins()
                 _inverse_mat3(fp64, glsl_type::dmat3_type),
                 _inverse_mat4(fp64, glsl_type::dmat4_type),
                 NULL);
-   add_function("transpose",
+   ADD_FUNCTION("transpose",
                 _transpose(v120, glsl_type::mat2_type),
                 _transpose(v120, glsl_type::mat3_type),
                 _transpose(v120, glsl_type::mat4_type),
@@ -1800,25 +1894,25 @@ builtin_builder::create_builtins()
    FIUBD_VEC(notEqual)
    FIUBD_VEC(equal)
 
-   add_function("any",
+   ADD_FUNCTION("any",
                 _any(glsl_type::bvec2_type),
                 _any(glsl_type::bvec3_type),
                 _any(glsl_type::bvec4_type),
                 NULL);
 
-   add_function("all",
+   ADD_FUNCTION("all",
                 _all(glsl_type::bvec2_type),
                 _all(glsl_type::bvec3_type),
                 _all(glsl_type::bvec4_type),
                 NULL);
 
-   add_function("not",
+   ADD_FUNCTION("not",
                 _not(glsl_type::bvec2_type),
                 _not(glsl_type::bvec3_type),
                 _not(glsl_type::bvec4_type),
                 NULL);
 
-   add_function("textureSize",
+   ADD_FUNCTION("textureSize",
                 _textureSize(v130, glsl_type::int_type,   glsl_type::sampler1D_type),
                 _textureSize(v130, glsl_type::int_type,   glsl_type::isampler1D_type),
                 _textureSize(v130, glsl_type::int_type,   glsl_type::usampler1D_type),
@@ -1871,7 +1965,7 @@ builtin_builder::create_builtins()
                 _textureSize(texture_multisample_array, glsl_type::ivec3_type, glsl_type::usampler2DMSArray_type),
                 NULL);
 
-   add_function("textureSamples",
+   ADD_FUNCTION("textureSamples",
                 _textureSamples(shader_samples, glsl_type::sampler2DMS_type),
                 _textureSamples(shader_samples, glsl_type::isampler2DMS_type),
                 _textureSamples(shader_samples, glsl_type::usampler2DMS_type),
@@ -1881,7 +1975,7 @@ builtin_builder::create_builtins()
                 _textureSamples(shader_samples, glsl_type::usampler2DMSArray_type),
                 NULL);
 
-   add_function("texture",
+   ADD_FUNCTION("texture",
                 _texture(ir_tex, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::float_type),
                 _texture(ir_tex, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::float_type),
                 _texture(ir_tex, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::float_type),
@@ -1964,7 +2058,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txb, v130_fs_only, glsl_type::float_type, glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("textureLod",
+   ADD_FUNCTION("textureLod",
                 _texture(ir_txl, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::float_type),
                 _texture(ir_txl, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::float_type),
                 _texture(ir_txl, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::float_type),
@@ -1999,7 +2093,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txl, v130, glsl_type::float_type, glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("textureOffset",
+   ADD_FUNCTION("textureOffset",
                 _texture(ir_tex, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::float_type, TEX_OFFSET),
                 _texture(ir_tex, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::float_type, TEX_OFFSET),
                 _texture(ir_tex, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::float_type, TEX_OFFSET),
@@ -2064,7 +2158,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txb, v130_fs_only, glsl_type::float_type, glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type, TEX_OFFSET),
                 NULL);
 
-   add_function("textureProj",
+   ADD_FUNCTION("textureProj",
                 _texture(ir_tex, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_tex, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_tex, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
@@ -2120,7 +2214,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txb, v130_fs_only, glsl_type::float_type, glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texelFetch",
+   ADD_FUNCTION("texelFetch",
                 _texelFetch(v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::int_type),
                 _texelFetch(v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::int_type),
                 _texelFetch(v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::int_type),
@@ -2162,7 +2256,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 
-   add_function("texelFetchOffset",
+   ADD_FUNCTION("texelFetchOffset",
                 _texelFetch(v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::int_type, glsl_type::int_type),
                 _texelFetch(v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::int_type, glsl_type::int_type),
                 _texelFetch(v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::int_type, glsl_type::int_type),
@@ -2189,7 +2283,7 @@ builtin_builder::create_builtins()
 
                 NULL);
 
-   add_function("textureProjOffset",
+   ADD_FUNCTION("textureProjOffset",
                 _texture(ir_tex, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
                 _texture(ir_tex, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
                 _texture(ir_tex, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
@@ -2242,7 +2336,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txb, v130_fs_only, glsl_type::float_type, glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT | TEX_OFFSET),
                 NULL);
 
-   add_function("textureLodOffset",
+   ADD_FUNCTION("textureLodOffset",
                 _texture(ir_txl, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::float_type, TEX_OFFSET),
                 _texture(ir_txl, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::float_type, TEX_OFFSET),
                 _texture(ir_txl, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::float_type, TEX_OFFSET),
@@ -2269,7 +2363,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txl, v130, glsl_type::float_type, glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type, TEX_OFFSET),
                 NULL);
 
-   add_function("textureProjLod",
+   ADD_FUNCTION("textureProjLod",
                 _texture(ir_txl, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txl, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txl, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
@@ -2292,7 +2386,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txl, v130, glsl_type::float_type, glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("textureProjLodOffset",
+   ADD_FUNCTION("textureProjLodOffset",
                 _texture(ir_txl, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
                 _texture(ir_txl, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
                 _texture(ir_txl, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
@@ -2315,7 +2409,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txl, v130, glsl_type::float_type, glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT | TEX_OFFSET),
                 NULL);
 
-   add_function("textureGrad",
+   ADD_FUNCTION("textureGrad",
                 _texture(ir_txd, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::float_type),
                 _texture(ir_txd, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::float_type),
                 _texture(ir_txd, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::float_type),
@@ -2358,7 +2452,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txd, v130, glsl_type::float_type, glsl_type::sampler2DArrayShadow_type, glsl_type::vec4_type),
                 NULL);
 
-   add_function("textureGradOffset",
+   ADD_FUNCTION("textureGradOffset",
                 _texture(ir_txd, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::float_type, TEX_OFFSET),
                 _texture(ir_txd, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::float_type, TEX_OFFSET),
                 _texture(ir_txd, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::float_type, TEX_OFFSET),
@@ -2392,7 +2486,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txd, v130, glsl_type::float_type, glsl_type::sampler2DArrayShadow_type, glsl_type::vec4_type, TEX_OFFSET),
                 NULL);
 
-   add_function("textureProjGrad",
+   ADD_FUNCTION("textureProjGrad",
                 _texture(ir_txd, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txd, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txd, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
@@ -2424,7 +2518,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txd, v130, glsl_type::float_type, glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("textureProjGradOffset",
+   ADD_FUNCTION("textureProjGradOffset",
                 _texture(ir_txd, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
                 _texture(ir_txd, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
                 _texture(ir_txd, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
@@ -2456,19 +2550,19 @@ builtin_builder::create_builtins()
                 _texture(ir_txd, v130, glsl_type::float_type, glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT | TEX_OFFSET),
                 NULL);
 
-   add_function("EmitVertex",   _EmitVertex(),   NULL);
-   add_function("EndPrimitive", _EndPrimitive(), NULL);
-   add_function("EmitStreamVertex",
+   ADD_FUNCTION("EmitVertex",   _EmitVertex(),   NULL);
+   ADD_FUNCTION("EndPrimitive", _EndPrimitive(), NULL);
+   ADD_FUNCTION("EmitStreamVertex",
                 _EmitStreamVertex(gs_streams, glsl_type::uint_type),
                 _EmitStreamVertex(gs_streams, glsl_type::int_type),
                 NULL);
-   add_function("EndStreamPrimitive",
+   ADD_FUNCTION("EndStreamPrimitive",
                 _EndStreamPrimitive(gs_streams, glsl_type::uint_type),
                 _EndStreamPrimitive(gs_streams, glsl_type::int_type),
                 NULL);
-   add_function("barrier", _barrier(), NULL);
+   ADD_FUNCTION("barrier", _barrier(), NULL);
 
-   add_function("textureQueryLOD",
+   ADD_FUNCTION("textureQueryLOD",
                 _textureQueryLod(texture_query_lod, glsl_type::sampler1D_type,  glsl_type::float_type),
                 _textureQueryLod(texture_query_lod, glsl_type::isampler1D_type, glsl_type::float_type),
                 _textureQueryLod(texture_query_lod, glsl_type::usampler1D_type, glsl_type::float_type),
@@ -2505,7 +2599,7 @@ builtin_builder::create_builtins()
                 _textureQueryLod(texture_query_lod, glsl_type::samplerCubeArrayShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("textureQueryLod",
+   ADD_FUNCTION("textureQueryLod",
                 _textureQueryLod(v400_fs_only, glsl_type::sampler1D_type,  glsl_type::float_type),
                 _textureQueryLod(v400_fs_only, glsl_type::isampler1D_type, glsl_type::float_type),
                 _textureQueryLod(v400_fs_only, glsl_type::usampler1D_type, glsl_type::float_type),
@@ -2542,7 +2636,7 @@ builtin_builder::create_builtins()
                 _textureQueryLod(v400_fs_only, glsl_type::samplerCubeArrayShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("textureQueryLevels",
+   ADD_FUNCTION("textureQueryLevels",
                 _textureQueryLevels(texture_query_levels, glsl_type::sampler1D_type),
                 _textureQueryLevels(texture_query_levels, glsl_type::sampler2D_type),
                 _textureQueryLevels(texture_query_levels, glsl_type::sampler3D_type),
@@ -2575,7 +2669,7 @@ builtin_builder::create_builtins()
 
                 NULL);
 
-   add_function("textureSamplesIdenticalEXT",
+   ADD_FUNCTION("textureSamplesIdenticalEXT",
                 _textureSamplesIdentical(texture_samples_identical, glsl_type::sampler2DMS_type,  glsl_type::ivec2_type),
                 _textureSamplesIdentical(texture_samples_identical, glsl_type::isampler2DMS_type, glsl_type::ivec2_type),
                 _textureSamplesIdentical(texture_samples_identical, glsl_type::usampler2DMS_type, glsl_type::ivec2_type),
@@ -2585,48 +2679,48 @@ builtin_builder::create_builtins()
                 _textureSamplesIdentical(texture_samples_identical_array, glsl_type::usampler2DMSArray_type, glsl_type::ivec3_type),
                 NULL);
 
-   add_function("texture1D",
+   ADD_FUNCTION("texture1D",
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::float_type),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::float_type),
                 NULL);
 
-   add_function("texture1DArray",
+   ADD_FUNCTION("texture1DArray",
                 _texture(ir_tex, texture_array,    glsl_type::vec4_type, glsl_type::sampler1DArray_type, glsl_type::vec2_type),
                 _texture(ir_txb, fs_texture_array, glsl_type::vec4_type, glsl_type::sampler1DArray_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture1DProj",
+   ADD_FUNCTION("texture1DProj",
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec4_type, TEX_PROJECT),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture1DLod",
+   ADD_FUNCTION("texture1DLod",
                 _texture(ir_txl, tex1d_lod, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::float_type),
                 NULL);
 
-   add_function("texture1DArrayLod",
+   ADD_FUNCTION("texture1DArrayLod",
                 _texture(ir_txl, texture_array_lod, glsl_type::vec4_type, glsl_type::sampler1DArray_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture1DProjLod",
+   ADD_FUNCTION("texture1DProjLod",
                 _texture(ir_txl, tex1d_lod, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txl, tex1d_lod, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture2D",
+   ADD_FUNCTION("texture2D",
                 _texture(ir_tex, always_available, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec2_type),
                 _texture(ir_txb, fs_only,          glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec2_type),
                 _texture(ir_tex, texture_external, glsl_type::vec4_type,  glsl_type::samplerExternalOES_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture2DArray",
+   ADD_FUNCTION("texture2DArray",
                 _texture(ir_tex, texture_array,    glsl_type::vec4_type, glsl_type::sampler2DArray_type, glsl_type::vec3_type),
                 _texture(ir_txb, fs_texture_array, glsl_type::vec4_type, glsl_type::sampler2DArray_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("texture2DProj",
+   ADD_FUNCTION("texture2DProj",
                 _texture(ir_tex, always_available, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec3_type, TEX_PROJECT),
                 _texture(ir_tex, always_available, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec4_type, TEX_PROJECT),
                 _texture(ir_txb, fs_only,          glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec3_type, TEX_PROJECT),
@@ -2635,177 +2729,177 @@ builtin_builder::create_builtins()
                 _texture(ir_tex, texture_external, glsl_type::vec4_type,  glsl_type::samplerExternalOES_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture2DLod",
+   ADD_FUNCTION("texture2DLod",
                 _texture(ir_txl, lod_exists_in_stage, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture2DArrayLod",
+   ADD_FUNCTION("texture2DArrayLod",
                 _texture(ir_txl, texture_array_lod, glsl_type::vec4_type, glsl_type::sampler2DArray_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("texture2DProjLod",
+   ADD_FUNCTION("texture2DProjLod",
                 _texture(ir_txl, lod_exists_in_stage, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec3_type, TEX_PROJECT),
                 _texture(ir_txl, lod_exists_in_stage, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture3D",
+   ADD_FUNCTION("texture3D",
                 _texture(ir_tex, tex3d,    glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec3_type),
                 _texture(ir_txb, fs_tex3d, glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("texture3DProj",
+   ADD_FUNCTION("texture3DProj",
                 _texture(ir_tex, tex3d,    glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec4_type, TEX_PROJECT),
                 _texture(ir_txb, fs_tex3d, glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture3DLod",
+   ADD_FUNCTION("texture3DLod",
                 _texture(ir_txl, tex3d_lod, glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("texture3DProjLod",
+   ADD_FUNCTION("texture3DProjLod",
                 _texture(ir_txl, tex3d_lod, glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("textureCube",
+   ADD_FUNCTION("textureCube",
                 _texture(ir_tex, always_available, glsl_type::vec4_type,  glsl_type::samplerCube_type, glsl_type::vec3_type),
                 _texture(ir_txb, fs_only,          glsl_type::vec4_type,  glsl_type::samplerCube_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("textureCubeLod",
+   ADD_FUNCTION("textureCubeLod",
                 _texture(ir_txl, lod_exists_in_stage, glsl_type::vec4_type,  glsl_type::samplerCube_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("texture2DRect",
+   ADD_FUNCTION("texture2DRect",
                 _texture(ir_tex, texture_rectangle, glsl_type::vec4_type,  glsl_type::sampler2DRect_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture2DRectProj",
+   ADD_FUNCTION("texture2DRectProj",
                 _texture(ir_tex, texture_rectangle, glsl_type::vec4_type,  glsl_type::sampler2DRect_type, glsl_type::vec3_type, TEX_PROJECT),
                 _texture(ir_tex, texture_rectangle, glsl_type::vec4_type,  glsl_type::sampler2DRect_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow1D",
+   ADD_FUNCTION("shadow1D",
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec3_type),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow1DArray",
+   ADD_FUNCTION("shadow1DArray",
                 _texture(ir_tex, texture_array,    glsl_type::vec4_type,  glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type),
                 _texture(ir_txb, fs_texture_array, glsl_type::vec4_type,  glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow2D",
+   ADD_FUNCTION("shadow2D",
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec3_type),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow2DArray",
+   ADD_FUNCTION("shadow2DArray",
                 _texture(ir_tex, texture_array,    glsl_type::vec4_type,  glsl_type::sampler2DArrayShadow_type, glsl_type::vec4_type),
                 _texture(ir_txb, fs_texture_array, glsl_type::vec4_type,  glsl_type::sampler2DArrayShadow_type, glsl_type::vec4_type),
                 NULL);
 
-   add_function("shadow1DProj",
+   ADD_FUNCTION("shadow1DProj",
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow2DProj",
+   ADD_FUNCTION("shadow2DProj",
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow1DLod",
+   ADD_FUNCTION("shadow1DLod",
                 _texture(ir_txl, v110_lod, glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow2DLod",
+   ADD_FUNCTION("shadow2DLod",
                 _texture(ir_txl, v110_lod, glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow1DArrayLod",
+   ADD_FUNCTION("shadow1DArrayLod",
                 _texture(ir_txl, texture_array_lod, glsl_type::vec4_type, glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow1DProjLod",
+   ADD_FUNCTION("shadow1DProjLod",
                 _texture(ir_txl, v110_lod, glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow2DProjLod",
+   ADD_FUNCTION("shadow2DProjLod",
                 _texture(ir_txl, v110_lod, glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow2DRect",
+   ADD_FUNCTION("shadow2DRect",
                 _texture(ir_tex, texture_rectangle, glsl_type::vec4_type,  glsl_type::sampler2DRectShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow2DRectProj",
+   ADD_FUNCTION("shadow2DRectProj",
                 _texture(ir_tex, texture_rectangle, glsl_type::vec4_type,  glsl_type::sampler2DRectShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture1DGradARB",
+   ADD_FUNCTION("texture1DGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::float_type),
                 NULL);
 
-   add_function("texture1DProjGradARB",
+   ADD_FUNCTION("texture1DProjGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture2DGradARB",
+   ADD_FUNCTION("texture2DGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture2DProjGradARB",
+   ADD_FUNCTION("texture2DProjGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec3_type, TEX_PROJECT),
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture3DGradARB",
+   ADD_FUNCTION("texture3DGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("texture3DProjGradARB",
+   ADD_FUNCTION("texture3DProjGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("textureCubeGradARB",
+   ADD_FUNCTION("textureCubeGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::samplerCube_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow1DGradARB",
+   ADD_FUNCTION("shadow1DGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow1DProjGradARB",
+   ADD_FUNCTION("shadow1DProjGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow2DGradARB",
+   ADD_FUNCTION("shadow2DGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow2DProjGradARB",
+   ADD_FUNCTION("shadow2DProjGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture2DRectGradARB",
+   ADD_FUNCTION("texture2DRectGradARB",
                 _texture(ir_txd, shader_texture_lod_and_rect, glsl_type::vec4_type,  glsl_type::sampler2DRect_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture2DRectProjGradARB",
+   ADD_FUNCTION("texture2DRectProjGradARB",
                 _texture(ir_txd, shader_texture_lod_and_rect, glsl_type::vec4_type,  glsl_type::sampler2DRect_type, glsl_type::vec3_type, TEX_PROJECT),
                 _texture(ir_txd, shader_texture_lod_and_rect, glsl_type::vec4_type,  glsl_type::sampler2DRect_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow2DRectGradARB",
+   ADD_FUNCTION("shadow2DRectGradARB",
                 _texture(ir_txd, shader_texture_lod_and_rect, glsl_type::vec4_type,  glsl_type::sampler2DRectShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow2DRectProjGradARB",
+   ADD_FUNCTION("shadow2DRectProjGradARB",
                 _texture(ir_txd, shader_texture_lod_and_rect, glsl_type::vec4_type,  glsl_type::sampler2DRectShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("textureGather",
+   ADD_FUNCTION("textureGather",
                 _texture(ir_tg4, texture_gather_or_es31, glsl_type::vec4_type, glsl_type::sampler2D_type, glsl_type::vec2_type),
                 _texture(ir_tg4, texture_gather_or_es31, glsl_type::ivec4_type, glsl_type::isampler2D_type, glsl_type::vec2_type),
                 _texture(ir_tg4, texture_gather_or_es31, glsl_type::uvec4_type, glsl_type::usampler2D_type, glsl_type::vec2_type),
@@ -2853,7 +2947,7 @@ builtin_builder::create_builtins()
                 _texture(ir_tg4, gpu_shader5, glsl_type::vec4_type, glsl_type::sampler2DRectShadow_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("textureGatherOffset",
+   ADD_FUNCTION("textureGatherOffset",
                 _texture(ir_tg4, texture_gather_only_or_es31, glsl_type::vec4_type, glsl_type::sampler2D_type, glsl_type::vec2_type, TEX_OFFSET),
                 _texture(ir_tg4, texture_gather_only_or_es31, glsl_type::ivec4_type, glsl_type::isampler2D_type, glsl_type::vec2_type, TEX_OFFSET),
                 _texture(ir_tg4, texture_gather_only_or_es31, glsl_type::uvec4_type, glsl_type::usampler2D_type, glsl_type::vec2_type, TEX_OFFSET),
@@ -2902,7 +2996,7 @@ builtin_builder::create_builtins()
                 _texture(ir_tg4, es31_not_gs5, glsl_type::vec4_type, glsl_type::sampler2DArrayShadow_type, glsl_type::vec3_type, TEX_OFFSET),
                 NULL);
 
-   add_function("textureGatherOffsets",
+   ADD_FUNCTION("textureGatherOffsets",
                 _texture(ir_tg4, gpu_shader5_es, glsl_type::vec4_type, glsl_type::sampler2D_type, glsl_type::vec2_type, TEX_OFFSET_ARRAY),
                 _texture(ir_tg4, gpu_shader5_es, glsl_type::ivec4_type, glsl_type::isampler2D_type, glsl_type::vec2_type, TEX_OFFSET_ARRAY),
                 _texture(ir_tg4, gpu_shader5_es, glsl_type::uvec4_type, glsl_type::usampler2D_type, glsl_type::vec2_type, TEX_OFFSET_ARRAY),
@@ -2954,7 +3048,7 @@ builtin_builder::create_builtins()
    IU(findMSB)
    FDGS5(fma)
 
-   add_function("ldexp",
+   ADD_FUNCTION("ldexp",
                 _ldexp(glsl_type::float_type, glsl_type::int_type),
                 _ldexp(glsl_type::vec2_type,  glsl_type::ivec2_type),
                 _ldexp(glsl_type::vec3_type,  glsl_type::ivec3_type),
@@ -2965,7 +3059,7 @@ builtin_builder::create_builtins()
                 _ldexp(glsl_type::dvec4_type,  glsl_type::ivec4_type),
                 NULL);
 
-   add_function("frexp",
+   ADD_FUNCTION("frexp",
                 _frexp(glsl_type::float_type, glsl_type::int_type),
                 _frexp(glsl_type::vec2_type,  glsl_type::ivec2_type),
                 _frexp(glsl_type::vec3_type,  glsl_type::ivec3_type),
@@ -2975,137 +3069,137 @@ builtin_builder::create_builtins()
                 _dfrexp(glsl_type::dvec3_type,  glsl_type::ivec3_type),
                 _dfrexp(glsl_type::dvec4_type,  glsl_type::ivec4_type),
                 NULL);
-   add_function("uaddCarry",
+   ADD_FUNCTION("uaddCarry",
                 _uaddCarry(glsl_type::uint_type),
                 _uaddCarry(glsl_type::uvec2_type),
                 _uaddCarry(glsl_type::uvec3_type),
                 _uaddCarry(glsl_type::uvec4_type),
                 NULL);
-   add_function("usubBorrow",
+   ADD_FUNCTION("usubBorrow",
                 _usubBorrow(glsl_type::uint_type),
                 _usubBorrow(glsl_type::uvec2_type),
                 _usubBorrow(glsl_type::uvec3_type),
                 _usubBorrow(glsl_type::uvec4_type),
                 NULL);
-   add_function("imulExtended",
+   ADD_FUNCTION("imulExtended",
                 _mulExtended(glsl_type::int_type),
                 _mulExtended(glsl_type::ivec2_type),
                 _mulExtended(glsl_type::ivec3_type),
                 _mulExtended(glsl_type::ivec4_type),
                 NULL);
-   add_function("umulExtended",
+   ADD_FUNCTION("umulExtended",
                 _mulExtended(glsl_type::uint_type),
                 _mulExtended(glsl_type::uvec2_type),
                 _mulExtended(glsl_type::uvec3_type),
                 _mulExtended(glsl_type::uvec4_type),
                 NULL);
-   add_function("interpolateAtCentroid",
+   ADD_FUNCTION("interpolateAtCentroid",
                 _interpolateAtCentroid(glsl_type::float_type),
                 _interpolateAtCentroid(glsl_type::vec2_type),
                 _interpolateAtCentroid(glsl_type::vec3_type),
                 _interpolateAtCentroid(glsl_type::vec4_type),
                 NULL);
-   add_function("interpolateAtOffset",
+   ADD_FUNCTION("interpolateAtOffset",
                 _interpolateAtOffset(glsl_type::float_type),
                 _interpolateAtOffset(glsl_type::vec2_type),
                 _interpolateAtOffset(glsl_type::vec3_type),
                 _interpolateAtOffset(glsl_type::vec4_type),
                 NULL);
-   add_function("interpolateAtSample",
+   ADD_FUNCTION("interpolateAtSample",
                 _interpolateAtSample(glsl_type::float_type),
                 _interpolateAtSample(glsl_type::vec2_type),
                 _interpolateAtSample(glsl_type::vec3_type),
                 _interpolateAtSample(glsl_type::vec4_type),
                 NULL);
 
-   add_function("atomicCounter",
+   ADD_FUNCTION("atomicCounter",
                 _atomic_counter_op("__intrinsic_atomic_read",
                                    shader_atomic_counters),
                 NULL);
-   add_function("atomicCounterIncrement",
+   ADD_FUNCTION("atomicCounterIncrement",
                 _atomic_counter_op("__intrinsic_atomic_increment",
                                    shader_atomic_counters),
                 NULL);
-   add_function("atomicCounterDecrement",
+   ADD_FUNCTION("atomicCounterDecrement",
                 _atomic_counter_op("__intrinsic_atomic_predecrement",
                                    shader_atomic_counters),
                 NULL);
 
-   add_function("atomicCounterAddARB",
+   ADD_FUNCTION("atomicCounterAddARB",
                 _atomic_counter_op1("__intrinsic_atomic_add",
                                     shader_atomic_counter_ops),
                 NULL);
-   add_function("atomicCounterSubtractARB",
+   ADD_FUNCTION("atomicCounterSubtractARB",
                 _atomic_counter_op1("__intrinsic_atomic_sub",
                                     shader_atomic_counter_ops),
                 NULL);
-   add_function("atomicCounterMinARB",
+   ADD_FUNCTION("atomicCounterMinARB",
                 _atomic_counter_op1("__intrinsic_atomic_min",
                                     shader_atomic_counter_ops),
                 NULL);
-   add_function("atomicCounterMaxARB",
+   ADD_FUNCTION("atomicCounterMaxARB",
                 _atomic_counter_op1("__intrinsic_atomic_max",
                                     shader_atomic_counter_ops),
                 NULL);
-   add_function("atomicCounterAndARB",
+   ADD_FUNCTION("atomicCounterAndARB",
                 _atomic_counter_op1("__intrinsic_atomic_and",
                                     shader_atomic_counter_ops),
                 NULL);
-   add_function("atomicCounterOrARB",
+   ADD_FUNCTION("atomicCounterOrARB",
                 _atomic_counter_op1("__intrinsic_atomic_or",
                                     shader_atomic_counter_ops),
                 NULL);
-   add_function("atomicCounterXorARB",
+   ADD_FUNCTION("atomicCounterXorARB",
                 _atomic_counter_op1("__intrinsic_atomic_xor",
                                     shader_atomic_counter_ops),
                 NULL);
-   add_function("atomicCounterExchangeARB",
+   ADD_FUNCTION("atomicCounterExchangeARB",
                 _atomic_counter_op1("__intrinsic_atomic_exchange",
                                     shader_atomic_counter_ops),
                 NULL);
-   add_function("atomicCounterCompSwapARB",
+   ADD_FUNCTION("atomicCounterCompSwapARB",
                 _atomic_counter_op2("__intrinsic_atomic_comp_swap",
                                     shader_atomic_counter_ops),
                 NULL);
 
-   add_function("atomicCounterAdd",
+   ADD_FUNCTION("atomicCounterAdd",
                 _atomic_counter_op1("__intrinsic_atomic_add",
                                     v460_desktop),
                 NULL);
-   add_function("atomicCounterSubtract",
+   ADD_FUNCTION("atomicCounterSubtract",
                 _atomic_counter_op1("__intrinsic_atomic_sub",
                                     v460_desktop),
                 NULL);
-   add_function("atomicCounterMin",
+   ADD_FUNCTION("atomicCounterMin",
                 _atomic_counter_op1("__intrinsic_atomic_min",
                                     v460_desktop),
                 NULL);
-   add_function("atomicCounterMax",
+   ADD_FUNCTION("atomicCounterMax",
                 _atomic_counter_op1("__intrinsic_atomic_max",
                                     v460_desktop),
                 NULL);
-   add_function("atomicCounterAnd",
+   ADD_FUNCTION("atomicCounterAnd",
                 _atomic_counter_op1("__intrinsic_atomic_and",
                                     v460_desktop),
                 NULL);
-   add_function("atomicCounterOr",
+   ADD_FUNCTION("atomicCounterOr",
                 _atomic_counter_op1("__intrinsic_atomic_or",
                                     v460_desktop),
                 NULL);
-   add_function("atomicCounterXor",
+   ADD_FUNCTION("atomicCounterXor",
                 _atomic_counter_op1("__intrinsic_atomic_xor",
                                     v460_desktop),
                 NULL);
-   add_function("atomicCounterExchange",
+   ADD_FUNCTION("atomicCounterExchange",
                 _atomic_counter_op1("__intrinsic_atomic_exchange",
                                     v460_desktop),
                 NULL);
-   add_function("atomicCounterCompSwap",
+   ADD_FUNCTION("atomicCounterCompSwap",
                 _atomic_counter_op2("__intrinsic_atomic_comp_swap",
                                     v460_desktop),
                 NULL);
 
-   add_function("atomicAdd",
+   ADD_FUNCTION("atomicAdd",
                 _atomic_op2("__intrinsic_atomic_add",
                             buffer_atomics_supported,
                             glsl_type::uint_type),
@@ -3113,7 +3207,7 @@ builtin_builder::create_builtins()
                             buffer_atomics_supported,
                             glsl_type::int_type),
                 NULL);
-   add_function("atomicMin",
+   ADD_FUNCTION("atomicMin",
                 _atomic_op2("__intrinsic_atomic_min",
                             buffer_atomics_supported,
                             glsl_type::uint_type),
@@ -3121,7 +3215,7 @@ builtin_builder::create_builtins()
                             buffer_atomics_supported,
                             glsl_type::int_type),
                 NULL);
-   add_function("atomicMax",
+   ADD_FUNCTION("atomicMax",
                 _atomic_op2("__intrinsic_atomic_max",
                             buffer_atomics_supported,
                             glsl_type::uint_type),
@@ -3129,7 +3223,7 @@ builtin_builder::create_builtins()
                             buffer_atomics_supported,
                             glsl_type::int_type),
                 NULL);
-   add_function("atomicAnd",
+   ADD_FUNCTION("atomicAnd",
                 _atomic_op2("__intrinsic_atomic_and",
                             buffer_atomics_supported,
                             glsl_type::uint_type),
@@ -3137,7 +3231,7 @@ builtin_builder::create_builtins()
                             buffer_atomics_supported,
                             glsl_type::int_type),
                 NULL);
-   add_function("atomicOr",
+   ADD_FUNCTION("atomicOr",
                 _atomic_op2("__intrinsic_atomic_or",
                             buffer_atomics_supported,
                             glsl_type::uint_type),
@@ -3145,7 +3239,7 @@ builtin_builder::create_builtins()
                             buffer_atomics_supported,
                             glsl_type::int_type),
                 NULL);
-   add_function("atomicXor",
+   ADD_FUNCTION("atomicXor",
                 _atomic_op2("__intrinsic_atomic_xor",
                             buffer_atomics_supported,
                             glsl_type::uint_type),
@@ -3153,7 +3247,7 @@ builtin_builder::create_builtins()
                             buffer_atomics_supported,
                             glsl_type::int_type),
                 NULL);
-   add_function("atomicExchange",
+   ADD_FUNCTION("atomicExchange",
                 _atomic_op2("__intrinsic_atomic_exchange",
                             buffer_atomics_supported,
                             glsl_type::uint_type),
@@ -3161,7 +3255,7 @@ builtin_builder::create_builtins()
                             buffer_atomics_supported,
                             glsl_type::int_type),
                 NULL);
-   add_function("atomicCompSwap",
+   ADD_FUNCTION("atomicCompSwap",
                 _atomic_op3("__intrinsic_atomic_comp_swap",
                             buffer_atomics_supported,
                             glsl_type::uint_type),
@@ -3170,7 +3264,7 @@ builtin_builder::create_builtins()
                             glsl_type::int_type),
                 NULL);
 
-   add_function("min3",
+   ADD_FUNCTION("min3",
                 _min3(glsl_type::float_type),
                 _min3(glsl_type::vec2_type),
                 _min3(glsl_type::vec3_type),
@@ -3187,7 +3281,7 @@ builtin_builder::create_builtins()
                 _min3(glsl_type::uvec4_type),
                 NULL);
 
-   add_function("max3",
+   ADD_FUNCTION("max3",
                 _max3(glsl_type::float_type),
                 _max3(glsl_type::vec2_type),
                 _max3(glsl_type::vec3_type),
@@ -3204,7 +3298,7 @@ builtin_builder::create_builtins()
                 _max3(glsl_type::uvec4_type),
                 NULL);
 
-   add_function("mid3",
+   ADD_FUNCTION("mid3",
                 _mid3(glsl_type::float_type),
                 _mid3(glsl_type::vec2_type),
                 _mid3(glsl_type::vec3_type),
@@ -3223,34 +3317,34 @@ builtin_builder::create_builtins()
 
    add_image_functions(true);
 
-   add_function("memoryBarrier",
+   ADD_FUNCTION("memoryBarrier",
                 _memory_barrier("__intrinsic_memory_barrier",
                                 shader_image_load_store),
                 NULL);
-   add_function("groupMemoryBarrier",
+   ADD_FUNCTION("groupMemoryBarrier",
                 _memory_barrier("__intrinsic_group_memory_barrier",
                                 compute_shader),
                 NULL);
-   add_function("memoryBarrierAtomicCounter",
+   ADD_FUNCTION("memoryBarrierAtomicCounter",
                 _memory_barrier("__intrinsic_memory_barrier_atomic_counter",
                                 compute_shader_supported),
                 NULL);
-   add_function("memoryBarrierBuffer",
+   ADD_FUNCTION("memoryBarrierBuffer",
                 _memory_barrier("__intrinsic_memory_barrier_buffer",
                                 compute_shader_supported),
                 NULL);
-   add_function("memoryBarrierImage",
+   ADD_FUNCTION("memoryBarrierImage",
                 _memory_barrier("__intrinsic_memory_barrier_image",
                                 compute_shader_supported),
                 NULL);
-   add_function("memoryBarrierShared",
+   ADD_FUNCTION("memoryBarrierShared",
                 _memory_barrier("__intrinsic_memory_barrier_shared",
                                 compute_shader),
                 NULL);
 
-   add_function("ballotARB", _ballot(), NULL);
+   ADD_FUNCTION("ballotARB", _ballot(), NULL);
 
-   add_function("readInvocationARB",
+   ADD_FUNCTION("readInvocationARB",
                 _read_invocation(glsl_type::float_type),
                 _read_invocation(glsl_type::vec2_type),
                 _read_invocation(glsl_type::vec3_type),
@@ -3267,7 +3361,7 @@ builtin_builder::create_builtins()
                 _read_invocation(glsl_type::uvec4_type),
                 NULL);
 
-   add_function("readFirstInvocationARB",
+   ADD_FUNCTION("readFirstInvocationARB",
                 _read_first_invocation(glsl_type::float_type),
                 _read_first_invocation(glsl_type::vec2_type),
                 _read_first_invocation(glsl_type::vec3_type),
@@ -3284,61 +3378,61 @@ builtin_builder::create_builtins()
                 _read_first_invocation(glsl_type::uvec4_type),
                 NULL);
 
-   add_function("clock2x32ARB",
+   ADD_FUNCTION("clock2x32ARB",
                 _shader_clock(shader_clock,
                               glsl_type::uvec2_type),
                 NULL);
 
-   add_function("clockARB",
+   ADD_FUNCTION("clockARB",
                 _shader_clock(shader_clock_int64,
                               glsl_type::uint64_t_type),
                 NULL);
 
-   add_function("anyInvocationARB",
+   ADD_FUNCTION("anyInvocationARB",
                 _vote("__intrinsic_vote_any", vote),
                 NULL);
 
-   add_function("allInvocationsARB",
+   ADD_FUNCTION("allInvocationsARB",
                 _vote("__intrinsic_vote_all", vote),
                 NULL);
 
-   add_function("allInvocationsEqualARB",
+   ADD_FUNCTION("allInvocationsEqualARB",
                 _vote("__intrinsic_vote_eq", vote),
                 NULL);
 
-   add_function("anyInvocation",
+   ADD_FUNCTION("anyInvocation",
                 _vote("__intrinsic_vote_any", v460_desktop),
                 NULL);
 
-   add_function("allInvocations",
+   ADD_FUNCTION("allInvocations",
                 _vote("__intrinsic_vote_all", v460_desktop),
                 NULL);
 
-   add_function("allInvocationsEqual",
+   ADD_FUNCTION("allInvocationsEqual",
                 _vote("__intrinsic_vote_eq", v460_desktop),
                 NULL);
 
-   add_function("__builtin_idiv64",
+   ADD_FUNCTION("__builtin_idiv64",
                 generate_ir::idiv64(mem_ctx, integer_functions_supported),
                 NULL);
 
-   add_function("__builtin_imod64",
+   ADD_FUNCTION("__builtin_imod64",
                 generate_ir::imod64(mem_ctx, integer_functions_supported),
                 NULL);
 
-   add_function("__builtin_sign64",
+   ADD_FUNCTION("__builtin_sign64",
                 generate_ir::sign64(mem_ctx, integer_functions_supported),
                 NULL);
 
-   add_function("__builtin_udiv64",
+   ADD_FUNCTION("__builtin_udiv64",
                 generate_ir::udiv64(mem_ctx, integer_functions_supported),
                 NULL);
 
-   add_function("__builtin_umod64",
+   ADD_FUNCTION("__builtin_umod64",
                 generate_ir::umod64(mem_ctx, integer_functions_supported),
                 NULL);
 
-   add_function("__builtin_umul64",
+   ADD_FUNCTION("__builtin_umul64",
                 generate_ir::umul64(mem_ctx, integer_functions_supported),
                 NULL);
 
@@ -3347,6 +3441,7 @@ builtin_builder::create_builtins()
 #undef FIUD_VEC
 #undef FIUBD_VEC
 #undef FIU2_MIXED
+#undef ADD_FUNCTION
 }
 
 void
@@ -3419,6 +3514,9 @@ builtin_builder::add_image_function(const char *name,
       glsl_type::uimage2DMSArray_type
    };
 
+   if (!is_requested(name))
+      return;
+
    ir_function *f = new(mem_ctx) ir_function(name);
 
    for (unsigned i = 0; i < ARRAY_SIZE(types); ++i) {
@@ -6326,7 +6424,7 @@ _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state, const char *name)
    ir_function *f;
    bool ret = false;
    mtx_lock(&builtins_lock);
-   f = builtins.shader->symbols->get_function(name);
+   f = builtins.get_function(name);
    if (f != NULL) {
       foreach_in_list(ir_function_signature, sig, &f->signatures) {
          if (sig->is_builtin_available(state)) {
@@ -6340,6 +6438,25 @@ _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state, const char *name)
    return ret;
 }
 
+ir_function *
+_mesa_glsl_find_builtin_function_by_name(const char *name)
+{
+   ir_function *f;
+   mtx_lock(&builtins_lock);
+   f = builtins.get_function(name);
+   mtx_unlock(&builtins_lock);
+
+   return f;
+}
+
+void
+_mesa_glsl_create_all_builtin_functions()
+{
+   mtx_lock(&builtins_lock);
+   builtins.create_all();
+   mtx_unlock(&builtins_lock);
+}
+
 gl_shader *
 _mesa_glsl_get_builtin_function_shader()
 {
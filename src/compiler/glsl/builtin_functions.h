@@ -35,6 +35,16 @@ extern bool
 _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state,
                                 const char *name);
 
+extern ir_function *
+_mesa_glsl_find_builtin_function_by_name(const char *name);
+
+/**
+ * Generate every built-in function now instead of on first use, replacing
+ * the ones generated so far.  Used to test the generation on first use.
+ */
+extern void
+_mesa_glsl_create_all_builtin_functions();
+
 extern gl_shader *
 _mesa_glsl_get_builtin_function_shader(void);
 
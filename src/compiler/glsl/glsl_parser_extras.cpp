@@ -35,6 +35,8 @@
 #include "util/ralloc.h"
 #include "util/disk_cache.h"
 #include "util/mesa-sha1.h"
+#include "util/debug.h"
+#include "util/os_time.h"
 #include "ast.h"
 #include "glsl_parser_extras.h"
 #include "glsl_parser.h"
@@ -1989,9 +1991,8 @@ opt_shader_and_create_symbol_table(struct gl_context *ctx,
                              ctx->Const.NativeIntegers);
    } else {
       /* Repeat it until it stops making changes. */
-      while (do_common_optimization(shader->ir, false, false, options,
-                                    ctx->Const.NativeIntegers))
-         ;
+      do_common_optimization_loop(shader->ir, false, false, options,
+                                  ctx->Const.NativeIntegers);
    }
 
    validate_ir_tree(shader->ir);
@@ -2046,8 +2047,10 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
          disk_cache_compute_key(ctx->Cache, source, strlen(source),
                                 shader->sha1);
          if (disk_cache_has_key(ctx->Cache, shader->sha1)) {
-            /* We've seen this shader before and know it compiles */
-            if (ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+            /* We've seen this shader before and know it compiles.  This may
+             * run on a compiler thread, so don't chase ctx->_Shader.
+             */
+            if (ctx->Shader.Flags & GLSL_CACHE_INFO) {
                _mesa_sha1_format(buf, shader->sha1);
                fprintf(stderr, "deferring compile of shader: %s\n", buf);
             }
@@ -2147,48 +2150,173 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
 }
 
 } /* extern "C" */
+namespace {
+
+#define MAX_COMMON_OPT_PASSES 32
+
 /**
- * Do the set of common optimizations passes
+ * Scheduling state of do_common_optimization_loop().
  *
- * \param ir                          List of instructions to be optimized
- * \param linked                      Is the shader linked?  This enables
- *                                    optimizations passes that remove code at
- *                                    global scope and could cause linking to
- *                                    fail.
- * \param uniform_locations_assigned  Have locations already been assigned for
- *                                    uniforms?  This prevents the declarations
- *                                    of unused uniforms from being removed.
- *                                    The setting of this flag only matters if
- *                                    \c linked is \c true.
- * \param options                     The driver's preferred shader options.
- * \param native_integers             Selects optimizations that depend on the
- *                                    implementations supporting integers
- *                                    natively (as opposed to supporting
- *                                    integers in floating point registers).
+ * A pass that made no progress can't make any before another pass changed
+ * the IR, so it is skipped until then.  The passes of a sweep always run in
+ * the same order, which identifies them by their index.
  */
-bool
-do_common_optimization(exec_list *ir, bool linked,
-		       bool uniform_locations_assigned,
-                       const struct gl_shader_compiler_options *options,
-                       bool native_integers)
+struct opt_schedule {
+   struct pass {
+      const char *name;
+      unsigned clean_at; /**< value of changes when it last made no progress */
+      unsigned runs;
+      unsigned skips;
+      unsigned progress;
+      int64_t time_ns;
+   };
+
+   opt_schedule(bool report)
+      : changes(0), next_pass(0), sweeps(0), report(report)
+   {
+      memset(passes, 0, sizeof(passes));
+      for (unsigned i = 0; i < MAX_COMMON_OPT_PASSES; i++)
+         passes[i].clean_at = ~0u;
+   }
+
+   void begin_sweep()
+   {
+      next_pass = 0;
+      sweeps++;
+   }
+
+   /**
+    * Returns whether the next pass of the sweep has to run.  Its index is
+    * returned in \p index.
+    */
+   bool begin_pass(const char *name, unsigned *index)
+   {
+      assert(next_pass < MAX_COMMON_OPT_PASSES);
+      *index = next_pass++;
+
+      struct pass *p = &passes[*index];
+      p->name = name;
+      if (p->clean_at == changes) {
+         p->skips++;
+         return false;
+      }
+
+      if (report)
+         p->time_ns -= os_time_get_nano();
+      return true;
+   }
+
+   void end_pass(unsigned index, bool progress)
+   {
+      struct pass *p = &passes[index];
+
+      if (report)
+         p->time_ns += os_time_get_nano();
+
+      p->runs++;
+      if (progress) {
+         p->progress++;
+         mark_dirty();
+      } else {
+         p->clean_at = changes;
+      }
+   }
+
+   /**
+    * Makes every pass run again on its next turn.  Code that changes the IR
+    * outside of begin_pass()/end_pass() has to call this.
+    */
+   void mark_dirty()
+   {
+      changes++;
+   }
+
+   void print_report(bool linked) const
+   {
+      int64_t total_ns = 0;
+
+      fprintf(stderr, "GLSL %s optimization loop: %u sweeps\n",
+              linked ? "linked" : "unlinked", sweeps);
+      fprintf(stderr, "  %-32s %6s %6s %9s %10s\n",
+              "pass", "runs", "skips", "progress", "time (us)");
+      for (unsigned i = 0; i < MAX_COMMON_OPT_PASSES && passes[i].name; i++) {
+         const struct pass *p = &passes[i];
+
+         fprintf(stderr, "  %-32s %6u %6u %9u %10.1f\n", p->name, p->runs,
+                 p->skips, p->progress, p->time_ns / 1000.0);
+         total_ns += p->time_ns;
+      }
+      fprintf(stderr, "  %-32s %6s %6s %9u %10.1f\n", "total", "", "",
+              changes, total_ns / 1000.0);
+   }
+
+   unsigned changes;   /**< number of pass runs that made progress */
+   unsigned next_pass;
+   unsigned sweeps;
+   bool report;
+   struct pass passes[MAX_COMMON_OPT_PASSES];
+};
+
+} /* anonymous namespace */
+
+static bool
+do_loop_unrolling(exec_list *ir,
+                  const struct gl_shader_compiler_options *options)
+{
+   bool progress = false;
+
+   loop_state *ls = analyze_loop_variables(ir);
+   if (ls->loop_found) {
+      progress = unroll_loops(ir, ls, options);
+
+      bool loop_progress = progress;
+      while (loop_progress) {
+         loop_progress = false;
+         loop_progress |= do_constant_propagation(ir);
+         loop_progress |= do_if_simplification(ir);
+      }
+   }
+   delete ls;
+
+   return progress;
+}
+
+/**
+ * Run one sweep of the common optimization passes.  If \p sched is not
+ * NULL, passes which can't make progress are skipped.
+ */
+static bool
+common_optimization_sweep(exec_list *ir, bool linked,
+                          bool uniform_locations_assigned,
+                          const struct gl_shader_compiler_options *options,
+                          bool native_integers, opt_schedule *sched)
 {
    const bool debug = false;
    GLboolean progress = GL_FALSE;
+   unsigned pass_index;
 
 #define OPT(PASS, ...) do {                                             \
+      if (sched && !sched->begin_pass(#PASS, &pass_index))              \
+         break;                                                         \
+      bool opt_progress;                                                \
       if (debug) {                                                      \
          fprintf(stderr, "START GLSL optimization %s\n", #PASS);        \
-         const bool opt_progress = PASS(__VA_ARGS__);                   \
-         progress = opt_progress || progress;                           \
+         opt_progress = PASS(__VA_ARGS__);                              \
          if (opt_progress)                                              \
             _mesa_print_ir(stderr, ir, NULL);                           \
          fprintf(stderr, "GLSL optimization %s: %s progress\n",         \
                  #PASS, opt_progress ? "made" : "no");                  \
       } else {                                                          \
-         progress = PASS(__VA_ARGS__) || progress;                      \
+         opt_progress = PASS(__VA_ARGS__);                              \
       }                                                                 \
+      progress = opt_progress || progress;                              \
+      if (sched)                                                        \
+         sched->end_pass(pass_index, opt_progress);                     \
    } while (false)
 
+   if (sched)
+      sched->begin_sweep();
+
    OPT(lower_instructions, ir, SUB_TO_ADD_NEG);
 
    if (linked) {
@@ -2196,7 +2324,7 @@ do_common_optimization(exec_list *ir, bool linked,
       OPT(do_dead_functions, ir);
       OPT(do_structure_splitting, ir);
    }
-   propagate_invariance(ir);
+   OPT(propagate_invariance, ir);
    OPT(do_if_simplification, ir);
    OPT(opt_flatten_nested_if_blocks, ir);
    OPT(opt_conditional_discard, ir);
@@ -2234,25 +2362,67 @@ do_common_optimization(exec_list *ir, bool linked,
    OPT(optimize_split_arrays, ir, linked);
    OPT(optimize_redundant_jumps, ir);
 
-   if (options->MaxUnrollIterations) {
-      loop_state *ls = analyze_loop_variables(ir);
-      if (ls->loop_found) {
-         bool loop_progress = unroll_loops(ir, ls, options);
-         while (loop_progress) {
-            loop_progress = false;
-            loop_progress |= do_constant_propagation(ir);
-            loop_progress |= do_if_simplification(ir);
-         }
-         progress |= loop_progress;
-      }
-      delete ls;
-   }
+   if (options->MaxUnrollIterations)
+      OPT(do_loop_unrolling, ir, options);
 
 #undef OPT
 
    return progress;
 }
 
+/**
+ * Do the set of common optimizations passes
+ *
+ * \param ir                          List of instructions to be optimized
+ * \param linked                      Is the shader linked?  This enables
+ *                                    optimizations passes that remove code at
+ *                                    global scope and could cause linking to
+ *                                    fail.
+ * \param uniform_locations_assigned  Have locations already been assigned for
+ *                                    uniforms?  This prevents the declarations
+ *                                    of unused uniforms from being removed.
+ *                                    The setting of this flag only matters if
+ *                                    \c linked is \c true.
+ * \param options                     The driver's preferred shader options.
+ * \param native_integers             Selects optimizations that depend on the
+ *                                    implementations supporting integers
+ *                                    natively (as opposed to supporting
+ *                                    integers in floating point registers).
+ */
+bool
+do_common_optimization(exec_list *ir, bool linked,
+		       bool uniform_locations_assigned,
+                       const struct gl_shader_compiler_options *options,
+                       bool native_integers)
+{
+   return common_optimization_sweep(ir, linked, uniform_locations_assigned,
+                                    options, native_integers, NULL);
+}
+
+/**
+ * Repeat the common optimization passes until they stop making progress.
+ *
+ * This gives the same result as calling do_common_optimization() until it
+ * returns false, but a pass is only run again once another pass changed the
+ * IR.  Setting MESA_GLSL_OPT_STATS=true prints how often each pass ran and
+ * the time it took.
+ */
+void
+do_common_optimization_loop(exec_list *ir, bool linked,
+                            bool uniform_locations_assigned,
+                            const struct gl_shader_compiler_options *options,
+                            bool native_integers)
+{
+   opt_schedule sched(env_var_as_boolean("MESA_GLSL_OPT_STATS", false));
+
+   while (common_optimization_sweep(ir, linked, uniform_locations_assigned,
+                                    options, native_integers, &sched))
+      ;
+
+   if (sched.report)
+      sched.print_report(linked);
+}
+
 extern "C" {
 
 /**
@@ -90,6 +90,10 @@ bool do_common_optimization(exec_list *ir, bool linked,
 			    bool uniform_locations_assigned,
                             const struct gl_shader_compiler_options *options,
                             bool native_integers);
+void do_common_optimization_loop(exec_list *ir, bool linked,
+                                 bool uniform_locations_assigned,
+                                 const struct gl_shader_compiler_options *options,
+                                 bool native_integers);
 
 bool ir_constant_fold(ir_rvalue **rvalue);
 
@@ -169,7 +173,7 @@ bool lower_cs_derived(gl_linked_shader *shader);
 bool lower_blend_equation_advanced(gl_linked_shader *shader, bool coherent);
 
 bool lower_subroutine(exec_list *instructions, struct _mesa_glsl_parse_state *state);
-void propagate_invariance(exec_list *instructions);
+bool propagate_invariance(exec_list *instructions);
 
 namespace ir_builder { class ir_factory; };
 
@@ -22,6 +22,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <getopt.h>
 
 /** @file main.cpp
@@ -38,6 +39,9 @@
 
 static struct standalone_options options;
 
+/** Largest value accepted by --threads.  0 means one thread per CPU. */
+#define MAX_BATCH_THREADS 256
+
 const struct option compiler_opts[] = {
    { "dump-ast", no_argument, &options.dump_ast, 1 },
    { "dump-hir", no_argument, &options.dump_hir, 1 },
@@ -46,6 +50,8 @@ const struct option compiler_opts[] = {
    { "link",     no_argument, &options.do_link,  1 },
    { "just-log", no_argument, &options.just_log, 1 },
    { "version",  required_argument, NULL, 'v' },
+   { "batch",    no_argument, &options.batch,    1 },
+   { "threads",  required_argument, NULL, 't' },
    { NULL, 0, NULL, 0 }
 };
 
@@ -58,9 +64,12 @@ usage_fail(const char *name)
 
    const char *header =
       "usage: %s [options] <file.vert | file.tesc | file.tese | file.geom | file.frag | file.comp>\n"
+      "       %s --batch [--threads N] <file.shader_test | directory>...\n"
+      "\n"
+      "--threads takes 0 (one per CPU) to %d.\n"
       "\n"
       "Possible options are:\n";
-   printf(header, name);
+   printf(header, name, name, MAX_BATCH_THREADS);
    for (const struct option *o = compiler_opts; o->name != 0; ++o) {
       printf("    --%s", o->name);
       if (o->has_arg == required_argument)
@@ -82,6 +91,16 @@ main(int argc, char * const* argv)
       case 'v':
          options.glsl_version = strtol(optarg, NULL, 10);
          break;
+      case 't': {
+         char *end;
+         long n = strtol(optarg, &end, 10);
+         if (end == optarg || *end != '\0' || n < 0 || n > MAX_BATCH_THREADS) {
+            fprintf(stderr, "%s: invalid thread count '%s'\n", argv[0], optarg);
+            usage_fail(argv[0]);
+         }
+         options.num_threads = n;
+         break;
+      }
       default:
          break;
       }
@@ -90,6 +109,10 @@ main(int argc, char * const* argv)
    if (argc <= optind)
       usage_fail(argv[0]);
 
+   /* Compile every .shader_test found and print compile-time statistics. */
+   if (options.batch)
+      return standalone_compile_batch(&options, argc - optind, &argv[optind]);
+
    struct gl_shader_program *whole_program;
 
    whole_program = standalone_compile_shader(&options, argc - optind, &argv[optind]);
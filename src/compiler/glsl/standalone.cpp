@@ -20,7 +20,14 @@
  * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
  * DEALINGS IN THE SOFTWARE.
  */
+#include <errno.h>
 #include <getopt.h>
+#include <limits.h>
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#endif
 
 /** @file standalone.cpp
  *
@@ -33,6 +40,7 @@
 #include "glsl_parser_extras.h"
 #include "ir_optimization.h"
 #include "program.h"
+#include "program/program.h"
 #include "loop_analysis.h"
 #include "standalone_scaffolding.h"
 #include "standalone.h"
@@ -43,6 +51,9 @@
 #include "ir_builder_print_visitor.h"
 #include "builtin_functions.h"
 #include "opt_add_neg_to_sub.h"
+#include "glsl_to_nir.h"
+#include "util/os_time.h"
+#include "util/u_queue.h"
 
 class dead_variable_visitor : public ir_hierarchical_visitor {
 public:
@@ -101,10 +112,12 @@ private:
 };
 
 static void
-init_gl_program(struct gl_program *prog, bool is_arb_asm)
+init_gl_program(struct gl_program *prog, GLenum target, bool is_arb_asm)
 {
    prog->RefCount = 1;
    prog->Format = GL_PROGRAM_FORMAT_ASCII_ARB;
+   prog->info.stage = (gl_shader_stage)
+      _mesa_program_enum_to_shader_stage(target);
    prog->is_arb_asm = is_arb_asm;
 }
 
@@ -120,7 +133,7 @@ new_program(UNUSED struct gl_context *ctx, GLenum target,
    case GL_FRAGMENT_PROGRAM_ARB:
    case GL_COMPUTE_PROGRAM_NV: {
       struct gl_program *prog = rzalloc(NULL, struct gl_program);
-      init_gl_program(prog, is_arb_asm);
+      init_gl_program(prog, target, is_arb_asm);
       return prog;
    }
    default:
@@ -131,15 +144,49 @@ new_program(UNUSED struct gl_context *ctx, GLenum target,
 
 static const struct standalone_options *options;
 
+/**
+ * Gets the API to compile shaders of the given GLSL version with.  Returns
+ * false if the version isn't supported.
+ */
+static bool
+get_glsl_api(int glsl_version, gl_api *api)
+{
+   switch (glsl_version) {
+   case 100:
+   case 300:
+      *api = API_OPENGLES2;
+      return true;
+   case 110:
+   case 120:
+   case 130:
+      *api = API_OPENGL_COMPAT;
+      return true;
+   case 140:
+   case 150:
+   case 330:
+   case 400:
+   case 410:
+   case 420:
+   case 430:
+   case 440:
+   case 450:
+   case 460:
+      *api = API_OPENGL_CORE;
+      return true;
+   default:
+      return false;
+   }
+}
+
 static void
-initialize_context(struct gl_context *ctx, gl_api api)
+initialize_context(struct gl_context *ctx, gl_api api, int glsl_version)
 {
    initialize_context_to_defaults(ctx, api);
 
    /* The standalone compiler needs to claim support for almost
     * everything in order to compile the built-in functions.
     */
-   ctx->Const.GLSLVersion = options->glsl_version;
+   ctx->Const.GLSLVersion = glsl_version;
    ctx->Extensions.ARB_ES3_compatibility = true;
    ctx->Const.MaxComputeWorkGroupCount[0] = 65535;
    ctx->Const.MaxComputeWorkGroupCount[1] = 65535;
@@ -401,6 +448,40 @@ compile_shader(struct gl_context *ctx, struct gl_shader *shader)
    return;
 }
 
+static struct gl_shader_program *
+create_shader_program(void)
+{
+   struct gl_shader_program *prog;
+
+   prog = rzalloc (NULL, struct gl_shader_program);
+   assert(prog != NULL);
+   prog->data = rzalloc(prog, struct gl_shader_program_data);
+   assert(prog->data != NULL);
+   prog->data->InfoLog = ralloc_strdup(prog->data, "");
+
+   /* Created just to avoid segmentation faults */
+   prog->AttributeBindings = new string_to_uint_map;
+   prog->FragDataBindings = new string_to_uint_map;
+   prog->FragDataIndexBindings = new string_to_uint_map;
+
+   return prog;
+}
+
+static void
+free_shader_program(struct gl_shader_program *prog)
+{
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (prog->_LinkedShaders[i])
+         ralloc_free(prog->_LinkedShaders[i]->Program);
+   }
+
+   delete prog->AttributeBindings;
+   delete prog->FragDataBindings;
+   delete prog->FragDataIndexBindings;
+
+   ralloc_free(prog);
+}
+
 extern "C" struct gl_shader_program *
 standalone_compile_shader(const struct standalone_options *_options,
       unsigned num_files, char* const* files)
@@ -408,53 +489,18 @@ standalone_compile_shader(const struct standalone_options *_options,
    int status = EXIT_SUCCESS;
    static struct gl_context local_ctx;
    struct gl_context *ctx = &local_ctx;
-   bool glsl_es = false;
+   gl_api api;
 
    options = _options;
 
-   switch (options->glsl_version) {
-   case 100:
-   case 300:
-      glsl_es = true;
-      break;
-   case 110:
-   case 120:
-   case 130:
-   case 140:
-   case 150:
-   case 330:
-   case 400:
-   case 410:
-   case 420:
-   case 430:
-   case 440:
-   case 450:
-   case 460:
-      glsl_es = false;
-      break;
-   default:
+   if (!get_glsl_api(options->glsl_version, &api)) {
       fprintf(stderr, "Unrecognized GLSL version `%d'\n", options->glsl_version);
       return NULL;
    }
 
-   if (glsl_es) {
-      initialize_context(ctx, API_OPENGLES2);
-   } else {
-      initialize_context(ctx, options->glsl_version > 130 ? API_OPENGL_CORE : API_OPENGL_COMPAT);
-   }
-
-   struct gl_shader_program *whole_program;
+   initialize_context(ctx, api, options->glsl_version);
 
-   whole_program = rzalloc (NULL, struct gl_shader_program);
-   assert(whole_program != NULL);
-   whole_program->data = rzalloc(whole_program, struct gl_shader_program_data);
-   assert(whole_program->data != NULL);
-   whole_program->data->InfoLog = ralloc_strdup(whole_program->data, "");
-
-   /* Created just to avoid segmentation faults */
-   whole_program->AttributeBindings = new string_to_uint_map;
-   whole_program->FragDataBindings = new string_to_uint_map;
-   whole_program->FragDataIndexBindings = new string_to_uint_map;
+   struct gl_shader_program *whole_program = create_shader_program();
 
    for (unsigned i = 0; i < num_files; i++) {
       whole_program->Shaders =
@@ -607,16 +653,450 @@ fail:
 extern "C" void
 standalone_compiler_cleanup(struct gl_shader_program *whole_program)
 {
+   free_shader_program(whole_program);
+
+   _mesa_glsl_release_types();
+   _mesa_glsl_release_builtin_functions();
+}
+
+/*
+ * Batch mode: compiles and links every .shader_test file found in the given
+ * files and directories on a pool of threads, through the GLSL IR and NIR
+ * pipelines, and reports how much time was spent in each stage.
+ */
+
+enum batch_stage {
+   BATCH_COMPILE,
+   BATCH_LINK,
+   BATCH_LOWER,
+   BATCH_GLSL_TO_NIR,
+   BATCH_NIR_OPT,
+   BATCH_NUM_STAGES
+};
+
+static const char *const batch_stage_names[BATCH_NUM_STAGES] = {
+   "compile",
+   "link",
+   "lower GLSL IR",
+   "glsl_to_nir",
+   "NIR optimize",
+};
+
+struct batch_shader {
+   GLenum type;
+   const char *source;
+};
+
+struct batch_job {
+   void *mem_ctx;
+   const char *path;
+   const struct gl_context *ctx;
+   struct batch_shader *shaders;
+   unsigned num_shaders;
+
+   struct util_queue_fence fence;
+   int64_t time_ns[BATCH_NUM_STAGES];
+   /* Why the program failed, or NULL. */
+   const char *error;
+};
+
+static nir_shader_compiler_options batch_nir_options;
+
+static const struct {
+   const char *name;
+   GLenum type;
+} batch_sections[] = {
+   { "[vertex shader]", GL_VERTEX_SHADER },
+   { "[tessellation control shader]", GL_TESS_CONTROL_SHADER },
+   { "[tessellation evaluation shader]", GL_TESS_EVALUATION_SHADER },
+   { "[geometry shader]", GL_GEOMETRY_SHADER },
+   { "[fragment shader]", GL_FRAGMENT_SHADER },
+   { "[compute shader]", GL_COMPUTE_SHADER },
+};
+
+/**
+ * Splits the text of a .shader_test file into its shaders and returns the
+ * GLSL version required by its [require] section, or 0 if there is none.
+ * The text is modified in place, so that each shader source is terminated.
+ */
+static int
+parse_shader_test(struct batch_job *job, char *text, bool *es)
+{
+   int glsl_version = 0;
+   bool in_require = false;
+
+   *es = false;
+
+   for (char *line = text; *line; ) {
+      char *next = strchr(line, '\n');
+      next = next ? next + 1 : line + strlen(line);
+
+      if (line[0] == '[') {
+         /* Terminate the previous section. */
+         *line = '\0';
+
+         in_require = strncmp(line + 1, "require]", 8) == 0;
+
+         for (unsigned i = 0; i < ARRAY_SIZE(batch_sections); i++) {
+            const size_t len = strlen(batch_sections[i].name);
+
+            if (strncmp(line + 1, batch_sections[i].name + 1, len - 1) != 0)
+               continue;
+
+            job->shaders = reralloc(job->mem_ctx, job->shaders,
+                                    struct batch_shader, job->num_shaders + 1);
+            job->shaders[job->num_shaders].type = batch_sections[i].type;
+            job->shaders[job->num_shaders].source = next;
+            job->num_shaders++;
+            break;
+         }
+      } else if (in_require) {
+         unsigned major, minor;
+
+         if (sscanf(line, " GLSL ES >= %u.%u", &major, &minor) == 2) {
+            glsl_version = major * 100 + minor;
+            *es = true;
+         } else if (sscanf(line, " GLSL >= %u.%u", &major, &minor) == 2) {
+            glsl_version = major * 100 + minor;
+         }
+      }
+
+      line = next;
+   }
+
+   return glsl_version;
+}
+
+static void
+batch_lower_glsl_ir(struct gl_context *ctx, struct gl_linked_shader *shader)
+{
+   exec_list *ir = shader->ir;
+
+   do_mat_op_to_vec(ir);
+   lower_instructions(ir, DIV_TO_MUL_RCP | SUB_TO_ADD_NEG | EXP_TO_EXP2 |
+                          LOG_TO_LOG2 | DFREXP_DLDEXP_TO_ARITH);
+   do_lower_texture_projection(ir);
+   do_vec_index_to_cond_assign(ir);
+   lower_vector_insert(ir, true);
+   lower_offset_arrays(ir);
+   lower_noise(ir);
+   lower_quadop_vector(ir, false);
+
+   do_common_optimization_loop(ir, true, false,
+                               &ctx->Const.ShaderCompilerOptions[shader->Stage],
+                               ctx->Const.NativeIntegers);
+}
+
+static void
+batch_optimize_nir(nir_shader *nir)
+{
+   nir_remove_dead_variables(nir, (nir_variable_mode)
+                             (nir_var_shader_in | nir_var_shader_out));
+   NIR_PASS_V(nir, nir_lower_global_vars_to_local);
+   NIR_PASS_V(nir, nir_split_var_copies);
+   NIR_PASS_V(nir, nir_lower_var_copies);
+
+   bool progress;
+   do {
+      progress = false;
+
+      NIR_PASS_V(nir, nir_lower_vars_to_ssa);
+      NIR_PASS(progress, nir, nir_copy_prop);
+      NIR_PASS(progress, nir, nir_opt_remove_phis);
+      NIR_PASS(progress, nir, nir_opt_dce);
+      NIR_PASS(progress, nir, nir_opt_if);
+      NIR_PASS(progress, nir, nir_opt_dead_cf);
+      NIR_PASS(progress, nir, nir_opt_cse);
+      NIR_PASS(progress, nir, nir_opt_peephole_select, 8);
+      NIR_PASS(progress, nir, nir_opt_algebraic);
+      NIR_PASS(progress, nir, nir_opt_constant_folding);
+      NIR_PASS(progress, nir, nir_opt_undef);
+      NIR_PASS(progress, nir, nir_opt_loop_unroll, (nir_variable_mode)0);
+   } while (progress);
+}
+
+static void
+batch_compile_program(void *data, int thread_index)
+{
+   struct batch_job *job = (struct batch_job *) data;
+   struct gl_context *ctx = (struct gl_context *) malloc(sizeof(*ctx));
+   struct gl_shader_program *prog = create_shader_program();
+   int64_t start;
+
+   /* Compiling and linking may change the context, so each job gets its
+    * own copy.
+    */
+   memcpy(ctx, job->ctx, sizeof(*ctx));
+
+   /* Like shader-db, link programs with a single stage as separate shader
+    * objects, so that e.g. lone fragment shaders link on ES.
+    */
+   prog->SeparateShader = job->shaders[0].type != GL_COMPUTE_SHADER;
+   for (unsigned i = 1; i < job->num_shaders; i++) {
+      if (job->shaders[i].type != job->shaders[0].type)
+         prog->SeparateShader = false;
+   }
+
+   start = os_time_get_nano();
+   for (unsigned i = 0; i < job->num_shaders; i++) {
+      struct gl_shader *shader = rzalloc(prog, gl_shader);
+
+      shader->Type = job->shaders[i].type;
+      shader->Stage = _mesa_shader_enum_to_shader_stage(shader->Type);
+      shader->Source = job->shaders[i].source;
+
+      prog->Shaders = reralloc(prog, prog->Shaders, struct gl_shader *,
+                               prog->NumShaders + 1);
+      prog->Shaders[prog->NumShaders++] = shader;
+
+      _mesa_glsl_compile_shader(ctx, shader, false, false, true);
+
+      if (!shader->CompileStatus) {
+         job->error = ralloc_asprintf(job->mem_ctx,
+                                      "%s shader failed to compile:\n%s",
+                                      _mesa_shader_stage_to_string(shader->Stage),
+                                      shader->InfoLog);
+         break;
+      }
+   }
+   job->time_ns[BATCH_COMPILE] = os_time_get_nano() - start;
+
+   if (job->error)
+      goto done;
+
+   start = os_time_get_nano();
+   _mesa_clear_shader_program_data(ctx, prog);
+   link_shaders(ctx, prog);
+   job->time_ns[BATCH_LINK] = os_time_get_nano() - start;
+
+   if (!prog->data->LinkStatus) {
+      job->error = ralloc_asprintf(job->mem_ctx, "failed to link:\n%s",
+                                   prog->data->InfoLog);
+      goto done;
+   }
+
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
-      if (whole_program->_LinkedShaders[i])
-         ralloc_free(whole_program->_LinkedShaders[i]->Program);
+      struct gl_linked_shader *shader = prog->_LinkedShaders[i];
+
+      if (!shader)
+         continue;
+
+      start = os_time_get_nano();
+      batch_lower_glsl_ir(ctx, shader);
+      job->time_ns[BATCH_LOWER] += os_time_get_nano() - start;
+
+      start = os_time_get_nano();
+      nir_shader *nir = glsl_to_nir(prog, (gl_shader_stage) i,
+                                    &batch_nir_options);
+      job->time_ns[BATCH_GLSL_TO_NIR] += os_time_get_nano() - start;
+
+      start = os_time_get_nano();
+      batch_optimize_nir(nir);
+      job->time_ns[BATCH_NIR_OPT] += os_time_get_nano() - start;
+
+      ralloc_free(nir);
    }
 
-   delete whole_program->AttributeBindings;
-   delete whole_program->FragDataBindings;
-   delete whole_program->FragDataIndexBindings;
+done:
+   free_shader_program(prog);
+   free(ctx);
+}
+
+static bool
+is_shader_test(const char *path)
+{
+   const size_t len = strlen(path);
+
+   return len > 12 && strcmp(path + len - 12, ".shader_test") == 0;
+}
+
+/**
+ * Adds path to the list of files to compile, or every .shader_test file in
+ * it if it is a directory.
+ */
+static void
+find_shader_tests(void *mem_ctx, const char *path, char ***files,
+                  unsigned *num_files)
+{
+#ifndef _WIN32
+   struct stat st;
+
+   if (stat(path, &st) != 0) {
+      fprintf(stderr, "%s: %s\n", path, strerror(errno));
+      return;
+   }
+
+   if (S_ISDIR(st.st_mode)) {
+      DIR *dir = opendir(path);
+      struct dirent *entry;
+
+      if (!dir) {
+         fprintf(stderr, "%s: %s\n", path, strerror(errno));
+         return;
+      }
+
+      while ((entry = readdir(dir)) != NULL) {
+         if (entry->d_name[0] == '.')
+            continue;
+
+         char *child = ralloc_asprintf(mem_ctx, "%s/%s", path, entry->d_name);
+         if (stat(child, &st) == 0 &&
+             (S_ISDIR(st.st_mode) || is_shader_test(child)))
+            find_shader_tests(mem_ctx, child, files, num_files);
+      }
+
+      closedir(dir);
+      return;
+   }
+#endif
+
+   *files = reralloc(mem_ctx, *files, char *, *num_files + 1);
+   (*files)[(*num_files)++] = ralloc_strdup(mem_ctx, path);
+}
+
+static int
+compare_paths(const void *a, const void *b)
+{
+   return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+extern "C" int
+standalone_compile_batch(const struct standalone_options *_options,
+                         unsigned num_paths, char* const* paths)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   /* One context per GLSL version, indexed by version / 10. */
+   struct gl_context *contexts[47] = { NULL };
+   struct util_queue queue;
+   char **files = NULL;
+   unsigned num_files = 0;
+   unsigned num_programs = 0, num_shaders = 0, num_failed = 0;
+   int64_t time_ns[BATCH_NUM_STAGES] = { 0 }, total_ns = 0;
+
+   options = _options;
+
+   batch_nir_options.native_integers = true;
+   batch_nir_options.max_unroll_iterations = 32;
+
+   for (unsigned i = 0; i < num_paths; i++)
+      find_shader_tests(mem_ctx, paths[i], &files, &num_files);
+
+   /* Reports list the programs in a stable order. */
+   if (num_files)
+      qsort(files, num_files, sizeof(*files), compare_paths);
+
+   struct batch_job *jobs = rzalloc_array(mem_ctx, struct batch_job,
+                                          MAX2(num_files, 1));
+
+   /* With no thread count given, use the process-wide pool, which has one
+    * thread per CPU unless MESA_SHARED_QUEUE_THREADS says otherwise.
+    */
+   if (!util_queue_init(&queue, "glsl_batch", 64,
+                        options->num_threads ? options->num_threads : UINT_MAX,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                        (options->num_threads ? 0 : UTIL_QUEUE_INIT_SHARED_POOL))) {
+      fprintf(stderr, "Failed to create the compile threads\n");
+      ralloc_free(mem_ctx);
+      return EXIT_FAILURE;
+   }
+
+   const int64_t start = os_time_get_nano();
+
+   for (unsigned i = 0; i < num_files; i++) {
+      struct batch_job *job = &jobs[i];
+      gl_api api;
+      bool es;
+
+      job->mem_ctx = ralloc_context(mem_ctx);
+      job->path = files[i];
+      util_queue_fence_init(&job->fence);
+
+      char *text = load_text_file(job->mem_ctx, job->path);
+      if (!text) {
+         job->error = "failed to read the file";
+         continue;
+      }
+
+      int glsl_version = parse_shader_test(job, text, &es);
+      if (!glsl_version)
+         glsl_version = options->glsl_version ? options->glsl_version : 110;
+
+      if (!job->num_shaders) {
+         /* Nothing to do, e.g. ARB assembly programs. */
+         continue;
+      }
+
+      if (!get_glsl_api(glsl_version, &api)) {
+         job->error = ralloc_asprintf(job->mem_ctx,
+                                      "unsupported GLSL%s version %d",
+                                      es ? " ES" : "", glsl_version);
+         continue;
+      }
+
+      /* The contexts are set up here rather than by the threads, because
+       * initializing one isn't thread-safe.
+       */
+      assert(glsl_version / 10 < (int) ARRAY_SIZE(contexts));
+      struct gl_context **ctx = &contexts[glsl_version / 10];
+      if (!*ctx) {
+         *ctx = (struct gl_context *) malloc(sizeof(**ctx));
+         initialize_context(*ctx, api, glsl_version);
+         (*ctx)->Const.NativeIntegers = true;
+         for (unsigned s = 0; s < MESA_SHADER_STAGES; s++)
+            (*ctx)->Const.ShaderCompilerOptions[s].NirOptions =
+               &batch_nir_options;
+      }
+      job->ctx = *ctx;
+
+      num_programs++;
+      num_shaders += job->num_shaders;
+      util_queue_add_job(&queue, job, &job->fence, batch_compile_program,
+                         NULL);
+   }
+
+   util_queue_finish(&queue);
+   total_ns = os_time_get_nano() - start;
+
+   for (unsigned i = 0; i < num_files; i++) {
+      struct batch_job *job = &jobs[i];
+
+      if (job->error) {
+         num_failed++;
+         printf("%s: %s\n", job->path, job->error);
+      }
+
+      for (unsigned s = 0; s < BATCH_NUM_STAGES; s++)
+         time_ns[s] += job->time_ns[s];
+
+      util_queue_fence_destroy(&job->fence);
+   }
+
+   printf("%u programs (%u shaders) compiled on %u threads, %u failed\n",
+          num_programs, num_shaders, queue.num_threads, num_failed);
+   printf("%-16s %12s\n", "stage", "time (ms)");
+
+   int64_t cpu_ns = 0;
+   for (unsigned s = 0; s < BATCH_NUM_STAGES; s++) {
+      printf("%-16s %12.2f\n", batch_stage_names[s], time_ns[s] / 1000000.0);
+      cpu_ns += time_ns[s];
+   }
+   printf("%-16s %12.2f\n", "total", cpu_ns / 1000000.0);
+   printf("%-16s %12.2f\n", "wall clock", total_ns / 1000000.0);
+
+#ifndef _WIN32
+   struct rusage usage;
+   if (getrusage(RUSAGE_SELF, &usage) == 0)
+      printf("peak memory: %ld kB\n", usage.ru_maxrss);
+#endif
+
+   util_queue_destroy(&queue);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(contexts); i++)
+      free(contexts[i]);
+   ralloc_free(mem_ctx);
 
-   ralloc_free(whole_program);
    _mesa_glsl_release_types();
    _mesa_glsl_release_builtin_functions();
+
+   return num_failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
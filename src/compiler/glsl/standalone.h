@@ -36,6 +36,8 @@ struct standalone_options {
    int dump_builder;
    int do_link;
    int just_log;
+   int batch;
+   int num_threads;
 };
 
 struct gl_shader_program;
@@ -46,6 +48,9 @@ struct gl_shader_program * standalone_compile_shader(
 
 void standalone_compiler_cleanup(struct gl_shader_program *prog);
 
+int standalone_compile_batch(const struct standalone_options *options,
+                             unsigned num_paths, char* const* paths);
+
 #ifdef __cplusplus
 }
 #endif
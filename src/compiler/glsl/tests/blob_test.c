@@ -147,6 +147,8 @@ test_write_and_read_functions (void)
 
    blob_write_intptr(&blob, (intptr_t) &blob);
 
+   blob_write_varint(&blob, uint64_test);
+
    blob_write_string(&blob, string_test_str);
 
    /* Finally, overwrite our placeholders. */
@@ -177,6 +179,8 @@ test_write_and_read_functions (void)
                 "blob_write/read_uint64");
    expect_equal((intptr_t) &blob, blob_read_intptr(&reader),
                 "blob_write/read_intptr");
+   expect_equal(uint64_test, blob_read_varint(&reader),
+                "blob_write/read_varint");
    expect_equal_str(string_test_str, blob_read_string(&reader),
                     "blob_write/read_string");
 
@@ -267,6 +271,58 @@ test_overrun(void)
    blob_finish(&blob);
 }
 
+/* Test that varints take as few bytes as their value needs, and that
+ * truncated ones are detected.
+ */
+static void
+test_varint(void)
+{
+   static const struct {
+      uint64_t value;
+      size_t size;
+   } tests[] = {
+      { 0, 1 },
+      { 0x7f, 1 },
+      { 0x80, 2 },
+      { 0x3fff, 2 },
+      { 0x4000, 3 },
+      { UINT32_MAX, 5 },
+      { UINT64_MAX, 10 },
+   };
+   struct blob blob;
+   struct blob_reader reader;
+   size_t i;
+
+   blob_init(&blob);
+
+   for (i = 0; i < ARRAY_SIZE(tests); i++) {
+      size_t size = blob.size;
+
+      blob_write_varint(&blob, tests[i].value);
+      expect_equal(tests[i].size, blob.size - size, "size of varint");
+   }
+
+   blob_reader_init(&reader, blob.data, blob.size);
+
+   for (i = 0; i < ARRAY_SIZE(tests); i++)
+      expect_equal(tests[i].value, blob_read_varint(&reader), "read of varint");
+
+   expect_equal(reader.end - reader.data, reader.current - reader.data,
+                "number of bytes read reading varints");
+   expect_equal(false, reader.overrun, "overrun flag not set reading varints");
+
+   /* Drop the last byte of the last value. */
+   blob_reader_init(&reader, blob.data, blob.size - 1);
+
+   for (i = 0; i < ARRAY_SIZE(tests) - 1; i++)
+      expect_equal(tests[i].value, blob_read_varint(&reader), "read of varint");
+
+   expect_equal(0, blob_read_varint(&reader), "read of truncated varint");
+   expect_equal(true, reader.overrun, "overrun flag set on truncated varint");
+
+   blob_finish(&blob);
+}
+
 /* Test that we can read and write some large objects, (exercising the code in
  * the blob_write functions to realloc blob->data.
  */
@@ -318,6 +374,7 @@ main (void)
    test_write_and_read_functions ();
    test_alignment ();
    test_overrun ();
+   test_varint ();
    test_big_objects ();
 
    return error ? 1 : 0;
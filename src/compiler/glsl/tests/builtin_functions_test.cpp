@@ -0,0 +1,98 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string>
+#include "ir.h"
+#include "builtin_functions.h"
+
+/* Built-ins that cover plain, intrinsic-based, image, 64-bit integer and
+ * generated-IR signatures.
+ */
+static const char *const names[] = {
+   "abs",
+   "mix",
+   "texture",
+   "atomicAdd",
+   "imageLoad",
+   "packHalf2x16",
+   "__builtin_umul64",
+   "__intrinsic_atomic_add",
+};
+
+/**
+ * Print all signatures of a built-in function.  Variable names that clash
+ * get a suffix from a process-wide counter, so the suffixes are dropped.
+ */
+static std::string
+print_function(const char *name)
+{
+   ir_function *f = _mesa_glsl_find_builtin_function_by_name(name);
+   if (f == NULL)
+      return std::string();
+
+   FILE *stream = tmpfile();
+   fprint_ir(stream, f);
+   rewind(stream);
+
+   std::string s;
+   int c;
+   while ((c = fgetc(stream)) != EOF) {
+      s += (char) c;
+      if (c == '@') {
+         while ((c = fgetc(stream)) >= '0' && c <= '9')
+            ;
+         if (c == EOF)
+            break;
+         s += (char) c;
+      }
+   }
+   fclose(stream);
+
+   return s;
+}
+
+TEST(builtin_functions, first_use_matches_all_at_once)
+{
+   std::string lazy[ARRAY_SIZE(names)];
+
+   _mesa_glsl_initialize_builtin_functions();
+   for (unsigned i = 0; i < ARRAY_SIZE(names); i++) {
+      lazy[i] = print_function(names[i]);
+      EXPECT_FALSE(lazy[i].empty()) << names[i];
+   }
+
+   _mesa_glsl_create_all_builtin_functions();
+   for (unsigned i = 0; i < ARRAY_SIZE(names); i++)
+      EXPECT_EQ(lazy[i], print_function(names[i])) << names[i];
+
+   _mesa_glsl_release_builtin_functions();
+}
+
+TEST(builtin_functions, user_function_is_not_builtin)
+{
+   _mesa_glsl_initialize_builtin_functions();
+   EXPECT_EQ(NULL, _mesa_glsl_find_builtin_function_by_name("my_function"));
+   EXPECT_EQ(NULL, _mesa_glsl_find_builtin_function_by_name("main"));
+   _mesa_glsl_release_builtin_functions();
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "main/mtypes.h"
+#include "ir.h"
+#include "ir_builder.h"
+#include "ir_optimization.h"
+#include "builtin_functions.h"
+
+using namespace ir_builder;
+
+/* Built-ins whose bodies contain loops. */
+static const char *const loop_builtins[] = {
+   "__builtin_udiv64",
+   "__builtin_idiv64",
+   "__builtin_umod64",
+   "__builtin_imod64",
+};
+
+class common_optimization : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   void add_counted_loops();
+   void add_squaring_loop();
+   std::string optimize(bool until_no_progress, bool native_integers);
+
+   void *mem_ctx;
+   exec_list functions;
+   gl_shader_compiler_options options;
+
+   /** Whether another sweep made no progress after the last optimize(). */
+   bool settled;
+};
+
+void
+common_optimization::SetUp()
+{
+   mem_ctx = ralloc_context(NULL);
+   functions.make_empty();
+
+   memset(&options, 0, sizeof(options));
+   options.MaxUnrollIterations = 32;
+   options.MaxIfDepth = UINT_MAX;
+}
+
+void
+common_optimization::TearDown()
+{
+   ralloc_free(mem_ctx);
+   mem_ctx = NULL;
+}
+
+/**
+ * Add a function equivalent to
+ *
+ *    float f()
+ *    {
+ *       float s = 0.0;
+ *       for (int i = 0; i < 4; i++)
+ *          for (int j = 0; j < 3; j++)
+ *             s += float(i * j);
+ *       return s;
+ *    }
+ *
+ * The outer loop can only be unrolled once the inner loop is gone, and the
+ * sum only folds to a constant once both are.
+ */
+void
+common_optimization::add_counted_loops()
+{
+   ir_function *f = new(mem_ctx) ir_function("counted_loops");
+   ir_function_signature *sig =
+      new(mem_ctx) ir_function_signature(glsl_type::float_type);
+   sig->is_defined = true;
+   f->add_signature(sig);
+   functions.push_tail(f);
+
+   ir_factory body(&sig->body, mem_ctx);
+   ir_variable *s = body.make_temp(glsl_type::float_type, "s");
+   ir_variable *i = body.make_temp(glsl_type::int_type, "i");
+   body.emit(assign(s, body.constant(0.0f)));
+   body.emit(assign(i, body.constant(0)));
+
+   ir_loop *outer = new(mem_ctx) ir_loop();
+   body.emit(outer);
+   ir_factory outer_body(&outer->body_instructions, mem_ctx);
+   outer_body.emit(if_tree(gequal(i, outer_body.constant(4)),
+                           new(mem_ctx) ir_loop_jump(ir_loop_jump::jump_break)));
+   ir_variable *j = outer_body.make_temp(glsl_type::int_type, "j");
+   outer_body.emit(assign(j, outer_body.constant(0)));
+
+   ir_loop *inner = new(mem_ctx) ir_loop();
+   outer_body.emit(inner);
+   ir_factory inner_body(&inner->body_instructions, mem_ctx);
+   inner_body.emit(if_tree(gequal(j, inner_body.constant(3)),
+                           new(mem_ctx) ir_loop_jump(ir_loop_jump::jump_break)));
+   inner_body.emit(assign(s, add(s, i2f(mul(i, j)))));
+   inner_body.emit(assign(j, add(j, inner_body.constant(1))));
+
+   outer_body.emit(assign(i, add(i, outer_body.constant(1))));
+   body.emit(ret(s));
+}
+
+/**
+ * Add a function equivalent to
+ *
+ *    float f(float a)
+ *    {
+ *       for (int i = 0; i < 3; i++)
+ *          a = a * a;
+ *       return a;
+ *    }
+ *
+ * Nothing but the loop unroller can make progress on it, so the sweep that
+ * unrolls the loop must report progress for the counter to be cleaned up.
+ */
+void
+common_optimization::add_squaring_loop()
+{
+   ir_function *f = new(mem_ctx) ir_function("squaring_loop");
+   ir_function_signature *sig =
+      new(mem_ctx) ir_function_signature(glsl_type::float_type);
+   ir_variable *a = new(mem_ctx) ir_variable(glsl_type::float_type, "a",
+                                             ir_var_function_in);
+   sig->parameters.push_tail(a);
+   sig->is_defined = true;
+   f->add_signature(sig);
+   functions.push_tail(f);
+
+   ir_factory body(&sig->body, mem_ctx);
+   ir_variable *i = body.make_temp(glsl_type::int_type, "i");
+   body.emit(assign(i, body.constant(0)));
+
+   ir_loop *loop = new(mem_ctx) ir_loop();
+   body.emit(loop);
+   ir_factory loop_body(&loop->body_instructions, mem_ctx);
+   loop_body.emit(if_tree(gequal(i, loop_body.constant(3)),
+                          new(mem_ctx) ir_loop_jump(ir_loop_jump::jump_break)));
+   loop_body.emit(assign(a, mul(a, a)));
+   loop_body.emit(assign(i, add(i, loop_body.constant(1))));
+
+   body.emit(ret(a));
+}
+
+/**
+ * Optimize a copy of the functions either by calling
+ * do_common_optimization() until it stops reporting progress, or with
+ * do_common_optimization_loop(), and print the result.  Also record whether
+ * the result is settled.  Variable names that
+ * clash get a suffix from a process-wide counter, so the suffixes are
+ * dropped.
+ */
+std::string
+common_optimization::optimize(bool until_no_progress, bool native_integers)
+{
+   void *ctx = ralloc_context(NULL);
+   exec_list *ir = new(ctx) exec_list;
+   clone_ir_list(ctx, ir, &functions);
+
+   if (until_no_progress) {
+      while (do_common_optimization(ir, false, false, &options,
+                                    native_integers))
+         ;
+   } else {
+      do_common_optimization_loop(ir, false, false, &options,
+                                  native_integers);
+   }
+
+   FILE *stream = tmpfile();
+   _mesa_print_ir(stream, ir, NULL);
+   rewind(stream);
+
+   std::string s;
+   int c;
+   while ((c = fgetc(stream)) != EOF) {
+      s += (char) c;
+      if (c == '@') {
+         while ((c = fgetc(stream)) >= '0' && c <= '9')
+            ;
+         if (c == EOF)
+            break;
+         s += (char) c;
+      }
+   }
+   fclose(stream);
+
+   settled = !do_common_optimization(ir, false, false, &options,
+                                     native_integers);
+   ralloc_free(ctx);
+
+   return s;
+}
+
+TEST_F(common_optimization, counted_loops_are_unrolled)
+{
+   add_counted_loops();
+
+   for (unsigned pass = 0; pass < 4; pass++) {
+      std::string s = optimize(pass & 1, pass & 2);
+      EXPECT_EQ(std::string::npos, s.find("(loop")) << s;
+      EXPECT_NE(std::string::npos, s.find("(return (constant float (18")) << s;
+      EXPECT_TRUE(settled) << s;
+   }
+}
+
+TEST_F(common_optimization, unrolling_alone_is_progress)
+{
+   add_squaring_loop();
+
+   for (unsigned pass = 0; pass < 4; pass++) {
+      std::string s = optimize(pass & 1, pass & 2);
+      EXPECT_EQ(std::string::npos, s.find("(loop")) << s;
+      EXPECT_TRUE(settled) << s;
+   }
+}
+
+TEST_F(common_optimization, loop_matches_repeated_calls)
+{
+   _mesa_glsl_initialize_builtin_functions();
+   for (unsigned i = 0; i < ARRAY_SIZE(loop_builtins); i++) {
+      ir_function *f = _mesa_glsl_find_builtin_function_by_name(loop_builtins[i]);
+      ASSERT_NE((ir_function *) NULL, f) << loop_builtins[i];
+      functions.push_tail(f->clone(mem_ctx, NULL));
+   }
+   add_counted_loops();
+   add_squaring_loop();
+
+   for (unsigned aos = 0; aos < 2; aos++) {
+      options.OptimizeForAOS = aos;
+      for (unsigned native = 0; native < 2; native++) {
+         EXPECT_EQ(optimize(true, native), optimize(false, native))
+            << "aos " << aos << " native " << native;
+      }
+   }
+
+   _mesa_glsl_release_builtin_functions();
+}
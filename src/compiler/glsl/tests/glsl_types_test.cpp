@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include "main/compiler.h"
+#include "main/mtypes.h"
+#include "main/macros.h"
+#include "c11/threads.h"
+#include "ir.h"
+
+/**
+ * \file glsl_types_test.cpp
+ *
+ * Test that derived types are interned, also when several threads create
+ * them at the same time.
+ */
+
+#define NUM_THREADS 4
+#define NUM_SIZES 500
+
+TEST(glsl_types, array_instances_are_unique)
+{
+   const glsl_type *a = glsl_type::get_array_instance(glsl_type::vec4_type, 3);
+   const glsl_type *b = glsl_type::get_array_instance(glsl_type::vec4_type, 3);
+   const glsl_type *c = glsl_type::get_array_instance(glsl_type::vec4_type, 4);
+   const glsl_type *d = glsl_type::get_array_instance(glsl_type::vec3_type, 3);
+
+   EXPECT_EQ(a, b);
+   EXPECT_NE(a, c);
+   EXPECT_NE(a, d);
+   EXPECT_STREQ("vec4[3]", a->name);
+   EXPECT_EQ(glsl_type::vec4_type, a->fields.array);
+   EXPECT_EQ(3u, a->length);
+}
+
+TEST(glsl_types, record_instances_are_unique)
+{
+   const glsl_struct_field f[] = {
+      glsl_struct_field(glsl_type::vec4_type, "v"),
+      glsl_struct_field(glsl_type::float_type, "f"),
+   };
+   const glsl_struct_field g[] = {
+      glsl_struct_field(glsl_type::vec4_type, "v"),
+      glsl_struct_field(glsl_type::int_type, "f"),
+   };
+
+   const glsl_type *a = glsl_type::get_record_instance(f, ARRAY_SIZE(f), "s");
+   const glsl_type *b = glsl_type::get_record_instance(f, ARRAY_SIZE(f), "s");
+   const glsl_type *c = glsl_type::get_record_instance(g, ARRAY_SIZE(g), "s");
+   const glsl_type *d = glsl_type::get_record_instance(f, ARRAY_SIZE(f), "t");
+
+   EXPECT_EQ(a, b);
+   EXPECT_NE(a, c);
+   EXPECT_NE(a, d);
+}
+
+struct thread_data {
+   const glsl_type *arrays[NUM_SIZES];
+   const glsl_type *records[NUM_SIZES];
+   unsigned seed;
+};
+
+static int
+create_types(void *data)
+{
+   struct thread_data *td = (struct thread_data *) data;
+
+   /* Every thread visits the sizes in a different order so that lookups,
+    * inserts and growing the tables overlap.
+    */
+   for (unsigned i = 0; i < NUM_SIZES; i++) {
+      unsigned size = (i * 7 + td->seed * 131) % NUM_SIZES + 1;
+      const glsl_struct_field f[] = {
+         glsl_struct_field(glsl_type::get_array_instance(glsl_type::uint_type,
+                                                         size), "a"),
+      };
+
+      td->arrays[size - 1] =
+         glsl_type::get_array_instance(glsl_type::ivec2_type, size);
+      td->records[size - 1] =
+         glsl_type::get_record_instance(f, ARRAY_SIZE(f), "threaded");
+   }
+
+   return 0;
+}
+
+TEST(glsl_types, concurrent_instances_are_unique)
+{
+   struct thread_data td[NUM_THREADS];
+   thrd_t threads[NUM_THREADS];
+
+   for (unsigned i = 0; i < NUM_THREADS; i++) {
+      td[i].seed = i;
+      ASSERT_EQ(thrd_success, thrd_create(&threads[i], create_types, &td[i]));
+   }
+
+   for (unsigned i = 0; i < NUM_THREADS; i++)
+      thrd_join(threads[i], NULL);
+
+   for (unsigned size = 1; size <= NUM_SIZES; size++) {
+      const glsl_type *array =
+         glsl_type::get_array_instance(glsl_type::ivec2_type, size);
+
+      EXPECT_EQ(size, array->length);
+      for (unsigned i = 0; i < NUM_THREADS; i++) {
+         EXPECT_EQ(array, td[i].arrays[size - 1]);
+         EXPECT_EQ(td[0].records[size - 1], td[i].records[size - 1]);
+      }
+
+      if (size > 1)
+         EXPECT_NE(td[0].records[size - 2], td[0].records[size - 1]);
+   }
+}
@@ -26,14 +26,146 @@
 #include "compiler/glsl/glsl_parser_extras.h"
 #include "glsl_types.h"
 #include "util/hash_table.h"
+#include "util/u_atomic.h"
+
+
+/**
+ * An insert-only hash table of types which can be searched without taking
+ * glsl_type::hash_mutex.
+ *
+ * Entries are never modified once they are published, so a search only
+ * ever walks complete chains.  Inserts are made with hash_mutex held.  When
+ * the table grows, the entries are copied to a new bucket array and the old
+ * one stays around until _mesa_glsl_release_types(), since searches may
+ * still be walking it.  A search that misses an entry being added
+ * concurrently is repeated under the mutex before the type is created, so
+ * every type is still created exactly once.
+ */
+struct glsl_type_table_entry {
+   uint32_t hash;
+   const glsl_type *type;
+   glsl_type_table_entry *next;
+};
+
+struct glsl_type_table_buckets {
+   unsigned size;
+   glsl_type_table_entry **entries;
+
+   /** The smaller bucket array this one replaced. */
+   glsl_type_table_buckets *old;
+};
+
+struct glsl_type_table {
+   glsl_type_table_buckets *buckets;
+   unsigned count;
+};
+
+typedef bool (*glsl_type_key_equal)(const void *key, const void *type);
+
+static const glsl_type *
+type_table_search(glsl_type_table *table, uint32_t hash, const void *key,
+                  glsl_type_key_equal equal)
+{
+   glsl_type_table_buckets *buckets = p_atomic_read(&table->buckets);
+   if (buckets == NULL)
+      return NULL;
+
+   glsl_type_table_entry *entry =
+      p_atomic_read(&buckets->entries[hash & (buckets->size - 1)]);
+   for (; entry != NULL; entry = entry->next) {
+      if (entry->hash == hash && equal(key, entry->type))
+         return entry->type;
+   }
+
+   return NULL;
+}
+
+static void
+type_table_publish(glsl_type_table_buckets *buckets,
+                   glsl_type_table_entry *entry)
+{
+   glsl_type_table_entry **head =
+      &buckets->entries[entry->hash & (buckets->size - 1)];
+
+   entry->next = *head;
+   p_atomic_set(head, entry);
+}
+
+/** Adds a type to the table; must be called with hash_mutex held. */
+static void
+type_table_insert(glsl_type_table *table, uint32_t hash, const glsl_type *type)
+{
+   glsl_type_table_buckets *buckets = table->buckets;
+
+   /* Keep the load factor at most 1. */
+   if (buckets == NULL || table->count >= buckets->size) {
+      glsl_type_table_buckets *grown = new glsl_type_table_buckets;
+
+      grown->size = buckets ? buckets->size * 2 : 64;
+      grown->entries = new glsl_type_table_entry *[grown->size]();
+      grown->old = buckets;
+
+      for (unsigned i = 0; buckets && i < buckets->size; i++) {
+         for (glsl_type_table_entry *old_entry = buckets->entries[i];
+              old_entry != NULL; old_entry = old_entry->next) {
+            glsl_type_table_entry *entry = new glsl_type_table_entry;
+            entry->hash = old_entry->hash;
+            entry->type = old_entry->type;
+            type_table_publish(grown, entry);
+         }
+      }
+
+      p_atomic_set(&table->buckets, grown);
+      buckets = grown;
+   }
+
+   glsl_type_table_entry *entry = new glsl_type_table_entry;
+   entry->hash = hash;
+   entry->type = type;
+   type_table_publish(buckets, entry);
+   table->count++;
+}
+
+static void
+type_table_destroy(glsl_type_table *table)
+{
+   glsl_type_table_buckets *buckets = table->buckets;
+
+   /* The newest bucket array holds every type exactly once. */
+   for (unsigned i = 0; buckets && i < buckets->size; i++) {
+      for (glsl_type_table_entry *entry = buckets->entries[i];
+           entry != NULL; entry = entry->next)
+         delete entry->type;
+   }
+
+   while (buckets != NULL) {
+      glsl_type_table_buckets *old = buckets->old;
+
+      for (unsigned i = 0; i < buckets->size; i++) {
+         glsl_type_table_entry *entry = buckets->entries[i];
+         while (entry != NULL) {
+            glsl_type_table_entry *next = entry->next;
+            delete entry;
+            entry = next;
+         }
+      }
+
+      delete[] buckets->entries;
+      delete buckets;
+      buckets = old;
+   }
+
+   table->buckets = NULL;
+   table->count = 0;
+}
 
 
 mtx_t glsl_type::hash_mutex = _MTX_INITIALIZER_NP;
-hash_table *glsl_type::array_types = NULL;
-hash_table *glsl_type::record_types = NULL;
-hash_table *glsl_type::interface_types = NULL;
-hash_table *glsl_type::function_types = NULL;
-hash_table *glsl_type::subroutine_types = NULL;
+glsl_type_table glsl_type::array_types;
+glsl_type_table glsl_type::record_types;
+glsl_type_table glsl_type::interface_types;
+glsl_type_table glsl_type::function_types;
+glsl_type_table glsl_type::subroutine_types;
 
 glsl_type::glsl_type(GLenum gl_type,
                      glsl_base_type base_type, unsigned vector_elements,
@@ -403,17 +535,6 @@ const glsl_type *glsl_type::get_scalar_type() const
 }
 
 
-static void
-hash_free_type_function(struct hash_entry *entry)
-{
-   glsl_type *type = (glsl_type *) entry->data;
-
-   if (type->is_array())
-      free((void*)entry->key);
-
-   delete type;
-}
-
 void
 _mesa_glsl_release_types(void)
 {
@@ -421,30 +542,11 @@ _mesa_glsl_release_types(void)
     * object, or if process terminates), so no mutex-locking should be
     * necessary.
     */
-   if (glsl_type::array_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::array_types, hash_free_type_function);
-      glsl_type::array_types = NULL;
-   }
-
-   if (glsl_type::record_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::record_types, hash_free_type_function);
-      glsl_type::record_types = NULL;
-   }
-
-   if (glsl_type::interface_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::interface_types, hash_free_type_function);
-      glsl_type::interface_types = NULL;
-   }
-
-   if (glsl_type::function_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::function_types, hash_free_type_function);
-      glsl_type::function_types = NULL;
-   }
-
-   if (glsl_type::subroutine_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::subroutine_types, hash_free_type_function);
-      glsl_type::subroutine_types = NULL;
-   }
+   type_table_destroy(&glsl_type::array_types);
+   type_table_destroy(&glsl_type::record_types);
+   type_table_destroy(&glsl_type::interface_types);
+   type_table_destroy(&glsl_type::function_types);
+   type_table_destroy(&glsl_type::subroutine_types);
 }
 
 
@@ -943,40 +1045,49 @@ glsl_type::get_image_instance(enum glsl_sampler_dim dim,
    unreachable("switch statement above should be complete");
 }
 
+struct array_key {
+   const glsl_type *base;
+   unsigned length;
+};
+
+static bool
+array_key_compare(const void *a, const void *b)
+{
+   const array_key *const key = (const array_key *) a;
+   const glsl_type *const type = (const glsl_type *) b;
+
+   return type->fields.array == key->base && type->length == key->length;
+}
+
 const glsl_type *
 glsl_type::get_array_instance(const glsl_type *base, unsigned array_size)
 {
-   /* Generate a name using the base type pointer in the key.  This is
-    * done because the name of the base type may not be unique across
-    * shaders.  For example, two shaders may have different record types
-    * named 'foo'.
+   /* Use the base type pointer in the key.  This is done because the name
+    * of the base type may not be unique across shaders.  For example, two
+    * shaders may have different record types named 'foo'.
     */
-   char key[128];
-   snprintf(key, sizeof(key), "%p[%u]", (void *) base, array_size);
-
-   mtx_lock(&glsl_type::hash_mutex);
-
-   if (array_types == NULL) {
-      array_types = _mesa_hash_table_create(NULL, _mesa_key_hash_string,
-                                            _mesa_key_string_equal);
-   }
-
-   const struct hash_entry *entry = _mesa_hash_table_search(array_types, key);
-   if (entry == NULL) {
-      const glsl_type *t = new glsl_type(base, array_size);
+   const array_key key = { base, array_size };
+   const uint32_t hash = _mesa_hash_pointer(base) ^ (array_size * 0x9e3779b1);
+
+   const glsl_type *t = type_table_search(&array_types, hash, &key,
+                                          array_key_compare);
+   if (t == NULL) {
+      mtx_lock(&glsl_type::hash_mutex);
+
+      t = type_table_search(&array_types, hash, &key, array_key_compare);
+      if (t == NULL) {
+         t = new glsl_type(base, array_size);
+         type_table_insert(&array_types, hash, t);
+      }
 
-      entry = _mesa_hash_table_insert(array_types,
-                                      strdup(key),
-                                      (void *) t);
+      mtx_unlock(&glsl_type::hash_mutex);
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_ARRAY);
-   assert(((glsl_type *) entry->data)->length == array_size);
-   assert(((glsl_type *) entry->data)->fields.array == base);
+   assert(t->base_type == GLSL_TYPE_ARRAY);
+   assert(t->length == array_size);
+   assert(t->fields.array == base);
 
-   mtx_unlock(&glsl_type::hash_mutex);
-
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 
@@ -1105,29 +1216,27 @@ glsl_type::get_record_instance(const glsl_struct_field *fields,
                                const char *name)
 {
    const glsl_type key(fields, num_fields, name);
+   const uint32_t hash = record_key_hash(&key);
 
-   mtx_lock(&glsl_type::hash_mutex);
+   const glsl_type *t = type_table_search(&record_types, hash, &key,
+                                          record_key_compare);
+   if (t == NULL) {
+      mtx_lock(&glsl_type::hash_mutex);
 
-   if (record_types == NULL) {
-      record_types = _mesa_hash_table_create(NULL, record_key_hash,
-                                             record_key_compare);
-   }
-
-   const struct hash_entry *entry = _mesa_hash_table_search(record_types,
-                                                            &key);
-   if (entry == NULL) {
-      const glsl_type *t = new glsl_type(fields, num_fields, name);
+      t = type_table_search(&record_types, hash, &key, record_key_compare);
+      if (t == NULL) {
+         t = new glsl_type(fields, num_fields, name);
+         type_table_insert(&record_types, hash, t);
+      }
 
-      entry = _mesa_hash_table_insert(record_types, t, (void *) t);
+      mtx_unlock(&glsl_type::hash_mutex);
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_STRUCT);
-   assert(((glsl_type *) entry->data)->length == num_fields);
-   assert(strcmp(((glsl_type *) entry->data)->name, name) == 0);
+   assert(t->base_type == GLSL_TYPE_STRUCT);
+   assert(t->length == num_fields);
+   assert(strcmp(t->name, name) == 0);
 
-   mtx_unlock(&glsl_type::hash_mutex);
-
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 
@@ -1139,58 +1248,53 @@ glsl_type::get_interface_instance(const glsl_struct_field *fields,
                                   const char *block_name)
 {
    const glsl_type key(fields, num_fields, packing, row_major, block_name);
+   const uint32_t hash = record_key_hash(&key);
 
-   mtx_lock(&glsl_type::hash_mutex);
+   const glsl_type *t = type_table_search(&interface_types, hash, &key,
+                                          record_key_compare);
+   if (t == NULL) {
+      mtx_lock(&glsl_type::hash_mutex);
 
-   if (interface_types == NULL) {
-      interface_types = _mesa_hash_table_create(NULL, record_key_hash,
-                                                record_key_compare);
-   }
-
-   const struct hash_entry *entry = _mesa_hash_table_search(interface_types,
-                                                            &key);
-   if (entry == NULL) {
-      const glsl_type *t = new glsl_type(fields, num_fields,
-                                         packing, row_major, block_name);
+      t = type_table_search(&interface_types, hash, &key, record_key_compare);
+      if (t == NULL) {
+         t = new glsl_type(fields, num_fields, packing, row_major, block_name);
+         type_table_insert(&interface_types, hash, t);
+      }
 
-      entry = _mesa_hash_table_insert(interface_types, t, (void *) t);
+      mtx_unlock(&glsl_type::hash_mutex);
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_INTERFACE);
-   assert(((glsl_type *) entry->data)->length == num_fields);
-   assert(strcmp(((glsl_type *) entry->data)->name, block_name) == 0);
-
-   mtx_unlock(&glsl_type::hash_mutex);
+   assert(t->base_type == GLSL_TYPE_INTERFACE);
+   assert(t->length == num_fields);
+   assert(strcmp(t->name, block_name) == 0);
 
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 const glsl_type *
 glsl_type::get_subroutine_instance(const char *subroutine_name)
 {
    const glsl_type key(subroutine_name);
+   const uint32_t hash = record_key_hash(&key);
 
-   mtx_lock(&glsl_type::hash_mutex);
-
-   if (subroutine_types == NULL) {
-      subroutine_types = _mesa_hash_table_create(NULL, record_key_hash,
-                                                 record_key_compare);
-   }
+   const glsl_type *t = type_table_search(&subroutine_types, hash, &key,
+                                          record_key_compare);
+   if (t == NULL) {
+      mtx_lock(&glsl_type::hash_mutex);
 
-   const struct hash_entry *entry = _mesa_hash_table_search(subroutine_types,
-                                                            &key);
-   if (entry == NULL) {
-      const glsl_type *t = new glsl_type(subroutine_name);
+      t = type_table_search(&subroutine_types, hash, &key, record_key_compare);
+      if (t == NULL) {
+         t = new glsl_type(subroutine_name);
+         type_table_insert(&subroutine_types, hash, t);
+      }
 
-      entry = _mesa_hash_table_insert(subroutine_types, t, (void *) t);
+      mtx_unlock(&glsl_type::hash_mutex);
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_SUBROUTINE);
-   assert(strcmp(((glsl_type *) entry->data)->name, subroutine_name) == 0);
-
-   mtx_unlock(&glsl_type::hash_mutex);
+   assert(t->base_type == GLSL_TYPE_SUBROUTINE);
+   assert(strcmp(t->name, subroutine_name) == 0);
 
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 
@@ -1222,28 +1326,26 @@ glsl_type::get_function_instance(const glsl_type *return_type,
                                  unsigned num_params)
 {
    const glsl_type key(return_type, params, num_params);
+   const uint32_t hash = function_key_hash(&key);
+
+   const glsl_type *t = type_table_search(&function_types, hash, &key,
+                                          function_key_compare);
+   if (t == NULL) {
+      mtx_lock(&glsl_type::hash_mutex);
+
+      t = type_table_search(&function_types, hash, &key,
+                            function_key_compare);
+      if (t == NULL) {
+         t = new glsl_type(return_type, params, num_params);
+         type_table_insert(&function_types, hash, t);
+      }
 
-   mtx_lock(&glsl_type::hash_mutex);
-
-   if (function_types == NULL) {
-      function_types = _mesa_hash_table_create(NULL, function_key_hash,
-                                               function_key_compare);
-   }
-
-   struct hash_entry *entry = _mesa_hash_table_search(function_types, &key);
-   if (entry == NULL) {
-      const glsl_type *t = new glsl_type(return_type, params, num_params);
-
-      entry = _mesa_hash_table_insert(function_types, t, (void *) t);
+      mtx_unlock(&glsl_type::hash_mutex);
    }
 
-   const glsl_type *t = (const glsl_type *)entry->data;
-
    assert(t->base_type == GLSL_TYPE_FUNCTION);
    assert(t->length == num_params);
 
-   mtx_unlock(&glsl_type::hash_mutex);
-
    return t;
 }
 
@@ -881,19 +881,19 @@ private:
    glsl_type(const char *name);
 
    /** Hash table containing the known array types. */
-   static struct hash_table *array_types;
+   static struct glsl_type_table array_types;
 
    /** Hash table containing the known record types. */
-   static struct hash_table *record_types;
+   static struct glsl_type_table record_types;
 
    /** Hash table containing the known interface types. */
-   static struct hash_table *interface_types;
+   static struct glsl_type_table interface_types;
 
    /** Hash table containing the known subroutine types. */
-   static struct hash_table *subroutine_types;
+   static struct glsl_type_table subroutine_types;
 
    /** Hash table containing the known function types. */
-   static struct hash_table *function_types;
+   static struct glsl_type_table function_types;
 
    static bool record_key_compare(const void *a, const void *b);
    static unsigned record_key_hash(const void *key);
@@ -2425,8 +2425,36 @@ static inline bool should_serialize_deserialize_nir(void) { return false; }
 static inline bool should_print_nir(void) { return false; }
 #endif /* NDEBUG */
 
-#define _PASS(nir, do_pass) do {                                     \
+/* Opt-in per-pass statistics, see nir_pass_stats.c */
+struct nir_pass_stats_run {
+   int64_t start_ns;
+   unsigned num_instrs;
+};
+
+bool nir_pass_stats_enabled(void);
+void nir_pass_stats_begin(nir_shader *shader, struct nir_pass_stats_run *run);
+void nir_pass_stats_end(nir_shader *shader, const char *pass, bool progress,
+                        const struct nir_pass_stats_run *run);
+
+static inline bool
+should_record_nir_pass_stats(void)
+{
+   static int should_record = -1;
+   if (should_record < 0)
+      should_record = nir_pass_stats_enabled();
+
+   return should_record;
+}
+
+#define _PASS(nir, pass, do_pass) do {                               \
+   struct nir_pass_stats_run _pass_stats;                            \
+   bool _pass_progress = false;                                      \
+   const bool _record_stats = should_record_nir_pass_stats();        \
+   if (_record_stats)                                                \
+      nir_pass_stats_begin(nir, &_pass_stats);                       \
    do_pass                                                           \
+   if (_record_stats)                                                \
+      nir_pass_stats_end(nir, #pass, _pass_progress, &_pass_stats);  \
    nir_validate_shader(nir);                                         \
    if (should_clone_nir()) {                                         \
       nir_shader *clone = nir_shader_clone(ralloc_parent(nir), nir); \
@@ -2439,19 +2467,20 @@ static inline bool should_print_nir(void) { return false; }
    }                                                                 \
 } while (0)
 
-#define NIR_PASS(progress, nir, pass, ...) _PASS(nir,                \
+#define NIR_PASS(progress, nir, pass, ...) _PASS(nir, pass,          \
    nir_metadata_set_validation_flag(nir);                            \
    if (should_print_nir())                                           \
       printf("%s\n", #pass);                                         \
    if (pass(nir, ##__VA_ARGS__)) {                                   \
       progress = true;                                               \
+      _pass_progress = true;                                         \
       if (should_print_nir())                                        \
          nir_print_shader(nir, stdout);                              \
       nir_metadata_check_validation_flag(nir);                       \
    }                                                                 \
 )
 
-#define NIR_PASS_V(nir, pass, ...) _PASS(nir,                        \
+#define NIR_PASS_V(nir, pass, ...) _PASS(nir, pass,                  \
    if (should_print_nir())                                           \
       printf("%s\n", #pass);                                         \
    pass(nir, ##__VA_ARGS__);                                         \
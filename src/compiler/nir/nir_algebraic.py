@@ -31,6 +31,7 @@ import sys
 import mako.template
 import re
 import traceback
+from collections import defaultdict
 
 from nir_opcodes import opcodes
 
@@ -495,6 +496,149 @@ class SearchAndReplace(object):
 
       BitSizeValidator(varset).validate(self.search, self.replace)
 
+class TreeAutomaton(object):
+   """Computes a bottom-up tree automaton which quickly finds the transforms
+   whose search expression may match a given instruction.
+
+   Every SSA value gets a state, which is the set of search sub-expressions
+   ("items") it may match.  The state of an ALU instruction is looked up in a
+   per-opcode transition table from the states of its sources, so computing
+   it takes one table lookup per source.  The automaton only looks at
+   opcodes and whether a value is a load_const; bit sizes, variable
+   consistency, constant values and conditions are still checked by
+   nir_replace_instr() on the transforms the state lets through.
+
+   To keep the tables small, the states of the sources are first mapped
+   through a per-opcode filter which drops the items that never appear as a
+   source of that opcode, and the transition table is indexed by the
+   filtered states.
+   """
+   class Item(object):
+      def __init__(self, opcode, children):
+         self.opcode = opcode
+         self.children = children
+         # Indices of the transforms whose search expression is this item.
+         self.patterns = []
+         # Opcodes this item is a source of.
+         self.parent_ops = set()
+
+   def __init__(self, transforms):
+      self.patterns = [xform.search for xform in transforms]
+      self._compute_items()
+      self._build_table()
+
+   def _compute_items(self):
+      # Map from (opcode, child items) to item, so that equal subtrees of
+      # different search expressions share an item.
+      self.items = {}
+      self.opcodes = []
+
+      def get_item(opcode, children):
+         key = (opcode, children)
+         if key not in self.items:
+            self.items[key] = self.Item(opcode, children)
+            # nir_search also tries the swapped sources of commutative
+            # opcodes, so both orders lead to the same item.
+            if len(children) == 2 and \
+               "commutative" in opcodes[opcode].algebraic_properties:
+               self.items[(opcode, (children[1], children[0]))] = \
+                  self.items[key]
+         return self.items[key]
+
+      # Variables match anything and constants match load_const
+      # instructions; the actual variable and constant value are left to
+      # nir_search.
+      self.wildcard = get_item("__wildcard", ())
+      self.const = get_item("__const", ())
+
+      def process(value):
+         if isinstance(value, Constant):
+            return self.const
+         elif isinstance(value, Variable):
+            return self.const if value.is_constant else self.wildcard
+
+         assert isinstance(value, Expression)
+         if value.opcode not in self.opcodes:
+            self.opcodes.append(value.opcode)
+
+         children = tuple(process(src) for src in value.sources)
+         for child in children:
+            child.parent_ops.add(value.opcode)
+         return get_item(value.opcode, children)
+
+      for i, search in enumerate(self.patterns):
+         process(search).patterns.append(i)
+
+   def _build_table(self):
+      # All states found so far, and their indices.  The first two are the
+      # states of non-ALU values and load_const instructions.
+      self.states = [frozenset([self.wildcard]),
+                     frozenset([self.wildcard, self.const])]
+      state_index = dict((state, i) for i, state in enumerate(self.states))
+
+      # Per opcode: the filtered state of every state, the list of distinct
+      # filtered states and the transition table, which maps a tuple of
+      # filtered source state indices to a state index.
+      self.filter = defaultdict(list)
+      self.filtered_states = defaultdict(list)
+      filtered_index = defaultdict(dict)
+      self.table = defaultdict(dict)
+
+      # Transforms matched by each state, in the order of the source so
+      # nir_search tries them in the same order as before.
+      self.state_patterns = []
+
+      # States and filtered states which still need to be processed.
+      next_state = 0
+      next_filtered = defaultdict(int)
+
+      while next_state < len(self.states):
+         # Filter the new states for every opcode.
+         while next_state < len(self.states):
+            state = self.states[next_state]
+            self.state_patterns.append(
+               sorted(p for item in state for p in item.patterns))
+
+            for op in self.opcodes:
+               filtered = frozenset(item for item in state
+                                    if op in item.parent_ops)
+               if filtered not in filtered_index[op]:
+                  filtered_index[op][filtered] = len(self.filtered_states[op])
+                  self.filtered_states[op].append(filtered)
+               self.filter[op].append(filtered_index[op][filtered])
+
+            next_state += 1
+
+         # Compute the transitions involving a new filtered state.
+         for op in self.opcodes:
+            reps = self.filtered_states[op]
+            num_srcs = opcodes[op].num_inputs
+            for srcs in itertools.product(range(len(reps)), repeat=num_srcs):
+               if all(src < next_filtered[op] for src in srcs):
+                  continue
+
+               parent = set([self.wildcard])
+               for children in itertools.product(*(reps[s] for s in srcs)):
+                  if (op, children) in self.items:
+                     parent.add(self.items[(op, children)])
+               parent = frozenset(parent)
+
+               if parent not in state_index:
+                  state_index[parent] = len(self.states)
+                  self.states.append(parent)
+               self.table[op][srcs] = state_index[parent]
+
+            next_filtered[op] = len(reps)
+
+      assert len(self.states) <= 65536
+
+   def flat_table(self, op):
+      """The transition table of op, in the order the C code indexes it."""
+      reps = self.filtered_states[op]
+      return [self.table[op][srcs] for srcs in
+              itertools.product(range(len(reps)),
+                                repeat=opcodes[op].num_inputs)]
+
 _algebraic_pass_template = mako.template.Template("""
 #include "nir.h"
 #include "nir_search.h"
@@ -509,27 +653,110 @@ struct transform {
    unsigned condition_offset;
 };
 
+struct per_op_table {
+   const uint16_t *filter;
+   unsigned num_filtered_states;
+   const uint16_t *table;
+};
+
+/* The states every value which isn't the result of an ALU instruction
+ * starts in.  These must match TreeAutomaton._build_table().
+ */
+#define WILDCARD_STATE 0
+#define CONST_STATE 1
+
 #endif
 
-% for (opcode, xform_list) in xform_dict.iteritems():
-% for xform in xform_list:
+% for xform in xforms:
    ${xform.search.render()}
    ${xform.replace.render()}
 % endfor
 
-static const struct transform ${pass_name}_${opcode}_xforms[] = {
-% for xform in xform_list:
-   { &${xform.search.name}, ${xform.replace.c_ptr}, ${xform.condition_index} },
+% for state_id, patterns in enumerate(automaton.state_patterns):
+% if patterns:
+static const struct transform ${pass_name}_state${state_id}_xforms[] = {
+% for i in patterns:
+   { &${xforms[i].search.name}, ${xforms[i].replace.c_ptr}, ${xforms[i].condition_index} },
 % endfor
 };
+% endif
 % endfor
 
+% for op in automaton.opcodes:
+static const uint16_t ${pass_name}_${op}_filter[] = {
+% for i in range(0, len(automaton.filter[op]), 16):
+   ${', '.join(str(f) for f in automaton.filter[op][i:i + 16])},
+% endfor
+};
+
+static const uint16_t ${pass_name}_${op}_table[] = {
+<% table = automaton.flat_table(op) %>\\
+% for i in range(0, len(table), 16):
+   ${', '.join(str(t) for t in table[i:i + 16])},
+% endfor
+};
+
+% endfor
+static const struct per_op_table ${pass_name}_table[nir_num_opcodes] = {
+% for op in automaton.opcodes:
+   [nir_op_${op}] = {
+      ${pass_name}_${op}_filter,
+      ${len(automaton.filtered_states[op])},
+      ${pass_name}_${op}_table,
+   },
+% endfor
+};
+
+/* Computes the automaton state of every ALU and load_const instruction.
+ * Sources always come before their users except for phis, which are left
+ * in the wildcard state.
+ */
+static void
+${pass_name}_pre_block(nir_block *block, uint16_t *states)
+{
+   nir_foreach_instr(instr, block) {
+      switch (instr->type) {
+      case nir_instr_type_alu: {
+         nir_alu_instr *alu = nir_instr_as_alu(instr);
+         const struct per_op_table *tbl = &${pass_name}_table[alu->op];
+
+         if (tbl->table == NULL || !alu->dest.dest.is_ssa)
+            break;
+
+         /* This must match the order of itertools.product(), which was
+          * used to emit the transition table.
+          */
+         unsigned index = 0;
+         for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+            uint16_t src_state = alu->src[i].src.is_ssa ?
+               states[alu->src[i].src.ssa->index] : WILDCARD_STATE;
+
+            index = index * tbl->num_filtered_states + tbl->filter[src_state];
+         }
+         states[alu->dest.dest.ssa.index] = tbl->table[index];
+         break;
+      }
+
+      case nir_instr_type_load_const:
+         states[nir_instr_as_load_const(instr)->def.index] = CONST_STATE;
+         break;
+
+      default:
+         break;
+      }
+   }
+}
+
 static bool
-${pass_name}_block(nir_block *block, const bool *condition_flags,
-                   void *mem_ctx)
+${pass_name}_block(nir_block *block, const uint16_t *states,
+                   const bool *condition_flags, void *mem_ctx)
 {
    bool progress = false;
 
+   /* Instructions added by a replacement are inserted after the next
+    * instruction we visit, so we never look up the state of a value which
+    * was created after the states were computed.
+    */
    nir_foreach_instr_reverse_safe(instr, block) {
       if (instr->type != nir_instr_type_alu)
          continue;
@@ -538,11 +765,12 @@ ${pass_name}_block(nir_block *block, const bool *condition_flags,
       if (!alu->dest.dest.is_ssa)
          continue;
 
-      switch (alu->op) {
-      % for opcode in xform_dict.keys():
-      case nir_op_${opcode}:
-         for (unsigned i = 0; i < ARRAY_SIZE(${pass_name}_${opcode}_xforms); i++) {
-            const struct transform *xform = &${pass_name}_${opcode}_xforms[i];
+      switch (states[alu->dest.dest.ssa.index]) {
+% for state_id, patterns in enumerate(automaton.state_patterns):
+% if patterns:
+      case ${state_id}:
+         for (unsigned i = 0; i < ARRAY_SIZE(${pass_name}_state${state_id}_xforms); i++) {
+            const struct transform *xform = &${pass_name}_state${state_id}_xforms[i];
             if (condition_flags[xform->condition_offset] &&
                 nir_replace_instr(alu, xform->search, xform->replace,
                                   mem_ctx)) {
@@ -551,7 +779,8 @@ ${pass_name}_block(nir_block *block, const bool *condition_flags,
             }
          }
          break;
-      % endfor
+% endif
+% endfor
       default:
          break;
       }
@@ -566,10 +795,23 @@ ${pass_name}_impl(nir_function_impl *impl, const bool *condition_flags)
    void *mem_ctx = ralloc_parent(impl);
    bool progress = false;
 
+   /* Zero-filling puts everything in WILDCARD_STATE, so only ALU and
+    * load_const instructions need to be visited.
+    */
+   uint16_t *states = calloc(impl->ssa_alloc, sizeof(*states));
+   if (!states)
+      return false;
+
+   nir_foreach_block(block, impl) {
+      ${pass_name}_pre_block(block, states);
+   }
+
    nir_foreach_block_reverse(block, impl) {
-      progress |= ${pass_name}_block(block, condition_flags, mem_ctx);
+      progress |= ${pass_name}_block(block, states, condition_flags, mem_ctx);
    }
 
+   free(states);
+
    if (progress)
       nir_metadata_preserve(impl, nir_metadata_block_index |
                                   nir_metadata_dominance);
@@ -601,7 +843,7 @@ ${pass_name}(nir_shader *shader)
 
 class AlgebraicPass(object):
    def __init__(self, pass_name, transforms):
-      self.xform_dict = {}
+      self.xforms = []
       self.pass_name = pass_name
 
       error = False
@@ -618,15 +860,15 @@ class AlgebraicPass(object):
                error = True
                continue
 
-         if xform.search.opcode not in self.xform_dict:
-            self.xform_dict[xform.search.opcode] = []
-
-         self.xform_dict[xform.search.opcode].append(xform)
+         self.xforms.append(xform)
 
       if error:
          sys.exit(1)
 
+      self.automaton = TreeAutomaton(self.xforms)
+
    def render(self):
       return _algebraic_pass_template.render(pass_name=self.pass_name,
-                                             xform_dict=self.xform_dict,
+                                             xforms=self.xforms,
+                                             automaton=self.automaton,
                                              condition_list=condition_list)
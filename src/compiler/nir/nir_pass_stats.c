@@ -0,0 +1,215 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Process-wide statistics of the passes run through NIR_PASS and
+ * NIR_PASS_V, enabled by the NIR_PASS_STATS environment variable:
+ *
+ *    NIR_PASS_STATS=csv|json       format of the report printed at exit
+ *    NIR_PASS_STATS_FILE=<path>    where to write it instead of stderr
+ *
+ * For every pass, the report has the number of runs and of runs that made
+ * progress, the time spent in it and the instruction counts before and
+ * after it, summed over all runs.  NIR_PASS_V runs never count as progress.
+ */
+
+#include "nir.h"
+#include "c11/threads.h"
+#include "util/hash_table.h"
+#include "util/os_time.h"
+#include "util/simple_mtx.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum nir_pass_stats_format {
+   NIR_PASS_STATS_NONE,
+   NIR_PASS_STATS_CSV,
+   NIR_PASS_STATS_JSON,
+};
+
+struct nir_pass_stats {
+   const char *name;
+   unsigned runs;
+   unsigned progress;
+   int64_t time_ns;
+   uint64_t instrs_before;
+   uint64_t instrs_after;
+};
+
+static once_flag stats_once_flag = ONCE_FLAG_INIT;
+static enum nir_pass_stats_format stats_format;
+static simple_mtx_t stats_lock = _SIMPLE_MTX_INITIALIZER_NP;
+static struct hash_table *stats_table;
+
+static int
+compare_time(const void *a, const void *b)
+{
+   const struct nir_pass_stats *sa = *(const struct nir_pass_stats **)a;
+   const struct nir_pass_stats *sb = *(const struct nir_pass_stats **)b;
+
+   if (sa->time_ns != sb->time_ns)
+      return sa->time_ns > sb->time_ns ? -1 : 1;
+   return strcmp(sa->name, sb->name);
+}
+
+static void
+dump_stats(void)
+{
+   simple_mtx_lock(&stats_lock);
+
+   const char *path = getenv("NIR_PASS_STATS_FILE");
+   FILE *fp = path ? fopen(path, "w") : stderr;
+   if (!fp) {
+      fprintf(stderr, "NIR_PASS_STATS: failed to open %s\n", path);
+      simple_mtx_unlock(&stats_lock);
+      return;
+   }
+
+   /* Passes taking the most time first. */
+   unsigned count = stats_table->entries, i = 0;
+   struct nir_pass_stats **sorted = malloc(count * sizeof(*sorted));
+   struct hash_entry *entry;
+   hash_table_foreach(stats_table, entry)
+      sorted[i++] = entry->data;
+   qsort(sorted, count, sizeof(*sorted), compare_time);
+
+   if (stats_format == NIR_PASS_STATS_JSON)
+      fprintf(fp, "[\n");
+   else
+      fprintf(fp, "pass,runs,progress,time_us,instrs_before,instrs_after\n");
+
+   for (i = 0; i < count; i++) {
+      const struct nir_pass_stats *s = sorted[i];
+
+      if (stats_format == NIR_PASS_STATS_JSON) {
+         fprintf(fp, "  { \"pass\": \"%s\", \"runs\": %u, \"progress\": %u, "
+                 "\"time_us\": %.1f, \"instrs_before\": %" PRIu64 ", "
+                 "\"instrs_after\": %" PRIu64 " }%s\n",
+                 s->name, s->runs, s->progress, s->time_ns / 1000.0,
+                 s->instrs_before, s->instrs_after,
+                 i + 1 < count ? "," : "");
+      } else {
+         fprintf(fp, "%s,%u,%u,%.1f,%" PRIu64 ",%" PRIu64 "\n",
+                 s->name, s->runs, s->progress, s->time_ns / 1000.0,
+                 s->instrs_before, s->instrs_after);
+      }
+   }
+
+   if (stats_format == NIR_PASS_STATS_JSON)
+      fprintf(fp, "]\n");
+
+   free(sorted);
+   if (fp != stderr)
+      fclose(fp);
+
+   simple_mtx_unlock(&stats_lock);
+}
+
+static void
+init_stats(void)
+{
+   const char *format = getenv("NIR_PASS_STATS");
+
+   if (!format || !format[0])
+      return;
+
+   if (strcmp(format, "json") == 0) {
+      stats_format = NIR_PASS_STATS_JSON;
+   } else if (strcmp(format, "csv") == 0) {
+      stats_format = NIR_PASS_STATS_CSV;
+   } else {
+      fprintf(stderr, "NIR_PASS_STATS: unknown format \"%s\", "
+              "expected csv or json\n", format);
+      return;
+   }
+
+   stats_table = _mesa_hash_table_create(NULL, _mesa_key_hash_string,
+                                         _mesa_key_string_equal);
+   if (!stats_table) {
+      stats_format = NIR_PASS_STATS_NONE;
+      return;
+   }
+
+   atexit(dump_stats);
+}
+
+bool
+nir_pass_stats_enabled(void)
+{
+   call_once(&stats_once_flag, init_stats);
+   return stats_format != NIR_PASS_STATS_NONE;
+}
+
+static unsigned
+count_instrs(nir_shader *shader)
+{
+   unsigned count = 0;
+
+   nir_foreach_function(function, shader) {
+      if (!function->impl)
+         continue;
+
+      nir_foreach_block(block, function->impl)
+         count += exec_list_length(&block->instr_list);
+   }
+
+   return count;
+}
+
+void
+nir_pass_stats_begin(nir_shader *shader, struct nir_pass_stats_run *run)
+{
+   run->num_instrs = count_instrs(shader);
+   run->start_ns = os_time_get_nano();
+}
+
+void
+nir_pass_stats_end(nir_shader *shader, const char *pass, bool progress,
+                   const struct nir_pass_stats_run *run)
+{
+   int64_t time_ns = os_time_get_nano() - run->start_ns;
+   unsigned num_instrs = count_instrs(shader);
+
+   simple_mtx_lock(&stats_lock);
+
+   struct nir_pass_stats *s;
+   struct hash_entry *entry = _mesa_hash_table_search(stats_table, pass);
+   if (entry) {
+      s = entry->data;
+   } else {
+      s = rzalloc(stats_table, struct nir_pass_stats);
+      s->name = pass;
+      _mesa_hash_table_insert(stats_table, pass, s);
+   }
+
+   s->runs++;
+   if (progress)
+      s->progress++;
+   s->time_ns += time_ns;
+   s->instrs_before += run->num_instrs;
+   s->instrs_after += num_instrs;
+
+   simple_mtx_unlock(&stats_lock);
+}
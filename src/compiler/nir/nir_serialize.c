@@ -82,37 +82,69 @@ write_lookup_object(write_ctx *ctx, const void *obj)
    return (uintptr_t) entry->data;
 }
 
+/* References to objects are stored relative to the next index to assign,
+ * since most of them are to objects written shortly before, which makes them
+ * fit in one or two bytes.  Objects are added in the same order when reading,
+ * so the reader can resolve them the same way.
+ */
+static uintptr_t
+write_lookup_object_rel(write_ctx *ctx, const void *obj)
+{
+   uintptr_t idx = write_lookup_object(ctx, obj);
+   assert(idx < ctx->next_idx);
+   return ctx->next_idx - idx;
+}
+
 static void
 write_object(write_ctx *ctx, const void *obj)
 {
-   blob_write_intptr(ctx->blob, write_lookup_object(ctx, obj));
+   blob_write_varint(ctx->blob, write_lookup_object_rel(ctx, obj));
 }
 
+/* The reader may be handed a truncated or corrupt blob (e.g. from the disk
+ * cache), so indices are checked rather than asserted.  Bad ones are
+ * reported through blob->overrun, which callers already check.
+ */
 static void
 read_add_object(read_ctx *ctx, void *obj)
 {
-   assert(ctx->next_idx < ctx->idx_table_len);
+   if (ctx->next_idx >= ctx->idx_table_len) {
+      ctx->blob->overrun = true;
+      return;
+   }
    ctx->idx_table[ctx->next_idx++] = obj;
 }
 
 static void *
 read_lookup_object(read_ctx *ctx, uintptr_t idx)
 {
-   assert(idx < ctx->idx_table_len);
+   /* A relative index larger than next_idx wraps around to a huge value, so
+    * this also catches those.
+    */
+   if (idx >= ctx->next_idx) {
+      ctx->blob->overrun = true;
+      return NULL;
+   }
    return ctx->idx_table[idx];
 }
 
+static void *
+read_lookup_object_rel(read_ctx *ctx, uintptr_t rel)
+{
+   return read_lookup_object(ctx, ctx->next_idx - rel);
+}
+
 static void *
 read_object(read_ctx *ctx)
 {
-   return read_lookup_object(ctx, blob_read_intptr(ctx->blob));
+   return read_lookup_object_rel(ctx, blob_read_varint(ctx->blob));
 }
 
 static void
 write_constant(write_ctx *ctx, const nir_constant *c)
 {
    blob_write_bytes(ctx->blob, c->values, sizeof(c->values));
-   blob_write_uint32(ctx->blob, c->num_elements);
+   blob_write_varint(ctx->blob, c->num_elements);
    for (unsigned i = 0; i < c->num_elements; i++)
       write_constant(ctx, c->elements[i]);
 }
@@ -123,8 +155,9 @@ read_constant(read_ctx *ctx, nir_variable *nvar)
    nir_constant *c = ralloc(nvar, nir_constant);
 
    blob_copy_bytes(ctx->blob, (uint8_t *)c->values, sizeof(c->values));
-   c->num_elements = blob_read_uint32(ctx->blob);
-   c->elements = ralloc_array(ctx->nir, nir_constant *, c->num_elements);
+   c->num_elements = blob_read_varint(ctx->blob);
+   c->elements = c->num_elements ?
+      ralloc_array(ctx->nir, nir_constant *, c->num_elements) : NULL;
    for (unsigned i = 0; i < c->num_elements; i++)
       c->elements[i] = read_constant(ctx, nvar);
 
@@ -136,17 +169,17 @@ write_variable(write_ctx *ctx, const nir_variable *var)
 {
    write_add_object(ctx, var);
    encode_type_to_blob(ctx->blob, var->type);
-   blob_write_uint32(ctx->blob, !!(var->name));
+   blob_write_varint(ctx->blob, !!(var->name));
    if (var->name)
       blob_write_string(ctx->blob, var->name);
    blob_write_bytes(ctx->blob, (uint8_t *) &var->data, sizeof(var->data));
-   blob_write_uint32(ctx->blob, var->num_state_slots);
+   blob_write_varint(ctx->blob, var->num_state_slots);
    blob_write_bytes(ctx->blob, (uint8_t *) var->state_slots,
                     var->num_state_slots * sizeof(nir_state_slot));
-   blob_write_uint32(ctx->blob, !!(var->constant_initializer));
+   blob_write_varint(ctx->blob, !!(var->constant_initializer));
    if (var->constant_initializer)
       write_constant(ctx, var->constant_initializer);
-   blob_write_uint32(ctx->blob, !!(var->interface_type));
+   blob_write_varint(ctx->blob, !!(var->interface_type));
    if (var->interface_type)
       encode_type_to_blob(ctx->blob, var->interface_type);
 }
@@ -158,7 +191,7 @@ read_variable(read_ctx *ctx)
    read_add_object(ctx, var);
 
    var->type = decode_type_from_blob(ctx->blob);
-   bool has_name = blob_read_uint32(ctx->blob);
+   bool has_name = blob_read_varint(ctx->blob);
    if (has_name) {
       const char *name = blob_read_string(ctx->blob);
       var->name = ralloc_strdup(var, name);
@@ -166,16 +199,19 @@ read_variable(read_ctx *ctx)
       var->name = NULL;
    }
    blob_copy_bytes(ctx->blob, (uint8_t *) &var->data, sizeof(var->data));
-   var->num_state_slots = blob_read_uint32(ctx->blob);
-   var->state_slots = ralloc_array(var, nir_state_slot, var->num_state_slots);
-   blob_copy_bytes(ctx->blob, (uint8_t *) var->state_slots,
-                   var->num_state_slots * sizeof(nir_state_slot));
-   bool has_const_initializer = blob_read_uint32(ctx->blob);
+   var->num_state_slots = blob_read_varint(ctx->blob);
+   if (var->num_state_slots) {
+      var->state_slots = ralloc_array(var, nir_state_slot,
+                                      var->num_state_slots);
+      blob_copy_bytes(ctx->blob, (uint8_t *) var->state_slots,
+                      var->num_state_slots * sizeof(nir_state_slot));
+   }
+   bool has_const_initializer = blob_read_varint(ctx->blob);
    if (has_const_initializer)
       var->constant_initializer = read_constant(ctx, var);
    else
       var->constant_initializer = NULL;
-   bool has_interface_type = blob_read_uint32(ctx->blob);
+   bool has_interface_type = blob_read_varint(ctx->blob);
    if (has_interface_type)
       var->interface_type = decode_type_from_blob(ctx->blob);
    else
@@ -187,7 +223,7 @@ read_variable(read_ctx *ctx)
 static void
 write_var_list(write_ctx *ctx, const struct exec_list *src)
 {
-   blob_write_uint32(ctx->blob, exec_list_length(src));
+   blob_write_varint(ctx->blob, exec_list_length(src));
    foreach_list_typed(nir_variable, var, node, src) {
       write_variable(ctx, var);
    }
@@ -197,7 +233,7 @@ static void
 read_var_list(read_ctx *ctx, struct exec_list *dst)
 {
    exec_list_make_empty(dst);
-   unsigned num_vars = blob_read_uint32(ctx->blob);
+   unsigned num_vars = blob_read_varint(ctx->blob);
    for (unsigned i = 0; i < num_vars; i++) {
       nir_variable *var = read_variable(ctx);
       exec_list_push_tail(dst, &var->node);
@@ -208,14 +244,14 @@ static void
 write_register(write_ctx *ctx, const nir_register *reg)
 {
    write_add_object(ctx, reg);
-   blob_write_uint32(ctx->blob, reg->num_components);
-   blob_write_uint32(ctx->blob, reg->bit_size);
-   blob_write_uint32(ctx->blob, reg->num_array_elems);
-   blob_write_uint32(ctx->blob, reg->index);
-   blob_write_uint32(ctx->blob, !!(reg->name));
+   blob_write_varint(ctx->blob, reg->num_components);
+   blob_write_varint(ctx->blob, reg->bit_size);
+   blob_write_varint(ctx->blob, reg->num_array_elems);
+   blob_write_varint(ctx->blob, reg->index);
+   blob_write_varint(ctx->blob, !!(reg->name));
    if (reg->name)
       blob_write_string(ctx->blob, reg->name);
-   blob_write_uint32(ctx->blob, reg->is_global << 1 | reg->is_packed);
+   blob_write_varint(ctx->blob, reg->is_global << 1 | reg->is_packed);
 }
 
 static nir_register *
@@ -223,18 +259,18 @@ read_register(read_ctx *ctx)
 {
    nir_register *reg = ralloc(ctx->nir, nir_register);
    read_add_object(ctx, reg);
-   reg->num_components = blob_read_uint32(ctx->blob);
-   reg->bit_size = blob_read_uint32(ctx->blob);
-   reg->num_array_elems = blob_read_uint32(ctx->blob);
-   reg->index = blob_read_uint32(ctx->blob);
-   bool has_name = blob_read_uint32(ctx->blob);
+   reg->num_components = blob_read_varint(ctx->blob);
+   reg->bit_size = blob_read_varint(ctx->blob);
+   reg->num_array_elems = blob_read_varint(ctx->blob);
+   reg->index = blob_read_varint(ctx->blob);
+   bool has_name = blob_read_varint(ctx->blob);
    if (has_name) {
       const char *name = blob_read_string(ctx->blob);
       reg->name = ralloc_strdup(reg, name);
    } else {
       reg->name = NULL;
    }
-   unsigned flags = blob_read_uint32(ctx->blob);
+   unsigned flags = blob_read_varint(ctx->blob);
    reg->is_global = flags & 0x2;
    reg->is_packed = flags & 0x1;
 
@@ -248,7 +284,7 @@ read_register(read_ctx *ctx)
 static void
 write_reg_list(write_ctx *ctx, const struct exec_list *src)
 {
-   blob_write_uint32(ctx->blob, exec_list_length(src));
+   blob_write_varint(ctx->blob, exec_list_length(src));
    foreach_list_typed(nir_register, reg, node, src)
       write_register(ctx, reg);
 }
@@ -257,7 +293,7 @@ static void
 read_reg_list(read_ctx *ctx, struct exec_list *dst)
 {
    exec_list_make_empty(dst);
-   unsigned num_regs = blob_read_uint32(ctx->blob);
+   unsigned num_regs = blob_read_varint(ctx->blob);
    for (unsigned i = 0; i < num_regs; i++) {
       nir_register *reg = read_register(ctx);
       exec_list_push_tail(dst, &reg->node);
@@ -269,20 +305,19 @@ write_src(write_ctx *ctx, const nir_src *src)
 {
    /* Since sources are very frequent, we try to save some space when storing
     * them. In particular, we store whether the source is a register and
-    * whether the register has an indirect index in the low two bits. We can
-    * assume that the high two bits of the index are zero, since otherwise our
-    * address space would've been exhausted allocating the remap table!
+    * whether the register has an indirect index in the low two bits of the
+    * relative index of the value.
     */
    if (src->is_ssa) {
-      uintptr_t idx = write_lookup_object(ctx, src->ssa) << 2;
+      uintptr_t idx = write_lookup_object_rel(ctx, src->ssa) << 2;
       idx |= 1;
-      blob_write_intptr(ctx->blob, idx);
+      blob_write_varint(ctx->blob, idx);
    } else {
-      uintptr_t idx = write_lookup_object(ctx, src->reg.reg) << 2;
+      uintptr_t idx = write_lookup_object_rel(ctx, src->reg.reg) << 2;
       if (src->reg.indirect)
          idx |= 2;
-      blob_write_intptr(ctx->blob, idx);
-      blob_write_uint32(ctx->blob, src->reg.base_offset);
+      blob_write_varint(ctx->blob, idx);
+      blob_write_varint(ctx->blob, src->reg.base_offset);
       if (src->reg.indirect) {
          write_src(ctx, src->reg.indirect);
       }
@@ -292,15 +327,15 @@ write_src(write_ctx *ctx, const nir_src *src)
 static void
 read_src(read_ctx *ctx, nir_src *src, void *mem_ctx)
 {
-   uintptr_t val = blob_read_intptr(ctx->blob);
+   uintptr_t val = blob_read_varint(ctx->blob);
    uintptr_t idx = val >> 2;
    src->is_ssa = val & 0x1;
    if (src->is_ssa) {
-      src->ssa = read_lookup_object(ctx, idx);
+      src->ssa = read_lookup_object_rel(ctx, idx);
    } else {
       bool is_indirect = val & 0x2;
-      src->reg.reg = read_lookup_object(ctx, idx);
-      src->reg.base_offset = blob_read_uint32(ctx->blob);
+      src->reg.reg = read_lookup_object_rel(ctx, idx);
+      src->reg.base_offset = blob_read_varint(ctx->blob);
       if (is_indirect) {
          src->reg.indirect = ralloc(mem_ctx, nir_src);
          read_src(ctx, src->reg.indirect, mem_ctx);
@@ -321,14 +356,14 @@ write_dest(write_ctx *ctx, const nir_dest *dst)
    } else {
       val |= !!(dst->reg.indirect) << 1;
    }
-   blob_write_uint32(ctx->blob, val);
+   blob_write_varint(ctx->blob, val);
    if (dst->is_ssa) {
       write_add_object(ctx, &dst->ssa);
       if (dst->ssa.name)
          blob_write_string(ctx->blob, dst->ssa.name);
    } else {
-      blob_write_intptr(ctx->blob, write_lookup_object(ctx, dst->reg.reg));
-      blob_write_uint32(ctx->blob, dst->reg.base_offset);
+      write_object(ctx, dst->reg.reg);
+      blob_write_varint(ctx->blob, dst->reg.base_offset);
       if (dst->reg.indirect)
          write_src(ctx, dst->reg.indirect);
    }
@@ -337,7 +372,7 @@ write_dest(write_ctx *ctx, const nir_dest *dst)
 static void
 read_dest(read_ctx *ctx, nir_dest *dst, nir_instr *instr)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
+   uint32_t val = blob_read_varint(ctx->blob);
    bool is_ssa = val & 0x1;
    if (is_ssa) {
       bool has_name = val & 0x2;
@@ -349,7 +384,7 @@ read_dest(read_ctx *ctx, nir_dest *dst, nir_instr *instr)
    } else {
       bool is_indirect = val & 0x2;
       dst->reg.reg = read_object(ctx);
-      dst->reg.base_offset = blob_read_uint32(ctx->blob);
+      dst->reg.base_offset = blob_read_varint(ctx->blob);
       if (is_indirect) {
          dst->reg.indirect = ralloc(instr, nir_src);
          read_src(ctx, dst->reg.indirect, instr);
@@ -365,22 +400,22 @@ write_deref_chain(write_ctx *ctx, const nir_deref_var *deref_var)
    uint32_t len = 0;
    for (const nir_deref *d = deref_var->deref.child; d; d = d->child)
       len++;
-   blob_write_uint32(ctx->blob, len);
+   blob_write_varint(ctx->blob, len);
 
    for (const nir_deref *d = deref_var->deref.child; d; d = d->child) {
-      blob_write_uint32(ctx->blob, d->deref_type);
+      blob_write_varint(ctx->blob, d->deref_type);
       switch (d->deref_type) {
       case nir_deref_type_array: {
          const nir_deref_array *deref_array = nir_deref_as_array(d);
-         blob_write_uint32(ctx->blob, deref_array->deref_array_type);
-         blob_write_uint32(ctx->blob, deref_array->base_offset);
+         blob_write_varint(ctx->blob, deref_array->deref_array_type);
+         blob_write_varint(ctx->blob, deref_array->base_offset);
          if (deref_array->deref_array_type == nir_deref_array_type_indirect)
             write_src(ctx, &deref_array->indirect);
          break;
       }
       case nir_deref_type_struct: {
          const nir_deref_struct *deref_struct = nir_deref_as_struct(d);
-         blob_write_uint32(ctx->blob, deref_struct->index);
+         blob_write_varint(ctx->blob, deref_struct->index);
          break;
       }
       case nir_deref_type_var:
@@ -395,26 +430,29 @@ static nir_deref_var *
 read_deref_chain(read_ctx *ctx, void *mem_ctx)
 {
    nir_variable *var = read_object(ctx);
+   if (var == NULL)
+      return NULL;
+
    nir_deref_var *deref_var = nir_deref_var_create(mem_ctx, var);
 
-   uint32_t len = blob_read_uint32(ctx->blob);
+   uint32_t len = blob_read_varint(ctx->blob);
 
    nir_deref *tail = &deref_var->deref;
    for (uint32_t i = 0; i < len; i++) {
-      nir_deref_type deref_type = blob_read_uint32(ctx->blob);
+      nir_deref_type deref_type = blob_read_varint(ctx->blob);
       nir_deref *deref = NULL;
       switch (deref_type) {
       case nir_deref_type_array: {
          nir_deref_array *deref_array = nir_deref_array_create(tail);
-         deref_array->deref_array_type = blob_read_uint32(ctx->blob);
-         deref_array->base_offset = blob_read_uint32(ctx->blob);
+         deref_array->deref_array_type = blob_read_varint(ctx->blob);
+         deref_array->base_offset = blob_read_varint(ctx->blob);
          if (deref_array->deref_array_type == nir_deref_array_type_indirect)
             read_src(ctx, &deref_array->indirect, mem_ctx);
          deref = &deref_array->deref;
          break;
       }
       case nir_deref_type_struct: {
-         uint32_t index = blob_read_uint32(ctx->blob);
+         uint32_t index = blob_read_varint(ctx->blob);
          nir_deref_struct *deref_struct = nir_deref_struct_create(tail, index);
          deref = &deref_struct->deref;
          break;
@@ -435,11 +473,11 @@ read_deref_chain(read_ctx *ctx, void *mem_ctx)
 static void
 write_alu(write_ctx *ctx, const nir_alu_instr *alu)
 {
-   blob_write_uint32(ctx->blob, alu->op);
+   /* The opcode and the flags share one header. */
    uint32_t flags = alu->exact;
    flags |= alu->dest.saturate << 1;
    flags |= alu->dest.write_mask << 2;
-   blob_write_uint32(ctx->blob, flags);
+   blob_write_varint(ctx->blob, alu->op << 6 | flags);
 
    write_dest(ctx, &alu->dest.dest);
 
@@ -449,26 +487,26 @@ write_alu(write_ctx *ctx, const nir_alu_instr *alu)
       flags |= alu->src[i].abs << 1;
       for (unsigned j = 0; j < 4; j++)
          flags |= alu->src[i].swizzle[j] << (2 + 2 * j);
-      blob_write_uint32(ctx->blob, flags);
+      blob_write_varint(ctx->blob, flags);
    }
 }
 
 static nir_alu_instr *
 read_alu(read_ctx *ctx)
 {
-   nir_op op = blob_read_uint32(ctx->blob);
+   uint32_t flags = blob_read_varint(ctx->blob);
+   nir_op op = flags >> 6;
    nir_alu_instr *alu = nir_alu_instr_create(ctx->nir, op);
 
-   uint32_t flags = blob_read_uint32(ctx->blob);
    alu->exact = flags & 1;
    alu->dest.saturate = flags & 2;
-   alu->dest.write_mask = flags >> 2;
+   alu->dest.write_mask = (flags >> 2) & 0xf;
 
    read_dest(ctx, &alu->dest.dest, &alu->instr);
 
    for (unsigned i = 0; i < nir_op_infos[op].num_inputs; i++) {
       read_src(ctx, &alu->src[i].src, &alu->instr);
-      flags = blob_read_uint32(ctx->blob);
+      flags = blob_read_varint(ctx->blob);
       alu->src[i].negate = flags & 1;
       alu->src[i].abs = flags & 2;
       for (unsigned j = 0; j < 4; j++)
@@ -481,14 +519,13 @@ read_alu(read_ctx *ctx)
 static void
 write_intrinsic(write_ctx *ctx, const nir_intrinsic_instr *intrin)
 {
-   blob_write_uint32(ctx->blob, intrin->intrinsic);
+   assert(intrin->num_components < 8);
+   blob_write_varint(ctx->blob, intrin->intrinsic << 3 | intrin->num_components);
 
    unsigned num_variables = nir_intrinsic_infos[intrin->intrinsic].num_variables;
    unsigned num_srcs = nir_intrinsic_infos[intrin->intrinsic].num_srcs;
    unsigned num_indices = nir_intrinsic_infos[intrin->intrinsic].num_indices;
 
-   blob_write_uint32(ctx->blob, intrin->num_components);
-
    if (nir_intrinsic_infos[intrin->intrinsic].has_dest)
       write_dest(ctx, &intrin->dest);
 
@@ -499,13 +536,14 @@ write_intrinsic(write_ctx *ctx, const nir_intrinsic_instr *intrin)
       write_src(ctx, &intrin->src[i]);
 
    for (unsigned i = 0; i < num_indices; i++)
-      blob_write_uint32(ctx->blob, intrin->const_index[i]);
+      blob_write_varint(ctx->blob, (uint32_t) intrin->const_index[i]);
 }
 
 static nir_intrinsic_instr *
 read_intrinsic(read_ctx *ctx)
 {
-   nir_intrinsic_op op = blob_read_uint32(ctx->blob);
+   uint32_t val = blob_read_varint(ctx->blob);
+   nir_intrinsic_op op = val >> 3;
 
    nir_intrinsic_instr *intrin = nir_intrinsic_instr_create(ctx->nir, op);
 
@@ -513,7 +551,7 @@ read_intrinsic(read_ctx *ctx)
    unsigned num_srcs = nir_intrinsic_infos[op].num_srcs;
    unsigned num_indices = nir_intrinsic_infos[op].num_indices;
 
-   intrin->num_components = blob_read_uint32(ctx->blob);
+   intrin->num_components = val & 0x7;
 
    if (nir_intrinsic_infos[op].has_dest)
       read_dest(ctx, &intrin->dest, &intrin->instr);
@@ -525,7 +563,7 @@ read_intrinsic(read_ctx *ctx)
       read_src(ctx, &intrin->src[i], &intrin->instr);
 
    for (unsigned i = 0; i < num_indices; i++)
-      intrin->const_index[i] = blob_read_uint32(ctx->blob);
+      intrin->const_index[i] = (uint32_t) blob_read_varint(ctx->blob);
 
    return intrin;
 }
@@ -535,20 +573,23 @@ write_load_const(write_ctx *ctx, const nir_load_const_instr *lc)
 {
    uint32_t val = lc->def.num_components;
    val |= lc->def.bit_size << 3;
-   blob_write_uint32(ctx->blob, val);
-   blob_write_bytes(ctx->blob, (uint8_t *) &lc->value, sizeof(lc->value));
+   blob_write_varint(ctx->blob, val);
+   /* Only the components in use, the rest of the value is zero. */
+   blob_write_bytes(ctx->blob, (uint8_t *) &lc->value,
+                    lc->def.num_components * lc->def.bit_size / 8);
    write_add_object(ctx, &lc->def);
 }
 
 static nir_load_const_instr *
 read_load_const(read_ctx *ctx)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
+   uint32_t val = blob_read_varint(ctx->blob);
 
    nir_load_const_instr *lc =
       nir_load_const_instr_create(ctx->nir, val & 0x7, val >> 3);
 
-   blob_copy_bytes(ctx->blob, (uint8_t *) &lc->value, sizeof(lc->value));
+   blob_copy_bytes(ctx->blob, (uint8_t *) &lc->value,
+                   lc->def.num_components * lc->def.bit_size / 8);
    read_add_object(ctx, &lc->def);
    return lc;
 }
@@ -558,14 +599,14 @@ write_ssa_undef(write_ctx *ctx, const nir_ssa_undef_instr *undef)
 {
    uint32_t val = undef->def.num_components;
    val |= undef->def.bit_size << 3;
-   blob_write_uint32(ctx->blob, val);
+   blob_write_varint(ctx->blob, val);
    write_add_object(ctx, &undef->def);
 }
 
 static nir_ssa_undef_instr *
 read_ssa_undef(read_ctx *ctx)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
+   uint32_t val = blob_read_varint(ctx->blob);
 
    nir_ssa_undef_instr *undef =
       nir_ssa_undef_instr_create(ctx->nir, val & 0x7, val >> 3);
@@ -593,11 +634,11 @@ union packed_tex_data {
 static void
 write_tex(write_ctx *ctx, const nir_tex_instr *tex)
 {
-   blob_write_uint32(ctx->blob, tex->num_srcs);
-   blob_write_uint32(ctx->blob, tex->op);
-   blob_write_uint32(ctx->blob, tex->texture_index);
-   blob_write_uint32(ctx->blob, tex->texture_array_size);
-   blob_write_uint32(ctx->blob, tex->sampler_index);
+   blob_write_varint(ctx->blob, tex->num_srcs);
+   blob_write_varint(ctx->blob, tex->op);
+   blob_write_varint(ctx->blob, tex->texture_index);
+   blob_write_varint(ctx->blob, tex->texture_array_size);
+   blob_write_varint(ctx->blob, tex->sampler_index);
 
    STATIC_ASSERT(sizeof(union packed_tex_data) == sizeof(uint32_t));
    union packed_tex_data packed = {
@@ -611,11 +652,11 @@ write_tex(write_ctx *ctx, const nir_tex_instr *tex)
       .u.has_texture_deref = tex->texture != NULL,
       .u.has_sampler_deref = tex->sampler != NULL,
    };
-   blob_write_uint32(ctx->blob, packed.u32);
+   blob_write_varint(ctx->blob, packed.u32);
 
    write_dest(ctx, &tex->dest);
    for (unsigned i = 0; i < tex->num_srcs; i++) {
-      blob_write_uint32(ctx->blob, tex->src[i].src_type);
+      blob_write_varint(ctx->blob, tex->src[i].src_type);
       write_src(ctx, &tex->src[i].src);
    }
 
@@ -628,16 +669,16 @@ write_tex(write_ctx *ctx, const nir_tex_instr *tex)
 static nir_tex_instr *
 read_tex(read_ctx *ctx)
 {
-   unsigned num_srcs = blob_read_uint32(ctx->blob);
+   unsigned num_srcs = blob_read_varint(ctx->blob);
    nir_tex_instr *tex = nir_tex_instr_create(ctx->nir, num_srcs);
 
-   tex->op = blob_read_uint32(ctx->blob);
-   tex->texture_index = blob_read_uint32(ctx->blob);
-   tex->texture_array_size = blob_read_uint32(ctx->blob);
-   tex->sampler_index = blob_read_uint32(ctx->blob);
+   tex->op = blob_read_varint(ctx->blob);
+   tex->texture_index = blob_read_varint(ctx->blob);
+   tex->texture_array_size = blob_read_varint(ctx->blob);
+   tex->sampler_index = blob_read_varint(ctx->blob);
 
    union packed_tex_data packed;
-   packed.u32 = blob_read_uint32(ctx->blob);
+   packed.u32 = blob_read_varint(ctx->blob);
    tex->sampler_dim = packed.u.sampler_dim;
    tex->dest_type = packed.u.dest_type;
    tex->coord_components = packed.u.coord_components;
@@ -648,7 +689,7 @@ read_tex(read_ctx *ctx)
 
    read_dest(ctx, &tex->dest, &tex->instr);
    for (unsigned i = 0; i < tex->num_srcs; i++) {
-      tex->src[i].src_type = blob_read_uint32(ctx->blob);
+      tex->src[i].src_type = blob_read_varint(ctx->blob);
       read_src(ctx, &tex->src[i].src, &tex->instr);
    }
 
@@ -664,19 +705,19 @@ static void
 write_phi(write_ctx *ctx, const nir_phi_instr *phi)
 {
    /* Phi nodes are special, since they may reference SSA definitions and
-    * basic blocks that don't exist yet. We leave two empty uintptr_t's here,
+    * basic blocks that don't exist yet. We leave two empty uint32_t's here,
     * and then store enough information so that a later fixup pass can fill
     * them in correctly.
     */
    write_dest(ctx, &phi->dest);
 
-   blob_write_uint32(ctx->blob, exec_list_length(&phi->srcs));
+   blob_write_varint(ctx->blob, exec_list_length(&phi->srcs));
 
    nir_foreach_phi_src(src, phi) {
       assert(src->src.is_ssa);
-      size_t blob_offset = blob_reserve_intptr(ctx->blob);
-      MAYBE_UNUSED size_t blob_offset2 = blob_reserve_intptr(ctx->blob);
-      assert(blob_offset + sizeof(uintptr_t) == blob_offset2);
+      size_t blob_offset = blob_reserve_uint32(ctx->blob);
+      MAYBE_UNUSED size_t blob_offset2 = blob_reserve_uint32(ctx->blob);
+      assert(blob_offset + sizeof(uint32_t) == blob_offset2);
       write_phi_fixup fixup = {
          .blob_offset = blob_offset,
          .src = src->src.ssa,
@@ -690,7 +731,7 @@ static void
 write_fixup_phis(write_ctx *ctx)
 {
    util_dynarray_foreach(&ctx->phi_fixups, write_phi_fixup, fixup) {
-      uintptr_t *blob_ptr = (uintptr_t *)(ctx->blob->data + fixup->blob_offset);
+      uint32_t *blob_ptr = (uint32_t *)(ctx->blob->data + fixup->blob_offset);
       blob_ptr[0] = write_lookup_object(ctx, fixup->src);
       blob_ptr[1] = write_lookup_object(ctx, fixup->block);
    }
@@ -705,7 +746,7 @@ read_phi(read_ctx *ctx, nir_block *blk)
 
    read_dest(ctx, &phi->dest, &phi->instr);
 
-   unsigned num_srcs = blob_read_uint32(ctx->blob);
+   unsigned num_srcs = blob_read_varint(ctx->blob);
 
    /* For similar reasons as before, we just store the index directly into the
     * pointer, and let a later pass resolve the phi sources.
@@ -715,14 +756,17 @@ read_phi(read_ctx *ctx, nir_block *blk)
     * lists, we have to add the phi instruction *before* we set up its
     * sources.
     */
+   if (ctx->blob->overrun)
+      return;
+
    nir_instr_insert_after_block(blk, &phi->instr);
 
    for (unsigned i = 0; i < num_srcs; i++) {
       nir_phi_src *src = ralloc(phi, nir_phi_src);
 
       src->src.is_ssa = true;
-      src->src.ssa = (nir_ssa_def *) blob_read_intptr(ctx->blob);
-      src->pred = (nir_block *) blob_read_intptr(ctx->blob);
+      src->src.ssa = (nir_ssa_def *)(uintptr_t) blob_read_uint32(ctx->blob);
+      src->pred = (nir_block *)(uintptr_t) blob_read_uint32(ctx->blob);
 
       /* Since we're not letting nir_insert_instr handle use/def stuff for us,
        * we have to set the parent_instr manually.  It doesn't really matter
@@ -744,6 +788,14 @@ read_phi(read_ctx *ctx, nir_block *blk)
 static void
 read_fixup_phis(read_ctx *ctx)
 {
+   /* After an overrun the indices may refer to objects of the wrong type,
+    * so leave the sources unresolved.  The shader is thrown away anyway.
+    */
+   if (ctx->blob->overrun) {
+      list_inithead(&ctx->phi_srcs);
+      return;
+   }
+
    list_for_each_entry_safe(nir_phi_src, src, &ctx->phi_srcs, src.use_link) {
       src->pred = read_lookup_object(ctx, (uintptr_t)src->pred);
       src->src.ssa = read_lookup_object(ctx, (uintptr_t)src->src.ssa);
@@ -751,7 +803,8 @@ read_fixup_phis(read_ctx *ctx)
       /* Remove from this list */
       list_del(&src->src.use_link);
 
-      list_addtail(&src->src.use_link, &src->src.ssa->uses);
+      if (src->src.ssa)
+         list_addtail(&src->src.use_link, &src->src.ssa->uses);
    }
    assert(list_empty(&ctx->phi_srcs));
 }
@@ -759,13 +812,13 @@ read_fixup_phis(read_ctx *ctx)
 static void
 write_jump(write_ctx *ctx, const nir_jump_instr *jmp)
 {
-   blob_write_uint32(ctx->blob, jmp->type);
+   blob_write_varint(ctx->blob, jmp->type);
 }
 
 static nir_jump_instr *
 read_jump(read_ctx *ctx)
 {
-   nir_jump_type type = blob_read_uint32(ctx->blob);
+   nir_jump_type type = blob_read_varint(ctx->blob);
    nir_jump_instr *jmp = nir_jump_instr_create(ctx->nir, type);
    return jmp;
 }
@@ -773,7 +826,7 @@ read_jump(read_ctx *ctx)
 static void
 write_call(write_ctx *ctx, const nir_call_instr *call)
 {
-   blob_write_intptr(ctx->blob, write_lookup_object(ctx, call->callee));
+   write_object(ctx, call->callee);
 
    for (unsigned i = 0; i < call->num_params; i++)
       write_deref_chain(ctx, call->params[i]);
@@ -785,6 +838,9 @@ static nir_call_instr *
 read_call(read_ctx *ctx)
 {
    nir_function *callee = read_object(ctx);
+   if (callee == NULL)
+      return NULL;
+
    nir_call_instr *call = nir_call_instr_create(ctx->nir, callee);
 
    for (unsigned i = 0; i < call->num_params; i++)
@@ -798,7 +854,7 @@ read_call(read_ctx *ctx)
 static void
 write_instr(write_ctx *ctx, const nir_instr *instr)
 {
-   blob_write_uint32(ctx->blob, instr->type);
+   blob_write_varint(ctx->blob, instr->type);
    switch (instr->type) {
    case nir_instr_type_alu:
       write_alu(ctx, nir_instr_as_alu(instr));
@@ -834,7 +890,7 @@ write_instr(write_ctx *ctx, const nir_instr *instr)
 static void
 read_instr(read_ctx *ctx, nir_block *block)
 {
-   nir_instr_type type = blob_read_uint32(ctx->blob);
+   nir_instr_type type = blob_read_varint(ctx->blob);
    nir_instr *instr;
    switch (type) {
    case nir_instr_type_alu:
@@ -863,15 +919,23 @@ read_instr(read_ctx *ctx, nir_block *block)
    case nir_instr_type_jump:
       instr = &read_jump(ctx)->instr;
       break;
-   case nir_instr_type_call:
-      instr = &read_call(ctx)->instr;
+   case nir_instr_type_call: {
+      nir_call_instr *call = read_call(ctx);
+      if (call == NULL)
+         return;
+      instr = &call->instr;
       break;
+   }
    case nir_instr_type_parallel_copy:
       unreachable("Cannot read parallel copies");
    default:
       unreachable("bad instr type");
    }
 
+   /* Its sources may be missing, so don't add it to their use lists. */
+   if (ctx->blob->overrun)
+      return;
+
    nir_instr_insert_after_block(block, instr);
 }
 
@@ -879,7 +943,7 @@ static void
 write_block(write_ctx *ctx, const nir_block *block)
 {
    write_add_object(ctx, block);
-   blob_write_uint32(ctx->blob, exec_list_length(&block->instr_list));
+   blob_write_varint(ctx->blob, exec_list_length(&block->instr_list));
    nir_foreach_instr(instr, block)
       write_instr(ctx, instr);
 }
@@ -895,8 +959,8 @@ read_block(read_ctx *ctx, struct exec_list *cf_list)
       exec_node_data(nir_block, exec_list_get_tail(cf_list), cf_node.node);
 
    read_add_object(ctx, block);
-   unsigned num_instrs = blob_read_uint32(ctx->blob);
-   for (unsigned i = 0; i < num_instrs; i++) {
+   unsigned num_instrs = blob_read_varint(ctx->blob);
+   for (unsigned i = 0; i < num_instrs && !ctx->blob->overrun; i++) {
       read_instr(ctx, block);
    }
 }
@@ -922,6 +986,8 @@ read_if(read_ctx *ctx, struct exec_list *cf_list)
    nir_if *nif = nir_if_create(ctx->nir);
 
    read_src(ctx, &nif->condition, nif);
+   if (ctx->blob->overrun)
+      return;
 
    nir_cf_node_insert_end(cf_list, &nif->cf_node);
 
@@ -948,7 +1014,7 @@ read_loop(read_ctx *ctx, struct exec_list *cf_list)
 static void
 write_cf_node(write_ctx *ctx, nir_cf_node *cf)
 {
-   blob_write_uint32(ctx->blob, cf->type);
+   blob_write_varint(ctx->blob, cf->type);
 
    switch (cf->type) {
    case nir_cf_node_block:
@@ -968,7 +1034,7 @@ write_cf_node(write_ctx *ctx, nir_cf_node *cf)
 static void
 read_cf_node(read_ctx *ctx, struct exec_list *list)
 {
-   nir_cf_node_type type = blob_read_uint32(ctx->blob);
+   nir_cf_node_type type = blob_read_varint(ctx->blob);
 
    switch (type) {
    case nir_cf_node_block:
@@ -988,7 +1054,7 @@ read_cf_node(read_ctx *ctx, struct exec_list *list)
 static void
 write_cf_list(write_ctx *ctx, const struct exec_list *cf_list)
 {
-   blob_write_uint32(ctx->blob, exec_list_length(cf_list));
+   blob_write_varint(ctx->blob, exec_list_length(cf_list));
    foreach_list_typed(nir_cf_node, cf, node, cf_list) {
       write_cf_node(ctx, cf);
    }
@@ -997,8 +1063,8 @@ write_cf_list(write_ctx *ctx, const struct exec_list *cf_list)
 static void
 read_cf_list(read_ctx *ctx, struct exec_list *cf_list)
 {
-   uint32_t num_cf_nodes = blob_read_uint32(ctx->blob);
-   for (unsigned i = 0; i < num_cf_nodes; i++)
+   uint32_t num_cf_nodes = blob_read_varint(ctx->blob);
+   for (unsigned i = 0; i < num_cf_nodes && !ctx->blob->overrun; i++)
       read_cf_node(ctx, cf_list);
 }
 
@@ -1007,14 +1073,14 @@ write_function_impl(write_ctx *ctx, const nir_function_impl *fi)
 {
    write_var_list(ctx, &fi->locals);
    write_reg_list(ctx, &fi->registers);
-   blob_write_uint32(ctx->blob, fi->reg_alloc);
+   blob_write_varint(ctx->blob, fi->reg_alloc);
 
-   blob_write_uint32(ctx->blob, fi->num_params);
+   blob_write_varint(ctx->blob, fi->num_params);
    for (unsigned i = 0; i < fi->num_params; i++) {
       write_variable(ctx, fi->params[i]);
    }
 
-   blob_write_uint32(ctx->blob, !!(fi->return_var));
+   blob_write_varint(ctx->blob, !!(fi->return_var));
    if (fi->return_var)
       write_variable(ctx, fi->return_var);
 
@@ -1030,14 +1096,14 @@ read_function_impl(read_ctx *ctx, nir_function *fxn)
 
    read_var_list(ctx, &fi->locals);
    read_reg_list(ctx, &fi->registers);
-   fi->reg_alloc = blob_read_uint32(ctx->blob);
+   fi->reg_alloc = blob_read_varint(ctx->blob);
 
-   fi->num_params = blob_read_uint32(ctx->blob);
+   fi->num_params = blob_read_varint(ctx->blob);
    for (unsigned i = 0; i < fi->num_params; i++) {
       fi->params[i] = read_variable(ctx);
    }
 
-   bool has_return = blob_read_uint32(ctx->blob);
+   bool has_return = blob_read_varint(ctx->blob);
    if (has_return)
       fi->return_var = read_variable(ctx);
    else
@@ -1054,15 +1120,15 @@ read_function_impl(read_ctx *ctx, nir_function *fxn)
 static void
 write_function(write_ctx *ctx, const nir_function *fxn)
 {
-   blob_write_uint32(ctx->blob, !!(fxn->name));
+   blob_write_varint(ctx->blob, !!(fxn->name));
    if (fxn->name)
       blob_write_string(ctx->blob, fxn->name);
 
    write_add_object(ctx, fxn);
 
-   blob_write_uint32(ctx->blob, fxn->num_params);
+   blob_write_varint(ctx->blob, fxn->num_params);
    for (unsigned i = 0; i < fxn->num_params; i++) {
-      blob_write_uint32(ctx->blob, fxn->params[i].param_type);
+      blob_write_varint(ctx->blob, fxn->params[i].param_type);
       encode_type_to_blob(ctx->blob, fxn->params[i].type);
    }
 
@@ -1078,16 +1144,16 @@ write_function(write_ctx *ctx, const nir_function *fxn)
 static void
 read_function(read_ctx *ctx)
 {
-   bool has_name = blob_read_uint32(ctx->blob);
+   bool has_name = blob_read_varint(ctx->blob);
    char *name = has_name ? blob_read_string(ctx->blob) : NULL;
 
    nir_function *fxn = nir_function_create(ctx->nir, name);
 
    read_add_object(ctx, fxn);
 
-   fxn->num_params = blob_read_uint32(ctx->blob);
+   fxn->num_params = blob_read_varint(ctx->blob);
    for (unsigned i = 0; i < fxn->num_params; i++) {
-      fxn->params[i].param_type = blob_read_uint32(ctx->blob);
+      fxn->params[i].param_type = blob_read_varint(ctx->blob);
       fxn->params[i].type = decode_type_from_blob(ctx->blob);
    }
 
@@ -1105,7 +1171,7 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
    ctx.nir = nir;
    util_dynarray_init(&ctx.phi_fixups, NULL);
 
-   size_t idx_size_offset = blob_reserve_intptr(blob);
+   size_t idx_size_offset = blob_reserve_uint32(blob);
 
    struct shader_info info = nir->info;
    uint32_t strings = 0;
@@ -1113,7 +1179,7 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
       strings |= 0x1;
    if (info.label)
       strings |= 0x2;
-   blob_write_uint32(blob, strings);
+   blob_write_varint(blob, strings);
    if (info.name)
       blob_write_string(blob, info.name);
    if (info.label)
@@ -1129,13 +1195,13 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
    write_var_list(&ctx, &nir->system_values);
 
    write_reg_list(&ctx, &nir->registers);
-   blob_write_uint32(blob, nir->reg_alloc);
-   blob_write_uint32(blob, nir->num_inputs);
-   blob_write_uint32(blob, nir->num_uniforms);
-   blob_write_uint32(blob, nir->num_outputs);
-   blob_write_uint32(blob, nir->num_shared);
+   blob_write_varint(blob, nir->reg_alloc);
+   blob_write_varint(blob, nir->num_inputs);
+   blob_write_varint(blob, nir->num_uniforms);
+   blob_write_varint(blob, nir->num_outputs);
+   blob_write_varint(blob, nir->num_shared);
 
-   blob_write_uint32(blob, exec_list_length(&nir->functions));
+   blob_write_varint(blob, exec_list_length(&nir->functions));
    nir_foreach_function(fxn, nir) {
       write_function(&ctx, fxn);
    }
@@ -1144,7 +1210,7 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
       write_function_impl(&ctx, fxn->impl);
    }
 
-   *(uintptr_t *)(blob->data + idx_size_offset) = ctx.next_idx;
+   blob_overwrite_uint32(blob, idx_size_offset, ctx.next_idx);
 
    _mesa_hash_table_destroy(ctx.remap_table, NULL);
    util_dynarray_fini(&ctx.phi_fixups);
@@ -1158,11 +1224,13 @@ nir_deserialize(void *mem_ctx,
    read_ctx ctx;
    ctx.blob = blob;
    list_inithead(&ctx.phi_srcs);
-   ctx.idx_table_len = blob_read_intptr(blob);
+   ctx.idx_table_len = blob_read_uint32(blob);
    ctx.idx_table = calloc(ctx.idx_table_len, sizeof(uintptr_t));
+   if (!ctx.idx_table)
+      ctx.idx_table_len = 0;
    ctx.next_idx = 0;
 
-   uint32_t strings = blob_read_uint32(blob);
+   uint32_t strings = blob_read_varint(blob);
    char *name = (strings & 0x1) ? blob_read_string(blob) : NULL;
    char *label = (strings & 0x2) ? blob_read_string(blob) : NULL;
 
@@ -1184,13 +1252,13 @@ nir_deserialize(void *mem_ctx,
    read_var_list(&ctx, &ctx.nir->system_values);
 
    read_reg_list(&ctx, &ctx.nir->registers);
-   ctx.nir->reg_alloc = blob_read_uint32(blob);
-   ctx.nir->num_inputs = blob_read_uint32(blob);
-   ctx.nir->num_uniforms = blob_read_uint32(blob);
-   ctx.nir->num_outputs = blob_read_uint32(blob);
-   ctx.nir->num_shared = blob_read_uint32(blob);
+   ctx.nir->reg_alloc = blob_read_varint(blob);
+   ctx.nir->num_inputs = blob_read_varint(blob);
+   ctx.nir->num_uniforms = blob_read_varint(blob);
+   ctx.nir->num_outputs = blob_read_varint(blob);
+   ctx.nir->num_shared = blob_read_varint(blob);
 
-   unsigned num_functions = blob_read_uint32(blob);
+   unsigned num_functions = blob_read_varint(blob);
    for (unsigned i = 0; i < num_functions; i++)
       read_function(&ctx);
 
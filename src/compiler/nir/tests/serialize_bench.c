@@ -0,0 +1,177 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Measures the size of serialized NIR and the time it takes to write and
+ * load it, which is what the shader cache pays on every hit.
+ *
+ * The shader is a synthetic fragment shader made of a number of sections,
+ * each an if/else on a running value followed by a small loop, lowered to
+ * SSA so it has phis.  Re-serializing the loaded shader must give the same
+ * bytes.
+ *
+ * Usage: nir_serialize_bench [sections] [iterations]
+ */
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nir.h"
+#include "nir_builder.h"
+#include "nir_serialize.h"
+#include "util/os_time.h"
+
+static const nir_shader_compiler_options options = { 0 };
+
+static nir_shader *
+build_shader(unsigned num_sections)
+{
+   nir_builder b;
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+
+   const struct glsl_type *vec4 = glsl_vec4_type();
+   nir_variable *in = nir_variable_create(b.shader, nir_var_shader_in,
+                                          vec4, "in_color");
+   nir_variable *u = nir_variable_create(b.shader, nir_var_uniform,
+                                         vec4, "scale");
+   nir_variable *out = nir_variable_create(b.shader, nir_var_shader_out,
+                                           vec4, "out_color");
+   nir_variable *acc = nir_local_variable_create(b.impl, vec4, "acc");
+   nir_variable *count = nir_local_variable_create(b.impl, glsl_int_type(),
+                                                   "count");
+
+   nir_store_var(&b, acc, nir_load_var(&b, in), 0xf);
+
+   for (unsigned i = 0; i < num_sections; i++) {
+      nir_ssa_def *value = nir_load_var(&b, acc);
+      nir_ssa_def *scale = nir_load_var(&b, u);
+
+      nir_if *nif = nir_push_if(&b, nir_flt(&b, nir_channel(&b, value, 0),
+                                            nir_imm_float(&b, i * 0.5f)));
+      nir_store_var(&b, acc, nir_ffma(&b, value, scale,
+                                      nir_imm_vec4(&b, i, 1.0f, 0.5f, 0.25f)),
+                    0xf);
+      nir_push_else(&b, nif);
+      nir_store_var(&b, acc, nir_fsub(&b, value, nir_fmul(&b, scale, scale)),
+                    0x3);
+      nir_pop_if(&b, nif);
+
+      nir_store_var(&b, count, nir_imm_int(&b, 0), 0x1);
+      nir_loop *loop = nir_push_loop(&b);
+      {
+         nir_ssa_def *n = nir_load_var(&b, count);
+         nir_if *brk = nir_push_if(&b, nir_ige(&b, n, nir_imm_int(&b, i % 7)));
+         nir_jump(&b, nir_jump_break);
+         nir_pop_if(&b, brk);
+
+         value = nir_load_var(&b, acc);
+         nir_store_var(&b, acc, nir_fmax(&b, nir_fabs(&b, value),
+                                         nir_fsat(&b, value)), 0xf);
+         nir_store_var(&b, count, nir_iadd(&b, n, nir_imm_int(&b, 1)), 0x1);
+      }
+      nir_pop_loop(&b, loop);
+   }
+
+   nir_store_var(&b, out, nir_load_var(&b, acc), 0xf);
+
+   nir_lower_vars_to_ssa(b.shader);
+   nir_opt_dce(b.shader);
+
+   return b.shader;
+}
+
+static unsigned
+count_instrs(nir_shader *shader)
+{
+   unsigned count = 0;
+
+   nir_foreach_function(function, shader) {
+      if (!function->impl)
+         continue;
+
+      nir_foreach_block(block, function->impl)
+         count += exec_list_length(&block->instr_list);
+   }
+
+   return count;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_sections = argc > 1 ? atoi(argv[1]) : 200;
+   unsigned iterations = argc > 2 ? atoi(argv[2]) : 200;
+
+   nir_shader *shader = build_shader(num_sections);
+
+   struct blob blob;
+   blob_init(&blob);
+   nir_serialize(&blob, shader);
+
+   /* The loaded shader serializes to the same data. */
+   struct blob_reader reader;
+   blob_reader_init(&reader, blob.data, blob.size);
+   nir_shader *loaded = nir_deserialize(NULL, &options, &reader);
+   assert(!reader.overrun && reader.current == reader.end);
+   nir_validate_shader(loaded);
+
+   struct blob blob2;
+   blob_init(&blob2);
+   nir_serialize(&blob2, loaded);
+   assert(blob2.size == blob.size);
+   assert(memcmp(blob2.data, blob.data, blob.size) == 0);
+   blob_finish(&blob2);
+   ralloc_free(loaded);
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < iterations; i++) {
+      struct blob tmp;
+      blob_init(&tmp);
+      nir_serialize(&tmp, shader);
+      blob_finish(&tmp);
+   }
+   int64_t write_ns = os_time_get_nano() - start;
+
+   start = os_time_get_nano();
+   for (unsigned i = 0; i < iterations; i++) {
+      blob_reader_init(&reader, blob.data, blob.size);
+      ralloc_free(nir_deserialize(NULL, &options, &reader));
+   }
+   int64_t read_ns = os_time_get_nano() - start;
+
+   unsigned num_instrs = count_instrs(shader);
+
+   printf("%u instructions, %zu bytes (%.1f bytes/instruction)\n",
+          num_instrs, blob.size, (double)blob.size / num_instrs);
+   printf("serialize:   %8.1f us\n", write_ns / 1000.0 / iterations);
+   printf("deserialize: %8.1f us\n", read_ns / 1000.0 / iterations);
+
+   blob_finish(&blob);
+   ralloc_free(shader);
+
+   return 0;
+}
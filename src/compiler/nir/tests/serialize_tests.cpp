@@ -0,0 +1,133 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include "nir.h"
+#include "nir_builder.h"
+#include "nir_serialize.h"
+
+class nir_serialize_test : public ::testing::Test {
+protected:
+   nir_serialize_test();
+   ~nir_serialize_test();
+
+   nir_builder b;
+   struct blob blob;
+};
+
+static const nir_shader_compiler_options options = { };
+
+nir_serialize_test::nir_serialize_test()
+{
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+
+   /* Create IR with variables, an if, a loop and the phis for them:
+    *
+    * acc = in;
+    * if (acc.x < 0.5) acc = acc * u; else acc.xy = acc - u;
+    * for (count = 0; count < 3; count++) acc = max(|acc|, sat(acc));
+    * out = acc;
+    */
+   const struct glsl_type *vec4 = glsl_vec4_type();
+   nir_variable *in = nir_variable_create(b.shader, nir_var_shader_in,
+                                          vec4, "in");
+   nir_variable *u = nir_variable_create(b.shader, nir_var_uniform,
+                                         vec4, "u");
+   nir_variable *out = nir_variable_create(b.shader, nir_var_shader_out,
+                                           vec4, "out");
+   nir_variable *acc = nir_local_variable_create(b.impl, vec4, "acc");
+   nir_variable *count = nir_local_variable_create(b.impl, glsl_int_type(),
+                                                   "count");
+
+   nir_store_var(&b, acc, nir_load_var(&b, in), 0xf);
+
+   nir_ssa_def *value = nir_load_var(&b, acc);
+   nir_if *nif = nir_push_if(&b, nir_flt(&b, nir_channel(&b, value, 0),
+                                         nir_imm_float(&b, 0.5f)));
+   nir_store_var(&b, acc, nir_fmul(&b, value, nir_load_var(&b, u)), 0xf);
+   nir_push_else(&b, nif);
+   nir_store_var(&b, acc, nir_fsub(&b, value, nir_load_var(&b, u)), 0x3);
+   nir_pop_if(&b, nif);
+
+   nir_store_var(&b, count, nir_imm_int(&b, 0), 0x1);
+   nir_loop *loop = nir_push_loop(&b);
+   {
+      nir_ssa_def *n = nir_load_var(&b, count);
+      nir_if *brk = nir_push_if(&b, nir_ige(&b, n, nir_imm_int(&b, 3)));
+      nir_jump(&b, nir_jump_break);
+      nir_pop_if(&b, brk);
+
+      value = nir_load_var(&b, acc);
+      nir_store_var(&b, acc, nir_fmax(&b, nir_fabs(&b, value),
+                                      nir_fsat(&b, value)), 0xf);
+      nir_store_var(&b, count, nir_iadd(&b, n, nir_imm_int(&b, 1)), 0x1);
+   }
+   nir_pop_loop(&b, loop);
+
+   nir_store_var(&b, out, nir_load_var(&b, acc), 0xf);
+
+   nir_lower_vars_to_ssa(b.shader);
+
+   blob_init(&blob);
+   nir_serialize(&blob, b.shader);
+}
+
+nir_serialize_test::~nir_serialize_test()
+{
+   blob_finish(&blob);
+   ralloc_free(b.shader);
+}
+
+TEST_F(nir_serialize_test, round_trip)
+{
+   struct blob_reader reader;
+   blob_reader_init(&reader, blob.data, blob.size);
+   nir_shader *loaded = nir_deserialize(NULL, &options, &reader);
+
+   EXPECT_FALSE(reader.overrun);
+   EXPECT_EQ(reader.end, reader.current);
+   nir_validate_shader(loaded);
+
+   struct blob blob2;
+   blob_init(&blob2);
+   nir_serialize(&blob2, loaded);
+   ASSERT_EQ(blob.size, blob2.size);
+   EXPECT_EQ(0, memcmp(blob.data, blob2.data, blob.size));
+
+   blob_finish(&blob2);
+   ralloc_free(loaded);
+}
+
+TEST_F(nir_serialize_test, truncated)
+{
+   /* A truncated cache entry has to be reported as an overrun, without
+    * reading past the end of the object table or following bad pointers.
+    */
+   for (size_t size = 0; size < blob.size; size++) {
+      struct blob_reader reader;
+      blob_reader_init(&reader, blob.data, size);
+      nir_shader *loaded = nir_deserialize(NULL, &options, &reader);
+
+      EXPECT_TRUE(reader.overrun) << "size " << size;
+      ralloc_free(loaded);
+   }
+}
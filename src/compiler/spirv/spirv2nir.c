@@ -29,26 +29,121 @@
  * A simple executable that opens a SPIR-V shader, converts it to NIR, and
  * dumps out the result.  This should be useful for testing the
  * spirv_to_nir code.
+ *
+ * With --time, the shader is converted a number of times and the time it
+ * took is printed instead, to benchmark spirv_to_nir on large modules.
  */
 
 #include "spirv/nir_spirv.h"
+#include "util/os_time.h"
 
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <fcntl.h>
+#include <getopt.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <string.h>
 
 #define WORD_SIZE 4
 
+static const struct {
+   const char *name;
+   gl_shader_stage stage;
+} stages[] = {
+   { "vertex", MESA_SHADER_VERTEX },
+   { "tess-ctrl", MESA_SHADER_TESS_CTRL },
+   { "tess-eval", MESA_SHADER_TESS_EVAL },
+   { "geometry", MESA_SHADER_GEOMETRY },
+   { "fragment", MESA_SHADER_FRAGMENT },
+   { "compute", MESA_SHADER_COMPUTE },
+};
+
+static void
+usage(const char *name)
+{
+   fprintf(stderr, "usage: %s [options] <file.spv>\n"
+           "\n"
+           "  -s, --stage=STAGE   vertex, tess-ctrl, tess-eval, geometry,\n"
+           "                      fragment (the default) or compute\n"
+           "  -e, --entry=NAME    entry point, main by default\n"
+           "  -t, --time=N        convert the shader N times and print how\n"
+           "                      long it took instead of the shader\n",
+           name);
+}
+
+static unsigned
+count_instrs(nir_shader *shader)
+{
+   unsigned count = 0;
+
+   nir_foreach_function(function, shader) {
+      if (!function->impl)
+         continue;
+
+      nir_foreach_block(block, function->impl)
+         count += exec_list_length(&block->instr_list);
+   }
+
+   return count;
+}
+
 int main(int argc, char **argv)
 {
-   int fd = open(argv[1], O_RDONLY);
+   static const struct option long_options[] = {
+      { "stage", required_argument, NULL, 's' },
+      { "entry", required_argument, NULL, 'e' },
+      { "time", required_argument, NULL, 't' },
+      { NULL, 0, NULL, 0 }
+   };
+   gl_shader_stage stage = MESA_SHADER_FRAGMENT;
+   const char *entry_point = "main";
+   unsigned iterations = 0;
+   int opt;
+
+   while ((opt = getopt_long(argc, argv, "s:e:t:", long_options, NULL)) != -1) {
+      switch (opt) {
+      case 's': {
+         unsigned i;
+         for (i = 0; i < ARRAY_SIZE(stages); i++) {
+            if (strcmp(optarg, stages[i].name) == 0)
+               break;
+         }
+         if (i == ARRAY_SIZE(stages)) {
+            fprintf(stderr, "Unknown stage %s\n", optarg);
+            return 1;
+         }
+         stage = stages[i].stage;
+         break;
+      }
+      case 'e':
+         entry_point = optarg;
+         break;
+      case 't':
+         iterations = atoi(optarg);
+         if (iterations == 0) {
+            fprintf(stderr, "Invalid number of iterations %s\n", optarg);
+            return 1;
+         }
+         break;
+      default:
+         usage(argv[0]);
+         return 1;
+      }
+   }
+
+   if (optind != argc - 1) {
+      usage(argv[0]);
+      return 1;
+   }
+
+   const char *filename = argv[optind];
+   int fd = open(filename, O_RDONLY);
    if (fd < 0)
    {
-      fprintf(stderr, "Failed to open %s\n", argv[1]);
+      fprintf(stderr, "Failed to open %s\n", filename);
       return 1;
    }
 
@@ -74,9 +169,47 @@ int main(int argc, char **argv)
 
    struct spirv_to_nir_options spirv_opts = {};
 
+   if (iterations) {
+      int64_t total_ns = 0, min_ns = INT64_MAX;
+      unsigned num_functions = 0, num_instrs = 0;
+
+      for (unsigned i = 0; i < iterations; i++) {
+         int64_t start = os_time_get_nano();
+         nir_function *func = spirv_to_nir(map, word_count, NULL, 0,
+                                           stage, entry_point,
+                                           &spirv_opts, NULL);
+         int64_t time_ns = os_time_get_nano() - start;
+
+         if (!func) {
+            fprintf(stderr, "Failed to convert %s\n", filename);
+            return 1;
+         }
+
+         total_ns += time_ns;
+         if (time_ns < min_ns)
+            min_ns = time_ns;
+
+         num_functions = exec_list_length(&func->shader->functions);
+         num_instrs = count_instrs(func->shader);
+         ralloc_free(func->shader);
+      }
+
+      printf("%s: %zu words, %u functions, %u instructions\n",
+             filename, word_count, num_functions, num_instrs);
+      printf("spirv_to_nir: %.3f ms min, %.3f ms mean over %u runs\n",
+             min_ns / 1000000.0, total_ns / 1000000.0 / iterations,
+             iterations);
+      return 0;
+   }
+
    nir_function *func = spirv_to_nir(map, word_count, NULL, 0,
-                                     MESA_SHADER_FRAGMENT, "main",
+                                     stage, entry_point,
                                      &spirv_opts, NULL);
+   if (!func) {
+      fprintf(stderr, "Failed to convert %s\n", filename);
+      return 1;
+   }
+
    nir_print_shader(func->shader, stderr);
 
    return 0;
@@ -43,6 +43,8 @@ static bool
 vtn_cfg_handle_prepass_instruction(struct vtn_builder *b, SpvOp opcode,
                                    const uint32_t *w, unsigned count)
 {
+   vtn_set_instruction_result_type(b, opcode, w, count);
+
    switch (opcode) {
    case SpvOpFunction: {
       vtn_assert(b->func == NULL);
@@ -590,11 +592,115 @@ vtn_cfg_walk_blocks(struct vtn_builder *b, struct list_head *cf_list,
    }
 }
 
+struct vtn_function_range {
+   const uint32_t *start;
+   const uint32_t *end;
+
+   /* Ids of the functions called by this one */
+   struct util_dynarray callees;
+
+   bool reachable;
+};
+
+/* Walks the function section once, recording where every function starts
+ * and ends and which functions it calls, and marks the ones reachable from
+ * the entry point.  Modules translated from other languages often carry
+ * lots of functions the entry point never calls, which we can then skip
+ * entirely instead of building values, NIR functions and CFGs for them.
+ *
+ * Returns the ranges of all the functions, in module order.
+ */
+static struct util_dynarray
+vtn_index_functions(struct vtn_builder *b, const uint32_t *words,
+                    const uint32_t *end)
+{
+   struct vtn_function_range **id_ranges =
+      rzalloc_array(b, struct vtn_function_range *, b->value_id_bound);
+   struct util_dynarray ranges;
+   util_dynarray_init(&ranges, b);
+
+   struct vtn_function_range *range = NULL;
+   const uint32_t *w = words;
+   while (w < end) {
+      SpvOp opcode = w[0] & SpvOpCodeMask;
+      unsigned count = w[0] >> SpvWordCountShift;
+      vtn_assert(count >= 1 && w + count <= end);
+
+      switch (opcode) {
+      case SpvOpFunction:
+         vtn_assert(range == NULL && count >= 5);
+         vtn_fail_if(w[2] >= b->value_id_bound,
+                     "SPIR-V id %u is out-of-bounds", w[2]);
+         range = rzalloc(b, struct vtn_function_range);
+         range->start = w;
+         util_dynarray_init(&range->callees, b);
+         id_ranges[w[2]] = range;
+         util_dynarray_append(&ranges, struct vtn_function_range *, range);
+         break;
+
+      case SpvOpFunctionCall:
+         vtn_assert(range != NULL && count >= 4);
+         util_dynarray_append(&range->callees, uint32_t, w[3]);
+         break;
+
+      case SpvOpFunctionEnd:
+         vtn_assert(range != NULL);
+         range->end = w + count;
+         range = NULL;
+         break;
+
+      default:
+         break;
+      }
+
+      w += count;
+   }
+   vtn_assert(range == NULL);
+
+   range = id_ranges[b->entry_point - b->values];
+   vtn_fail_if(range == NULL, "Entry point is not a function");
+
+   struct util_dynarray worklist;
+   util_dynarray_init(&worklist, b);
+
+   range->reachable = true;
+   util_dynarray_append(&worklist, struct vtn_function_range *, range);
+
+   while (worklist.size > 0) {
+      range = util_dynarray_pop(&worklist, struct vtn_function_range *);
+
+      util_dynarray_foreach(&range->callees, uint32_t, id) {
+         vtn_fail_if(*id >= b->value_id_bound || id_ranges[*id] == NULL,
+                     "SPIR-V id %u is not a function", *id);
+
+         struct vtn_function_range *callee = id_ranges[*id];
+         if (!callee->reachable) {
+            callee->reachable = true;
+            util_dynarray_append(&worklist, struct vtn_function_range *,
+                                 callee);
+         }
+      }
+   }
+
+   util_dynarray_fini(&worklist);
+   ralloc_free(id_ranges);
+
+   return ranges;
+}
+
 void
 vtn_build_cfg(struct vtn_builder *b, const uint32_t *words, const uint32_t *end)
 {
-   vtn_foreach_instruction(b, words, end,
-                           vtn_cfg_handle_prepass_instruction);
+   struct util_dynarray ranges = vtn_index_functions(b, words, end);
+
+   util_dynarray_foreach(&ranges, struct vtn_function_range *, range) {
+      if ((*range)->reachable) {
+         vtn_foreach_instruction(b, (*range)->start, (*range)->end,
+                                 vtn_cfg_handle_prepass_instruction);
+      }
+   }
+
+   util_dynarray_fini(&ranges);
 
    foreach_list_typed(struct vtn_function, func, node, &b->functions) {
       vtn_cfg_walk_blocks(b, &func->body, func->start_block,
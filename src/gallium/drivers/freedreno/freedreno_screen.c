@@ -339,6 +339,7 @@ fd_screen_get_param(struct pipe_screen *pscreen, enum pipe_cap param)
 	case PIPE_CAP_SIGNED_VERTEX_BUFFER_OFFSET:
 	case PIPE_CAP_FENCE_SIGNAL:
 	case PIPE_CAP_CONSTBUF0_FLAGS:
+	case PIPE_CAP_PREFER_REAL_BUFFER_IN_CONSTBUF0:
 		return 0;
 
 	case PIPE_CAP_CONTEXT_PRIORITY_MASK:
@@ -250,6 +250,7 @@ static int r300_get_param(struct pipe_screen* pscreen, enum pipe_cap param)
         case PIPE_CAP_CONTEXT_PRIORITY_MASK:
         case PIPE_CAP_FENCE_SIGNAL:
         case PIPE_CAP_CONSTBUF0_FLAGS:
+        case PIPE_CAP_PREFER_REAL_BUFFER_IN_CONSTBUF0:
             return 0;
 
         /* SWTCL-only features. */
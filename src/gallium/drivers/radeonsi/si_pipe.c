@@ -725,9 +725,14 @@ struct pipe_screen *radeonsi_screen_create(struct radeon_winsys *ws,
 	num_compiler_threads_lowprio =
 		MIN2(num_threads, ARRAY_SIZE(sscreen->tm_low_priority));
 
+	/* The main compiler queue shares its threads with the other compiler
+	 * queues in the process, so that several screens (or the disk cache)
+	 * compiling at the same time don't oversubscribe the CPU.
+	 */
 	if (!util_queue_init(&sscreen->shader_compiler_queue, "si_shader",
 			     32, num_compiler_threads,
-			     UTIL_QUEUE_INIT_RESIZE_IF_FULL)) {
+			     UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+			     UTIL_QUEUE_INIT_SHARED_POOL)) {
 		si_destroy_shader_cache(sscreen);
 		FREE(sscreen);
 		return NULL;
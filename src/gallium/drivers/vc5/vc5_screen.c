@@ -260,6 +260,7 @@ vc5_screen_get_param(struct pipe_screen *pscreen, enum pipe_cap param)
         case PIPE_CAP_MAX_COMBINED_SHADER_OUTPUT_RESOURCES:
         case PIPE_CAP_CONTEXT_PRIORITY_MASK:
 	case PIPE_CAP_CONSTBUF0_FLAGS:
+	case PIPE_CAP_PREFER_REAL_BUFFER_IN_CONSTBUF0:
                 return 0;
 
                 /* Geometry shader output, unsupported. */
@@ -794,6 +794,7 @@ enum pipe_cap
    PIPE_CAP_CONTEXT_PRIORITY_MASK,
    PIPE_CAP_FENCE_SIGNAL,
    PIPE_CAP_CONSTBUF0_FLAGS,
+   PIPE_CAP_PREFER_REAL_BUFFER_IN_CONSTBUF0,
 };
 
 /**
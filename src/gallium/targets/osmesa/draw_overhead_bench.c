@@ -0,0 +1,172 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Measures the CPU cost of a draw call in the state tracker for a few
+ * common patterns of state changes between draws.
+ *
+ * Every draw is a single triangle clipped to a 1x1 scissor, which keeps
+ * rasterization out of the numbers.  With softpipe, running the vertex
+ * shader in the draw module still takes most of the time of each draw, so
+ * small savings in state validation are within the run to run noise.
+ *
+ * Usage: osmesa_draw_overhead_bench [draws]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "GL/osmesa.h"
+#include "GL/gl.h"
+#include "GL/glext.h"
+#include "util/macros.h"
+#include "util/os_time.h"
+
+#define SIZE 32
+
+static PFNGLGENBUFFERSPROC GenBuffers;
+static PFNGLBINDBUFFERPROC BindBuffer;
+static PFNGLBUFFERDATAPROC BufferData;
+
+static const GLfloat triangle[] = {
+   -1.0f, -1.0f, 0.0f, 0.0f,
+    1.0f, -1.0f, 1.0f, 0.0f,
+    0.0f,  1.0f, 0.5f, 1.0f,
+};
+
+static GLuint vbos[2];
+static GLuint textures[2];
+
+static void
+bind_vbo(GLuint vbo)
+{
+   BindBuffer(GL_ARRAY_BUFFER, vbo);
+   glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), (void *)0);
+   glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat),
+                     (void *)(2 * sizeof(GLfloat)));
+}
+
+enum bench_case {
+   SAME_STATE,
+   SWAP_VBO,
+   SWAP_TEXTURE,
+   REBIND_TEXTURE,
+   CHANGE_COLOR,
+};
+
+static const char *case_names[] = {
+   [SAME_STATE] = "no state change",
+   [SWAP_VBO] = "alternate two VBOs",
+   [SWAP_TEXTURE] = "alternate two textures",
+   [REBIND_TEXTURE] = "rebind the same texture",
+   [CHANGE_COLOR] = "change the current color",
+};
+
+static void
+run_case(enum bench_case c, unsigned draws)
+{
+   bind_vbo(vbos[0]);
+   glBindTexture(GL_TEXTURE_2D, textures[0]);
+   glDrawArrays(GL_TRIANGLES, 0, 3);
+   glFinish();
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < draws; i++) {
+      switch (c) {
+      case SAME_STATE:
+         break;
+      case SWAP_VBO:
+         bind_vbo(vbos[i & 1]);
+         break;
+      case SWAP_TEXTURE:
+         glBindTexture(GL_TEXTURE_2D, textures[i & 1]);
+         break;
+      case REBIND_TEXTURE:
+         glBindTexture(GL_TEXTURE_2D, 0);
+         glBindTexture(GL_TEXTURE_2D, textures[0]);
+         break;
+      case CHANGE_COLOR:
+         glColor4f((i & 0xff) / 255.0f, 0.5f, 0.5f, 1.0f);
+         break;
+      }
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+   }
+   glFinish();
+   int64_t ns = os_time_get_nano() - start;
+
+   printf("%-26s %8.1f ns/draw\n", case_names[c], (double)ns / draws);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned draws = argc > 1 ? atoi(argv[1]) : 100000;
+   static GLubyte buffer[SIZE * SIZE * 4];
+   static const GLubyte texels[2][4] = {
+      { 0xff, 0x00, 0x00, 0xff },
+      { 0x00, 0xff, 0x00, 0xff },
+   };
+
+   OSMesaContext ctx = OSMesaCreateContextExt(OSMESA_RGBA, 24, 0, 0, NULL);
+   if (!ctx || !OSMesaMakeCurrent(ctx, buffer, GL_UNSIGNED_BYTE, SIZE, SIZE)) {
+      fprintf(stderr, "failed to create an OSMesa context\n");
+      return 1;
+   }
+
+   GenBuffers = (PFNGLGENBUFFERSPROC)OSMesaGetProcAddress("glGenBuffers");
+   BindBuffer = (PFNGLBINDBUFFERPROC)OSMesaGetProcAddress("glBindBuffer");
+   BufferData = (PFNGLBUFFERDATAPROC)OSMesaGetProcAddress("glBufferData");
+   if (!GenBuffers || !BindBuffer || !BufferData) {
+      fprintf(stderr, "buffer objects are not supported\n");
+      return 1;
+   }
+
+   printf("%s\n", (const char *)glGetString(GL_RENDERER));
+
+   glEnable(GL_SCISSOR_TEST);
+   glScissor(0, 0, 1, 1);
+
+   GenBuffers(2, vbos);
+   for (unsigned i = 0; i < 2; i++) {
+      BindBuffer(GL_ARRAY_BUFFER, vbos[i]);
+      BufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+   }
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+   glGenTextures(2, textures);
+   for (unsigned i = 0; i < 2; i++) {
+      glBindTexture(GL_TEXTURE_2D, textures[i]);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, texels[i]);
+   }
+   glEnable(GL_TEXTURE_2D);
+
+   for (unsigned c = 0; c < ARRAY_SIZE(case_names); c++)
+      run_case(c, draws);
+
+   OSMesaDestroyContext(ctx);
+
+   return 0;
+}
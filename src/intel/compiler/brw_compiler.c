@@ -27,7 +27,13 @@
 #include "common/gen_debug.h"
 #include "compiler/nir/nir.h"
 #include "main/errors.h"
+#include "util/build_id.h"
 #include "util/debug.h"
+#include "util/disk_cache.h"
+#include "util/mesa-sha1.h"
+#include "util/ralloc.h"
+#include "util/register_allocate.h"
+#include "util/simple_mtx.h"
 
 #define COMMON_OPTIONS                                                        \
    .lower_sub = true,                                                         \
@@ -113,6 +119,177 @@ static const struct nir_shader_compiler_options vector_nir_options_gen6 = {
    .max_unroll_iterations = 32,
 };
 
+/* Register sets only depend on the device, so keep a serialized copy of each
+ * set built by this process, and store it in the shader cache so that later
+ * processes don't build it either.  Creating a compiler for a device whose
+ * sets are cached then just copies the tables instead of recomputing the
+ * register conflicts.
+ */
+struct brw_reg_set_cache_entry {
+   struct brw_reg_set_cache_entry *next;
+   int gen;
+   bool has_pln;
+   unsigned kind;
+   size_t size;
+   void *data;
+};
+
+static simple_mtx_t reg_set_cache_mutex = _SIMPLE_MTX_INITIALIZER_NP;
+static struct brw_reg_set_cache_entry *reg_set_cache;
+static void *reg_set_cache_mem_ctx;
+#ifdef ENABLE_SHADER_CACHE
+static struct disk_cache *reg_set_disk_cache;
+#endif
+
+static void
+brw_reg_set_cache_fini(void)
+{
+   simple_mtx_lock(&reg_set_cache_mutex);
+#ifdef ENABLE_SHADER_CACHE
+   disk_cache_destroy(reg_set_disk_cache);
+   reg_set_disk_cache = NULL;
+#endif
+   ralloc_free(reg_set_cache_mem_ctx);
+   reg_set_cache_mem_ctx = NULL;
+   reg_set_cache = NULL;
+   simple_mtx_unlock(&reg_set_cache_mutex);
+}
+
+/* Called with reg_set_cache_mutex held. */
+static void
+brw_reg_set_cache_init(void)
+{
+   if (reg_set_cache_mem_ctx)
+      return;
+
+   reg_set_cache_mem_ctx = ralloc_context(NULL);
+
+#ifdef ENABLE_SHADER_CACHE
+   const struct build_id_note *note =
+      build_id_find_nhdr_for_addr(brw_reg_set_cache_init);
+   if (note && build_id_length(note) == 20 /* sha1 */) {
+      char timestamp[41];
+      _mesa_sha1_format(timestamp, build_id_data(note));
+      reg_set_disk_cache = disk_cache_create("intel_reg_sets", timestamp, 0);
+   }
+#endif
+
+   /* The disk cache has to be destroyed before the queue threads are killed
+    * at exit, so register the handler after creating it.
+    */
+   atexit(brw_reg_set_cache_fini);
+}
+
+#ifdef ENABLE_SHADER_CACHE
+static void
+brw_reg_set_cache_key(const struct gen_device_info *devinfo, unsigned kind,
+                      cache_key key)
+{
+   char name[64];
+   int len = snprintf(name, sizeof(name), "reg_set gen %d pln %d kind %u",
+                      devinfo->gen, devinfo->has_pln, kind);
+   disk_cache_compute_key(reg_set_disk_cache, name, len, key);
+}
+#endif
+
+static struct brw_reg_set_cache_entry *
+brw_reg_set_cache_find(const struct gen_device_info *devinfo, unsigned kind)
+{
+   for (struct brw_reg_set_cache_entry *entry = reg_set_cache; entry;
+        entry = entry->next) {
+      if (entry->gen == devinfo->gen && entry->has_pln == devinfo->has_pln &&
+          entry->kind == kind)
+         return entry;
+   }
+   return NULL;
+}
+
+static struct brw_reg_set_cache_entry *
+brw_reg_set_cache_add(const struct gen_device_info *devinfo, unsigned kind)
+{
+   struct brw_reg_set_cache_entry *entry =
+      rzalloc(reg_set_cache_mem_ctx, struct brw_reg_set_cache_entry);
+   entry->gen = devinfo->gen;
+   entry->has_pln = devinfo->has_pln;
+   entry->kind = kind;
+   return entry;
+}
+
+/**
+ * Returns a copy of a register set previously built for a device like
+ * \p devinfo, or NULL if there is none.  \p kind tells the register sets of
+ * a device apart, such as the dispatch widths.
+ */
+struct ra_regs *
+brw_reg_set_cache_load(void *mem_ctx, const struct gen_device_info *devinfo,
+                       unsigned kind)
+{
+   struct ra_regs *regs = NULL;
+
+   simple_mtx_lock(&reg_set_cache_mutex);
+   brw_reg_set_cache_init();
+
+   struct brw_reg_set_cache_entry *entry =
+      brw_reg_set_cache_find(devinfo, kind);
+   if (entry) {
+      regs = ra_set_deserialize(mem_ctx, entry->data, entry->size);
+   } else {
+#ifdef ENABLE_SHADER_CACHE
+      if (reg_set_disk_cache) {
+         cache_key key;
+         size_t size;
+
+         brw_reg_set_cache_key(devinfo, kind, key);
+         void *data = disk_cache_get(reg_set_disk_cache, key, &size);
+         if (data) {
+            regs = ra_set_deserialize(mem_ctx, data, size);
+            if (regs) {
+               entry = brw_reg_set_cache_add(devinfo, kind);
+               entry->data = ralloc_size(entry, size);
+               memcpy(entry->data, data, size);
+               entry->size = size;
+               entry->next = reg_set_cache;
+               reg_set_cache = entry;
+            }
+            free(data);
+         }
+      }
+#endif
+   }
+   simple_mtx_unlock(&reg_set_cache_mutex);
+
+   return regs;
+}
+
+void
+brw_reg_set_cache_store(const struct gen_device_info *devinfo, unsigned kind,
+                        const struct ra_regs *regs)
+{
+   simple_mtx_lock(&reg_set_cache_mutex);
+   brw_reg_set_cache_init();
+
+   if (!brw_reg_set_cache_find(devinfo, kind)) {
+      struct brw_reg_set_cache_entry *entry =
+         brw_reg_set_cache_add(devinfo, kind);
+      entry->data = ra_set_serialize(regs, entry, &entry->size);
+      if (entry->data) {
+         entry->next = reg_set_cache;
+         reg_set_cache = entry;
+
+#ifdef ENABLE_SHADER_CACHE
+         if (reg_set_disk_cache) {
+            cache_key key;
+
+            brw_reg_set_cache_key(devinfo, kind, key);
+            disk_cache_put(reg_set_disk_cache, key, entry->data, entry->size,
+                           NULL);
+         }
+#endif
+      }
+   }
+   simple_mtx_unlock(&reg_set_cache_mutex);
+}
+
 struct brw_compiler *
 brw_compiler_create(void *mem_ctx, const struct gen_device_info *devinfo)
 {
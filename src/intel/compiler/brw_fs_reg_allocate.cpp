@@ -141,9 +141,18 @@ brw_alloc_reg_set(struct brw_compiler *compiler, int dispatch_width)
    }
 
    uint8_t *ra_reg_to_grf = ralloc_array(compiler, uint8_t, ra_reg_count);
-   struct ra_regs *regs = ra_alloc_reg_set(compiler, ra_reg_count, false);
-   if (devinfo->gen >= 6)
-      ra_set_allocate_round_robin(regs);
+
+   /* If another compiler in this process already built the set, only the
+    * register mappings below need to be computed.
+    */
+   struct ra_regs *regs =
+      brw_reg_set_cache_load(compiler, devinfo, dispatch_width);
+   const bool cached = regs != NULL;
+   if (!cached) {
+      regs = ra_alloc_reg_set(compiler, ra_reg_count, false);
+      if (devinfo->gen >= 6)
+         ra_set_allocate_round_robin(regs);
+   }
    int *classes = ralloc_array(compiler, int, class_count);
    int aligned_pairs_class = -1;
 
@@ -200,7 +209,8 @@ brw_alloc_reg_set(struct brw_compiler *compiler, int dispatch_width)
          for (int j = 0; j < class_count; j++)
             q_values[i][j] = class_sizes[i] + class_sizes[j] - 1;
       }
-      classes[i] = ra_alloc_reg_class(regs);
+      /* Classes are numbered in the order they're allocated. */
+      classes[i] = cached ? i : ra_alloc_reg_class(regs);
 
       /* Save this off for the aligned pair class at the end. */
       if (class_sizes[i] == 2) {
@@ -210,28 +220,32 @@ brw_alloc_reg_set(struct brw_compiler *compiler, int dispatch_width)
 
       if (devinfo->gen <= 5 && dispatch_width >= 16) {
          for (int j = 0; j < class_reg_count; j++) {
-            ra_class_add_reg(regs, classes[i], reg);
-
             ra_reg_to_grf[reg] = j * 2;
 
-            for (int base_reg = j;
-                 base_reg < j + (class_sizes[i] + 1) / 2;
-                 base_reg++) {
-               ra_add_reg_conflict(regs, base_reg, reg);
+            if (!cached) {
+               ra_class_add_reg(regs, classes[i], reg);
+
+               for (int base_reg = j;
+                    base_reg < j + (class_sizes[i] + 1) / 2;
+                    base_reg++) {
+                  ra_add_reg_conflict(regs, base_reg, reg);
+               }
             }
 
             reg++;
          }
       } else {
          for (int j = 0; j < class_reg_count; j++) {
-            ra_class_add_reg(regs, classes[i], reg);
-
             ra_reg_to_grf[reg] = j;
 
-            for (int base_reg = j;
-                 base_reg < j + class_sizes[i];
-                 base_reg++) {
-               ra_add_reg_conflict(regs, base_reg, reg);
+            if (!cached) {
+               ra_class_add_reg(regs, classes[i], reg);
+
+               for (int base_reg = j;
+                    base_reg < j + class_sizes[i];
+                    base_reg++) {
+                  ra_add_reg_conflict(regs, base_reg, reg);
+               }
             }
 
             reg++;
@@ -243,19 +257,25 @@ brw_alloc_reg_set(struct brw_compiler *compiler, int dispatch_width)
    /* Applying transitivity to all of the base registers gives us the
     * appropreate register conflict relationships everywhere.
     */
-   for (int reg = 0; reg < base_reg_count; reg++)
-      ra_make_reg_conflicts_transitive(regs, reg);
+   if (!cached) {
+      for (int reg = 0; reg < base_reg_count; reg++)
+         ra_make_reg_conflicts_transitive(regs, reg);
+   }
 
    /* Add a special class for aligned pairs, which we'll put delta_xy
     * in on Gen <= 6 so that we can do PLN.
     */
    if (devinfo->has_pln && dispatch_width == 8 && devinfo->gen <= 6) {
-      aligned_pairs_class = ra_alloc_reg_class(regs);
+      if (cached) {
+         aligned_pairs_class = class_count;
+      } else {
+         aligned_pairs_class = ra_alloc_reg_class(regs);
 
-      for (int i = 0; i < pairs_reg_count; i++) {
-	 if ((ra_reg_to_grf[pairs_base_reg + i] & 1) == 0) {
-	    ra_class_add_reg(regs, aligned_pairs_class, pairs_base_reg + i);
-	 }
+         for (int i = 0; i < pairs_reg_count; i++) {
+            if ((ra_reg_to_grf[pairs_base_reg + i] & 1) == 0) {
+               ra_class_add_reg(regs, aligned_pairs_class, pairs_base_reg + i);
+            }
+         }
       }
 
       for (int i = 0; i < class_count; i++) {
@@ -271,7 +291,10 @@ brw_alloc_reg_set(struct brw_compiler *compiler, int dispatch_width)
       q_values[class_count][class_count] = 1;
    }
 
-   ra_set_finalize(regs, q_values);
+   if (!cached) {
+      ra_set_finalize(regs, q_values);
+      brw_reg_set_cache_store(devinfo, dispatch_width, regs);
+   }
 
    ralloc_free(q_values);
 
@@ -263,6 +263,13 @@ void brw_fs_alloc_reg_sets(struct brw_compiler *compiler);
 /* brw_vec4_reg_allocate.cpp */
 void brw_vec4_alloc_reg_set(struct brw_compiler *compiler);
 
+/* brw_compiler.c */
+struct ra_regs *brw_reg_set_cache_load(void *mem_ctx,
+                                       const struct gen_device_info *devinfo,
+                                       unsigned kind);
+void brw_reg_set_cache_store(const struct gen_device_info *devinfo,
+                             unsigned kind, const struct ra_regs *regs);
+
 /* brw_disasm.c */
 extern const char *const conditional_modifier[16];
 extern const char *const pred_ctrl_align16[16];
@@ -113,11 +113,27 @@ brw_vec4_alloc_reg_set(struct brw_compiler *compiler)
    ralloc_free(compiler->vec4_reg_set.ra_reg_to_grf);
    compiler->vec4_reg_set.ra_reg_to_grf = ralloc_array(compiler, uint8_t, ra_reg_count);
    ralloc_free(compiler->vec4_reg_set.regs);
+   ralloc_free(compiler->vec4_reg_set.classes);
+   compiler->vec4_reg_set.classes = ralloc_array(compiler, int, class_count);
+
+   /* Kind 0 is the vec4 set, the scalar sets use their dispatch width. */
+   compiler->vec4_reg_set.regs =
+      brw_reg_set_cache_load(compiler, compiler->devinfo, 0);
+   if (compiler->vec4_reg_set.regs) {
+      /* Only the register mappings need to be computed. */
+      int reg = 0;
+      for (int i = 0; i < class_count; i++) {
+         compiler->vec4_reg_set.classes[i] = i;
+         for (int j = 0; j < base_reg_count - (class_sizes[i] - 1); j++)
+            compiler->vec4_reg_set.ra_reg_to_grf[reg++] = j;
+      }
+      assert(reg == ra_reg_count);
+      return;
+   }
+
    compiler->vec4_reg_set.regs = ra_alloc_reg_set(compiler, ra_reg_count, false);
    if (compiler->devinfo->gen >= 6)
       ra_set_allocate_round_robin(compiler->vec4_reg_set.regs);
-   ralloc_free(compiler->vec4_reg_set.classes);
-   compiler->vec4_reg_set.classes = ralloc_array(compiler, int, class_count);
 
    /* Now, add the registers to their classes, and add the conflicts
     * between them and the base GRF registers (and also each other).
@@ -160,6 +176,7 @@ brw_vec4_alloc_reg_set(struct brw_compiler *compiler)
       ra_make_reg_conflicts_transitive(compiler->vec4_reg_set.regs, reg);
 
    ra_set_finalize(compiler->vec4_reg_set.regs, q_values);
+   brw_reg_set_cache_store(compiler->devinfo, 0, compiler->vec4_reg_set.regs);
 
    for (int i = 0; i < MAX_VGRF_SIZE; i++)
       delete[] q_values[i];
@@ -99,6 +99,8 @@ class PrintCode(gl_XML.gl_print_base):
             out('_mesa_glthread_finish(ctx);')
             out('debug_print_sync("{0}");'.format(func.name))
             self.print_sync_call(func)
+            if func.marshal_call_after:
+                out(func.marshal_call_after)
         out('}')
         out('')
         out('')
@@ -252,9 +254,17 @@ class PrintCode(gl_XML.gl_print_base):
                     out('return;')
                 out('}')
 
+            if func.marshal_sync:
+                out('if ({0})'.format(func.marshal_sync))
+                with indent():
+                    out('goto fallback_to_sync;')
+                need_fallback_sync = True
+
             out('if (cmd_size <= MARSHAL_MAX_CMD_SIZE) {')
             with indent():
                 self.print_async_dispatch(func)
+                if func.marshal_call_after:
+                    out(func.marshal_call_after)
                 out('return;')
             out('}')
 
@@ -264,6 +274,8 @@ class PrintCode(gl_XML.gl_print_base):
         with indent():
             out('_mesa_glthread_finish(ctx);')
             self.print_sync_dispatch(func)
+            if func.marshal_call_after:
+                out(func.marshal_call_after)
 
         out('}')
 
@@ -284,8 +296,7 @@ class PrintCode(gl_XML.gl_print_base):
             out('const struct marshal_cmd_base *cmd_base = cmd;')
             out('switch (cmd_base->cmd_id) {')
             for func in api.functionIterateAll():
-                flavor = func.marshal_flavor()
-                if flavor in ('skip', 'sync'):
+                if not func.marshal_queues_command():
                     continue
                 out('case DISPATCH_CMD_{0}:'.format(func.name))
                 with indent():
@@ -968,6 +968,8 @@ struct brw_context
       struct brw_bo *bo;
       uint32_t size;
       unsigned index_size;
+      bool primitive_restart;
+      unsigned restart_index;
 
       /* Offset to index buffer index to use in CMD_3D_PRIM so that we can
        * avoid re-uploading the IB packet over and over if we're actually
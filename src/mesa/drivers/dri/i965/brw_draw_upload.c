@@ -776,6 +776,13 @@ brw_upload_indices(struct brw_context *brw)
       brw->ib.index_size = index_buffer->index_size;
       brw->ctx.NewDriverState |= BRW_NEW_INDEX_BUFFER;
    }
+
+   if (index_buffer->primitive_restart != brw->ib.primitive_restart ||
+       index_buffer->restart_index != brw->ib.restart_index) {
+      brw->ib.primitive_restart = index_buffer->primitive_restart;
+      brw->ib.restart_index = index_buffer->restart_index;
+      brw->ctx.NewDriverState |= BRW_NEW_INDEX_BUFFER;
+   }
 }
 
 const struct brw_tracked_state brw_indices = {
@@ -44,23 +44,20 @@ static bool
 can_cut_index_handle_restart_index(struct gl_context *ctx,
                                    const struct _mesa_index_buffer *ib)
 {
-   /* The FixedIndex variant means 0xFF, 0xFFFF, or 0xFFFFFFFF based on
-    * the index buffer type, which corresponds exactly to the hardware.
+   /* The hardware always cuts at 0xFF, 0xFFFF, or 0xFFFFFFFF based on the
+    * index buffer type, which is also what the FixedIndex variant means.
     */
-   if (ctx->Array.PrimitiveRestartFixedIndex)
-      return true;
-
    bool cut_index_will_work;
 
    switch (ib->index_size) {
    case 1:
-      cut_index_will_work = ctx->Array.RestartIndex == 0xff;
+      cut_index_will_work = ib->restart_index == 0xff;
       break;
    case 2:
-      cut_index_will_work = ctx->Array.RestartIndex == 0xffff;
+      cut_index_will_work = ib->restart_index == 0xffff;
       break;
    case 4:
-      cut_index_will_work = ctx->Array.RestartIndex == 0xffffffff;
+      cut_index_will_work = ib->restart_index == 0xffffffff;
       break;
    default:
       unreachable("not reached");
@@ -150,7 +147,7 @@ brw_handle_primitive_restart(struct gl_context *ctx,
    /* If PrimitiveRestart is not enabled, then we aren't concerned about
     * handling this draw.
     */
-   if (!(ctx->Array._PrimitiveRestart)) {
+   if (!ib->primitive_restart) {
       return GL_FALSE;
    }
 
@@ -925,19 +925,17 @@ static const struct brw_tracked_state genX(index_buffer) = {
 static void
 genX(upload_cut_index)(struct brw_context *brw)
 {
-   const struct gl_context *ctx = &brw->ctx;
-
    brw_batch_emit(brw, GENX(3DSTATE_VF), vf) {
-      if (ctx->Array._PrimitiveRestart && brw->ib.ib) {
+      if (brw->ib.ib && brw->ib.primitive_restart) {
          vf.IndexedDrawCutIndexEnable = true;
-         vf.CutIndex = _mesa_primitive_restart_index(ctx, brw->ib.index_size);
+         vf.CutIndex = brw->ib.restart_index;
       }
    }
 }
 
 const struct brw_tracked_state genX(cut_index) = {
    .dirty = {
-      .mesa  = _NEW_TRANSFORM,
+      .mesa  = 0,
       .brw   = BRW_NEW_INDEX_BUFFER,
    },
    .emit = genX(upload_cut_index),
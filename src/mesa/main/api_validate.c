@@ -32,6 +32,7 @@
 #include "mtypes.h"
 #include "pipelineobj.h"
 #include "enums.h"
+#include "shaderapi.h"
 #include "state.h"
 #include "transformfeedback.h"
 #include "uniforms.h"
@@ -173,6 +174,8 @@ _mesa_valid_to_render(struct gl_context *ctx, const char *where)
     * samplers succeeded for the active program. */
    if (ctx->_Shader->ActiveProgram && ctx->_Shader != ctx->Pipeline.Current) {
       char errMsg[100];
+
+      _mesa_finish_program_link(ctx, ctx->_Shader->ActiveProgram);
       if (!_mesa_sampler_uniforms_are_valid(ctx->_Shader->ActiveProgram,
                                             errMsg, 100)) {
          _mesa_error(ctx, GL_INVALID_OPERATION, "%s", errMsg);
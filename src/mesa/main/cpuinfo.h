@@ -31,6 +31,9 @@
 #include "x86/common_x86_asm.h"
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 extern void
 _mesa_get_cpu_features(void);
@@ -40,4 +43,9 @@ extern char *
 _mesa_get_cpu_string(void);
 
 
+#ifdef __cplusplus
+}
+#endif
+
+
 #endif /* CPUINFO_H */
@@ -444,7 +444,12 @@ struct dd_function_table {
     * \name Vertex/fragment program functions
     */
    /*@{*/
-   /** Allocate a new program */
+   /**
+    * Allocate a new program.  This may be called from a GLSL linker thread,
+    * see _mesa_glsl_link_shader_ir(), so it must not change context state.
+    * The same goes for DeleteProgram on a program that NewProgram just
+    * returned.
+    */
    struct gl_program * (*NewProgram)(struct gl_context *ctx, GLenum target,
                                      GLuint id, bool is_arb_asm);
    /** Delete a program */
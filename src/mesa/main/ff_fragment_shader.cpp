@@ -1110,9 +1110,8 @@ create_new_program(struct gl_context *ctx, struct state_key *key)
 
    /* Conservative approach: Don't optimize here, the linker does it too. */
    if (!ctx->Const.GLSLOptimizeConservatively) {
-      while (do_common_optimization(p.shader->ir, false, false, options,
-                                    ctx->Const.NativeIntegers))
-         ;
+      do_common_optimization_loop(p.shader->ir, false, false, options,
+                                  ctx->Const.NativeIntegers);
    }
 
    reparent_ir(p.shader->ir, p.shader->ir);
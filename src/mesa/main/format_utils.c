@@ -26,6 +26,8 @@
 #include "glformats.h"
 #include "format_pack.h"
 #include "format_unpack.h"
+#include "main/sse_format_convert.h"
+#include "x86/common_x86_asm.h"
 
 const mesa_array_format RGBA32_FLOAT =
    MESA_ARRAY_FORMAT(4, 1, 1, 1, 4, 0, 1, 2, 3);
@@ -236,6 +238,48 @@ convert_ubyte_rgba_to_bgra(size_t width, size_t height,
 }
 
 
+/**
+ * Returns true if a conversion that has a direct pack or unpack function
+ * should rather go through _mesa_swizzle_and_convert, because both sides
+ * are array formats that its SIMD version handles.
+ *
+ * sRGB formats are excluded, since unpacking and packing them does the
+ * sRGB encoding while the array format path doesn't.
+ */
+static bool
+prefer_swizzle_and_convert(uint32_t src_format,
+                           mesa_array_format src_array_format,
+                           uint32_t dst_format,
+                           mesa_array_format dst_array_format)
+{
+#if defined(USE_SSE41)
+   enum mesa_array_format_datatype dst_type;
+
+   if (!cpu_has_sse4_1 || !src_array_format || !dst_array_format)
+      return false;
+
+   if ((!_mesa_format_is_mesa_array_format(src_format) &&
+        _mesa_get_format_color_encoding(src_format) == GL_SRGB) ||
+       (!_mesa_format_is_mesa_array_format(dst_format) &&
+        _mesa_get_format_color_encoding(dst_format) == GL_SRGB))
+      return false;
+
+   if (!_mesa_array_format_is_normalized(src_array_format) ||
+       !_mesa_array_format_is_normalized(dst_array_format) ||
+       _mesa_array_format_get_num_channels(dst_array_format) != 4)
+      return false;
+
+   dst_type = _mesa_array_format_get_datatype(dst_array_format);
+   return _mesa_array_format_get_datatype(src_array_format) ==
+             MESA_ARRAY_FORMAT_TYPE_UBYTE &&
+          (dst_type == MESA_ARRAY_FORMAT_TYPE_UBYTE ||
+           dst_type == MESA_ARRAY_FORMAT_TYPE_FLOAT);
+#else
+   return false;
+#endif
+}
+
+
 /**
  * This can be used to convert between most color formats.
  *
@@ -311,7 +355,9 @@ _mesa_format_convert(void *void_dst, uint32_t dst_format, size_t dst_stride,
     * avoid this path in these scenarios but in the future we may want to
     * enable it for specific combinations that are known to work.
     */
-   if (!rebase_swizzle) {
+   if (!rebase_swizzle &&
+       !prefer_swizzle_and_convert(src_format, src_array_format,
+                                   dst_format, dst_array_format)) {
       /* Do a direct memcpy where possible */
       if ((dst_format_is_mesa_array_format &&
            src_format_is_mesa_array_format &&
@@ -1510,6 +1556,24 @@ _mesa_swizzle_and_convert(void *void_dst, enum mesa_array_format_datatype dst_ty
                                   swizzle, normalized, count))
       return;
 
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1) {
+      int done = _mesa_sse41_swizzle_and_convert(void_dst, dst_type,
+                                                 num_dst_channels,
+                                                 void_src, src_type,
+                                                 num_src_channels,
+                                                 swizzle, normalized, count);
+      if (done == count)
+         return;
+
+      void_dst = (uint8_t *)void_dst + done * num_dst_channels *
+                 _mesa_array_format_datatype_get_size(dst_type);
+      void_src = (const uint8_t *)void_src + done * num_src_channels *
+                 _mesa_array_format_datatype_get_size(src_type);
+      count -= done;
+   }
+#endif
+
    switch (dst_type) {
    case MESA_ARRAY_FORMAT_TYPE_FLOAT:
       convert_float(void_dst, num_dst_channels, void_src, src_type,
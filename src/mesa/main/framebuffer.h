@@ -28,6 +28,10 @@
 
 #include "mtypes.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct gl_config;
 struct gl_context;
 struct gl_renderbuffer;
@@ -155,4 +159,8 @@ _mesa_is_alpha_test_enabled(const struct gl_context *ctx);
 extern bool
 _mesa_is_alpha_to_coverage_enabled(const struct gl_context *ctx);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* FRAMEBUFFER_H */
@@ -23,6 +23,7 @@
 
 #include "glspirv.h"
 #include "errors.h"
+#include "shaderapi.h"
 #include "util/u_atomic.h"
 
 void
@@ -80,6 +81,9 @@ _mesa_spirv_shader_binary(struct gl_context *ctx,
    for (int i = 0; i < n; ++i) {
       struct gl_shader *sh = shaders[i];
 
+      util_queue_fence_wait(&sh->CompileFence);
+      _mesa_wait_background_links(ctx);
+
       spirv_data = rzalloc(NULL, struct gl_shader_spirv_data);
       _mesa_shader_spirv_data_reference(&sh->spirv_data, spirv_data);
       _mesa_spirv_module_reference(&spirv_data->SpirVModule, module);
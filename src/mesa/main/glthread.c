@@ -91,10 +91,13 @@ _mesa_glthread_init(struct gl_context *ctx)
       util_queue_fence_init(&glthread->batches[i].fence);
    }
 
+   glthread->batch_size = MARSHAL_MAX_CMD_SIZE;
    glthread->stats.queue = &glthread->queue;
    ctx->CurrentClientDispatch = ctx->MarshalExec;
    ctx->GLThread = glthread;
 
+   _mesa_glthread_init_vaos(ctx);
+
    /* Execute the thread initialization function in the thread. */
    struct util_queue_fence fence;
    util_queue_fence_init(&fence);
@@ -118,6 +121,7 @@ _mesa_glthread_destroy(struct gl_context *ctx)
    for (unsigned i = 0; i < MARSHAL_MAX_BATCHES; i++)
       util_queue_fence_destroy(&glthread->batches[i].fence);
 
+   _mesa_glthread_destroy_vaos(ctx);
    free(glthread);
    ctx->GLThread = NULL;
 
@@ -139,6 +143,34 @@ _mesa_glthread_restore_dispatch(struct gl_context *ctx)
    }
 }
 
+/**
+ * Choose the size of the next batches from how busy the worker thread is.
+ *
+ * If all the queue slots are taken, the application thread is about to wait
+ * for the worker thread, so larger batches help by lowering the per-batch
+ * overhead.  If no batch is pending, the worker thread is idle, and smaller
+ * batches get work to it sooner.
+ */
+static void
+glthread_adapt_batch_size(struct glthread_state *glthread)
+{
+   unsigned pending = 0;
+
+   for (unsigned i = 0; i < MARSHAL_MAX_BATCHES; i++) {
+      if (i != glthread->next &&
+          !util_queue_fence_is_signalled(&glthread->batches[i].fence))
+         pending++;
+   }
+
+   if (pending >= MARSHAL_MAX_BATCHES - 2) {
+      glthread->batch_size = MIN2(glthread->batch_size * 2,
+                                  MARSHAL_MAX_BATCH_SIZE);
+   } else if (pending == 0) {
+      glthread->batch_size = MAX2(glthread->batch_size / 2,
+                                  MARSHAL_MAX_CMD_SIZE);
+   }
+}
+
 void
 _mesa_glthread_flush_batch(struct gl_context *ctx)
 {
@@ -162,6 +194,7 @@ _mesa_glthread_flush_batch(struct gl_context *ctx)
    }
 
    p_atomic_add(&glthread->stats.num_offloaded_items, next->used);
+   glthread_adapt_batch_size(glthread);
 
    util_queue_add_job(&glthread->queue, next, &next->fence,
                       glthread_unmarshal_batch, NULL);
@@ -218,3 +251,36 @@ _mesa_glthread_finish(struct gl_context *ctx)
    if (synced)
       p_atomic_inc(&glthread->stats.num_syncs);
 }
+
+/**
+ * Allocate memory for call data that doesn't fit in a batch.  The queued
+ * call owns it and frees it with _mesa_glthread_free_payload() after it's
+ * executed.
+ *
+ * Returns NULL if too much memory is held by queued calls already, in which
+ * case the call should be synchronous.
+ */
+void *
+_mesa_glthread_alloc_payload(struct gl_context *ctx, size_t size)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (size > MARSHAL_MAX_PAYLOAD_BYTES ||
+       p_atomic_read(&glthread->payload_bytes) + (int64_t)size >
+       MARSHAL_MAX_PAYLOAD_BYTES)
+      return NULL;
+
+   void *payload = malloc(size);
+   if (payload)
+      p_atomic_add(&glthread->payload_bytes, size);
+
+   return payload;
+}
+
+void
+_mesa_glthread_free_payload(struct gl_context *ctx, void *payload,
+                            size_t size)
+{
+   free(payload);
+   p_atomic_add(&ctx->GLThread->payload_bytes, -(int64_t)size);
+}
@@ -26,7 +26,8 @@
 
 #include "main/mtypes.h"
 
-/* The size of one batch and the maximum size of one call.
+/* The maximum size of one call, and the size of a batch when the worker
+ * thread keeps up with the application thread.
  *
  * This should be as low as possible, so that:
  * - multiple synchronizations within a frame don't slow us down much
@@ -37,6 +38,24 @@
  */
 #define MARSHAL_MAX_CMD_SIZE (8 * 1024)
 
+/* The maximum size of one batch.
+ *
+ * When the application thread finds the queue full, the batch size is
+ * doubled up to this, so that the worker thread spends less time in u_queue
+ * per call.  It is halved again when the worker thread runs out of work.
+ */
+#define MARSHAL_MAX_BATCH_SIZE (64 * 1024)
+
+/* The maximum amount of call data, in bytes, held in separate allocations
+ * by queued calls.
+ *
+ * Data too large for a batch, like big glBufferSubData uploads, is copied
+ * into a separate allocation that the queued call points to, so that the
+ * call doesn't have to be synchronous.  Beyond this amount, such calls are
+ * synchronous again to bound the memory use.
+ */
+#define MARSHAL_MAX_PAYLOAD_BYTES (64 * 1024 * 1024)
+
 /* The number of batch slots in memory.
  *
  * One batch is being executed, one batch is being filled, the rest are
@@ -50,6 +69,63 @@
 #include "util/u_queue.h"
 
 enum marshal_dispatch_cmd_id;
+struct _mesa_HashTable;
+
+/**
+ * The part of a vertex array object that the application thread tracks to
+ * find out which arrays a draw call reads from user memory.
+ */
+struct glthread_vao
+{
+   GLuint Name;
+   GLuint CurrentElementBufferName;
+
+   /** Mask of VERT_BIT_* values indicating which arrays are enabled */
+   GLbitfield Enabled;
+
+   /**
+    * Mask of VERT_BIT_* values of arrays that read from user memory, i.e.
+    * whose binding point has no buffer object.  Derived from the binding
+    * state.
+    */
+   GLbitfield UserPointerMask;
+
+   /**
+    * Mask of VERT_BIT_* values of arrays with a non-zero divisor.  Derived
+    * from the binding state.
+    */
+   GLbitfield NonZeroDivisorMask;
+
+   struct {
+      /** Size of one element in bytes, 0 if it can't be determined */
+      GLuint ElementSize;
+      /** Offset of the element from the binding point's offset */
+      GLuint RelativeOffset;
+      /** Binding point the array reads from, a gl_vert_attrib value */
+      GLubyte BufferIndex;
+      /** Distance between elements in bytes, from the binding point */
+      GLsizei Stride;
+      const void *Pointer;
+   } Attrib[VERT_ATTRIB_MAX];
+
+   /** \name Vertex buffer binding points, indexed by gl_vert_attrib */
+   /*@{*/
+   /** Mask of VERT_BIT_* values of binding points with no buffer object */
+   GLbitfield UserBindingMask;
+   /** Mask of VERT_BIT_* values of binding points with a non-zero divisor */
+   GLbitfield DivisorBindingMask;
+   GLsizei BindingStride[VERT_ATTRIB_MAX];
+   /*@}*/
+};
+
+/** Client attribute state saved by glPushClientAttrib. */
+struct glthread_client_attrib
+{
+   struct glthread_vao VAO;
+   GLuint CurrentArrayBufferName;
+   GLuint ClientActiveTexture;
+   bool Valid;
+};
 
 /** A single batch of commands queued up for execution. */
 struct glthread_batch
@@ -64,7 +140,7 @@ struct glthread_batch
    size_t used;
 
    /** Data contained in the command buffer. */
-   uint8_t buffer[MARSHAL_MAX_CMD_SIZE];
+   uint8_t buffer[MARSHAL_MAX_BATCH_SIZE];
 };
 
 struct glthread_state
@@ -84,17 +160,34 @@ struct glthread_state
    /** Index of the batch being filled and about to be submitted. */
    unsigned next;
 
-   /**
-    * Tracks on the main thread side whether the current vertex array binding
-    * is in a VBO.
-    */
-   bool vertex_array_is_vbo;
+   /** Size at which the batch being filled is submitted, in bytes. */
+   unsigned batch_size;
+
+   /** Size of the data in separate allocations held by queued calls. */
+   int64_t payload_bytes;
 
    /**
-    * Tracks on the main thread side whether the current element array (index
-    * buffer) binding is in a VBO.
+    * State tracked on the main thread side, so that draw calls using user
+    * vertex arrays or user indices and some glGet queries don't need to
+    * synchronize with the worker thread.
     */
-   bool element_array_is_vbo;
+   /*@{*/
+   struct _mesa_HashTable *VAOs;
+   struct glthread_vao DefaultVAO;
+   struct glthread_vao *CurrentVAO;
+
+   GLuint CurrentArrayBufferName;
+   GLuint ClientActiveTexture;
+
+   /** The last value set by glActiveTexture, or 0 if unknown. */
+   GLenum ActiveTexture;
+
+   /** The last value set by glMatrixMode, or 0 if unknown. */
+   GLenum MatrixMode;
+
+   struct glthread_client_attrib ClientAttribStack[MAX_CLIENT_ATTRIB_STACK_DEPTH];
+   unsigned ClientAttribStackTop;
+   /*@}*/
 };
 
 void _mesa_glthread_init(struct gl_context *ctx);
@@ -103,5 +196,61 @@ void _mesa_glthread_destroy(struct gl_context *ctx);
 void _mesa_glthread_restore_dispatch(struct gl_context *ctx);
 void _mesa_glthread_flush_batch(struct gl_context *ctx);
 void _mesa_glthread_finish(struct gl_context *ctx);
+void *_mesa_glthread_alloc_payload(struct gl_context *ctx, size_t size);
+void _mesa_glthread_free_payload(struct gl_context *ctx, void *payload,
+                                 size_t size);
+
+void _mesa_glthread_init_vaos(struct gl_context *ctx);
+void _mesa_glthread_destroy_vaos(struct gl_context *ctx);
+void _mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                               GLuint buffer);
+void _mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *buffers);
+void _mesa_glthread_GenVertexArrays(struct gl_context *ctx, GLsizei n,
+                                    const GLuint *arrays);
+void _mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                       const GLuint *arrays);
+void _mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint array);
+void _mesa_glthread_ClientState(struct gl_context *ctx, GLenum array,
+                                bool enable);
+void _mesa_glthread_ClientActiveTexture(struct gl_context *ctx,
+                                        GLenum texture);
+void _mesa_glthread_AttribPointer(struct gl_context *ctx,
+                                  gl_vert_attrib attrib, GLint size,
+                                  GLenum type, GLsizei stride,
+                                  const void *pointer);
+void _mesa_glthread_GenericAttribPointer(struct gl_context *ctx,
+                                         GLuint index, GLint size,
+                                         GLenum type, GLsizei stride,
+                                         const void *pointer);
+void _mesa_glthread_EnableVertexAttribArray(struct gl_context *ctx,
+                                            GLuint vaobj, GLuint index,
+                                            bool enable);
+void _mesa_glthread_InterleavedArrays(struct gl_context *ctx);
+void _mesa_glthread_VertexAttribFormat(struct gl_context *ctx, GLuint vaobj,
+                                       GLuint attribindex, GLint size,
+                                       GLenum type, GLuint relativeoffset);
+void _mesa_glthread_VertexAttribDivisor(struct gl_context *ctx, GLuint vaobj,
+                                        GLuint index, GLuint divisor);
+void _mesa_glthread_VertexBindingDivisor(struct gl_context *ctx,
+                                         GLuint vaobj, GLuint bindingindex,
+                                         GLuint divisor);
+void _mesa_glthread_VertexArrayElementBuffer(struct gl_context *ctx,
+                                             GLuint vaobj, GLuint buffer);
+void _mesa_glthread_BindVertexBuffer(struct gl_context *ctx, GLuint vaobj,
+                                     GLuint bindingindex, GLuint buffer,
+                                     GLsizei stride);
+void _mesa_glthread_BindVertexBuffers(struct gl_context *ctx, GLuint vaobj,
+                                      GLuint first, GLsizei count,
+                                      const GLuint *buffers,
+                                      const GLsizei *strides);
+void _mesa_glthread_VertexAttribBinding(struct gl_context *ctx,
+                                        GLuint vaobj, GLuint attribindex,
+                                        GLuint bindingindex);
+void _mesa_glthread_PushClientAttrib(struct gl_context *ctx, GLbitfield mask);
+void _mesa_glthread_PopClientAttrib(struct gl_context *ctx);
+void _mesa_glthread_ActiveTexture(struct gl_context *ctx, GLenum texture);
+void _mesa_glthread_MatrixMode(struct gl_context *ctx, GLenum mode);
+void _mesa_glthread_PopAttrib(struct gl_context *ctx);
 
 #endif /* _GLTHREAD_H*/
@@ -0,0 +1,698 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file glthread_varray.c
+ *
+ * Vertex array and buffer binding state tracked on the application thread.
+ *
+ * This is a shadow of a small part of the context state, updated by the
+ * marshalling functions after they queue a call.  It is what lets draw calls
+ * with user vertex arrays or user indices copy that data into the batch, and
+ * some glGet queries be answered, without waiting for the worker thread.
+ *
+ * The tracking doesn't validate everything the real implementation does.
+ * Where it can't tell what a call did, it leaves the element size of the
+ * array unknown, which makes draw calls using the array synchronous, so
+ * that it never copies less than the draw reads.
+ */
+
+#include "main/glthread.h"
+#include "main/bufferobj.h"
+#include "main/hash.h"
+#include "main/macros.h"
+#include "main/mtypes.h"
+#include "util/bitscan.h"
+
+
+/**
+ * Set up a new vertex array object: each array uses its own binding point,
+ * and no binding point has a buffer object.
+ */
+static void
+init_vao(struct glthread_vao *vao)
+{
+   for (unsigned i = 0; i < VERT_ATTRIB_MAX; i++)
+      vao->Attrib[i].BufferIndex = i;
+
+   vao->UserBindingMask = VERT_BIT_ALL;
+   vao->UserPointerMask = VERT_BIT_ALL;
+}
+
+
+/**
+ * Recompute the per-array state that comes from the binding points, after
+ * the binding points or the arrays' choice of them changed.
+ */
+static void
+update_arrays(struct glthread_vao *vao)
+{
+   vao->UserPointerMask = 0;
+   vao->NonZeroDivisorMask = 0;
+
+   for (unsigned i = 0; i < VERT_ATTRIB_MAX; i++) {
+      const unsigned binding = vao->Attrib[i].BufferIndex;
+
+      if (vao->UserBindingMask & VERT_BIT(binding))
+         vao->UserPointerMask |= VERT_BIT(i);
+      if (vao->DivisorBindingMask & VERT_BIT(binding))
+         vao->NonZeroDivisorMask |= VERT_BIT(i);
+      vao->Attrib[i].Stride = vao->BindingStride[binding];
+   }
+}
+
+
+static void
+set_binding(struct glthread_vao *vao, unsigned binding, bool user,
+            GLsizei stride)
+{
+   if (user)
+      vao->UserBindingMask |= VERT_BIT(binding);
+   else
+      vao->UserBindingMask &= ~VERT_BIT(binding);
+   vao->BindingStride[binding] = stride;
+}
+
+
+static void
+set_binding_divisor(struct glthread_vao *vao, unsigned binding,
+                    GLuint divisor)
+{
+   if (divisor)
+      vao->DivisorBindingMask |= VERT_BIT(binding);
+   else
+      vao->DivisorBindingMask &= ~VERT_BIT(binding);
+}
+
+
+void
+_mesa_glthread_init_vaos(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   glthread->VAOs = _mesa_NewHashTable();
+   init_vao(&glthread->DefaultVAO);
+   glthread->CurrentVAO = &glthread->DefaultVAO;
+   glthread->ActiveTexture = GL_TEXTURE0;
+   glthread->MatrixMode = GL_MODELVIEW;
+}
+
+
+static void
+free_vao(GLuint key, void *data, void *userData)
+{
+   free(data);
+}
+
+
+void
+_mesa_glthread_destroy_vaos(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (glthread->VAOs) {
+      _mesa_HashDeleteAll(glthread->VAOs, free_vao, NULL);
+      _mesa_DeleteHashTable(glthread->VAOs);
+      glthread->VAOs = NULL;
+   }
+}
+
+
+/**
+ * Return the VAO named by a DSA function, or the current one if vaobj is 0.
+ */
+static struct glthread_vao *
+get_vao(struct gl_context *ctx, GLuint vaobj)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!vaobj)
+      return glthread->CurrentVAO;
+
+   return _mesa_HashLookupLocked(glthread->VAOs, vaobj);
+}
+
+
+void
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   switch (target) {
+   case GL_ARRAY_BUFFER:
+      glthread->CurrentArrayBufferName = buffer;
+      break;
+   case GL_ELEMENT_ARRAY_BUFFER:
+      /* The element array buffer binding is part of the vertex array
+       * object.
+       */
+      glthread->CurrentVAO->CurrentElementBufferName = buffer;
+      break;
+   }
+}
+
+
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (n < 0 || !buffers)
+      return;
+
+   /* Deleting a bound buffer unbinds it from the context and from the
+    * current vertex array object.
+    */
+   for (GLsizei i = 0; i < n; i++) {
+      GLuint id = buffers[i];
+
+      if (!id)
+         continue;
+
+      if (glthread->CurrentArrayBufferName == id)
+         glthread->CurrentArrayBufferName = 0;
+      if (glthread->CurrentVAO->CurrentElementBufferName == id)
+         glthread->CurrentVAO->CurrentElementBufferName = 0;
+   }
+}
+
+
+/**
+ * Called after glGenVertexArrays and glCreateVertexArrays, which are
+ * synchronous, so the names are known to be valid.
+ */
+void
+_mesa_glthread_GenVertexArrays(struct gl_context *ctx, GLsizei n,
+                               const GLuint *arrays)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (n < 0 || !arrays)
+      return;
+
+   for (GLsizei i = 0; i < n; i++) {
+      GLuint id = arrays[i];
+
+      if (!id || _mesa_HashLookupLocked(glthread->VAOs, id))
+         continue;
+
+      struct glthread_vao *vao = calloc(1, sizeof(*vao));
+      if (!vao)
+         continue;
+
+      init_vao(vao);
+      vao->Name = id;
+      _mesa_HashInsertLocked(glthread->VAOs, id, vao);
+   }
+}
+
+
+void
+_mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *arrays)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (n < 0 || !arrays)
+      return;
+
+   for (GLsizei i = 0; i < n; i++) {
+      GLuint id = arrays[i];
+      struct glthread_vao *vao;
+
+      if (!id)
+         continue;
+
+      vao = _mesa_HashLookupLocked(glthread->VAOs, id);
+      if (!vao)
+         continue;
+
+      /* Deleting the current VAO binds the default one. */
+      if (glthread->CurrentVAO == vao)
+         glthread->CurrentVAO = &glthread->DefaultVAO;
+
+      _mesa_HashRemoveLocked(glthread->VAOs, id);
+      free(vao);
+   }
+}
+
+
+void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint array)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (array == 0) {
+      glthread->CurrentVAO = &glthread->DefaultVAO;
+   } else {
+      struct glthread_vao *vao = _mesa_HashLookupLocked(glthread->VAOs, array);
+
+      /* Binding a name that wasn't generated is an error. */
+      if (vao)
+         glthread->CurrentVAO = vao;
+   }
+}
+
+
+static void
+enable_array(struct glthread_vao *vao, gl_vert_attrib attrib, bool enable)
+{
+   if (enable)
+      vao->Enabled |= VERT_BIT(attrib);
+   else
+      vao->Enabled &= ~VERT_BIT(attrib);
+}
+
+
+void
+_mesa_glthread_ClientState(struct gl_context *ctx, GLenum array, bool enable)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   gl_vert_attrib attrib;
+
+   switch (array) {
+   case GL_VERTEX_ARRAY:
+      attrib = VERT_ATTRIB_POS;
+      break;
+   case GL_NORMAL_ARRAY:
+      attrib = VERT_ATTRIB_NORMAL;
+      break;
+   case GL_COLOR_ARRAY:
+      attrib = VERT_ATTRIB_COLOR0;
+      break;
+   case GL_INDEX_ARRAY:
+      attrib = VERT_ATTRIB_COLOR_INDEX;
+      break;
+   case GL_TEXTURE_COORD_ARRAY:
+      attrib = VERT_ATTRIB_TEX(glthread->ClientActiveTexture);
+      break;
+   case GL_EDGE_FLAG_ARRAY:
+      attrib = VERT_ATTRIB_EDGEFLAG;
+      break;
+   case GL_FOG_COORDINATE_ARRAY:
+      attrib = VERT_ATTRIB_FOG;
+      break;
+   case GL_SECONDARY_COLOR_ARRAY:
+      attrib = VERT_ATTRIB_COLOR1;
+      break;
+   case GL_POINT_SIZE_ARRAY_OES:
+      attrib = VERT_ATTRIB_POINT_SIZE;
+      break;
+   default:
+      return;
+   }
+
+   enable_array(glthread->CurrentVAO, attrib, enable);
+}
+
+
+void
+_mesa_glthread_ClientActiveTexture(struct gl_context *ctx, GLenum texture)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLuint unit = texture - GL_TEXTURE0;
+
+   if (unit < ctx->Const.MaxTextureCoordUnits &&
+       unit < MAX_TEXTURE_COORD_UNITS)
+      glthread->ClientActiveTexture = unit;
+}
+
+
+/**
+ * Return the size of one vertex of an array in bytes, or 0 if the
+ * parameters are invalid or unknown here.
+ */
+static GLuint
+get_element_size(GLint size, GLenum type)
+{
+   if (size == GL_BGRA)
+      size = 4;
+
+   if (size < 1 || size > 4)
+      return 0;
+
+   switch (type) {
+   case GL_BYTE:
+   case GL_UNSIGNED_BYTE:
+      return size;
+   case GL_SHORT:
+   case GL_UNSIGNED_SHORT:
+   case GL_HALF_FLOAT:
+   case GL_HALF_FLOAT_OES:
+      return size * 2;
+   case GL_INT:
+   case GL_UNSIGNED_INT:
+   case GL_FLOAT:
+   case GL_FIXED:
+      return size * 4;
+   case GL_DOUBLE:
+      return size * 8;
+   case GL_INT_2_10_10_10_REV:
+   case GL_UNSIGNED_INT_2_10_10_10_REV:
+   case GL_UNSIGNED_INT_10F_11F_11F_REV:
+      return 4;
+   default:
+      return 0;
+   }
+}
+
+
+void
+_mesa_glthread_AttribPointer(struct gl_context *ctx, gl_vert_attrib attrib,
+                             GLint size, GLenum type, GLsizei stride,
+                             const void *pointer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_vao *vao = glthread->CurrentVAO;
+   GLuint element_size = get_element_size(size, type);
+
+   if (stride < 0)
+      return;
+
+   /* An element size of 0 makes draw calls using the array synchronous. */
+   vao->Attrib[attrib].ElementSize = element_size;
+   vao->Attrib[attrib].RelativeOffset = 0;
+   vao->Attrib[attrib].Pointer = pointer;
+
+   /* The array uses its own binding point, with the current array buffer. */
+   vao->Attrib[attrib].BufferIndex = attrib;
+   set_binding(vao, attrib, !glthread->CurrentArrayBufferName,
+               stride ? stride : element_size);
+   update_arrays(vao);
+}
+
+
+void
+_mesa_glthread_GenericAttribPointer(struct gl_context *ctx, GLuint index,
+                                    GLint size, GLenum type, GLsizei stride,
+                                    const void *pointer)
+{
+   if (index >= ctx->Const.Program[MESA_SHADER_VERTEX].MaxAttribs ||
+       index >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   _mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_GENERIC(index), size, type,
+                                stride, pointer);
+}
+
+
+/**
+ * Copy the state of an array and its binding point from the context.  This
+ * is only valid after a synchronous call, while the worker thread is idle.
+ */
+static void
+copy_array_from_context(struct gl_context *ctx, gl_vert_attrib attrib)
+{
+   struct glthread_vao *vao = ctx->GLThread->CurrentVAO;
+   const struct gl_vertex_array_object *real_vao = ctx->Array.VAO;
+   const struct gl_array_attributes *array = &real_vao->VertexAttrib[attrib];
+   const unsigned binding = array->BufferBindingIndex;
+   const struct gl_vertex_buffer_binding *real_binding =
+      &real_vao->BufferBinding[binding];
+
+   enable_array(vao, attrib, array->Enabled);
+   vao->Attrib[attrib].ElementSize = array->_ElementSize;
+   vao->Attrib[attrib].RelativeOffset = array->RelativeOffset;
+   vao->Attrib[attrib].BufferIndex = binding;
+   vao->Attrib[attrib].Pointer = array->Ptr;
+
+   set_binding(vao, binding, !_mesa_is_bufferobj(real_binding->BufferObj),
+               real_binding->Stride);
+   set_binding_divisor(vao, binding, real_binding->InstanceDivisor);
+}
+
+
+/**
+ * Called after glInterleavedArrays, which is synchronous.  It sets up and
+ * enables or disables several arrays depending on the format, so they are
+ * taken from the context rather than worked out again here.
+ */
+void
+_mesa_glthread_InterleavedArrays(struct gl_context *ctx)
+{
+   struct glthread_vao *vao = ctx->GLThread->CurrentVAO;
+
+   copy_array_from_context(ctx, VERT_ATTRIB_POS);
+   copy_array_from_context(ctx, VERT_ATTRIB_NORMAL);
+   copy_array_from_context(ctx, VERT_ATTRIB_COLOR0);
+   copy_array_from_context(ctx, VERT_ATTRIB_COLOR_INDEX);
+   copy_array_from_context(ctx, VERT_ATTRIB_EDGEFLAG);
+   copy_array_from_context(ctx, VERT_ATTRIB_TEX(ctx->Array.ActiveTexture));
+   update_arrays(vao);
+}
+
+
+void
+_mesa_glthread_VertexAttribFormat(struct gl_context *ctx, GLuint vaobj,
+                                  GLuint attribindex, GLint size, GLenum type,
+                                  GLuint relativeoffset)
+{
+   struct glthread_vao *vao = get_vao(ctx, vaobj);
+
+   if (!vao || attribindex >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   const gl_vert_attrib attrib = VERT_ATTRIB_GENERIC(attribindex);
+
+   vao->Attrib[attrib].ElementSize = get_element_size(size, type);
+   vao->Attrib[attrib].RelativeOffset = relativeoffset;
+}
+
+
+void
+_mesa_glthread_EnableVertexAttribArray(struct gl_context *ctx, GLuint vaobj,
+                                       GLuint index, bool enable)
+{
+   struct glthread_vao *vao = get_vao(ctx, vaobj);
+
+   if (!vao || index >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   enable_array(vao, VERT_ATTRIB_GENERIC(index), enable);
+}
+
+
+/**
+ * glVertexAttribDivisor is glVertexAttribBinding(index, index) followed by
+ * glVertexBindingDivisor(index, divisor).
+ */
+void
+_mesa_glthread_VertexAttribDivisor(struct gl_context *ctx, GLuint vaobj,
+                                   GLuint index, GLuint divisor)
+{
+   struct glthread_vao *vao = get_vao(ctx, vaobj);
+
+   if (!vao || index >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   vao->Attrib[VERT_ATTRIB_GENERIC(index)].BufferIndex =
+      VERT_ATTRIB_GENERIC(index);
+   set_binding_divisor(vao, VERT_ATTRIB_GENERIC(index), divisor);
+   update_arrays(vao);
+}
+
+
+void
+_mesa_glthread_VertexBindingDivisor(struct gl_context *ctx, GLuint vaobj,
+                                    GLuint bindingindex, GLuint divisor)
+{
+   struct glthread_vao *vao = get_vao(ctx, vaobj);
+
+   if (!vao || bindingindex >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   set_binding_divisor(vao, VERT_ATTRIB_GENERIC(bindingindex), divisor);
+   update_arrays(vao);
+}
+
+
+void
+_mesa_glthread_VertexArrayElementBuffer(struct gl_context *ctx, GLuint vaobj,
+                                        GLuint buffer)
+{
+   struct glthread_vao *vao = get_vao(ctx, vaobj);
+
+   if (vao)
+      vao->CurrentElementBufferName = buffer;
+}
+
+
+/**
+ * Binding buffer 0 to a vertex buffer binding point makes the arrays using
+ * it read from user memory, at the pointers last set with gl*Pointer.
+ */
+void
+_mesa_glthread_BindVertexBuffer(struct gl_context *ctx, GLuint vaobj,
+                                GLuint bindingindex, GLuint buffer,
+                                GLsizei stride)
+{
+   struct glthread_vao *vao = get_vao(ctx, vaobj);
+
+   if (!vao || bindingindex >= VERT_ATTRIB_GENERIC_MAX || stride < 0)
+      return;
+
+   set_binding(vao, VERT_ATTRIB_GENERIC(bindingindex), buffer == 0, stride);
+   update_arrays(vao);
+}
+
+
+void
+_mesa_glthread_BindVertexBuffers(struct gl_context *ctx, GLuint vaobj,
+                                 GLuint first, GLsizei count,
+                                 const GLuint *buffers, const GLsizei *strides)
+{
+   struct glthread_vao *vao = get_vao(ctx, vaobj);
+
+   if (!vao || count < 0 || first >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   count = MIN2(count, VERT_ATTRIB_GENERIC_MAX - first);
+   for (GLsizei i = 0; i < count; i++) {
+      const unsigned binding = VERT_ATTRIB_GENERIC(first + i);
+
+      /* With no buffers, the binding points are reset to no buffer and the
+       * default stride of 16.
+       */
+      if (!buffers) {
+         set_binding(vao, binding, true, 16);
+         continue;
+      }
+
+      const GLsizei stride = strides ? strides[i] : 0;
+
+      /* Invalid strides leave the binding point alone. */
+      if (stride < 0)
+         continue;
+
+      set_binding(vao, binding, buffers[i] == 0, stride);
+   }
+   update_arrays(vao);
+}
+
+
+void
+_mesa_glthread_VertexAttribBinding(struct gl_context *ctx, GLuint vaobj,
+                                   GLuint attribindex, GLuint bindingindex)
+{
+   struct glthread_vao *vao = get_vao(ctx, vaobj);
+
+   if (!vao || attribindex >= VERT_ATTRIB_GENERIC_MAX ||
+       bindingindex >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   vao->Attrib[VERT_ATTRIB_GENERIC(attribindex)].BufferIndex =
+      VERT_ATTRIB_GENERIC(bindingindex);
+   update_arrays(vao);
+}
+
+
+void
+_mesa_glthread_PushClientAttrib(struct gl_context *ctx, GLbitfield mask)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (glthread->ClientAttribStackTop >= MAX_CLIENT_ATTRIB_STACK_DEPTH)
+      return;
+
+   struct glthread_client_attrib *top =
+      &glthread->ClientAttribStack[glthread->ClientAttribStackTop++];
+
+   top->Valid = (mask & GL_CLIENT_VERTEX_ARRAY_BIT) != 0;
+   if (top->Valid) {
+      top->VAO = *glthread->CurrentVAO;
+      top->CurrentArrayBufferName = glthread->CurrentArrayBufferName;
+      top->ClientActiveTexture = glthread->ClientActiveTexture;
+   }
+}
+
+
+void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (glthread->ClientAttribStackTop == 0)
+      return;
+
+   struct glthread_client_attrib *top =
+      &glthread->ClientAttribStack[--glthread->ClientAttribStackTop];
+
+   if (!top->Valid)
+      return;
+
+   /* A deleted VAO isn't recreated. */
+   struct glthread_vao *vao = top->VAO.Name ?
+      _mesa_HashLookupLocked(glthread->VAOs, top->VAO.Name) :
+      &glthread->DefaultVAO;
+   if (!vao)
+      return;
+
+   *vao = top->VAO;
+   glthread->CurrentVAO = vao;
+   glthread->CurrentArrayBufferName = top->CurrentArrayBufferName;
+   glthread->ClientActiveTexture = top->ClientActiveTexture;
+}
+
+
+void
+_mesa_glthread_ActiveTexture(struct gl_context *ctx, GLenum texture)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (texture - GL_TEXTURE0 < ctx->Const.MaxCombinedTextureImageUnits)
+      glthread->ActiveTexture = texture;
+}
+
+
+void
+_mesa_glthread_MatrixMode(struct gl_context *ctx, GLenum mode)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   switch (mode) {
+   case GL_MODELVIEW:
+   case GL_PROJECTION:
+   case GL_TEXTURE:
+      glthread->MatrixMode = mode;
+      break;
+   default:
+      /* Whether other modes are valid depends on extensions. */
+      glthread->MatrixMode = 0;
+      break;
+   }
+}
+
+
+/**
+ * glPopAttrib can restore the active texture and the matrix mode; they are
+ * unknown until they are set or queried again.
+ */
+void
+_mesa_glthread_PopAttrib(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   glthread->ActiveTexture = 0;
+   glthread->MatrixMode = 0;
+}
@@ -36,7 +36,25 @@
 
 #include "glheader.h"
 #include "hash.h"
+#include "macros.h"
 #include "util/hash_table.h"
+#include "util/u_atomic.h"
+
+
+/**
+ * Keys below this are also stored in the direct-indexed array.  glGen*()
+ * hands out names from 1 upwards, so this covers the objects of nearly
+ * every application while bounding the array to 512KB on 64-bit.
+ */
+#define DENSE_MAX_SIZE (1 << 16)
+#define DENSE_MIN_SIZE 256
+
+struct _mesa_HashDenseArray {
+   GLuint Size;
+   /** Next array in _mesa_HashTable::retired_dense. */
+   struct _mesa_HashDenseArray *Next;
+   void *Data[];
+};
 
 
 /**
@@ -93,12 +111,94 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 
    _mesa_hash_table_destroy(table->ht, NULL);
 
+   free(table->dense);
+   while (table->retired_dense) {
+      struct _mesa_HashDenseArray *next = table->retired_dense->Next;
+      free(table->retired_dense);
+      table->retired_dense = next;
+   }
+
    mtx_destroy(&table->Mutex);
    free(table);
 }
 
 
 
+/**
+ * Lookup an entry in the direct-indexed array, which is safe without the
+ * mutex.
+ *
+ * \return true if the key is covered by the array, in which case its entry
+ *         (possibly NULL) is stored in \p data.
+ */
+static inline bool
+lookup_dense(const struct _mesa_HashTable *table, GLuint key, void **data)
+{
+   struct _mesa_HashDenseArray *dense = p_atomic_read(&table->dense);
+
+   if (!dense || key >= dense->Size)
+      return false;
+
+   *data = p_atomic_read(&dense->Data[key]);
+   return true;
+}
+
+
+/**
+ * Update the entry for \p key in the direct-indexed array, if it covers the
+ * key.  The mutex must be held.
+ */
+static inline void
+set_dense(struct _mesa_HashTable *table, GLuint key, void *data)
+{
+   struct _mesa_HashDenseArray *dense = table->dense;
+
+   if (dense && key < dense->Size)
+      p_atomic_set(&dense->Data[key], data);
+}
+
+
+/**
+ * Replace the direct-indexed array by one that covers \p key.  The mutex
+ * must be held.
+ *
+ * Lookups may still be reading the old array, so it is kept until the table
+ * is destroyed.  Since the size doubles at least, all the retired arrays
+ * together are smaller than the current one.
+ */
+static void
+grow_dense(struct _mesa_HashTable *table, GLuint key)
+{
+   struct _mesa_HashDenseArray *old = table->dense;
+   const GLuint size = MAX2(util_next_power_of_two(key + 1), DENSE_MIN_SIZE);
+   struct _mesa_HashDenseArray *dense =
+      calloc(1, sizeof(*dense) + size * sizeof(dense->Data[0]));
+   struct hash_entry *entry;
+
+   /* The hash table still has every entry, so lookups of keys past the
+    * array just keep taking the slow path.
+    */
+   if (!dense)
+      return;
+
+   dense->Size = size;
+   hash_table_foreach(table->ht, entry) {
+      const GLuint k = (uintptr_t)entry->key;
+      if (k < size)
+         dense->Data[k] = entry->data;
+   }
+   dense->Data[DELETED_KEY_VALUE] = table->deleted_key_data;
+
+   /* Publish the filled array; p_atomic_set() is a release store. */
+   p_atomic_set(&table->dense, dense);
+
+   if (old) {
+      old->Next = table->retired_dense;
+      table->retired_dense = old;
+   }
+}
+
+
 /**
  * Lookup an entry in the hash table, without locking.
  * \sa _mesa_HashLookup
@@ -107,10 +207,14 @@ static inline void *
 _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 {
    const struct hash_entry *entry;
+   void *data;
 
    assert(table);
    assert(key);
 
+   if (lookup_dense(table, key, &data))
+      return data;
+
    if (key == DELETED_KEY_VALUE)
       return table->deleted_key_data;
 
@@ -126,6 +230,10 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 
 /**
  * Lookup an entry in the hash table.
+ *
+ * Keys covered by the direct-indexed array are looked up without taking
+ * the mutex, so that contexts sharing objects across threads don't contend
+ * on every bind.
  * 
  * \param table the hash table.
  * \param key the key.
@@ -136,6 +244,13 @@ void *
 _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
    void *res;
+
+   assert(table);
+   assert(key);
+
+   if (lookup_dense(table, key, &res))
+      return res;
+
    _mesa_HashLockMutex(table);
    res = _mesa_HashLookup_unlocked(table, key);
    _mesa_HashUnlockMutex(table);
@@ -173,6 +288,11 @@ _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
    if (key > table->MaxKey)
       table->MaxKey = key;
 
+   if (key < DENSE_MAX_SIZE &&
+       (!table->dense || key >= table->dense->Size))
+      grow_dense(table, key);
+   set_dense(table, key, data);
+
    if (key == DELETED_KEY_VALUE) {
       table->deleted_key_data = data;
    } else {
@@ -243,6 +363,8 @@ _mesa_HashRemove_unlocked(struct _mesa_HashTable *table, GLuint key)
     */
    assert(!table->InDeleteAll);
 
+   set_dense(table, key, NULL);
+
    if (key == DELETED_KEY_VALUE) {
       table->deleted_key_data = NULL;
    } else {
@@ -289,10 +411,12 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
    table->InDeleteAll = GL_TRUE;
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
+      set_dense(table, (uintptr_t)entry->key, NULL);
       _mesa_hash_table_remove(table->ht, entry);
    }
    if (table->deleted_key_data) {
       callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
+      set_dense(table, DELETED_KEY_VALUE, NULL);
       table->deleted_key_data = NULL;
    }
    table->InDeleteAll = GL_FALSE;
@@ -35,6 +35,10 @@
 #include "glheader.h"
 #include "imports.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * Magic GLuint object name that gets stored outside of the struct hash_table.
  *
@@ -92,6 +96,8 @@ uint_key(GLuint id)
 }
 /** @} */
 
+struct _mesa_HashDenseArray;
+
 /**
  * The hash table data structure.
  */
@@ -102,6 +108,16 @@ struct _mesa_HashTable {
    GLboolean InDeleteAll;                /**< Debug check */
    /** Value that would be in the table for DELETED_KEY_VALUE. */
    void *deleted_key_data;
+
+   /**
+    * Direct-indexed copy of the entries whose keys are below its size,
+    * which _mesa_HashLookup() reads without taking the mutex.  It is only
+    * modified with the mutex held, and replaced by a bigger copy when a
+    * larger key is inserted.
+    */
+   struct _mesa_HashDenseArray *dense;
+   /** Arrays replaced by a bigger one, freed with the table. */
+   struct _mesa_HashDenseArray *retired_dense;
 };
 
 extern struct _mesa_HashTable *_mesa_NewHashTable(void);
@@ -174,5 +190,8 @@ _mesa_HashNumEntries(const struct _mesa_HashTable *table);
 
 extern void _mesa_test_hash_functions(void);
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -27,11 +27,13 @@
  * thread when automatic code generation isn't appropriate.
  */
 
+#include "main/bufferobj.h"
 #include "main/enums.h"
 #include "main/macros.h"
 #include "marshal.h"
 #include "dispatch.h"
 #include "marshal_generated.h"
+#include "util/bitscan.h"
 
 struct marshal_cmd_Flush
 {
@@ -204,16 +206,21 @@ struct marshal_cmd_BindBufferBase
    GLuint buffer;
 };
 
-/** Tracks the current bindings for the vertex array and index array buffers.
- *
- * This is part of what we need to enable glthread on compat-GL contexts that
- * happen to use VBOs, without also supporting the full tracking of VBO vs
- * user vertex array bindings per attribute on each vertex array for
- * determining what to upload at draw call time.
+struct marshal_cmd_BindBuffer
+{
+   struct marshal_cmd_base cmd_base;
+   GLenum target;
+   GLuint buffer;
+};
+
+/**
+ * This is just like the code-generated glBindBuffer() support, except that we
+ * call _mesa_glthread_BindBuffer() to track the vertex array and index array
+ * buffer bindings.
  *
  * Note that GL core makes it so that a buffer binding with an invalid handle
  * in the "buffer" parameter will throw an error, and then a
- * glVertexAttribPointer() that followsmight not end up pointing at a VBO.
+ * glVertexAttribPointer() that follows might not end up pointing at a VBO.
  * However, in GL core the draw call would throw an error as well, so we don't
  * really care if our tracking is wrong for this case -- we never need to
  * marshal user data for draw calls, and the unmarshal will just generate an
@@ -221,42 +228,8 @@ struct marshal_cmd_BindBufferBase
  *
  * For compatibility GL, we do need to accurately know whether the draw call
  * on the unmarshal side will dereference a user pointer or load data from a
- * VBO per vertex.  That would make it seem like we need to track whether a
- * "buffer" is valid, so that we can know when an error will be generated
- * instead of updating the binding.  However, compat GL has the ridiculous
- * feature that if you pass a bad name, it just gens a buffer object for you,
- * so we escape without having to know if things are valid or not.
- */
-static void
-track_vbo_binding(struct gl_context *ctx, GLenum target, GLuint buffer)
-{
-   struct glthread_state *glthread = ctx->GLThread;
-
-   switch (target) {
-   case GL_ARRAY_BUFFER:
-      glthread->vertex_array_is_vbo = (buffer != 0);
-      break;
-   case GL_ELEMENT_ARRAY_BUFFER:
-      /* The current element array buffer binding is actually tracked in the
-       * vertex array object instead of the context, so this would need to
-       * change on vertex array object updates.
-       */
-      glthread->element_array_is_vbo = (buffer != 0);
-      break;
-   }
-}
-
-
-struct marshal_cmd_BindBuffer
-{
-   struct marshal_cmd_base cmd_base;
-   GLenum target;
-   GLuint buffer;
-};
-
-/**
- * This is just like the code-generated glBindBuffer() support, except that we
- * call track_vbo_binding().
+ * VBO per vertex.  Compat GL gens a buffer object for a name that wasn't
+ * generated, so the binding always succeeds.
  */
 void
 _mesa_unmarshal_BindBuffer(struct gl_context *ctx,
@@ -274,8 +247,6 @@ _mesa_marshal_BindBuffer(GLenum target, GLuint buffer)
    struct marshal_cmd_BindBuffer *cmd;
    debug_print_marshal("BindBuffer");
 
-   track_vbo_binding(ctx, target, buffer);
-
    if (cmd_size <= MARSHAL_MAX_CMD_SIZE) {
       cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_BindBuffer,
                                             cmd_size);
@@ -286,6 +257,8 @@ _mesa_marshal_BindBuffer(GLenum target, GLuint buffer)
       _mesa_glthread_finish(ctx);
       CALL_BindBuffer(ctx->CurrentServerDispatch, (target, buffer));
    }
+
+   _mesa_glthread_BindBuffer(ctx, target, buffer);
 }
 
 /* BufferData: marshalled asynchronously */
@@ -296,6 +269,7 @@ struct marshal_cmd_BufferData
    GLsizeiptr size;
    GLenum usage;
    bool data_null; /* If set, no data follows for "data" */
+   void *payload; /* If set, the data is here instead of following */
    /* Next size bytes are GLubyte data[size] */
 };
 
@@ -310,10 +284,15 @@ _mesa_unmarshal_BufferData(struct gl_context *ctx,
 
    if (cmd->data_null)
       data = NULL;
+   else if (cmd->payload)
+      data = cmd->payload;
    else
       data = (const void *) (cmd + 1);
 
    CALL_BufferData(ctx->CurrentServerDispatch, (target, size, data, usage));
+
+   if (cmd->payload)
+      _mesa_glthread_free_payload(ctx, cmd->payload, size);
 }
 
 void GLAPIENTRY
@@ -323,6 +302,7 @@ _mesa_marshal_BufferData(GLenum target, GLsizeiptr size, const GLvoid * data,
    GET_CURRENT_CONTEXT(ctx);
    size_t cmd_size =
       sizeof(struct marshal_cmd_BufferData) + (data ? size : 0);
+   void *payload = NULL;
    debug_print_marshal("BufferData");
 
    if (unlikely(size < 0)) {
@@ -341,11 +321,25 @@ _mesa_marshal_BufferData(GLenum target, GLsizeiptr size, const GLvoid * data,
       cmd->size = size;
       cmd->usage = usage;
       cmd->data_null = !data;
+      cmd->payload = NULL;
       if (data) {
          char *variable_data = (char *) (cmd + 1);
          memcpy(variable_data, data, size);
       }
       _mesa_post_marshal_hook(ctx);
+   } else if (target != GL_EXTERNAL_VIRTUAL_MEMORY_BUFFER_AMD &&
+              (payload = _mesa_glthread_alloc_payload(ctx, size))) {
+      struct marshal_cmd_BufferData *cmd =
+         _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_BufferData,
+                                         sizeof(*cmd));
+
+      memcpy(payload, data, size);
+      cmd->target = target;
+      cmd->size = size;
+      cmd->usage = usage;
+      cmd->data_null = false;
+      cmd->payload = payload;
+      _mesa_post_marshal_hook(ctx);
    } else {
       _mesa_glthread_finish(ctx);
       CALL_BufferData(ctx->CurrentServerDispatch,
@@ -360,6 +354,7 @@ struct marshal_cmd_BufferSubData
    GLenum target;
    GLintptr offset;
    GLsizeiptr size;
+   void *payload; /* If set, the data is here instead of following */
    /* Next size bytes are GLubyte data[size] */
 };
 
@@ -370,10 +365,13 @@ _mesa_unmarshal_BufferSubData(struct gl_context *ctx,
    const GLenum target = cmd->target;
    const GLintptr offset = cmd->offset;
    const GLsizeiptr size = cmd->size;
-   const void *data = (const void *) (cmd + 1);
+   const void *data = cmd->payload ? cmd->payload : (const void *) (cmd + 1);
 
    CALL_BufferSubData(ctx->CurrentServerDispatch,
                       (target, offset, size, data));
+
+   if (cmd->payload)
+      _mesa_glthread_free_payload(ctx, cmd->payload, size);
 }
 
 void GLAPIENTRY
@@ -382,6 +380,7 @@ _mesa_marshal_BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size,
 {
    GET_CURRENT_CONTEXT(ctx);
    size_t cmd_size = sizeof(struct marshal_cmd_BufferSubData) + size;
+   void *payload = NULL;
 
    debug_print_marshal("BufferSubData");
    if (unlikely(size < 0)) {
@@ -398,9 +397,22 @@ _mesa_marshal_BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size,
       cmd->target = target;
       cmd->offset = offset;
       cmd->size = size;
+      cmd->payload = NULL;
       char *variable_data = (char *) (cmd + 1);
       memcpy(variable_data, data, size);
       _mesa_post_marshal_hook(ctx);
+   } else if (target != GL_EXTERNAL_VIRTUAL_MEMORY_BUFFER_AMD && data &&
+              (payload = _mesa_glthread_alloc_payload(ctx, size))) {
+      struct marshal_cmd_BufferSubData *cmd =
+         _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_BufferSubData,
+                                         sizeof(*cmd));
+
+      memcpy(payload, data, size);
+      cmd->target = target;
+      cmd->offset = offset;
+      cmd->size = size;
+      cmd->payload = payload;
+      _mesa_post_marshal_hook(ctx);
    } else {
       _mesa_glthread_finish(ctx);
       CALL_BufferSubData(ctx->CurrentServerDispatch,
@@ -416,6 +428,7 @@ struct marshal_cmd_NamedBufferData
    GLsizei size;
    GLenum usage;
    bool data_null; /* If set, no data follows for "data" */
+   void *payload; /* If set, the data is here instead of following */
    /* Next size bytes are GLubyte data[size] */
 };
 
@@ -430,11 +443,16 @@ _mesa_unmarshal_NamedBufferData(struct gl_context *ctx,
 
    if (cmd->data_null)
       data = NULL;
+   else if (cmd->payload)
+      data = cmd->payload;
    else
       data = (const void *) (cmd + 1);
 
    CALL_NamedBufferData(ctx->CurrentServerDispatch,
                         (name, size, data, usage));
+
+   if (cmd->payload)
+      _mesa_glthread_free_payload(ctx, cmd->payload, size);
 }
 
 void GLAPIENTRY
@@ -443,6 +461,7 @@ _mesa_marshal_NamedBufferData(GLuint buffer, GLsizeiptr size,
 {
    GET_CURRENT_CONTEXT(ctx);
    size_t cmd_size = sizeof(struct marshal_cmd_NamedBufferData) + (data ? size : 0);
+   void *payload = NULL;
 
    debug_print_marshal("NamedBufferData");
    if (unlikely(size < 0)) {
@@ -459,11 +478,25 @@ _mesa_marshal_NamedBufferData(GLuint buffer, GLsizeiptr size,
       cmd->size = size;
       cmd->usage = usage;
       cmd->data_null = !data;
+      cmd->payload = NULL;
       if (data) {
          char *variable_data = (char *) (cmd + 1);
          memcpy(variable_data, data, size);
       }
       _mesa_post_marshal_hook(ctx);
+   } else if (buffer > 0 &&
+              (payload = _mesa_glthread_alloc_payload(ctx, size))) {
+      struct marshal_cmd_NamedBufferData *cmd =
+         _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_NamedBufferData,
+                                         sizeof(*cmd));
+
+      memcpy(payload, data, size);
+      cmd->name = buffer;
+      cmd->size = size;
+      cmd->usage = usage;
+      cmd->data_null = false;
+      cmd->payload = payload;
+      _mesa_post_marshal_hook(ctx);
    } else {
       _mesa_glthread_finish(ctx);
       CALL_NamedBufferData(ctx->CurrentServerDispatch,
@@ -478,6 +511,7 @@ struct marshal_cmd_NamedBufferSubData
    GLuint name;
    GLintptr offset;
    GLsizei size;
+   void *payload; /* If set, the data is here instead of following */
    /* Next size bytes are GLubyte data[size] */
 };
 
@@ -488,10 +522,13 @@ _mesa_unmarshal_NamedBufferSubData(struct gl_context *ctx,
    const GLuint name = cmd->name;
    const GLintptr offset = cmd->offset;
    const GLsizei size = cmd->size;
-   const void *data = (const void *) (cmd + 1);
+   const void *data = cmd->payload ? cmd->payload : (const void *) (cmd + 1);
 
    CALL_NamedBufferSubData(ctx->CurrentServerDispatch,
                            (name, offset, size, data));
+
+   if (cmd->payload)
+      _mesa_glthread_free_payload(ctx, cmd->payload, size);
 }
 
 void GLAPIENTRY
@@ -500,6 +537,7 @@ _mesa_marshal_NamedBufferSubData(GLuint buffer, GLintptr offset,
 {
    GET_CURRENT_CONTEXT(ctx);
    size_t cmd_size = sizeof(struct marshal_cmd_NamedBufferSubData) + size;
+   void *payload = NULL;
 
    debug_print_marshal("NamedBufferSubData");
    if (unlikely(size < 0)) {
@@ -515,9 +553,22 @@ _mesa_marshal_NamedBufferSubData(GLuint buffer, GLintptr offset,
       cmd->name = buffer;
       cmd->offset = offset;
       cmd->size = size;
+      cmd->payload = NULL;
       char *variable_data = (char *) (cmd + 1);
       memcpy(variable_data, data, size);
       _mesa_post_marshal_hook(ctx);
+   } else if (buffer > 0 && data &&
+              (payload = _mesa_glthread_alloc_payload(ctx, size))) {
+      struct marshal_cmd_NamedBufferSubData *cmd =
+         _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_NamedBufferSubData,
+                                         sizeof(*cmd));
+
+      memcpy(payload, data, size);
+      cmd->name = buffer;
+      cmd->offset = offset;
+      cmd->size = size;
+      cmd->payload = payload;
+      _mesa_post_marshal_hook(ctx);
    } else {
       _mesa_glthread_finish(ctx);
       CALL_NamedBufferSubData(ctx->CurrentServerDispatch,
@@ -747,3 +798,474 @@ _mesa_marshal_ClearBufferfi(GLenum buffer, GLint drawbuffer,
                          (buffer, drawbuffer, depth, stencil));
    }
 }
+
+
+/**
+ * Draw calls on compat contexts can read vertex arrays and indices from user
+ * memory, which the application may change as soon as the call returns.
+ * DrawArrays, DrawElements and DrawRangeElements copy the used range of such
+ * data into the command, and point the arrays at the copy while the worker
+ * thread executes the draw.  Calls whose data doesn't fit in a batch, or
+ * whose arrays the application thread doesn't know enough about, are
+ * synchronous.
+ */
+struct marshal_user_arrays
+{
+   /** VERT_BIT_* mask of the arrays copied into the command */
+   GLbitfield mask;
+   /** Offset of the data of each copied array, for index 0, from the
+    * start of the command.
+    */
+   ptrdiff_t offset[VERT_ATTRIB_MAX];
+};
+
+
+/**
+ * Return the mask of the enabled arrays in user memory and the size of the
+ * data to copy for vertices min_index to max_index.  Returns false if the
+ * draw has to be synchronous.
+ */
+static bool
+measure_user_arrays(struct gl_context *ctx, unsigned min_index,
+                    unsigned max_index, GLbitfield *mask, size_t *size)
+{
+   const struct glthread_vao *vao = ctx->GLThread->CurrentVAO;
+   GLbitfield user_arrays = vao->Enabled & vao->UserPointerMask;
+
+   *mask = user_arrays;
+   *size = 0;
+
+   if (!user_arrays)
+      return true;
+
+   /* Instanced arrays would have to be copied per instance. */
+   if (user_arrays & vao->NonZeroDivisorMask ||
+       max_index < min_index ||
+       max_index - min_index >= MARSHAL_MAX_CMD_SIZE)
+      return false;
+
+   while (user_arrays) {
+      const unsigned i = u_bit_scan(&user_arrays);
+
+      /* A relative offset comes from the ARB_vertex_attrib_binding format
+       * functions; leave the rare mix of those and user memory to the
+       * real implementation.
+       */
+      if (!vao->Attrib[i].ElementSize || !vao->Attrib[i].Pointer ||
+          vao->Attrib[i].RelativeOffset)
+         return false;
+
+      *size += ALIGN((size_t)(max_index - min_index) * vao->Attrib[i].Stride +
+                     vao->Attrib[i].ElementSize, 8);
+      if (*size > MARSHAL_MAX_CMD_SIZE)
+         return false;
+   }
+
+   return true;
+}
+
+
+static void
+copy_user_arrays(struct gl_context *ctx, unsigned min_index,
+                 unsigned max_index, GLbitfield mask, const void *cmd,
+                 GLubyte *data, struct marshal_user_arrays *arrays)
+{
+   const struct glthread_vao *vao = ctx->GLThread->CurrentVAO;
+
+   arrays->mask = mask;
+
+   while (mask) {
+      const unsigned i = u_bit_scan(&mask);
+      const size_t start = (size_t)min_index * vao->Attrib[i].Stride;
+      const size_t size = (size_t)(max_index - min_index) *
+                          vao->Attrib[i].Stride + vao->Attrib[i].ElementSize;
+
+      memcpy(data, (const GLubyte *)vao->Attrib[i].Pointer + start, size);
+      arrays->offset[i] = (data - (const GLubyte *)cmd) - (ptrdiff_t)start;
+      data += ALIGN(size, 8);
+   }
+}
+
+
+/**
+ * Point the user arrays of the current vertex array object at the copies in
+ * the command, saving the application's pointers.  Arrays that turn out to
+ * be in a buffer object are left alone.
+ */
+static void
+bind_user_arrays(struct gl_context *ctx, const void *cmd,
+                 const struct marshal_user_arrays *arrays,
+                 const GLubyte **saved)
+{
+   struct gl_vertex_array_object *vao = ctx->Array.VAO;
+   GLbitfield mask = arrays->mask;
+
+   while (mask) {
+      const unsigned i = u_bit_scan(&mask);
+      struct gl_array_attributes *array = &vao->VertexAttrib[i];
+      const struct gl_vertex_buffer_binding *binding =
+         &vao->BufferBinding[array->BufferBindingIndex];
+
+      saved[i] = array->Ptr;
+      if (!_mesa_is_bufferobj(binding->BufferObj)) {
+         array->Ptr = (const GLubyte *)cmd + arrays->offset[i];
+         vao->NewArrays |= vao->_Enabled & VERT_BIT(i);
+      }
+   }
+}
+
+
+static void
+unbind_user_arrays(struct gl_context *ctx,
+                   const struct marshal_user_arrays *arrays,
+                   const GLubyte **saved)
+{
+   struct gl_vertex_array_object *vao = ctx->Array.VAO;
+   GLbitfield mask = arrays->mask;
+
+   while (mask) {
+      const unsigned i = u_bit_scan(&mask);
+      struct gl_array_attributes *array = &vao->VertexAttrib[i];
+
+      if (array->Ptr != saved[i]) {
+         array->Ptr = saved[i];
+         vao->NewArrays |= vao->_Enabled & VERT_BIT(i);
+      }
+   }
+}
+
+
+/* DrawArrays: marshalled asynchronously, with user arrays copied */
+struct marshal_cmd_DrawArrays
+{
+   struct marshal_cmd_base cmd_base;
+   GLenum mode;
+   GLint first;
+   GLsizei count;
+   struct marshal_user_arrays user_arrays;
+   /* Followed by the data of the user arrays */
+};
+
+void
+_mesa_unmarshal_DrawArrays(struct gl_context *ctx,
+                           const struct marshal_cmd_DrawArrays *cmd)
+{
+   const GLubyte *saved[VERT_ATTRIB_MAX];
+
+   if (!cmd->user_arrays.mask) {
+      CALL_DrawArrays(ctx->CurrentServerDispatch,
+                      (cmd->mode, cmd->first, cmd->count));
+      return;
+   }
+
+   bind_user_arrays(ctx, cmd, &cmd->user_arrays, saved);
+   CALL_DrawArrays(ctx->CurrentServerDispatch,
+                   (cmd->mode, cmd->first, cmd->count));
+   unbind_user_arrays(ctx, &cmd->user_arrays, saved);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_DrawArrays *cmd;
+   GLbitfield user_arrays = 0;
+   size_t cmd_size, data_size = 0;
+   debug_print_marshal("DrawArrays");
+
+   if (ctx->API != API_OPENGL_CORE && count > 0 && first >= 0 &&
+       !measure_user_arrays(ctx, first, (unsigned)first + count - 1,
+                            &user_arrays, &data_size))
+      goto fallback_to_sync;
+
+   cmd_size = ALIGN(sizeof(*cmd), 8) + data_size;
+   if (cmd_size <= MARSHAL_MAX_CMD_SIZE) {
+      cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_DrawArrays,
+                                            cmd_size);
+      cmd->mode = mode;
+      cmd->first = first;
+      cmd->count = count;
+      cmd->user_arrays.mask = 0;
+      if (user_arrays) {
+         copy_user_arrays(ctx, first, (unsigned)first + count - 1,
+                          user_arrays, cmd,
+                          (GLubyte *)cmd + ALIGN(sizeof(*cmd), 8),
+                          &cmd->user_arrays);
+      }
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+fallback_to_sync:
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawArrays");
+   CALL_DrawArrays(ctx->CurrentServerDispatch, (mode, first, count));
+}
+
+
+/* DrawElements and DrawRangeElements: marshalled asynchronously, with user
+ * indices and user arrays copied
+ */
+struct marshal_cmd_DrawElements
+{
+   struct marshal_cmd_base cmd_base;
+   GLenum mode;
+   GLsizei count;
+   GLenum type;
+   GLuint start;
+   GLuint end;
+   /** Whether the indices follow the command; if not, they are an offset
+    * into the element array buffer
+    */
+   bool user_indices;
+   const GLvoid *indices;
+   struct marshal_user_arrays user_arrays;
+   /* Followed by the indices if user_indices is set, then the data of the
+    * user arrays
+    */
+};
+
+static void
+unmarshal_draw_elements(struct gl_context *ctx,
+                        const struct marshal_cmd_DrawElements *cmd,
+                        bool range)
+{
+   const GLvoid *indices = cmd->user_indices ?
+      (const GLubyte *)cmd + ALIGN(sizeof(*cmd), 8) : cmd->indices;
+   const GLubyte *saved[VERT_ATTRIB_MAX];
+
+   if (cmd->user_arrays.mask)
+      bind_user_arrays(ctx, cmd, &cmd->user_arrays, saved);
+
+   if (range) {
+      CALL_DrawRangeElements(ctx->CurrentServerDispatch,
+                             (cmd->mode, cmd->start, cmd->end, cmd->count,
+                              cmd->type, indices));
+   } else {
+      CALL_DrawElements(ctx->CurrentServerDispatch,
+                        (cmd->mode, cmd->count, cmd->type, indices));
+   }
+
+   if (cmd->user_arrays.mask)
+      unbind_user_arrays(ctx, &cmd->user_arrays, saved);
+}
+
+void
+_mesa_unmarshal_DrawElements(struct gl_context *ctx,
+                             const struct marshal_cmd_DrawElements *cmd)
+{
+   unmarshal_draw_elements(ctx, cmd, false);
+}
+
+void
+_mesa_unmarshal_DrawRangeElements(struct gl_context *ctx,
+                                  const struct marshal_cmd_DrawElements *cmd)
+{
+   unmarshal_draw_elements(ctx, cmd, true);
+}
+
+
+static unsigned
+get_index_size(GLenum type)
+{
+   switch (type) {
+   case GL_UNSIGNED_BYTE:
+      return 1;
+   case GL_UNSIGNED_SHORT:
+      return 2;
+   case GL_UNSIGNED_INT:
+      return 4;
+   default:
+      return 0;
+   }
+}
+
+
+static void
+get_index_range(GLenum type, const GLvoid *indices, GLsizei count,
+                unsigned *min_index, unsigned *max_index)
+{
+   unsigned min = ~0u, max = 0;
+
+#define SCAN_INDICES(T)                            \
+   for (GLsizei i = 0; i < count; i++) {           \
+      const unsigned index = ((const T *)indices)[i]; \
+      min = MIN2(min, index);                      \
+      max = MAX2(max, index);                      \
+   }
+
+   switch (type) {
+   case GL_UNSIGNED_BYTE:
+      SCAN_INDICES(GLubyte);
+      break;
+   case GL_UNSIGNED_SHORT:
+      SCAN_INDICES(GLushort);
+      break;
+   default:
+      SCAN_INDICES(GLuint);
+      break;
+   }
+#undef SCAN_INDICES
+
+   *min_index = min;
+   *max_index = max;
+}
+
+
+static void
+marshal_draw_elements(struct gl_context *ctx, GLenum mode, GLuint start,
+                      GLuint end, GLsizei count, GLenum type,
+                      const GLvoid *indices, bool range)
+{
+   const struct glthread_vao *vao = ctx->GLThread->CurrentVAO;
+   struct marshal_cmd_DrawElements *cmd;
+   const bool compat = ctx->API != API_OPENGL_CORE;
+   const bool user_indices = compat && !vao->CurrentElementBufferName;
+   const unsigned index_size = get_index_size(type);
+   GLbitfield user_arrays = 0;
+   unsigned min_index = 0, max_index = 0;
+   size_t cmd_size, indices_size = 0, data_size = 0;
+
+   if (user_indices && count > 0) {
+      if (!index_size || !indices ||
+          (size_t)count * index_size > MARSHAL_MAX_CMD_SIZE)
+         goto fallback_to_sync;
+      indices_size = ALIGN((size_t)count * index_size, 8);
+   }
+
+   if (compat && count > 0 && (vao->Enabled & vao->UserPointerMask)) {
+      /* The range of vertices used by indices in a buffer object isn't
+       * known on this thread.
+       */
+      if (!user_indices || (range && start > end))
+         goto fallback_to_sync;
+
+      get_index_range(type, indices, count, &min_index, &max_index);
+
+      /* The driver may read all of the range the application passed. */
+      if (range) {
+         min_index = MIN2(min_index, start);
+         max_index = MAX2(max_index, end);
+      }
+
+      if (!measure_user_arrays(ctx, min_index, max_index, &user_arrays,
+                               &data_size))
+         goto fallback_to_sync;
+   }
+
+   cmd_size = ALIGN(sizeof(*cmd), 8) + indices_size + data_size;
+   if (cmd_size <= MARSHAL_MAX_CMD_SIZE) {
+      cmd = _mesa_glthread_allocate_command(ctx, range ?
+                                            DISPATCH_CMD_DrawRangeElements :
+                                            DISPATCH_CMD_DrawElements,
+                                            cmd_size);
+      GLubyte *data = (GLubyte *)cmd + ALIGN(sizeof(*cmd), 8);
+
+      cmd->mode = mode;
+      cmd->count = count;
+      cmd->type = type;
+      cmd->start = start;
+      cmd->end = end;
+      cmd->user_indices = indices_size != 0;
+      cmd->indices = indices;
+      cmd->user_arrays.mask = 0;
+      if (cmd->user_indices) {
+         memcpy(data, indices, (size_t)count * index_size);
+         data += indices_size;
+      }
+      if (user_arrays) {
+         copy_user_arrays(ctx, min_index, max_index, user_arrays, cmd,
+                          data, &cmd->user_arrays);
+      }
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+fallback_to_sync:
+   _mesa_glthread_finish(ctx);
+   if (range) {
+      debug_print_sync_fallback("DrawRangeElements");
+      CALL_DrawRangeElements(ctx->CurrentServerDispatch,
+                             (mode, start, end, count, type, indices));
+   } else {
+      debug_print_sync_fallback("DrawElements");
+      CALL_DrawElements(ctx->CurrentServerDispatch,
+                        (mode, count, type, indices));
+   }
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawElements(GLenum mode, GLsizei count, GLenum type,
+                           const GLvoid *indices)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawElements");
+   marshal_draw_elements(ctx, mode, 0, ~0u, count, type, indices, false);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawRangeElements(GLenum mode, GLuint start, GLuint end,
+                                GLsizei count, GLenum type,
+                                const GLvoid *indices)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawRangeElements");
+   marshal_draw_elements(ctx, mode, start, end, count, type, indices, true);
+}
+
+
+/**
+ * GetIntegerv: answered on the application thread for the state that
+ * glthread tracks, synchronous otherwise.
+ */
+void GLAPIENTRY
+_mesa_marshal_GetIntegerv(GLenum pname, GLint *params)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct glthread_state *glthread = ctx->GLThread;
+
+   switch (pname) {
+   case GL_VERTEX_ARRAY_BINDING:
+      if (_mesa_is_desktop_gl(ctx) || _mesa_is_gles3(ctx)) {
+         *params = glthread->CurrentVAO->Name;
+         return;
+      }
+      break;
+   case GL_ARRAY_BUFFER_BINDING:
+      *params = glthread->CurrentArrayBufferName;
+      return;
+   case GL_ELEMENT_ARRAY_BUFFER_BINDING:
+      *params = glthread->CurrentVAO->CurrentElementBufferName;
+      return;
+   case GL_CLIENT_ACTIVE_TEXTURE:
+      if (ctx->API == API_OPENGL_COMPAT || ctx->API == API_OPENGLES) {
+         *params = GL_TEXTURE0 + glthread->ClientActiveTexture;
+         return;
+      }
+      break;
+   case GL_ACTIVE_TEXTURE:
+      if (glthread->ActiveTexture) {
+         *params = glthread->ActiveTexture;
+         return;
+      }
+      break;
+   case GL_MATRIX_MODE:
+      if ((ctx->API == API_OPENGL_COMPAT || ctx->API == API_OPENGLES) &&
+          glthread->MatrixMode) {
+         *params = glthread->MatrixMode;
+         return;
+      }
+      break;
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync("GetIntegerv");
+   CALL_GetIntegerv(ctx->CurrentServerDispatch, (pname, params));
+
+   /* Queries relearn the state that glPopAttrib makes unknown. */
+   if (pname == GL_ACTIVE_TEXTURE)
+      glthread->ActiveTexture = *params;
+   else if (pname == GL_MATRIX_MODE &&
+            (ctx->API == API_OPENGL_COMPAT || ctx->API == API_OPENGLES))
+      _mesa_glthread_MatrixMode(ctx, *params);
+}
@@ -57,7 +57,7 @@ _mesa_glthread_allocate_command(struct gl_context *ctx,
    struct marshal_cmd_base *cmd_base;
    const size_t aligned_size = ALIGN(size, 8);
 
-   if (unlikely(next->used + size > MARSHAL_MAX_CMD_SIZE)) {
+   if (unlikely(next->used + size > glthread->batch_size)) {
       _mesa_glthread_flush_batch(ctx);
       next = &glthread->batches[glthread->next];
    }
@@ -70,28 +70,44 @@ _mesa_glthread_allocate_command(struct gl_context *ctx,
 }
 
 /**
- * Instead of conditionally handling marshaling previously-bound user vertex
- * array data in draw calls (deprecated and removed in GL core), we just
- * disable threading at the point where the user sets a user vertex array.
+ * The glVertexPointerEXT() family of entry points doesn't have its array
+ * state tracked by glthread, so threading is disabled when one of them sets
+ * a user vertex array.
  */
 static inline bool
 _mesa_glthread_is_non_vbo_vertex_attrib_pointer(const struct gl_context *ctx)
 {
    struct glthread_state *glthread = ctx->GLThread;
 
-   return ctx->API != API_OPENGL_CORE && !glthread->vertex_array_is_vbo;
+   return ctx->API != API_OPENGL_CORE && !glthread->CurrentArrayBufferName;
 }
 
 /**
- * Instead of conditionally handling marshaling immediate index data in draw
- * calls (deprecated and removed in GL core), we just disable threading.
+ * Whether a draw call reads enabled vertex arrays from user memory.  Draw
+ * calls that don't copy user arrays into the batch have to be synchronous
+ * then.  User arrays are deprecated and removed in GL core.
  */
 static inline bool
-_mesa_glthread_is_non_vbo_draw_elements(const struct gl_context *ctx)
+_mesa_glthread_has_non_vbo_vertices(const struct gl_context *ctx)
 {
-   struct glthread_state *glthread = ctx->GLThread;
+   const struct glthread_vao *vao = ctx->GLThread->CurrentVAO;
+
+   return ctx->API != API_OPENGL_CORE &&
+          (vao->Enabled & vao->UserPointerMask) != 0;
+}
+
+/**
+ * Same as _mesa_glthread_has_non_vbo_vertices(), but also true if the draw
+ * call reads its indices from user memory.
+ */
+static inline bool
+_mesa_glthread_has_non_vbo_vertices_or_indices(const struct gl_context *ctx)
+{
+   const struct glthread_vao *vao = ctx->GLThread->CurrentVAO;
 
-   return ctx->API != API_OPENGL_CORE && !glthread->element_array_is_vbo;
+   return ctx->API != API_OPENGL_CORE &&
+          (!vao->CurrentElementBufferName ||
+           (vao->Enabled & vao->UserPointerMask) != 0);
 }
 
 #define DEBUG_MARSHAL_PRINT_CALLS 0
@@ -151,29 +167,6 @@ _mesa_post_marshal_hook(struct gl_context *ctx)
 }
 
 
-/**
- * Checks whether we're on a compat context for code-generated
- * glBindVertexArray().
- *
- * In order to decide whether a draw call uses only VBOs for vertex and index
- * buffers, we track the current vertex and index buffer bindings by
- * glBindBuffer().  However, the index buffer binding is stored in the vertex
- * array as opposed to the context.  If we were to accurately track whether
- * the index buffer was a user pointer ot not, we'd have to track it per
- * vertex array, which would mean synchronizing with the client thread and
- * looking into the hash table to find the actual vertex array object.  That's
- * more tracking than we'd like to do in the main thread, if possible.
- *
- * Instead, just punt for now and disable threading on apps using vertex
- * arrays and compat contexts.  Apps using vertex arrays can probably use a
- * core context.
- */
-static inline bool
-_mesa_glthread_is_compat_bind_vertex_array(const struct gl_context *ctx)
-{
-   return ctx->API != API_OPENGL_CORE;
-}
-
 struct marshal_cmd_Enable;
 struct marshal_cmd_ShaderSource;
 struct marshal_cmd_Flush;
@@ -187,6 +180,9 @@ struct marshal_cmd_ClearBuffer;
 #define marshal_cmd_ClearBufferiv   marshal_cmd_ClearBuffer
 #define marshal_cmd_ClearBufferuiv  marshal_cmd_ClearBuffer
 #define marshal_cmd_ClearBufferfi   marshal_cmd_ClearBuffer
+struct marshal_cmd_DrawArrays;
+struct marshal_cmd_DrawElements;
+#define marshal_cmd_DrawRangeElements marshal_cmd_DrawElements
 
 void
 _mesa_unmarshal_Enable(struct gl_context *ctx,
@@ -281,4 +277,31 @@ void GLAPIENTRY
 _mesa_marshal_ClearBufferfi(GLenum buffer, GLint drawbuffer,
                             const GLfloat depth, const GLint stencil);
 
+void
+_mesa_unmarshal_DrawArrays(struct gl_context *ctx,
+                           const struct marshal_cmd_DrawArrays *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawArrays(GLenum mode, GLint first, GLsizei count);
+
+void
+_mesa_unmarshal_DrawElements(struct gl_context *ctx,
+                             const struct marshal_cmd_DrawElements *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawElements(GLenum mode, GLsizei count, GLenum type,
+                           const GLvoid *indices);
+
+void
+_mesa_unmarshal_DrawRangeElements(struct gl_context *ctx,
+                                  const struct marshal_cmd_DrawElements *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawRangeElements(GLenum mode, GLuint start, GLuint end,
+                                GLsizei count, GLenum type,
+                                const GLvoid *indices);
+
+void GLAPIENTRY
+_mesa_marshal_GetIntegerv(GLenum pname, GLint *params);
+
 #endif /* MARSHAL_H */
@@ -40,6 +40,15 @@
 #include "util/half_float.h"
 #include "util/format_rgb9e5.h"
 #include "util/format_r11g11b10f.h"
+#include "util/u_atomic.h"
+#include "util/u_queue.h"
+
+
+/** Max number of jobs a 2D mipmap level is split into. */
+#define MIPMAP_MAX_JOBS 16
+
+/** Smaller 2D mipmap levels, in bytes, are generated on the calling thread. */
+#define MIPMAP_PARALLEL_MIN_SIZE (256 * 1024)
 
 
 /**
@@ -185,7 +194,31 @@ do_row(GLenum datatype, GLuint comps, GLint srcWidth,
    assert(srcWidth == dstWidth || srcWidth == 2 * dstWidth);
    */
 
-   if (datatype == GL_UNSIGNED_BYTE && comps == 4) {
+   if (datatype == GL_UNSIGNED_BYTE && comps == 4 && colStride == 2) {
+      /* Average the two texel pairs a 64-bit word at a time: the even and
+       * odd channels of the four texels are summed in separate 16-bit
+       * lanes, which can't overflow, then divided by four.
+       */
+      const uint64_t mask = 0x00ff00ff00ff00ffull;
+      const GLubyte *rowA = (const GLubyte *) srcRowA;
+      const GLubyte *rowB = (const GLubyte *) srcRowB;
+      GLubyte *dst = (GLubyte *) dstRow;
+      GLuint i;
+      for (i = 0; i < (GLuint) dstWidth; i++) {
+         uint64_t a, b, even, odd;
+         uint32_t texel;
+
+         memcpy(&a, rowA + i * 8, 8);
+         memcpy(&b, rowB + i * 8, 8);
+         even = (a & mask) + (b & mask);
+         odd = ((a >> 8) & mask) + ((b >> 8) & mask);
+         even += even >> 32;
+         odd += odd >> 32;
+         texel = ((even >> 2) & 0x00ff00ff) | (((odd >> 2) & 0x00ff00ff) << 8);
+         memcpy(dst + i * 4, &texel, 4);
+      }
+   }
+   else if (datatype == GL_UNSIGNED_BYTE && comps == 4) {
       GLuint i, j, k;
       const GLubyte(*rowA)[4] = (const GLubyte(*)[4]) srcRowA;
       const GLubyte(*rowB)[4] = (const GLubyte(*)[4]) srcRowB;
@@ -1466,6 +1499,119 @@ make_1d_mipmap(GLenum datatype, GLuint comps, GLint border,
 }
 
 
+/**
+ * A band of rows of a 2D mipmap level, see make_2d_mipmap_rows().
+ */
+struct mipmap_rows_job {
+   GLenum datatype;
+   GLuint comps;
+   GLint srcWidth, dstWidth;
+   const GLubyte *srcA, *srcB;
+   GLint srcStep;       /**< bytes between the source rows of two dst rows */
+   GLubyte *dst;
+   GLint dstRowStride;
+   GLint numRows;
+   int claimed;         /**< set by whichever thread generates the band */
+   struct util_queue_fence fence;
+};
+
+static struct util_queue mipmap_queue;
+static bool mipmap_queue_ready;
+static once_flag mipmap_queue_once_flag = ONCE_FLAG_INIT;
+
+static void
+init_mipmap_queue(void)
+{
+   mipmap_queue_ready =
+      util_queue_init(&mipmap_queue, "mipmap", MIPMAP_MAX_JOBS,
+                      MIPMAP_MAX_JOBS, UTIL_QUEUE_INIT_SHARED_POOL);
+}
+
+static void
+do_rows(void *data, int thread_index)
+{
+   const struct mipmap_rows_job *job = (const struct mipmap_rows_job *) data;
+   const GLubyte *srcA = job->srcA, *srcB = job->srcB;
+   GLubyte *dst = job->dst;
+   GLint row;
+
+   for (row = 0; row < job->numRows; row++) {
+      do_row(job->datatype, job->comps, job->srcWidth, srcA, srcB,
+             job->dstWidth, dst);
+      srcA += job->srcStep;
+      srcB += job->srcStep;
+      dst += job->dstRowStride;
+   }
+}
+
+/**
+ * Generate a band unless another thread already started it.
+ */
+static void
+claim_rows(void *data, int thread_index)
+{
+   struct mipmap_rows_job *job = (struct mipmap_rows_job *) data;
+
+   if (p_atomic_cmpxchg(&job->claimed, 0, 1) == 0)
+      do_rows(job, thread_index);
+}
+
+/**
+ * Generate the rows of a 2D mipmap level, not including its border.
+ * Large levels are split into bands of rows that are generated by the
+ * process-wide thread pool, the first band by the calling thread.  The pool
+ * may be busy with other queues, so the calling thread then also generates
+ * the bands that no pool thread has started yet, instead of waiting idle.
+ */
+static void
+make_2d_mipmap_rows(struct mipmap_rows_job *rows)
+{
+   struct mipmap_rows_job jobs[MIPMAP_MAX_JOBS];
+   GLint num_jobs, rows_per_job, i;
+
+   const GLint size = rows->numRows * abs(rows->dstRowStride);
+
+   if (size >= MIPMAP_PARALLEL_MIN_SIZE)
+      call_once(&mipmap_queue_once_flag, init_mipmap_queue);
+
+   if (size < MIPMAP_PARALLEL_MIN_SIZE ||
+       !mipmap_queue_ready || mipmap_queue.num_threads < 2) {
+      do_rows(rows, 0);
+      return;
+   }
+
+   num_jobs = MIN2(mipmap_queue.num_threads, rows->numRows);
+   rows_per_job = DIV_ROUND_UP(rows->numRows, num_jobs);
+   num_jobs = DIV_ROUND_UP(rows->numRows, rows_per_job);
+
+   for (i = 0; i < num_jobs; i++) {
+      jobs[i] = *rows;
+      jobs[i].srcA += i * rows_per_job * rows->srcStep;
+      jobs[i].srcB += i * rows_per_job * rows->srcStep;
+      jobs[i].dst += i * rows_per_job * rows->dstRowStride;
+      jobs[i].numRows = MIN2(rows_per_job,
+                             rows->numRows - i * rows_per_job);
+
+      jobs[i].claimed = 0;
+
+      if (i > 0) {
+         util_queue_fence_init(&jobs[i].fence);
+         util_queue_add_job_with_priority(&mipmap_queue, &jobs[i],
+                                          &jobs[i].fence, claim_rows, NULL,
+                                          UTIL_QUEUE_PRIORITY_HIGH);
+      }
+   }
+
+   for (i = 0; i < num_jobs; i++)
+      claim_rows(&jobs[i], 0);
+
+   for (i = 1; i < num_jobs; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
+
+
 static void
 make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
                GLint srcWidth, GLint srcHeight,
@@ -1480,6 +1626,7 @@ make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
    const GLubyte *srcA, *srcB;
    GLubyte *dst;
    GLint row, srcRowStep;
+   struct mipmap_rows_job rows;
 
    /* Compute src and dst pointers, skipping any border */
    srcA = srcPtr + border * ((srcWidth + 1) * bpt);
@@ -1496,13 +1643,17 @@ make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
 
    dst = dstPtr + border * ((dstWidth + 1) * bpt);
 
-   for (row = 0; row < dstHeightNB; row++) {
-      do_row(datatype, comps, srcWidthNB, srcA, srcB,
-             dstWidthNB, dst);
-      srcA += srcRowStep * srcRowStride;
-      srcB += srcRowStep * srcRowStride;
-      dst += dstRowStride;
-   }
+   rows.datatype = datatype;
+   rows.comps = comps;
+   rows.srcWidth = srcWidthNB;
+   rows.dstWidth = dstWidthNB;
+   rows.srcA = srcA;
+   rows.srcB = srcB;
+   rows.srcStep = srcRowStep * srcRowStride;
+   rows.dst = dst;
+   rows.dstRowStride = dstRowStride;
+   rows.numRows = dstHeightNB;
+   make_2d_mipmap_rows(&rows);
 
    /* This is ugly but probably won't be used much */
    if (border > 0) {
@@ -28,6 +28,10 @@
 
 #include "mtypes.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 unsigned
 _mesa_compute_num_levels(struct gl_context *ctx,
                          struct gl_texture_object *texObj,
@@ -58,4 +62,8 @@ _mesa_next_mipmap_level_size(GLenum target, GLint border,
                        GLint srcWidth, GLint srcHeight, GLint srcDepth,
                        GLint *dstWidth, GLint *dstHeight, GLint *dstDepth);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* MIPMAP_H */
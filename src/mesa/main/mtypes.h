@@ -48,6 +48,7 @@
 #include "compiler/glsl/list.h"
 #include "util/simple_mtx.h"
 #include "util/u_dynarray.h"
+#include "util/u_queue.h"
 
 
 #ifdef __cplusplus
@@ -2690,6 +2691,13 @@ struct gl_shader
 
    enum gl_compile_status CompileStatus;
 
+   /**
+    * Signalled once a compile queued by glCompileShader has finished, see
+    * GL_ARB_parallel_shader_compile.  Everything written by the compiler
+    * must only be accessed after waiting on it.
+    */
+   struct util_queue_fence CompileFence;
+
 #ifdef DEBUG
    unsigned SourceChecksum;       /**< for debug/logging purposes */
 #endif
@@ -3039,6 +3047,17 @@ struct gl_shader_program
    GLuint NumShaders;          /**< number of attached shaders */
    struct gl_shader **Shaders; /**< List of attached the shaders */
 
+   /**
+    * Signalled once a link queued by glLinkProgram has run the GLSL linker,
+    * see GL_ARB_parallel_shader_compile.  LinkPending stays set until the
+    * driver has linked the program too, which _mesa_finish_program_link()
+    * does on the first use of the program, holding LinkMutex so that only
+    * one context does it.
+    */
+   struct util_queue_fence LinkFence;
+   bool LinkPending;
+   simple_mtx_t LinkMutex;
+
    /**
     * User-defined attribute bindings
     *
@@ -3378,6 +3397,13 @@ struct gl_shared_state
    /** Table of both gl_shader and gl_shader_program objects */
    struct _mesa_HashTable *ShaderObjects;
 
+   /**
+    * Runs the GLSL linker for the programs linked in the background, see
+    * GL_ARB_parallel_shader_compile.  Created on first use.  The linker
+    * reads the attached shaders, so changing a shader waits for it.
+    */
+   struct util_queue LinkQueue;
+
    /* GL_EXT_framebuffer_object */
    struct _mesa_HashTable *RenderBuffers;
    struct _mesa_HashTable *FrameBuffers;
@@ -5072,6 +5098,17 @@ struct gl_context
    simple_mtx_t DebugMutex;
    struct gl_debug_state *Debug;
 
+   /**
+    * \name GL_ARB_parallel_shader_compile
+    *
+    * Shaders are compiled on CompileQueue, which is created on first use
+    * and runs at most MaxShaderCompilerThreads compiles at a time.
+    */
+   /*@{*/
+   GLuint MaxShaderCompilerThreads;
+   struct util_queue CompileQueue;
+   /*@}*/
+
    GLenum16 RenderMode;      /**< either GL_RENDER, GL_SELECT, GL_FEEDBACK */
    GLbitfield NewState;      /**< bitwise-or of _NEW_* flags */
    uint64_t NewDriverState;  /**< bitwise-or of flags from DriverFlags */
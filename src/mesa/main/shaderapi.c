@@ -41,6 +41,7 @@
 #include <c99_alloca.h>
 #include "main/glheader.h"
 #include "main/context.h"
+#include "main/debug_output.h"
 #include "main/dispatch.h"
 #include "main/enums.h"
 #include "main/glspirv.h"
@@ -64,6 +65,7 @@
 #include "util/hash_table.h"
 #include "util/mesa-sha1.h"
 #include "util/crc32.h"
+#include "util/u_atomic.h"
 
 /**
  * Return mask of GLSL_x flags by examining the MESA_GLSL env var.
@@ -142,6 +144,9 @@ _mesa_init_shader_state(struct gl_context *ctx)
    if (ctx->Shader.Flags != 0)
       ctx->Const.GenerateTemporaryNames = true;
 
+   /* As many compiler threads as there are CPUs, the queue clamps this. */
+   ctx->MaxShaderCompilerThreads = 0xffffffff;
+
    /* Extended for ARB_separate_shader_objects */
    ctx->Shader.RefCount = 1;
    ctx->TessCtrlProgram.patch_vertices = 3;
@@ -158,6 +163,14 @@ _mesa_init_shader_state(struct gl_context *ctx)
 void
 _mesa_free_shader_state(struct gl_context *ctx)
 {
+   if (util_queue_is_initialized(&ctx->CompileQueue)) {
+      util_queue_finish(&ctx->CompileQueue);
+      util_queue_destroy(&ctx->CompileQueue);
+   }
+
+   /* The background links of this context use it. */
+   _mesa_wait_background_links(ctx);
+
    for (int i = 0; i < MESA_SHADER_STAGES; i++) {
       _mesa_reference_program(ctx, &ctx->Shader.CurrentProgram[i], NULL);
    }
@@ -655,8 +668,20 @@ static void
 get_programiv(struct gl_context *ctx, GLuint program, GLenum pname,
               GLint *params)
 {
-   struct gl_shader_program *shProg
-      = _mesa_lookup_shader_program_err(ctx, program, "glGetProgramiv(program)");
+   struct gl_shader_program *shProg;
+
+   /* Polling the link status must not wait for the link. */
+   if (pname == GL_COMPLETION_STATUS_ARB &&
+       _mesa_has_ARB_parallel_shader_compile(ctx)) {
+      shProg = _mesa_lookup_shader_program_err_no_wait(ctx, program,
+                                                       "glGetProgramiv(program)");
+      if (shProg)
+         *params = util_queue_fence_is_signalled(&shProg->LinkFence);
+      return;
+   }
+
+   shProg = _mesa_lookup_shader_program_err(ctx, program,
+                                            "glGetProgramiv(program)");
 
    /* Is transform feedback available in this context?
     */
@@ -959,9 +984,18 @@ get_shaderiv(struct gl_context *ctx, GLuint name, GLenum pname, GLint *params)
       *params = shader->DeletePending;
       break;
    case GL_COMPILE_STATUS:
+      util_queue_fence_wait(&shader->CompileFence);
       *params = shader->CompileStatus ? GL_TRUE : GL_FALSE;
       break;
+   case GL_COMPLETION_STATUS_ARB:
+      if (!_mesa_has_ARB_parallel_shader_compile(ctx)) {
+         _mesa_error(ctx, GL_INVALID_ENUM, "glGetShaderiv(pname)");
+         return;
+      }
+      *params = util_queue_fence_is_signalled(&shader->CompileFence);
+      break;
    case GL_INFO_LOG_LENGTH:
+      util_queue_fence_wait(&shader->CompileFence);
       *params = (shader->InfoLog && shader->InfoLog[0] != '\0') ?
          strlen(shader->InfoLog) + 1 : 0;
       break;
@@ -1027,6 +1061,7 @@ get_shader_info_log(struct gl_context *ctx, GLuint shader, GLsizei bufSize,
       return;
    }
 
+   util_queue_fence_wait(&sh->CompileFence);
    _mesa_copy_string(infoLog, bufSize, length, sh->InfoLog);
 }
 
@@ -1058,10 +1093,15 @@ get_shader_source(struct gl_context *ctx, GLuint shader, GLsizei maxLength,
  * glShaderSource[ARB].
  */
 static void
-set_shader_source(struct gl_shader *sh, const GLchar *source)
+set_shader_source(struct gl_context *ctx, struct gl_shader *sh,
+                  const GLchar *source)
 {
    assert(sh);
 
+   /* The compiler or the linker may still be reading the old source. */
+   util_queue_fence_wait(&sh->CompileFence);
+   _mesa_wait_background_links(ctx);
+
    /* The GL_ARB_gl_spirv spec adds the following to the end of the description
     * of ShaderSource:
     *
@@ -1091,33 +1131,18 @@ set_shader_source(struct gl_shader *sh, const GLchar *source)
 
 
 /**
- * Compile a shader.
+ * Compile a shader and do the logging requested by the GLSL_* flags.
  */
-void
-_mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
+static void
+compile_shader(struct gl_context *ctx, struct gl_shader *sh, GLbitfield flags)
 {
-   if (!sh)
-      return;
-
-   /* The GL_ARB_gl_spirv spec says:
-    *
-    *    "Add a new error for the CompileShader command:
-    *
-    *      An INVALID_OPERATION error is generated if the SPIR_V_BINARY_ARB
-    *      state of <shader> is TRUE."
-    */
-   if (sh->spirv_data) {
-      _mesa_error(ctx, GL_INVALID_OPERATION, "glCompileShader(SPIR-V)");
-      return;
-   }
-
    if (!sh->Source) {
       /* If the user called glCompileShader without first calling
        * glShaderSource, we should fail to compile, but not raise a GL_ERROR.
        */
       sh->CompileStatus = COMPILE_FAILURE;
    } else {
-      if (ctx->_Shader->Flags & GLSL_DUMP) {
+      if (flags & GLSL_DUMP) {
          _mesa_log("GLSL source for %s shader %d:\n",
                  _mesa_shader_stage_to_string(sh->Stage), sh->Name);
          _mesa_log("%s\n", sh->Source);
@@ -1128,11 +1153,11 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
        */
       _mesa_glsl_compile_shader(ctx, sh, false, false, false);
 
-      if (ctx->_Shader->Flags & GLSL_LOG) {
+      if (flags & GLSL_LOG) {
          _mesa_write_shader_to_file(sh);
       }
 
-      if (ctx->_Shader->Flags & GLSL_DUMP) {
+      if (flags & GLSL_DUMP) {
          if (sh->CompileStatus) {
             if (sh->ir) {
                _mesa_log("GLSL IR for shader %d:\n", sh->Name);
@@ -1153,14 +1178,14 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
    }
 
    if (!sh->CompileStatus) {
-      if (ctx->_Shader->Flags & GLSL_DUMP_ON_ERROR) {
+      if (flags & GLSL_DUMP_ON_ERROR) {
          _mesa_log("GLSL source for %s shader %d:\n",
                  _mesa_shader_stage_to_string(sh->Stage), sh->Name);
          _mesa_log("%s\n", sh->Source);
          _mesa_log("Info Log:\n%s\n", sh->InfoLog);
       }
 
-      if (ctx->_Shader->Flags & GLSL_REPORT_ERRORS) {
+      if (flags & GLSL_REPORT_ERRORS) {
          _mesa_debug(ctx, "Error compiling shader %u:\n%s\n",
                      sh->Name, sh->InfoLog);
       }
@@ -1168,63 +1193,197 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
 }
 
 
+struct compile_shader_job {
+   struct gl_context *ctx;
+   struct gl_shader *sh;
+};
+
+static void
+compile_shader_job_execute(void *data, int thread_index)
+{
+   struct compile_shader_job *job = (struct compile_shader_job *) data;
+
+   compile_shader(job->ctx, job->sh, 0);
+   free(job);
+}
+
+
 /**
- * Link a program's shaders.
+ * Whether the context allows compiling and linking in the background
+ * (GL_ARB_parallel_shader_compile).
  */
-static ALWAYS_INLINE void
-link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
-             bool no_error)
+static bool
+background_compiles_allowed(struct gl_context *ctx)
 {
-   if (!shProg)
+   if (ctx->MaxShaderCompilerThreads == 0)
+      return false;
+
+   /* Keep the MESA_GLSL output in API order, and report compiler messages
+    * from the application thread if it asked for synchronous debug output.
+    */
+   return !ctx->_Shader->Flags &&
+          !_mesa_get_debug_state_int(ctx, GL_DEBUG_OUTPUT_SYNCHRONOUS);
+}
+
+
+/**
+ * Whether glCompileShader may return before the shader is compiled.
+ */
+static bool
+can_compile_in_background(struct gl_context *ctx)
+{
+   if (!background_compiles_allowed(ctx))
+      return false;
+
+   /* The queue runs on the process-wide pool, so each context only limits
+    * how many of its compiles run at once.
+    */
+   if (!util_queue_is_initialized(&ctx->CompileQueue) &&
+       !util_queue_init(&ctx->CompileQueue, "glsl", 32,
+                        ctx->MaxShaderCompilerThreads,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                        UTIL_QUEUE_INIT_SHARED_POOL))
+      return false;
+
+   return true;
+}
+
+
+static void
+compile_shader_err(struct gl_context *ctx, struct gl_shader *sh,
+                   bool background)
+{
+   if (!sh)
       return;
 
-   if (!no_error) {
-      /* From the ARB_transform_feedback2 specification:
-       * "The error INVALID_OPERATION is generated by LinkProgram if <program>
-       * is the name of a program being used by one or more transform feedback
-       * objects, even if the objects are not currently bound or are paused."
-       */
-      if (_mesa_transform_feedback_is_using_program(ctx, shProg)) {
-         _mesa_error(ctx, GL_INVALID_OPERATION,
-                     "glLinkProgram(transform feedback is using the program)");
+   /* The GL_ARB_gl_spirv spec says:
+    *
+    *    "Add a new error for the CompileShader command:
+    *
+    *      An INVALID_OPERATION error is generated if the SPIR_V_BINARY_ARB
+    *      state of <shader> is TRUE."
+    */
+   if (sh->spirv_data) {
+      _mesa_error(ctx, GL_INVALID_OPERATION, "glCompileShader(SPIR-V)");
+      return;
+   }
+
+   /* A previous compile of the same shader may still be running, and
+    * background links may still be reading the shader.
+    */
+   util_queue_fence_wait(&sh->CompileFence);
+   _mesa_wait_background_links(ctx);
+
+   if (background && can_compile_in_background(ctx)) {
+      struct compile_shader_job *job = malloc(sizeof(*job));
+
+      if (job) {
+         job->ctx = ctx;
+         job->sh = sh;
+         util_queue_add_job(&ctx->CompileQueue, job, &sh->CompileFence,
+                            compile_shader_job_execute, NULL);
          return;
       }
    }
 
-   unsigned programs_in_use = 0;
-   if (ctx->_Shader)
-      for (unsigned stage = 0; stage < MESA_SHADER_STAGES; stage++) {
-         if (ctx->_Shader->CurrentProgram[stage] &&
-             ctx->_Shader->CurrentProgram[stage]->Id == shProg->Name) {
-            programs_in_use |= 1 << stage;
-         }
-   }
+   compile_shader(ctx, sh, ctx->_Shader->Flags);
+}
 
-   FLUSH_VERTICES(ctx, 0);
-   _mesa_glsl_link_shader(ctx, shProg);
 
-   /* From section 7.3 (Program Objects) of the OpenGL 4.5 spec:
-    *
-    *    "If LinkProgram or ProgramBinary successfully re-links a program
-    *     object that is active for any shader stage, then the newly generated
-    *     executable code will be installed as part of the current rendering
-    *     state for all shader stages where the program is active.
-    *     Additionally, the newly generated executable code is made part of
-    *     the state of any program pipeline for all stages where the program
-    *     is attached."
-    */
-   if (shProg->data->LinkStatus && programs_in_use) {
-      while (programs_in_use) {
-         const int stage = u_bit_scan(&programs_in_use);
+/**
+ * Compile a shader.  The shader is compiled when this returns.
+ */
+void
+_mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
+{
+   compile_shader_err(ctx, sh, false);
+}
 
-         struct gl_program *prog = NULL;
-         if (shProg->_LinkedShaders[stage])
-            prog = shProg->_LinkedShaders[stage]->Program;
 
-         _mesa_use_program(ctx, stage, shProg, prog, ctx->_Shader);
-      }
+/**
+ * Wait until the background links of the share group are done.  Shaders
+ * must not be changed while a link reads them.
+ */
+void
+_mesa_wait_background_links(struct gl_context *ctx)
+{
+   struct gl_shared_state *shared = ctx->Shared;
+   bool initialized;
+
+   simple_mtx_lock(&shared->Mutex);
+   initialized = util_queue_is_initialized(&shared->LinkQueue);
+   simple_mtx_unlock(&shared->Mutex);
+
+   if (initialized)
+      util_queue_finish(&shared->LinkQueue);
+}
+
+
+struct link_program_job {
+   struct gl_context *ctx;
+   struct gl_shader_program *shProg;
+};
+
+static void
+link_program_job_execute(void *data, int thread_index)
+{
+   struct link_program_job *job = (struct link_program_job *) data;
+
+   _mesa_glsl_link_shader_ir(job->ctx, job->shProg);
+   free(job);
+}
+
+
+/**
+ * Whether glLinkProgram may return before the GLSL linker has run.
+ */
+static bool
+can_link_in_background(struct gl_context *ctx,
+                       struct gl_shader_program *shProg,
+                       unsigned programs_in_use)
+{
+   struct gl_shared_state *shared = ctx->Shared;
+   bool initialized;
+
+   /* A program that is in use has to be installed again right away.  The
+    * active program is in use too: glUniform* write it without a lookup.
+    */
+   if (programs_in_use || !background_compiles_allowed(ctx))
+      return false;
+   if (ctx->Shader.ActiveProgram == shProg ||
+       (ctx->_Shader && ctx->_Shader->ActiveProgram == shProg))
+      return false;
+
+   /* The linker recompiles the shaders whose compile was deferred by the
+    * shader cache, which must not happen behind the application's back.
+    */
+   if (!shProg->NumShaders)
+      return false;
+   for (unsigned i = 0; i < shProg->NumShaders; i++) {
+      if (shProg->Shaders[i]->CompileStatus != COMPILE_SUCCESS ||
+          shProg->Shaders[i]->spirv_data)
+         return false;
    }
 
+   /* Links don't depend on each other, so they may use the whole pool. */
+   simple_mtx_lock(&shared->Mutex);
+   if (!util_queue_is_initialized(&shared->LinkQueue))
+      util_queue_init(&shared->LinkQueue, "glsl_link", 32, UINT_MAX,
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                      UTIL_QUEUE_INIT_SHARED_POOL);
+   initialized = util_queue_is_initialized(&shared->LinkQueue);
+   simple_mtx_unlock(&shared->Mutex);
+
+   return initialized;
+}
+
+
+/**
+ * The parts of glLinkProgram that follow the link.
+ */
+static void
+link_program_done(struct gl_context *ctx, struct gl_shader_program *shProg)
+{
    /* Capture .shader_test files. */
    const char *capture_path = _mesa_get_shader_capture_path();
    if (shProg->Name != 0 && shProg->Name != ~0 && capture_path != NULL) {
@@ -1278,6 +1437,121 @@ link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
 }
 
 
+/**
+ * Link a program's shaders.
+ */
+static ALWAYS_INLINE void
+link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
+             bool no_error)
+{
+   if (!shProg)
+      return;
+
+   if (!no_error) {
+      /* From the ARB_transform_feedback2 specification:
+       * "The error INVALID_OPERATION is generated by LinkProgram if <program>
+       * is the name of a program being used by one or more transform feedback
+       * objects, even if the objects are not currently bound or are paused."
+       */
+      if (_mesa_transform_feedback_is_using_program(ctx, shProg)) {
+         _mesa_error(ctx, GL_INVALID_OPERATION,
+                     "glLinkProgram(transform feedback is using the program)");
+         return;
+      }
+   }
+
+   unsigned programs_in_use = 0;
+   if (ctx->_Shader)
+      for (unsigned stage = 0; stage < MESA_SHADER_STAGES; stage++) {
+         if (ctx->_Shader->CurrentProgram[stage] &&
+             ctx->_Shader->CurrentProgram[stage]->Id == shProg->Name) {
+            programs_in_use |= 1 << stage;
+         }
+   }
+
+   /* The linker reads what the compiler produced for the attached shaders. */
+   for (unsigned i = 0; i < shProg->NumShaders; i++)
+      util_queue_fence_wait(&shProg->Shaders[i]->CompileFence);
+
+   FLUSH_VERTICES(ctx, 0);
+
+   if (can_link_in_background(ctx, shProg, programs_in_use)) {
+      struct link_program_job *job = malloc(sizeof(*job));
+
+      if (job) {
+         /* The driver part runs on the first use of the program, see
+          * _mesa_finish_program_link().
+          */
+         _mesa_glsl_link_shader_begin(ctx, shProg);
+         p_atomic_set(&shProg->LinkPending, true);
+
+         job->ctx = ctx;
+         job->shProg = shProg;
+         util_queue_add_job(&ctx->Shared->LinkQueue, job, &shProg->LinkFence,
+                            link_program_job_execute, NULL);
+         return;
+      }
+   }
+
+   _mesa_glsl_link_shader(ctx, shProg);
+
+   /* From section 7.3 (Program Objects) of the OpenGL 4.5 spec:
+    *
+    *    "If LinkProgram or ProgramBinary successfully re-links a program
+    *     object that is active for any shader stage, then the newly generated
+    *     executable code will be installed as part of the current rendering
+    *     state for all shader stages where the program is active.
+    *     Additionally, the newly generated executable code is made part of
+    *     the state of any program pipeline for all stages where the program
+    *     is attached."
+    */
+   if (shProg->data->LinkStatus && programs_in_use) {
+      while (programs_in_use) {
+         const int stage = u_bit_scan(&programs_in_use);
+
+         struct gl_program *prog = NULL;
+         if (shProg->_LinkedShaders[stage])
+            prog = shProg->_LinkedShaders[stage]->Program;
+
+         _mesa_use_program(ctx, stage, shProg, prog, ctx->_Shader);
+      }
+   }
+
+   link_program_done(ctx, shProg);
+}
+
+
+/**
+ * Complete a link started in the background by glLinkProgram: wait for the
+ * GLSL linker, then let the driver link the program.  This is called when
+ * the program is looked up, so it runs before any use or query, and by the
+ * paths that use the active program without looking it up.
+ */
+void
+_mesa_finish_program_link(struct gl_context *ctx,
+                          struct gl_shader_program *shProg)
+{
+   if (!p_atomic_read(&shProg->LinkPending))
+      return;
+
+   util_queue_fence_wait(&shProg->LinkFence);
+
+   /* Contexts sharing the program may look it up at the same time.  Only
+    * the program's own lock is held, so lookups of other programs and the
+    * driver's own use of the shared state don't wait for the driver link.
+    * LinkPending is cleared last, so the other contexts wait here until
+    * the program is ready.
+    */
+   simple_mtx_lock(&shProg->LinkMutex);
+   if (shProg->LinkPending) {
+      _mesa_glsl_link_shader_end(ctx, shProg);
+      link_program_done(ctx, shProg);
+      p_atomic_set(&shProg->LinkPending, false);
+   }
+   simple_mtx_unlock(&shProg->LinkMutex);
+}
+
+
 static void
 link_program_error(struct gl_context *ctx, struct gl_shader_program *shProg)
 {
@@ -1476,8 +1750,8 @@ _mesa_CompileShader(GLuint shaderObj)
    GET_CURRENT_CONTEXT(ctx);
    if (MESA_VERBOSE & VERBOSE_API)
       _mesa_debug(ctx, "glCompileShader %u\n", shaderObj);
-   _mesa_compile_shader(ctx, _mesa_lookup_shader_err(ctx, shaderObj,
-                                                     "glCompileShader"));
+   compile_shader_err(ctx, _mesa_lookup_shader_err(ctx, shaderObj,
+                                                   "glCompileShader"), true);
 }
 
 
@@ -1978,7 +2252,7 @@ shader_source(struct gl_context *ctx, GLuint shaderObj, GLsizei count,
    }
 #endif /* ENABLE_SHADER_CACHE */
 
-   set_shader_source(sh, source);
+   set_shader_source(ctx, sh, source);
 
    free(offsets);
 }
@@ -2157,10 +2431,42 @@ _mesa_GetShaderPrecisionFormat(GLenum shadertype, GLenum precisiontype,
 void GLAPIENTRY
 _mesa_ReleaseShaderCompiler(void)
 {
+   GET_CURRENT_CONTEXT(ctx);
+
+   /* Don't pull the built-ins from under compiles and links still running.
+    * Only this context's compiles are waited for: the compile queues of the
+    * other contexts are private to them, like the compiles that other
+    * application threads run.  The links of the share group are waited for.
+    */
+   if (util_queue_is_initialized(&ctx->CompileQueue))
+      util_queue_finish(&ctx->CompileQueue);
+   _mesa_wait_background_links(ctx);
+
    _mesa_destroy_shader_compiler_caches();
 }
 
 
+/**
+ * For GL_ARB_parallel_shader_compile
+ */
+void GLAPIENTRY
+_mesa_MaxShaderCompilerThreadsARB(GLuint count)
+{
+   GET_CURRENT_CONTEXT(ctx);
+
+   if (count == ctx->MaxShaderCompilerThreads)
+      return;
+
+   ctx->MaxShaderCompilerThreads = count;
+
+   /* The queue is created again with the new limit by the next compile. */
+   if (util_queue_is_initialized(&ctx->CompileQueue)) {
+      util_queue_finish(&ctx->CompileQueue);
+      util_queue_destroy(&ctx->CompileQueue);
+   }
+}
+
+
 /**
  * For OpenGL ES 2.0, GL_ARB_ES2_compatibility
  */
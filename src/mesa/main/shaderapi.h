@@ -64,6 +64,13 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh);
 extern void
 _mesa_link_program(struct gl_context *ctx, struct gl_shader_program *sh_prog);
 
+extern void
+_mesa_finish_program_link(struct gl_context *ctx,
+                          struct gl_shader_program *shProg);
+
+extern void
+_mesa_wait_background_links(struct gl_context *ctx);
+
 extern unsigned
 _mesa_count_active_attribs(struct gl_shader_program *shProg);
 
@@ -235,6 +242,9 @@ _mesa_GetShaderPrecisionFormat(GLenum shadertype, GLenum precisiontype,
 extern void GLAPIENTRY
 _mesa_ReleaseShaderCompiler(void);
 
+extern void GLAPIENTRY
+_mesa_MaxShaderCompilerThreadsARB(GLuint count);
+
 extern void GLAPIENTRY
 _mesa_ShaderBinary(GLint n, const GLuint *shaders, GLenum binaryformat,
                    const void* binary, GLint length);
@@ -91,6 +91,7 @@ static void
 _mesa_init_shader(struct gl_shader *shader)
 {
    shader->RefCount = 1;
+   util_queue_fence_init(&shader->CompileFence);
    shader->info.Geom.VerticesOut = -1;
    shader->info.Geom.InputType = GL_TRIANGLES;
    shader->info.Geom.OutputType = GL_TRIANGLE_STRIP;
@@ -122,6 +123,12 @@ _mesa_new_shader(GLuint name, gl_shader_stage stage)
 void
 _mesa_delete_shader(struct gl_context *ctx, struct gl_shader *sh)
 {
+   /* Deleting a shader doesn't cancel its compile, the compiler still owns
+    * it until then.
+    */
+   util_queue_fence_wait(&sh->CompileFence);
+   util_queue_fence_destroy(&sh->CompileFence);
+
    _mesa_shader_spirv_data_reference(&sh->spirv_data, NULL);
    free((void *)sh->Source);
    free((void *)sh->FallbackSource);
@@ -284,6 +291,8 @@ init_shader_program(struct gl_shader_program *prog)
 {
    prog->Type = GL_SHADER_PROGRAM_MESA;
    prog->RefCount = 1;
+   util_queue_fence_init(&prog->LinkFence);
+   simple_mtx_init(&prog->LinkMutex, mtx_plain);
 
    prog->AttributeBindings = string_to_uint_map_ctor();
    prog->FragDataBindings = string_to_uint_map_ctor();
@@ -359,6 +368,10 @@ _mesa_free_shader_program_data(struct gl_context *ctx,
 
    assert(shProg->Type == GL_SHADER_PROGRAM_MESA);
 
+   /* The linker may still be writing the program. */
+   util_queue_fence_wait(&shProg->LinkFence);
+   shProg->LinkPending = false;
+
    _mesa_clear_shader_program_data(ctx, shProg);
 
    if (shProg->AttributeBindings) {
@@ -406,12 +419,15 @@ _mesa_delete_shader_program(struct gl_context *ctx,
                             struct gl_shader_program *shProg)
 {
    _mesa_free_shader_program_data(ctx, shProg);
+   util_queue_fence_destroy(&shProg->LinkFence);
+   simple_mtx_destroy(&shProg->LinkMutex);
    ralloc_free(shProg);
 }
 
 
 /**
- * Lookup a GLSL program object.
+ * Lookup a GLSL program object.  If the program is still being linked in
+ * the background, this waits for the link to complete.
  */
 struct gl_shader_program *
 _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
@@ -427,6 +443,8 @@ _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
       if (shProg && shProg->Type != GL_SHADER_PROGRAM_MESA) {
          return NULL;
       }
+      if (shProg)
+         _mesa_finish_program_link(ctx, shProg);
       return shProg;
    }
    return NULL;
@@ -439,6 +457,23 @@ _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
 struct gl_shader_program *
 _mesa_lookup_shader_program_err(struct gl_context *ctx, GLuint name,
                                 const char *caller)
+{
+   struct gl_shader_program *shProg =
+      _mesa_lookup_shader_program_err_no_wait(ctx, name, caller);
+
+   if (shProg)
+      _mesa_finish_program_link(ctx, shProg);
+   return shProg;
+}
+
+
+/**
+ * As above, but don't wait for a background link of the program, for
+ * GL_COMPLETION_STATUS_ARB.
+ */
+struct gl_shader_program *
+_mesa_lookup_shader_program_err_no_wait(struct gl_context *ctx, GLuint name,
+                                        const char *caller)
 {
    if (!name) {
       _mesa_error(ctx, GL_INVALID_VALUE, "%s", caller);
@@ -365,6 +365,12 @@ free_shared_state(struct gl_context *ctx, struct gl_shared_state *shared)
       _mesa_DeleteHashTable(shared->BitmapAtlas);
    }
 
+   /* Background links write to the programs freed below. */
+   if (util_queue_is_initialized(&shared->LinkQueue)) {
+      util_queue_finish(&shared->LinkQueue);
+      util_queue_destroy(&shared->LinkQueue);
+   }
+
    if (shared->ShaderObjects) {
       _mesa_HashWalk(shared->ShaderObjects, free_shader_program_data_cb, ctx);
       _mesa_HashDeleteAll(shared->ShaderObjects, delete_shader_cb, ctx);
@@ -0,0 +1,123 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "main/sse_format_convert.h"
+#include <smmintrin.h>
+
+/**
+ * SSE4.1 version of _mesa_swizzle_and_convert for 8-bit sources with
+ * four destination channels, which covers the RGBA/BGRA swaps, RGB to RGBA
+ * expansion and 8-bit to float conversions used by most uploads and
+ * readbacks.
+ *
+ * The swizzle is done with a single PSHUFB per four pixels, with the
+ * constant 0 and 1 channels OR'ed in afterwards.  Float destinations are
+ * then widened with PMOVZXBD, and unorm values are scaled the same way as
+ * _mesa_unorm_to_float so that the results are bit-identical.
+ *
+ * \return  the number of pixels converted, a multiple of four.  The caller
+ *          converts the remaining pixels, or all of them if the combination
+ *          isn't handled here.
+ */
+int
+_mesa_sse41_swizzle_and_convert(void *void_dst,
+                                enum mesa_array_format_datatype dst_type,
+                                int num_dst_channels,
+                                const void *void_src,
+                                enum mesa_array_format_datatype src_type,
+                                int num_src_channels,
+                                const uint8_t swizzle[4], bool normalized,
+                                int count)
+{
+   const uint8_t one = normalized ? UINT8_MAX : 1;
+   const uint8_t *src = void_src;
+   const int src_bytes = count * num_src_channels;
+   uint8_t shuffle[16] __attribute__ ((aligned (16)));
+   uint8_t consts[16] __attribute__ ((aligned (16)));
+   __m128i shuffle4, consts4;
+   int i, p, c;
+
+   if (src_type != MESA_ARRAY_FORMAT_TYPE_UBYTE ||
+       num_src_channels < 1 || num_src_channels > 4 ||
+       num_dst_channels != 4)
+      return 0;
+
+   if (dst_type != MESA_ARRAY_FORMAT_TYPE_UBYTE &&
+       dst_type != MESA_ARRAY_FORMAT_TYPE_FLOAT)
+      return 0;
+
+   for (c = 0; c < 4; c++) {
+      if (swizzle[c] >= num_src_channels &&
+          swizzle[c] != MESA_FORMAT_SWIZZLE_ZERO &&
+          swizzle[c] != MESA_FORMAT_SWIZZLE_ONE)
+         return 0;
+   }
+
+   for (p = 0; p < 4; p++) {
+      for (c = 0; c < 4; c++) {
+         const uint8_t s = swizzle[c];
+
+         /* PSHUFB writes zero for indices with the top bit set. */
+         shuffle[p * 4 + c] = s < num_src_channels ?
+                              p * num_src_channels + s : 0x80;
+         consts[p * 4 + c] = s == MESA_FORMAT_SWIZZLE_ONE ? one : 0;
+      }
+   }
+   shuffle4 = _mm_load_si128((const __m128i *)shuffle);
+   consts4 = _mm_load_si128((const __m128i *)consts);
+
+   /* Every iteration loads 16 source bytes, so stop before that would read
+    * past the end of the row.
+    */
+   if (dst_type == MESA_ARRAY_FORMAT_TYPE_UBYTE) {
+      __m128i *dst = void_dst;
+
+      for (i = 0; i * num_src_channels + 16 <= src_bytes; i += 4) {
+         __m128i v = _mm_loadu_si128((const __m128i *)(src +
+                                                        i * num_src_channels));
+         v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle4), consts4);
+         _mm_storeu_si128(dst++, v);
+      }
+   } else {
+      const __m128 scale = _mm_set1_ps(normalized ? 1.0f / 255.0f : 1.0f);
+      float *dst = void_dst;
+
+      for (i = 0; i * num_src_channels + 16 <= src_bytes; i += 4) {
+         __m128i v = _mm_loadu_si128((const __m128i *)(src +
+                                                        i * num_src_channels));
+         v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle4), consts4);
+
+         _mm_storeu_ps(dst + 0, _mm_mul_ps(_mm_cvtepi32_ps(
+            _mm_cvtepu8_epi32(v)), scale));
+         _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_cvtepi32_ps(
+            _mm_cvtepu8_epi32(_mm_srli_si128(v, 4))), scale));
+         _mm_storeu_ps(dst + 8, _mm_mul_ps(_mm_cvtepi32_ps(
+            _mm_cvtepu8_epi32(_mm_srli_si128(v, 8))), scale));
+         _mm_storeu_ps(dst + 12, _mm_mul_ps(_mm_cvtepi32_ps(
+            _mm_cvtepu8_epi32(_mm_srli_si128(v, 12))), scale));
+         dst += 16;
+      }
+   }
+
+   return i;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Measures the throughput of _mesa_format_convert for every pair of a set
+ * of common upload and readback formats.
+ *
+ * When the SSE4.1 paths are available, every pair is also run with them
+ * disabled.  main-test checks that both give the same results.
+ *
+ * Usage: mesa_format_convert_bench [size] [iterations]
+ */
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "main/glheader.h"
+#include "main/cpuinfo.h"
+#include "main/formats.h"
+#include "main/format_utils.h"
+#include "main/macros.h"
+#include "util/os_time.h"
+#include "x86/common_x86_asm.h"
+
+static const struct {
+   const char *name;
+   uint32_t format;
+   bool is_float;
+} formats[] = {
+   { "RGBA8", MESA_ARRAY_FORMAT(1, 0, 0, 1, 4, 0, 1, 2, 3), false },
+   { "BGRA8", MESA_ARRAY_FORMAT(1, 0, 0, 1, 4, 2, 1, 0, 3), false },
+   { "RGB8", MESA_ARRAY_FORMAT(1, 0, 0, 1, 3, 0, 1, 2, 5), false },
+   { "BGR8", MESA_ARRAY_FORMAT(1, 0, 0, 1, 3, 2, 1, 0, 5), false },
+   { "RG8", MESA_ARRAY_FORMAT(1, 0, 0, 1, 2, 0, 1, 4, 5), false },
+   { "R8", MESA_ARRAY_FORMAT(1, 0, 0, 1, 1, 0, 4, 4, 5), false },
+   { "RGBA16", MESA_ARRAY_FORMAT(2, 0, 0, 1, 4, 0, 1, 2, 3), false },
+   { "RGBA32F", MESA_ARRAY_FORMAT(4, 1, 1, 1, 4, 0, 1, 2, 3), true },
+   { "R8G8B8A8_UNORM", MESA_FORMAT_R8G8B8A8_UNORM, false },
+   { "B8G8R8A8_UNORM", MESA_FORMAT_B8G8R8A8_UNORM, false },
+   { "B5G6R5_UNORM", MESA_FORMAT_B5G6R5_UNORM, false },
+   { "RGBA_FLOAT32", MESA_FORMAT_RGBA_FLOAT32, true },
+};
+
+static unsigned
+format_bytes(uint32_t format)
+{
+   if (_mesa_format_is_mesa_array_format(format)) {
+      return _mesa_array_format_get_num_channels(format) *
+             _mesa_array_format_datatype_get_size(
+                _mesa_array_format_get_datatype(format));
+   }
+
+   return _mesa_get_format_bytes(format);
+}
+
+static double
+run_pair(unsigned s, unsigned d, void *dst, void *src, unsigned size,
+         unsigned iterations)
+{
+   const unsigned src_stride = size * format_bytes(formats[s].format);
+   const unsigned dst_stride = size * format_bytes(formats[d].format);
+
+   int64_t start = os_time_get_nano();
+   for (unsigned it = 0; it < iterations; it++) {
+      _mesa_format_convert(dst, formats[d].format, dst_stride,
+                           src, formats[s].format, src_stride,
+                           size, size, NULL);
+   }
+   int64_t ns = os_time_get_nano() - start;
+
+   /* Megapixels per second. */
+   return (double)size * size * iterations * 1000.0 / ns;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned size = argc > 1 ? atoi(argv[1]) : 1024;
+   unsigned iterations = argc > 2 ? atoi(argv[2]) : 10;
+   const size_t max_bytes = (size_t)size * size * 16;
+   uint8_t *src = malloc(max_bytes);
+   uint8_t *dst = malloc(max_bytes);
+
+   assert(src && dst);
+
+   _mesa_get_cpu_features();
+
+#if defined(USE_SSE41)
+   const int cpu_features = _mesa_x86_cpu_features;
+   const bool has_simd = cpu_has_sse4_1;
+#else
+   const bool has_simd = false;
+#endif
+
+   printf("%-15s %-15s %10s%s\n", "source", "destination", "Mpix/s",
+          has_simd ? "  Mpix/s (scalar)" : "");
+
+   for (unsigned s = 0; s < ARRAY_SIZE(formats); s++) {
+      if (formats[s].is_float) {
+         for (size_t i = 0; i < max_bytes / sizeof(float); i++)
+            ((float *)src)[i] = (float)rand() / RAND_MAX;
+      } else {
+         for (size_t i = 0; i < max_bytes; i++)
+            src[i] = rand();
+      }
+
+      for (unsigned d = 0; d < ARRAY_SIZE(formats); d++) {
+         double mpix = run_pair(s, d, dst, src, size, iterations);
+
+         printf("%-15s %-15s %10.1f", formats[s].name, formats[d].name, mpix);
+
+#if defined(USE_SSE41)
+         if (has_simd) {
+            _mesa_x86_cpu_features &= ~X86_FEATURE_SSE4_1;
+            printf("  %10.1f", run_pair(s, d, dst, src, size, iterations));
+            _mesa_x86_cpu_features = cpu_features;
+         }
+#endif
+         printf("\n");
+      }
+   }
+
+   free(src);
+   free(dst);
+
+   return 0;
+}
@@ -0,0 +1,334 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \name format_utils.cpp
+ *
+ * Check that _mesa_swizzle_and_convert gives the same results for 8-bit
+ * sources with and without its SSE4.1 path, and that _mesa_format_convert
+ * gives the same results whether it uses the SSE4.1 path or the direct
+ * pack, unpack and memcpy paths.
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "main/glheader.h"
+#include "main/cpuinfo.h"
+#include "main/formats.h"
+#include "main/format_utils.h"
+#include "main/macros.h"
+#if defined(USE_SSE41)
+#include "x86/common_x86_asm.h"
+#endif
+
+#define GUARD_BYTES 64
+#define GUARD_VALUE 0xcd
+
+static const GLubyte ZERO = MESA_FORMAT_SWIZZLE_ZERO;
+static const GLubyte ONE = MESA_FORMAT_SWIZZLE_ONE;
+
+static const GLubyte swizzles[][4] = {
+   { 0, 1, 2, 3 },
+   { 2, 1, 0, 3 },
+   { 3, 2, 1, 0 },
+   { 1, 2, 3, 0 },
+   { 0, 1, 2, ONE },
+   { 2, 1, 0, ONE },
+   { 0, 1, ZERO, ONE },
+   { 0, 0, 0, ONE },
+   { 0, 0, 0, 0 },
+   { ZERO, ZERO, ZERO, 0 },
+   { ONE, 0, ZERO, 1 },
+};
+
+/* Pixel counts below, at and above the four pixels the SIMD loop handles
+ * at a time, with leftovers.
+ */
+static const int counts[] = { 1, 3, 4, 5, 8, 17, 64, 67 };
+
+class MesaFormatUtilsTest : public ::testing::Test {
+protected:
+   virtual void SetUp()
+   {
+      _mesa_get_cpu_features();
+#if defined(USE_SSE41)
+      cpu_features = _mesa_x86_cpu_features;
+#endif
+   }
+
+   virtual void TearDown()
+   {
+      set_simd(true);
+   }
+
+   /* Returns false if the SSE4.1 path can't be disabled, because the CPU
+    * doesn't have it or the whole build already requires it.
+    */
+   bool set_simd(bool enable)
+   {
+#if defined(USE_SSE41) && !defined(__SSE4_1__)
+      if (enable)
+         _mesa_x86_cpu_features = cpu_features;
+      else
+         _mesa_x86_cpu_features = cpu_features & ~X86_FEATURE_SSE4_1;
+      return (cpu_features & X86_FEATURE_SSE4_1) != 0;
+#else
+      (void) enable;
+      return false;
+#endif
+   }
+
+   int cpu_features;
+};
+
+static bool
+swizzle_is_valid(const GLubyte swizzle[4], int num_src_channels,
+                 int num_dst_channels)
+{
+   for (int c = 0; c < num_dst_channels; c++) {
+      if (swizzle[c] >= num_src_channels && swizzle[c] != ZERO &&
+          swizzle[c] != ONE)
+         return false;
+   }
+   return true;
+}
+
+static void
+expected_ubyte(std::vector<GLubyte> &dst, const std::vector<GLubyte> &src,
+               int num_src_channels, int num_dst_channels,
+               const GLubyte swizzle[4], bool normalized, int count)
+{
+   for (int i = 0; i < count; i++) {
+      for (int c = 0; c < num_dst_channels; c++) {
+         GLubyte v;
+
+         if (swizzle[c] == ZERO)
+            v = 0;
+         else if (swizzle[c] == ONE)
+            v = normalized ? 0xff : 1;
+         else
+            v = src[i * num_src_channels + swizzle[c]];
+
+         dst[i * num_dst_channels + c] = v;
+      }
+   }
+}
+
+static void
+expected_float(std::vector<GLubyte> &dst, const std::vector<GLubyte> &src,
+               int num_src_channels, int num_dst_channels,
+               const GLubyte swizzle[4], bool normalized, int count)
+{
+   float *f = (float *)dst.data();
+
+   for (int i = 0; i < count; i++) {
+      for (int c = 0; c < num_dst_channels; c++) {
+         float v;
+
+         if (swizzle[c] == ZERO) {
+            v = 0.0f;
+         } else if (swizzle[c] == ONE) {
+            v = 1.0f;
+         } else {
+            GLubyte s = src[i * num_src_channels + swizzle[c]];
+            v = normalized ? _mesa_unorm_to_float(s, 8) : (float)s;
+         }
+
+         f[i * num_dst_channels + c] = v;
+      }
+   }
+}
+
+/* Converts into a buffer followed by guard bytes, and checks that they
+ * weren't written.
+ */
+static std::vector<GLubyte>
+swizzle_and_convert(enum mesa_array_format_datatype dst_type,
+                    int num_dst_channels, const std::vector<GLubyte> &src,
+                    int num_src_channels, const GLubyte swizzle[4],
+                    bool normalized, int count)
+{
+   const size_t dst_bytes = (size_t)count * num_dst_channels *
+                            _mesa_array_format_datatype_get_size(dst_type);
+   std::vector<GLubyte> dst(dst_bytes + GUARD_BYTES, GUARD_VALUE);
+
+   _mesa_swizzle_and_convert(dst.data(), dst_type, num_dst_channels,
+                             src.data(), MESA_ARRAY_FORMAT_TYPE_UBYTE,
+                             num_src_channels, swizzle, normalized, count);
+
+   for (size_t i = dst_bytes; i < dst.size(); i++)
+      EXPECT_EQ(GUARD_VALUE, dst[i]) << "written past the end";
+
+   dst.resize(dst_bytes);
+   return dst;
+}
+
+static void
+check_swizzle_and_convert(enum mesa_array_format_datatype dst_type,
+                          bool simd)
+{
+   const int dst_size = _mesa_array_format_datatype_get_size(dst_type);
+
+   for (int num_src = 1; num_src <= 4; num_src++) {
+      for (int num_dst = 1; num_dst <= 4; num_dst++) {
+         for (unsigned s = 0; s < ARRAY_SIZE(swizzles); s++) {
+            if (!swizzle_is_valid(swizzles[s], num_src, num_dst))
+               continue;
+
+            for (int normalized = 0; normalized <= 1; normalized++) {
+               for (unsigned n = 0; n < ARRAY_SIZE(counts); n++) {
+                  const int count = counts[n];
+                  /* Sized exactly, so that reading past the end of the
+                   * source is caught by memory checkers.
+                   */
+                  std::vector<GLubyte> src((size_t)count * num_src);
+                  std::vector<GLubyte> expected((size_t)count * num_dst *
+                                                dst_size);
+
+                  for (size_t i = 0; i < src.size(); i++)
+                     src[i] = rand();
+
+                  if (dst_type == MESA_ARRAY_FORMAT_TYPE_UBYTE) {
+                     expected_ubyte(expected, src, num_src, num_dst,
+                                    swizzles[s], normalized, count);
+                  } else {
+                     expected_float(expected, src, num_src, num_dst,
+                                    swizzles[s], normalized, count);
+                  }
+
+                  std::vector<GLubyte> dst =
+                     swizzle_and_convert(dst_type, num_dst, src, num_src,
+                                         swizzles[s], normalized, count);
+
+                  EXPECT_TRUE(dst == expected)
+                     << (simd ? "SSE4.1" : "scalar")
+                     << " src channels " << num_src
+                     << " dst channels " << num_dst
+                     << " swizzle " << s
+                     << " normalized " << normalized
+                     << " count " << count;
+               }
+            }
+         }
+      }
+   }
+}
+
+TEST_F(MesaFormatUtilsTest, SwizzleAndConvertUbyteToUbyte)
+{
+   check_swizzle_and_convert(MESA_ARRAY_FORMAT_TYPE_UBYTE, true);
+
+   if (set_simd(false))
+      check_swizzle_and_convert(MESA_ARRAY_FORMAT_TYPE_UBYTE, false);
+}
+
+TEST_F(MesaFormatUtilsTest, SwizzleAndConvertUbyteToFloat)
+{
+   check_swizzle_and_convert(MESA_ARRAY_FORMAT_TYPE_FLOAT, true);
+
+   if (set_simd(false))
+      check_swizzle_and_convert(MESA_ARRAY_FORMAT_TYPE_FLOAT, false);
+}
+
+static unsigned
+format_bytes(uint32_t format)
+{
+   if (_mesa_format_is_mesa_array_format(format)) {
+      return _mesa_array_format_get_num_channels(format) *
+             _mesa_array_format_datatype_get_size(
+                _mesa_array_format_get_datatype(format));
+   }
+
+   return _mesa_get_format_bytes((mesa_format)format);
+}
+
+static std::vector<GLubyte>
+format_convert(uint32_t dst_format, uint32_t src_format,
+               std::vector<GLubyte> &src, unsigned width, unsigned height)
+{
+   const unsigned dst_stride = width * format_bytes(dst_format);
+   std::vector<GLubyte> dst((size_t)dst_stride * height);
+
+   _mesa_format_convert(dst.data(), dst_format, dst_stride,
+                        src.data(), src_format,
+                        width * format_bytes(src_format),
+                        width, height, NULL);
+   return dst;
+}
+
+/* With SSE4.1, conversions between 8-bit mesa formats go through
+ * _mesa_swizzle_and_convert instead of the direct pack, unpack and memcpy
+ * paths, which must give the same results.
+ */
+TEST_F(MesaFormatUtilsTest, FormatConvertMatchesDirectPaths)
+{
+   static const uint32_t src_formats[] = {
+      MESA_FORMAT_R8G8B8A8_UNORM,
+      MESA_FORMAT_B8G8R8A8_UNORM,
+      MESA_FORMAT_A8B8G8R8_UNORM,
+      MESA_FORMAT_A8R8G8B8_UNORM,
+      MESA_FORMAT_R8G8B8X8_UNORM,
+      MESA_FORMAT_B8G8R8X8_UNORM,
+      MESA_FORMAT_RGB_UNORM8,
+      MESA_FORMAT_R8G8_UNORM,
+      MESA_FORMAT_R_UNORM8,
+      MESA_FORMAT_L_UNORM8,
+   };
+   static const uint32_t dst_formats[] = {
+      MESA_FORMAT_R8G8B8A8_UNORM,
+      MESA_FORMAT_B8G8R8A8_UNORM,
+      MESA_FORMAT_A8B8G8R8_UNORM,
+      MESA_FORMAT_A8R8G8B8_UNORM,
+      MESA_ARRAY_FORMAT(1, 0, 0, 1, 4, 0, 1, 2, 3), /* RGBA8 */
+      MESA_ARRAY_FORMAT(1, 0, 0, 1, 4, 2, 1, 0, 3), /* BGRA8 */
+      MESA_ARRAY_FORMAT(4, 1, 1, 1, 4, 0, 1, 2, 3), /* RGBA32F */
+   };
+   const unsigned width = 37, height = 3;
+
+   if (!set_simd(false))
+      return;
+
+   for (unsigned s = 0; s < ARRAY_SIZE(src_formats); s++) {
+      std::vector<GLubyte> src((size_t)width * height *
+                               format_bytes(src_formats[s]));
+
+      for (size_t i = 0; i < src.size(); i++)
+         src[i] = rand();
+
+      for (unsigned d = 0; d < ARRAY_SIZE(dst_formats); d++) {
+         set_simd(false);
+         std::vector<GLubyte> expected =
+            format_convert(dst_formats[d], src_formats[s], src, width, height);
+
+         set_simd(true);
+         std::vector<GLubyte> dst =
+            format_convert(dst_formats[d], src_formats[s], src, width, height);
+
+         EXPECT_TRUE(dst == expected) << "source " << s
+                                      << " destination " << d;
+      }
+   }
+}
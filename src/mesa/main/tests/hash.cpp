@@ -0,0 +1,131 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \name hash.cpp
+ *
+ * Check that the GL object name table gives the same results for keys in
+ * its direct-indexed array and for keys only in the hash table.
+ */
+
+#include <gtest/gtest.h>
+
+#include "main/hash.h"
+
+static void *
+value(GLuint key)
+{
+   return (void *)(uintptr_t)(key * 2 + 1);
+}
+
+static void
+count_entry(GLuint key, void *data, void *userData)
+{
+   EXPECT_EQ(value(key), data);
+   (*(unsigned *)userData)++;
+}
+
+static const GLuint keys[] = {
+   DELETED_KEY_VALUE, 2, 255, 256, 1000, 65535, 65536, 1000000, 0xfffffffe,
+};
+
+TEST(MesaHashTest, InsertLookupRemove)
+{
+   struct _mesa_HashTable *table = _mesa_NewHashTable();
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+      EXPECT_EQ(NULL, _mesa_HashLookup(table, keys[i]));
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++) {
+      _mesa_HashInsert(table, keys[i], value(keys[i]));
+
+      /* The entries inserted before may have been moved to a bigger array. */
+      for (unsigned j = 0; j < ARRAY_SIZE(keys); j++) {
+         EXPECT_EQ(j <= i ? value(keys[j]) : NULL,
+                   _mesa_HashLookup(table, keys[j]));
+      }
+   }
+   EXPECT_EQ(ARRAY_SIZE(keys), _mesa_HashNumEntries(table));
+
+   /* Replacing an entry. */
+   _mesa_HashInsert(table, 1000, NULL);
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 1000));
+   _mesa_HashInsert(table, 1000, value(1000));
+
+   unsigned count = 0;
+   _mesa_HashWalk(table, count_entry, &count);
+   EXPECT_EQ(ARRAY_SIZE(keys), count);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++) {
+      _mesa_HashRemove(table, keys[i]);
+      EXPECT_EQ(NULL, _mesa_HashLookup(table, keys[i]));
+      EXPECT_EQ(NULL, _mesa_HashLookupLocked(table, keys[i]));
+   }
+   EXPECT_EQ(0u, _mesa_HashNumEntries(table));
+
+   _mesa_DeleteHashTable(table);
+}
+
+TEST(MesaHashTest, DeleteAll)
+{
+   struct _mesa_HashTable *table = _mesa_NewHashTable();
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+      _mesa_HashInsert(table, keys[i], value(keys[i]));
+
+   unsigned count = 0;
+   _mesa_HashDeleteAll(table, count_entry, &count);
+   EXPECT_EQ(ARRAY_SIZE(keys), count);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+      EXPECT_EQ(NULL, _mesa_HashLookup(table, keys[i]));
+
+   _mesa_DeleteHashTable(table);
+}
+
+TEST(MesaHashTest, FindFreeKeyBlock)
+{
+   struct _mesa_HashTable *table = _mesa_NewHashTable();
+
+   EXPECT_EQ(1u, _mesa_HashFindFreeKeyBlock(table, 10));
+
+   for (GLuint key = 1; key <= 300; key++)
+      _mesa_HashInsert(table, key, value(key));
+   EXPECT_EQ(301u, _mesa_HashFindFreeKeyBlock(table, 10));
+
+   /* Force the slow search, which has to find the hole left by the removed
+    * keys.
+    */
+   for (GLuint key = 100; key < 110; key++)
+      _mesa_HashRemove(table, key);
+   _mesa_HashInsert(table, 0xfffffffe, value(0xfffffffe));
+   EXPECT_EQ(100u, _mesa_HashFindFreeKeyBlock(table, 10));
+
+   for (GLuint key = 1; key <= 300; key++) {
+      if (key < 100 || key >= 110)
+         _mesa_HashRemove(table, key);
+   }
+   _mesa_HashRemove(table, 0xfffffffe);
+
+   _mesa_DeleteHashTable(table);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \name mipmap.cpp
+ *
+ * Check that 8-bit RGBA mipmap levels, which are filtered a word at a time
+ * and split into bands of rows when large, match a plain 2x2 box filter.
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "main/glheader.h"
+#include "main/mipmap.h"
+
+static void
+check_rgba8_level(GLint width, GLint height)
+{
+   const GLint dst_width = width / 2, dst_height = height / 2;
+   std::vector<GLubyte> src((size_t)width * height * 4);
+   std::vector<GLubyte> dst((size_t)dst_width * dst_height * 4);
+   const GLubyte *src_ptr = src.data();
+   GLubyte *dst_ptr = dst.data();
+
+   srand(width * height);
+   for (size_t i = 0; i < src.size(); i++)
+      src[i] = rand();
+
+   _mesa_generate_mipmap_level(GL_TEXTURE_2D, GL_UNSIGNED_BYTE, 4, 0,
+                               width, height, 1, &src_ptr, width * 4,
+                               dst_width, dst_height, 1, &dst_ptr,
+                               dst_width * 4);
+
+   for (GLint y = 0; y < dst_height; y++) {
+      const GLubyte *a = src_ptr + 2 * y * width * 4;
+      const GLubyte *b = a + width * 4;
+
+      for (GLint x = 0; x < dst_width; x++) {
+         for (GLint c = 0; c < 4; c++) {
+            const GLint i = 2 * x * 4 + c;
+
+            ASSERT_EQ((a[i] + a[i + 4] + b[i] + b[i + 4]) / 4,
+                      dst[(y * dst_width + x) * 4 + c])
+               << width << "x" << height << " texel " << x << "," << y
+               << " channel " << c;
+         }
+      }
+   }
+}
+
+TEST(MesaMipmapTest, RGBA8MatchesBoxFilter)
+{
+   check_rgba8_level(2, 2);
+   check_rgba8_level(6, 4);
+   check_rgba8_level(64, 64);
+   check_rgba8_level(256, 2);
+}
+
+/* Large enough for the level to be split into bands of rows. */
+TEST(MesaMipmapTest, RGBA8LargeLevelMatchesBoxFilter)
+{
+   check_rgba8_level(1024, 1024);
+   check_rgba8_level(2048, 514);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Measures the time _mesa_generate_mipmap_level takes to build the whole
+ * mipmap chain of square 2D images, for a few sizes and formats.  The
+ * results are checked by main-test.
+ *
+ * Usage: mesa_mipmap_bench [max_size] [iterations]
+ */
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "main/glheader.h"
+#include "main/macros.h"
+#include "main/mipmap.h"
+#include "util/os_time.h"
+
+static const struct {
+   const char *name;
+   GLenum datatype;
+   GLuint comps;
+   GLuint bpt;
+} formats[] = {
+   { "RGBA8", GL_UNSIGNED_BYTE, 4, 4 },
+   { "RGB8", GL_UNSIGNED_BYTE, 3, 3 },
+   { "R8", GL_UNSIGNED_BYTE, 1, 1 },
+   { "RGBA16F", GL_HALF_FLOAT_ARB, 4, 8 },
+   { "RGBA32F", GL_FLOAT, 4, 16 },
+};
+
+int
+main(int argc, char **argv)
+{
+   GLint max_size = argc > 1 ? atoi(argv[1]) : 8192;
+   unsigned iterations = argc > 2 ? atoi(argv[2]) : 3;
+
+   for (GLint size = 1024; size <= max_size; size *= 2) {
+      for (unsigned f = 0; f < ARRAY_SIZE(formats); f++) {
+         const GLuint bpt = formats[f].bpt;
+         GLubyte *levels[16];
+         GLint num_levels = 0;
+
+         for (GLint s = size; s > 0; s /= 2) {
+            levels[num_levels] = malloc((size_t)s * s * bpt);
+            assert(levels[num_levels]);
+            num_levels++;
+         }
+
+         /* Random texels, but no NaNs or infinities for the float formats. */
+         for (size_t i = 0; i < (size_t)size * size * bpt; i++)
+            levels[0][i] = formats[f].datatype == GL_UNSIGNED_BYTE ?
+                           rand() : (i % 2 ? 0x3c : rand() & 0x3f);
+
+         int64_t start = os_time_get_nano();
+         for (unsigned it = 0; it < iterations; it++) {
+            for (GLint l = 1, s = size / 2; l < num_levels; l++, s /= 2) {
+               const GLubyte *src = levels[l - 1];
+               GLubyte *dst = levels[l];
+
+               _mesa_generate_mipmap_level(GL_TEXTURE_2D,
+                                           formats[f].datatype,
+                                           formats[f].comps, 0,
+                                           s * 2, s * 2, 1, &src,
+                                           s * 2 * bpt,
+                                           s, s, 1, &dst, s * bpt);
+            }
+         }
+         int64_t ns = os_time_get_nano() - start;
+
+         printf("%5dx%-5d %-8s %9.2f ms\n", size, size, formats[f].name,
+                ns / 1000000.0 / iterations);
+
+         for (GLint l = 0; l < num_levels; l++)
+            free(levels[l]);
+      }
+   }
+
+   return 0;
+}
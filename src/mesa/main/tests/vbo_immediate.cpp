@@ -0,0 +1,387 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \name vbo_immediate.cpp
+ *
+ * Check the vertices that glBegin/glEnd immediate mode hands to the driver.
+ * The position is stored last in each vertex, so these cover the vertex
+ * layout, attributes that are added or grow inside a primitive, and the
+ * vertices that are copied when the vertex buffer is flushed or wrapped
+ * part way through a primitive.
+ */
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <vector>
+
+#include "GL/gl.h"
+#include "GL/glext.h"
+#include "main/compiler.h"
+#include "main/api_exec.h"
+#include "main/context.h"
+#include "main/framebuffer.h"
+#include "main/mtypes.h"
+#include "main/varray.h"
+#include "main/vtxfmt.h"
+#include "glapi/glapi.h"
+#include "drivers/common/driverfuncs.h"
+
+#include "vbo/vbo.h"
+
+#ifndef GLAPIENTRYP
+#define GLAPIENTRYP GL_APIENTRYP
+#endif
+
+#include "main/dispatch.h"
+
+struct captured_vertex {
+   GLfloat pos[4];
+   GLfloat color[4];
+   GLfloat tex[4];
+};
+
+struct captured_draw {
+   GLenum mode;
+   std::vector<captured_vertex> vertices;
+   /* Offset of the position in the vertex, and the vertex size, in bytes. */
+   GLuint pos_offset;
+   GLuint stride;
+};
+
+static std::vector<captured_draw> draws;
+
+/* Reads a float attribute the way a driver would, filling in the missing
+ * components from (0, 0, 0, 1).
+ */
+static void
+read_attrib(const struct gl_context *ctx, gl_vert_attrib attr, GLuint index,
+            GLfloat dst[4])
+{
+   const struct gl_vertex_array *array = &ctx->Array._DrawArrays[attr];
+   const struct gl_array_attributes *attrib = array->VertexAttrib;
+   const struct gl_vertex_buffer_binding *binding = array->BufferBinding;
+   const GLubyte *ptr = _mesa_vertex_attrib_address(attrib, binding);
+   const GLfloat *src;
+
+   if (_mesa_is_bufferobj(binding->BufferObj))
+      ptr = ADD_POINTERS(binding->BufferObj->Data, ptr);
+
+   ASSERT_EQ((GLenum) GL_FLOAT, (GLenum) attrib->Type);
+   src = (const GLfloat *) (ptr + index * binding->Stride);
+
+   dst[0] = 0.0f;
+   dst[1] = 0.0f;
+   dst[2] = 0.0f;
+   dst[3] = 1.0f;
+   for (int c = 0; c < attrib->Size; c++)
+      dst[c] = src[c];
+}
+
+static void
+capture_draw(struct gl_context *ctx, const struct _mesa_prim *prims,
+             GLuint nr_prims, const struct _mesa_index_buffer *ib,
+             GLboolean index_bounds_valid, GLuint min_index,
+             GLuint max_index,
+             struct gl_transform_feedback_object *tfb_vertcount,
+             unsigned tfb_stream, struct gl_buffer_object *indirect)
+{
+   const struct gl_vertex_array *pos = &ctx->Array._DrawArrays[VERT_ATTRIB_POS];
+
+   ASSERT_EQ(NULL, ib);
+
+   for (GLuint p = 0; p < nr_prims; p++) {
+      captured_draw draw;
+
+      draw.mode = prims[p].mode;
+      draw.pos_offset = pos->VertexAttrib->RelativeOffset;
+      draw.stride = pos->BufferBinding->Stride;
+
+      for (GLuint i = 0; i < prims[p].count; i++) {
+         const GLuint index = prims[p].start + i;
+         captured_vertex v;
+
+         read_attrib(ctx, VERT_ATTRIB_POS, index, v.pos);
+         read_attrib(ctx, VERT_ATTRIB_COLOR0, index, v.color);
+         read_attrib(ctx, VERT_ATTRIB_TEX0, index, v.tex);
+         draw.vertices.push_back(v);
+      }
+
+      draws.push_back(draw);
+   }
+}
+
+static void
+update_state(struct gl_context *ctx)
+{
+}
+
+class VboImmediateTest : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   struct gl_config visual;
+   struct dd_function_table driver_functions;
+   struct gl_context ctx;
+   struct gl_framebuffer *fb;
+   struct _glapi_table *disp;
+};
+
+void
+VboImmediateTest::SetUp()
+{
+   memset(&visual, 0, sizeof(visual));
+   memset(&driver_functions, 0, sizeof(driver_functions));
+   memset(&ctx, 0, sizeof(ctx));
+
+   _mesa_init_driver_functions(&driver_functions);
+   driver_functions.UpdateState = update_state;
+
+   _mesa_initialize_context(&ctx, API_OPENGL_COMPAT, &visual, NULL,
+                            &driver_functions);
+   _vbo_CreateContext(&ctx);
+
+   _mesa_override_extensions(&ctx);
+   ctx.Version = 21;
+
+   _mesa_initialize_dispatch_tables(&ctx);
+   _mesa_initialize_vbo_vtxfmt(&ctx);
+   vbo_set_draw_func(&ctx, capture_draw);
+
+   fb = _mesa_create_framebuffer(&visual);
+   _mesa_make_current(&ctx, fb, fb);
+   disp = ctx.CurrentClientDispatch;
+
+   draws.clear();
+}
+
+void
+VboImmediateTest::TearDown()
+{
+   _mesa_make_current(NULL, NULL, NULL);
+   _mesa_reference_framebuffer(&fb, NULL);
+   _vbo_DestroyContext(&ctx);
+   _mesa_free_context_data(&ctx);
+}
+
+/* Each vertex carries its index in x, so that the vertices a draw ends up
+ * with can be checked against the ones that were submitted.
+ */
+static void
+color(struct _glapi_table *disp, int i)
+{
+   CALL_Color3f(disp, (i * 0.25f, i * 0.5f, i * 0.75f));
+}
+
+static void
+expect_color(const captured_vertex &v, int i)
+{
+   EXPECT_EQ(i * 0.25f, v.color[0]);
+   EXPECT_EQ(i * 0.5f, v.color[1]);
+   EXPECT_EQ(i * 0.75f, v.color[2]);
+   EXPECT_EQ(1.0f, v.color[3]);
+}
+
+static void
+expect_vec4(const GLfloat v[4], GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+   EXPECT_EQ(x, v[0]);
+   EXPECT_EQ(y, v[1]);
+   EXPECT_EQ(z, v[2]);
+   EXPECT_EQ(w, v[3]);
+}
+
+static std::vector<int>
+vertex_ids(const captured_draw &draw)
+{
+   std::vector<int> ids;
+
+   for (size_t i = 0; i < draw.vertices.size(); i++)
+      ids.push_back((int) draw.vertices[i].pos[0]);
+   return ids;
+}
+
+TEST_F(VboImmediateTest, PositionIsLastInTheVertex)
+{
+   CALL_Begin(disp, (GL_TRIANGLES));
+   for (int i = 0; i < 3; i++) {
+      color(disp, i);
+      CALL_TexCoord2f(disp, (i + 0.5f, -i - 0.5f));
+      CALL_Vertex3f(disp, (i, -i, 2.0f * i));
+   }
+   CALL_End(disp, ());
+   CALL_Flush(disp, ());
+
+   ASSERT_EQ(1u, draws.size());
+   EXPECT_EQ((GLenum) GL_TRIANGLES, draws[0].mode);
+   EXPECT_EQ(draws[0].stride - 3 * sizeof(GLfloat), draws[0].pos_offset);
+   ASSERT_EQ(3u, draws[0].vertices.size());
+
+   for (int i = 0; i < 3; i++) {
+      const captured_vertex &v = draws[0].vertices[i];
+
+      expect_vec4(v.pos, i, -i, 2.0f * i, 1.0f);
+      expect_color(v, i);
+      expect_vec4(v.tex, i + 0.5f, -i - 0.5f, 0.0f, 1.0f);
+   }
+}
+
+/* A smaller glVertex after a larger one fills the missing components from
+ * (0, 0, 0, 1) instead of keeping the previous vertex's values.
+ */
+TEST_F(VboImmediateTest, ShortPositionAfterLongerOne)
+{
+   CALL_Begin(disp, (GL_POINTS));
+   CALL_Vertex4f(disp, (0.0f, 1.0f, 2.0f, 3.0f));
+   CALL_Vertex2f(disp, (1.0f, 4.0f));
+   CALL_Vertex3f(disp, (2.0f, 5.0f, 6.0f));
+   CALL_End(disp, ());
+   CALL_Flush(disp, ());
+
+   ASSERT_EQ(1u, draws.size());
+   EXPECT_EQ(draws[0].stride - 4 * sizeof(GLfloat), draws[0].pos_offset);
+   ASSERT_EQ(3u, draws[0].vertices.size());
+   expect_vec4(draws[0].vertices[0].pos, 0.0f, 1.0f, 2.0f, 3.0f);
+   expect_vec4(draws[0].vertices[1].pos, 1.0f, 4.0f, 0.0f, 1.0f);
+   expect_vec4(draws[0].vertices[2].pos, 2.0f, 5.0f, 6.0f, 1.0f);
+}
+
+/* A texcoord first set inside a triangle strip changes the vertex layout.
+ * The vertices drawn so far are flushed, and the last two are replayed into
+ * the new layout with the texcoord that was current when they were
+ * submitted.
+ */
+TEST_F(VboImmediateTest, NewAttributeInsidePrimitive)
+{
+   CALL_Begin(disp, (GL_TRIANGLE_STRIP));
+   for (int i = 0; i < 6; i++) {
+      color(disp, i);
+      CALL_Vertex3f(disp, (i, -i, 1.0f));
+   }
+   for (int i = 6; i < 10; i++) {
+      color(disp, i);
+      CALL_TexCoord2f(disp, (i + 0.5f, -i - 0.5f));
+      CALL_Vertex3f(disp, (i, -i, 1.0f));
+   }
+   CALL_End(disp, ());
+   CALL_Flush(disp, ());
+
+   ASSERT_EQ(2u, draws.size());
+   EXPECT_EQ(std::vector<int>({ 0, 1, 2, 3, 4, 5 }), vertex_ids(draws[0]));
+   EXPECT_EQ(std::vector<int>({ 4, 5, 6, 7, 8, 9 }), vertex_ids(draws[1]));
+   EXPECT_EQ(draws[1].stride - 3 * sizeof(GLfloat), draws[1].pos_offset);
+
+   for (size_t d = 0; d < draws.size(); d++) {
+      EXPECT_EQ((GLenum) GL_TRIANGLE_STRIP, draws[d].mode);
+
+      for (size_t i = 0; i < draws[d].vertices.size(); i++) {
+         const captured_vertex &v = draws[d].vertices[i];
+         const int id = (int) v.pos[0];
+
+         expect_vec4(v.pos, id, -id, 1.0f, 1.0f);
+         expect_color(v, id);
+         if (id < 6)
+            expect_vec4(v.tex, 0.0f, 0.0f, 0.0f, 1.0f);
+         else
+            expect_vec4(v.tex, id + 0.5f, -id - 0.5f, 0.0f, 1.0f);
+      }
+   }
+}
+
+/* The position growing inside a primitive moves it within the vertex.  The
+ * replayed vertices keep their coordinates and get z = 0, w = 1.
+ */
+TEST_F(VboImmediateTest, PositionGrowsInsidePrimitive)
+{
+   CALL_Begin(disp, (GL_TRIANGLE_STRIP));
+   for (int i = 0; i < 5; i++) {
+      color(disp, i);
+      CALL_Vertex2f(disp, (i, -i));
+   }
+   for (int i = 5; i < 8; i++) {
+      color(disp, i);
+      CALL_Vertex4f(disp, (i, -i, 2.0f * i, 0.5f));
+   }
+   CALL_End(disp, ());
+   CALL_Flush(disp, ());
+
+   ASSERT_EQ(2u, draws.size());
+   /* The strip had an odd number of vertices when it was flushed, so the
+    * last one is held back for the next draw.
+    */
+   EXPECT_EQ(std::vector<int>({ 0, 1, 2, 3 }), vertex_ids(draws[0]));
+   EXPECT_EQ(std::vector<int>({ 2, 3, 4, 5, 6, 7 }), vertex_ids(draws[1]));
+   EXPECT_EQ(draws[0].stride - 2 * sizeof(GLfloat), draws[0].pos_offset);
+   EXPECT_EQ(draws[1].stride - 4 * sizeof(GLfloat), draws[1].pos_offset);
+
+   for (size_t d = 0; d < draws.size(); d++) {
+      for (size_t i = 0; i < draws[d].vertices.size(); i++) {
+         const captured_vertex &v = draws[d].vertices[i];
+         const int id = (int) v.pos[0];
+
+         if (id < 5)
+            expect_vec4(v.pos, id, -id, 0.0f, 1.0f);
+         else
+            expect_vec4(v.pos, id, -id, 2.0f * id, 0.5f);
+         expect_color(v, id);
+      }
+   }
+}
+
+/* Enough vertices to fill the vertex buffer several times.  Each wrap starts
+ * a new draw that repeats the last two vertices drawn so far, plus the one
+ * held back to keep an even number of triangles.
+ */
+TEST_F(VboImmediateTest, WrapInsidePrimitive)
+{
+   const int count = 20001;
+
+   CALL_Begin(disp, (GL_TRIANGLE_STRIP));
+   for (int i = 0; i < count; i++) {
+      color(disp, i & 0xff);
+      CALL_Vertex3f(disp, (i, -i, 1.0f));
+   }
+   CALL_End(disp, ());
+   CALL_Flush(disp, ());
+
+   ASSERT_LT(1u, draws.size());
+
+   int last = -1;
+   for (size_t d = 0; d < draws.size(); d++) {
+      const std::vector<int> ids = vertex_ids(draws[d]);
+
+      ASSERT_LE(3u, ids.size());
+      EXPECT_EQ(d == 0 ? 0 : last - 1, ids[0]);
+
+      for (size_t i = 0; i < ids.size(); i++) {
+         const captured_vertex &v = draws[d].vertices[i];
+
+         EXPECT_EQ(ids[0] + (int) i, ids[i]);
+         expect_vec4(v.pos, ids[i], -ids[i], 1.0f, 1.0f);
+         expect_color(v, ids[i] & 0xff);
+      }
+      last = ids.back();
+   }
+   EXPECT_EQ(count - 1, last);
+}
@@ -1038,6 +1038,10 @@ _mesa_uniform(GLint location, GLsizei count, const GLvoid *values,
    unsigned offset;
    int size_mul = glsl_base_type_is_64bit(basicType) ? 2 : 1;
 
+   /* glUniform* get the active program without looking it up. */
+   if (shProg)
+      _mesa_finish_program_link(ctx, shProg);
+
    struct gl_uniform_storage *uni;
    if (_mesa_is_no_error_enabled(ctx)) {
       /* From Seciton 7.6 (UNIFORM VARIABLES) of the OpenGL 4.5 spec:
@@ -1217,6 +1221,10 @@ _mesa_uniform_matrix(GLint location, GLsizei count,
                      GLuint cols, GLuint rows, enum glsl_base_type basicType)
 {
    unsigned offset;
+
+   if (shProg)
+      _mesa_finish_program_link(ctx, shProg);
+
    struct gl_uniform_storage *const uni =
       validate_uniform_parameters(location, count, &offset,
                                   ctx, shProg, "glUniformMatrix");
@@ -1390,6 +1398,9 @@ _mesa_uniform_handle(GLint location, GLsizei count, const GLvoid *values,
    unsigned offset;
    struct gl_uniform_storage *uni;
 
+   if (shProg)
+      _mesa_finish_program_link(ctx, shProg);
+
    if (_mesa_is_no_error_enabled(ctx)) {
       /* From Section 7.6 (UNIFORM VARIABLES) of the OpenGL 4.5 spec:
        *
@@ -3076,19 +3076,41 @@ _mesa_ir_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 }
 
 /**
- * Link a GLSL shader program.  Called via glLinkProgram().
+ * Reset the results of the previous link of \p prog.  This is the part of
+ * _mesa_glsl_link_shader() that must run with the context current, before
+ * _mesa_glsl_link_shader_ir().
  */
 void
-_mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
+_mesa_glsl_link_shader_begin(struct gl_context *ctx,
+                             struct gl_shader_program *prog)
 {
-   unsigned int i;
-   bool spirv;
-
    _mesa_clear_shader_program_data(ctx, prog);
 
    prog->data = _mesa_create_shader_program_data();
 
    prog->data->LinkStatus = LINKING_SUCCESS;
+}
+
+/**
+ * Run the GLSL linker on \p prog.  This doesn't change the attached shaders,
+ * so it may run on another thread as long as \p prog and its shaders aren't
+ * changed meanwhile, see GL_ARB_parallel_shader_compile.
+ *
+ * The only driver hooks it calls are ctx->Driver.NewProgram, for the linked
+ * stages and for programs read from the shader cache, and
+ * ctx->Driver.DeleteProgram, when a link fails after creating them.  Those
+ * must be thread-safe for programs that haven't been handed to the driver
+ * yet.  In the drivers in the tree, NewProgram only allocates and
+ * initializes the program (i965 takes its ID with an atomic increment),
+ * and DeleteProgram only frees it; i915 and i965 also compare it against
+ * their current programs, which it never is.
+ */
+void
+_mesa_glsl_link_shader_ir(struct gl_context *ctx,
+                          struct gl_shader_program *prog)
+{
+   unsigned int i;
+   bool spirv;
 
    for (i = 0; i < prog->NumShaders; i++) {
       if (!prog->Shaders[i]->CompileStatus) {
@@ -3122,7 +3144,16 @@ _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
    if (prog->data->LinkStatus == LINKING_SUCCESS) {
       prog->SamplersValidated = GL_TRUE;
    }
+}
 
+/**
+ * Hand the output of _mesa_glsl_link_shader_ir() to the driver.  Must run
+ * with the context current.
+ */
+void
+_mesa_glsl_link_shader_end(struct gl_context *ctx,
+                           struct gl_shader_program *prog)
+{
    if (prog->data->LinkStatus && !ctx->Driver.LinkShader(ctx, prog)) {
       prog->data->LinkStatus = LINKING_FAILURE;
    }
@@ -3148,4 +3179,15 @@ _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 #endif
 }
 
+/**
+ * Link a GLSL shader program.  Called via glLinkProgram().
+ */
+void
+_mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
+{
+   _mesa_glsl_link_shader_begin(ctx, prog);
+   _mesa_glsl_link_shader_ir(ctx, prog);
+   _mesa_glsl_link_shader_end(ctx, prog);
+}
+
 } /* extern "C" */
@@ -449,6 +449,18 @@ set_vertex_attribs(struct st_context *st,
                              st->last_num_vbuffers - num_vbuffers, NULL);
    }
    st->last_num_vbuffers = num_vbuffers;
+
+   /* Most draws use the same vertex layout as the previous one, so avoid
+    * hashing the vertex elements in the CSO cache again.  Meta operations
+    * save and restore the vertex elements, so they don't invalidate this.
+    */
+   if (num_velements == st->last_num_velements &&
+       memcmp(velements, st->last_velements,
+              num_velements * sizeof(velements[0])) == 0)
+      return;
+
+   memcpy(st->last_velements, velements, num_velements * sizeof(velements[0]));
+   st->last_num_velements = num_velements;
    cso_set_vertex_elements(cso, num_velements, velements);
 }
 
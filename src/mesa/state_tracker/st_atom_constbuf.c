@@ -48,6 +48,97 @@
 #include "st_program.h"
 #include "st_cb_bufferobjects.h"
 
+/**
+ * Free the constant buffer of a program.
+ */
+void
+st_release_program_constants(struct st_program_constants *consts)
+{
+   pipe_resource_reference(&consts->buffer, NULL);
+   free(consts->shadow);
+   consts->shadow = NULL;
+   consts->st = NULL;
+}
+
+
+/**
+ * Write the parameters into the program's own constant buffer.  Only the
+ * vec4s between the first and the last one that differ from the shadow
+ * copy are uploaded, so changing a few uniforms between draws doesn't
+ * move the whole parameter list.
+ *
+ * \return false if the buffer can't be used and the parameters must be
+ *         passed as a user buffer.
+ */
+static bool
+update_program_constants(struct st_context *st,
+                         struct st_program_constants *consts,
+                         const void *data, unsigned size)
+{
+   struct pipe_context *pipe = st->pipe;
+   const unsigned vec4_size = 4 * sizeof(GLfloat);
+   const uint8_t *src = data;
+   uint8_t *shadow;
+
+   /* Programs can be shared between contexts, but the buffer is only
+    * written by the context that created it.
+    */
+   if (consts->st && consts->st != st)
+      return false;
+
+   if (!consts->buffer || consts->buffer->width0 < size) {
+      st_release_program_constants(consts);
+
+      consts->shadow = malloc(size);
+      if (!consts->shadow)
+         return false;
+
+      consts->buffer = pipe_buffer_create_const0(pipe->screen,
+                                                 PIPE_BIND_CONSTANT_BUFFER,
+                                                 PIPE_USAGE_DEFAULT, size);
+      if (!consts->buffer) {
+         st_release_program_constants(consts);
+         return false;
+      }
+
+      consts->st = st;
+      memcpy(consts->shadow, data, size);
+      pipe->buffer_subdata(pipe, consts->buffer,
+                           PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE,
+                           0, size, data);
+      return true;
+   }
+
+   /* Find the range of vec4s that changed. */
+   shadow = consts->shadow;
+   unsigned first = 0, last = size / vec4_size;
+
+   while (first < last &&
+          !memcmp(src + first * vec4_size, shadow + first * vec4_size,
+                  vec4_size))
+      first++;
+
+   if (first == last)
+      return true;
+
+   while (last - 1 > first &&
+          !memcmp(src + (last - 1) * vec4_size,
+                  shadow + (last - 1) * vec4_size, vec4_size))
+      last--;
+
+   unsigned offset = first * vec4_size;
+   unsigned length = (last - first) * vec4_size;
+
+   memcpy(shadow + offset, src + offset, length);
+   pipe->buffer_subdata(pipe, consts->buffer,
+                        length == consts->buffer->width0 ?
+                           PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE :
+                           PIPE_TRANSFER_DISCARD_RANGE,
+                        offset, length, src + offset);
+   return true;
+}
+
+
 /**
  * Pass the given program parameters to the graphics pipe as a
  * constant buffer.
@@ -101,8 +192,15 @@ void st_upload_constants(struct st_context *st, struct gl_program *prog)
 
       _mesa_shader_write_subroutine_indices(st->ctx, stage);
 
-      cb.buffer = NULL;
-      cb.user_buffer = params->ParameterValues;
+      if (st->prefer_real_buffer_in_constbuf0 &&
+          update_program_constants(st, st_program_constants(prog),
+                                   params->ParameterValues, paramBytes)) {
+         cb.buffer = st_program_constants(prog)->buffer;
+         cb.user_buffer = NULL;
+      } else {
+         cb.buffer = NULL;
+         cb.user_buffer = params->ParameterValues;
+      }
       cb.buffer_offset = 0;
       cb.buffer_size = paramBytes;
 
@@ -114,7 +212,6 @@ void st_upload_constants(struct st_context *st, struct gl_program *prog)
       }
 
       cso_set_constant_buffer(st->cso_context, shader_type, 0, &cb);
-      pipe_resource_reference(&cb.buffer, NULL);
 
       st->state.constants[shader_type].ptr = params->ParameterValues;
       st->state.constants[shader_type].size = paramBytes;
@@ -33,9 +33,12 @@
 
 struct gl_program_parameter_list;
 struct st_context;
+struct st_program_constants;
 
 
 void st_upload_constants(struct st_context *st, struct gl_program *prog);
 
+void st_release_program_constants(struct st_program_constants *consts);
+
 
 #endif /* ST_ATOM_CONSTBUF_H */
@@ -97,12 +97,18 @@ st_update_single_texture(struct st_context *st,
 
 
 
+/**
+ * Update the sampler views of a shader stage.  The views are kept referenced
+ * in st->state.sampler_views, so the CSO context only needs to be told about
+ * them when one of them or their number actually changed.
+ */
 static void
 update_textures(struct st_context *st,
                 enum pipe_shader_type shader_stage,
-                const struct gl_program *prog,
-                struct pipe_sampler_view **sampler_views)
+                const struct gl_program *prog)
 {
+   struct pipe_sampler_view **sampler_views =
+      st->state.sampler_views[shader_stage];
    const GLuint old_max = st->state.num_sampler_views[shader_stage];
    GLbitfield samplers_used = prog->SamplersUsed;
    GLbitfield texel_fetch_samplers = prog->info.textures_used_by_txf;
@@ -114,6 +120,7 @@ update_textures(struct st_context *st,
       return;
 
    unsigned num_textures = 0;
+   bool changed = false;
 
    /* prog->sh.data is NULL if it's ARB_fragment_program */
    bool glsl130 = (prog->sh.data ? prog->sh.data->Version : 0) >= 130;
@@ -158,7 +165,10 @@ update_textures(struct st_context *st,
          num_textures = unit + 1;
       }
 
-      pipe_sampler_view_reference(&(sampler_views[unit]), sampler_view);
+      if (sampler_views[unit] != sampler_view) {
+         pipe_sampler_view_reference(&(sampler_views[unit]), sampler_view);
+         changed = true;
+      }
    }
 
    /* For any external samplers with multiplaner YUV, stuff the additional
@@ -188,6 +198,7 @@ update_textures(struct st_context *st,
          tmpl.format = PIPE_FORMAT_RG88_UNORM;
          tmpl.swizzle_g = PIPE_SWIZZLE_Y;   /* tmpl from Y plane is R8 */
          extra = u_bit_scan(&free_slots);
+         pipe_sampler_view_reference(&sampler_views[extra], NULL);
          sampler_views[extra] =
                st->pipe->create_sampler_view(st->pipe, stObj->pt->next, &tmpl);
          break;
@@ -195,9 +206,11 @@ update_textures(struct st_context *st,
          /* we need two additional R8 views: */
          tmpl.format = PIPE_FORMAT_R8_UNORM;
          extra = u_bit_scan(&free_slots);
+         pipe_sampler_view_reference(&sampler_views[extra], NULL);
          sampler_views[extra] =
                st->pipe->create_sampler_view(st->pipe, stObj->pt->next, &tmpl);
          extra = u_bit_scan(&free_slots);
+         pipe_sampler_view_reference(&sampler_views[extra], NULL);
          sampler_views[extra] =
                st->pipe->create_sampler_view(st->pipe, stObj->pt->next->next, &tmpl);
          break;
@@ -206,8 +219,16 @@ update_textures(struct st_context *st,
       }
 
       num_textures = MAX2(num_textures, extra + 1);
+      /* The extra plane views are new objects every time, so programs
+       * with multi-planar external samplers still rebind all their
+       * sampler views on every validation.
+       */
+      changed = true;
    }
 
+   if (!changed && num_textures == old_max)
+      return;
+
    cso_set_sampler_views(st->cso_context,
                          shader_stage,
                          num_textures,
@@ -215,29 +236,14 @@ update_textures(struct st_context *st,
    st->state.num_sampler_views[shader_stage] = num_textures;
 }
 
-/* Same as update_textures, but don't store the views in st_context. */
-static void
-update_textures_local(struct st_context *st,
-                      enum pipe_shader_type shader_stage,
-                      const struct gl_program *prog)
-{
-   struct pipe_sampler_view *local_views[PIPE_MAX_SAMPLERS] = {0};
-
-   update_textures(st, shader_stage, prog, local_views);
-
-   unsigned num = st->state.num_sampler_views[shader_stage];
-   for (unsigned i = 0; i < num; i++)
-      pipe_sampler_view_reference(&local_views[i], NULL);
-}
-
 void
 st_update_vertex_textures(struct st_context *st)
 {
    const struct gl_context *ctx = st->ctx;
 
    if (ctx->Const.Program[MESA_SHADER_VERTEX].MaxTextureImageUnits > 0) {
-      update_textures_local(st, PIPE_SHADER_VERTEX,
-                            ctx->VertexProgram._Current);
+      update_textures(st, PIPE_SHADER_VERTEX,
+                      ctx->VertexProgram._Current);
    }
 }
 
@@ -249,8 +255,7 @@ st_update_fragment_textures(struct st_context *st)
 
    update_textures(st,
                    PIPE_SHADER_FRAGMENT,
-                   ctx->FragmentProgram._Current,
-                   st->state.frag_sampler_views);
+                   ctx->FragmentProgram._Current);
 }
 
 
@@ -260,8 +265,8 @@ st_update_geometry_textures(struct st_context *st)
    const struct gl_context *ctx = st->ctx;
 
    if (ctx->GeometryProgram._Current) {
-      update_textures_local(st, PIPE_SHADER_GEOMETRY,
-                            ctx->GeometryProgram._Current);
+      update_textures(st, PIPE_SHADER_GEOMETRY,
+                      ctx->GeometryProgram._Current);
    }
 }
 
@@ -272,8 +277,8 @@ st_update_tessctrl_textures(struct st_context *st)
    const struct gl_context *ctx = st->ctx;
 
    if (ctx->TessCtrlProgram._Current) {
-      update_textures_local(st, PIPE_SHADER_TESS_CTRL,
-                            ctx->TessCtrlProgram._Current);
+      update_textures(st, PIPE_SHADER_TESS_CTRL,
+                      ctx->TessCtrlProgram._Current);
    }
 }
 
@@ -284,8 +289,8 @@ st_update_tesseval_textures(struct st_context *st)
    const struct gl_context *ctx = st->ctx;
 
    if (ctx->TessEvalProgram._Current) {
-      update_textures_local(st, PIPE_SHADER_TESS_EVAL,
-                            ctx->TessEvalProgram._Current);
+      update_textures(st, PIPE_SHADER_TESS_EVAL,
+                      ctx->TessEvalProgram._Current);
    }
 }
 
@@ -296,7 +301,7 @@ st_update_compute_textures(struct st_context *st)
    const struct gl_context *ctx = st->ctx;
 
    if (ctx->ComputeProgram._Current) {
-      update_textures_local(st, PIPE_SHADER_COMPUTE,
-                            ctx->ComputeProgram._Current);
+      update_textures(st, PIPE_SHADER_COMPUTE,
+                      ctx->ComputeProgram._Current);
    }
 }
@@ -40,6 +40,7 @@
 #include "cso_cache/cso_context.h"
 #include "draw/draw_context.h"
 
+#include "st_atom_constbuf.h"
 #include "st_context.h"
 #include "st_debug.h"
 #include "st_program.h"
@@ -95,6 +96,8 @@ st_delete_program(struct gl_context *ctx, struct gl_program *prog)
 {
    struct st_context *st = st_context(ctx);
 
+   st_release_program_constants(st_program_constants(prog));
+
    switch( prog->Target ) {
    case GL_VERTEX_PROGRAM_ARB:
       {
@@ -125,6 +125,7 @@ struct st_context
    boolean has_half_float_packing;
    boolean has_multi_draw_indirect;
    boolean can_bind_const_buffer_as_vertex;
+   boolean prefer_real_buffer_in_constbuf0;
 
    /**
     * If a shader can be created when we get its source.
@@ -153,7 +154,7 @@ struct st_context
       struct pipe_rasterizer_state          rasterizer;
       struct pipe_sampler_state frag_samplers[PIPE_MAX_SAMPLERS];
       GLuint num_frag_samplers;
-      struct pipe_sampler_view *frag_sampler_views[PIPE_MAX_SAMPLERS];
+      struct pipe_sampler_view *sampler_views[PIPE_SHADER_TYPES][PIPE_MAX_SAMPLERS];
       GLuint num_sampler_views[PIPE_SHADER_TYPES];
       struct pipe_clip_state clip;
       struct {
@@ -278,6 +279,13 @@ struct st_context
    /* The number of vertex buffers from the last call of validate_arrays. */
    unsigned last_num_vbuffers;
 
+   /* The vertex elements from the last call of validate_arrays, so that
+    * identical ones aren't looked up in the CSO cache again.  The count is
+    * ~0 if none were set yet.
+    */
+   unsigned last_num_velements;
+   struct pipe_vertex_element last_velements[PIPE_MAX_ATTRIBS];
+
    int32_t draw_stamp;
    int32_t read_stamp;
 
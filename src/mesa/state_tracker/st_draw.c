@@ -70,13 +70,13 @@
  * Set the restart index.
  */
 static void
-setup_primitive_restart(struct gl_context *ctx, struct pipe_draw_info *info)
+setup_primitive_restart(const struct _mesa_index_buffer *ib,
+                        struct pipe_draw_info *info)
 {
-   if (ctx->Array._PrimitiveRestart) {
+   if (ib->primitive_restart) {
       unsigned index_size = info->index_size;
 
-      info->restart_index =
-         _mesa_primitive_restart_index(ctx, index_size);
+      info->restart_index = ib->restart_index;
 
       /* Enable primitive restart only when the restart index can have an
        * effect. This is required for correctness in radeonsi VI support.
@@ -180,7 +180,7 @@ st_draw_vbo(struct gl_context *ctx,
          info.index.user = ib->ptr;
       }
 
-      setup_primitive_restart(ctx, &info);
+      setup_primitive_restart(ib, &info);
    }
    else {
       info.index_size = 0;
@@ -264,7 +264,7 @@ st_indirect_draw_vbo(struct gl_context *ctx,
       info.start = pointer_to_offset(ib->ptr) / info.index_size;
 
       /* Primitive restart is not handled by the VBO module in this case. */
-      setup_primitive_restart(ctx, &info);
+      setup_primitive_restart(ib, &info);
    }
 
    info.mode = translate_prim(ctx, mode);
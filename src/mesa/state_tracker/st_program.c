@@ -50,6 +50,7 @@
 #include "tgsi/tgsi_ureg.h"
 
 #include "st_debug.h"
+#include "st_atom_constbuf.h"
 #include "st_cb_bitmap.h"
 #include "st_cb_drawpixels.h"
 #include "st_context.h"
@@ -552,6 +553,10 @@ st_create_vp_variant(struct st_context *st,
 {
    struct st_vp_variant *vpv = CALLOC_STRUCT(st_vp_variant);
    struct pipe_context *pipe = st->pipe;
+   struct st_vp_variant_key cache_key = *key;
+
+   /* The variant IR is cached per program, not per context. */
+   cache_key.st = NULL;
 
    vpv->key = *key;
    vpv->tgsi.stream_output = stvp->tgsi.stream_output;
@@ -559,16 +564,24 @@ st_create_vp_variant(struct st_context *st,
 
    if (stvp->tgsi.type == PIPE_SHADER_IR_NIR) {
       vpv->tgsi.type = PIPE_SHADER_IR_NIR;
-      vpv->tgsi.ir.nir = nir_shader_clone(NULL, stvp->tgsi.ir.nir);
-      if (key->clamp_color)
-         NIR_PASS_V(vpv->tgsi.ir.nir, nir_lower_clamp_color_outputs);
-      if (key->passthrough_edgeflags) {
-         NIR_PASS_V(vpv->tgsi.ir.nir, nir_lower_passthrough_edgeflags);
+
+      if (key->passthrough_edgeflags)
          vpv->num_inputs++;
-      }
 
-      st_finalize_nir(st, &stvp->Base, stvp->shader_program,
-                      vpv->tgsi.ir.nir);
+      if (!st_load_variant_from_disk_cache(st, &stvp->Base, &cache_key,
+                                           sizeof(cache_key), &vpv->tgsi)) {
+         vpv->tgsi.ir.nir = nir_shader_clone(NULL, stvp->tgsi.ir.nir);
+         if (key->clamp_color)
+            NIR_PASS_V(vpv->tgsi.ir.nir, nir_lower_clamp_color_outputs);
+         if (key->passthrough_edgeflags)
+            NIR_PASS_V(vpv->tgsi.ir.nir, nir_lower_passthrough_edgeflags);
+
+         st_finalize_nir(st, &stvp->Base, stvp->shader_program,
+                         vpv->tgsi.ir.nir);
+
+         st_store_variant_in_disk_cache(st, &stvp->Base, &cache_key,
+                                        sizeof(cache_key), &vpv->tgsi);
+      }
 
       vpv->driver_shader = pipe->create_vs_state(pipe, &vpv->tgsi);
       /* driver takes ownership of IR: */
@@ -576,27 +589,36 @@ st_create_vp_variant(struct st_context *st,
       return vpv;
    }
 
-   vpv->tgsi.tokens = tgsi_dup_tokens(stvp->tgsi.tokens);
-
    /* Emulate features. */
    if (key->clamp_color || key->passthrough_edgeflags) {
-      const struct tgsi_token *tokens;
-      unsigned flags =
-         (key->clamp_color ? TGSI_EMU_CLAMP_COLOR_OUTPUTS : 0) |
-         (key->passthrough_edgeflags ? TGSI_EMU_PASSTHROUGH_EDGEFLAG : 0);
+      if (st_load_variant_from_disk_cache(st, &stvp->Base, &cache_key,
+                                          sizeof(cache_key), &vpv->tgsi)) {
+         if (key->passthrough_edgeflags)
+            vpv->num_inputs++;
+      } else {
+         const struct tgsi_token *tokens;
+         unsigned flags =
+            (key->clamp_color ? TGSI_EMU_CLAMP_COLOR_OUTPUTS : 0) |
+            (key->passthrough_edgeflags ? TGSI_EMU_PASSTHROUGH_EDGEFLAG : 0);
 
-      tokens = tgsi_emulate(vpv->tgsi.tokens, flags);
+         tokens = tgsi_emulate(stvp->tgsi.tokens, flags);
 
-      if (tokens) {
-         tgsi_free_tokens(vpv->tgsi.tokens);
-         vpv->tgsi.tokens = tokens;
+         if (tokens) {
+            vpv->tgsi.tokens = tokens;
 
-         if (key->passthrough_edgeflags)
-            vpv->num_inputs++;
-      } else
-         fprintf(stderr, "mesa: cannot emulate deprecated features\n");
+            if (key->passthrough_edgeflags)
+               vpv->num_inputs++;
+
+            st_store_variant_in_disk_cache(st, &stvp->Base, &cache_key,
+                                           sizeof(cache_key), &vpv->tgsi);
+         } else
+            fprintf(stderr, "mesa: cannot emulate deprecated features\n");
+      }
    }
 
+   if (!vpv->tgsi.tokens)
+      vpv->tgsi.tokens = tgsi_dup_tokens(stvp->tgsi.tokens);
+
    if (ST_DEBUG & DEBUG_TGSI) {
       tgsi_dump(vpv->tgsi.tokens, 0);
       debug_printf("\n");
@@ -1019,18 +1041,29 @@ st_create_fp_variant(struct st_context *st,
       { STATE_INTERNAL, STATE_PT_SCALE };
    static const gl_state_index16 bias_state[STATE_LENGTH] =
       { STATE_INTERNAL, STATE_PT_BIAS };
+   struct st_fp_variant_key cache_key = *key;
+   bool cached;
 
    if (!variant)
       return NULL;
 
+   /* The variant IR is cached per program, not per context. */
+   cache_key.st = NULL;
+
+   /* When the lowered IR comes from the shader cache, only the samplers and
+    * state references of the variant get set up below.
+    */
    if (stfp->tgsi.type == PIPE_SHADER_IR_NIR) {
       tgsi.type = PIPE_SHADER_IR_NIR;
-      tgsi.ir.nir = nir_shader_clone(NULL, stfp->tgsi.ir.nir);
+      cached = st_load_variant_from_disk_cache(st, &stfp->Base, &cache_key,
+                                               sizeof(cache_key), &tgsi);
+      if (!cached)
+         tgsi.ir.nir = nir_shader_clone(NULL, stfp->tgsi.ir.nir);
 
-      if (key->clamp_color)
+      if (key->clamp_color && !cached)
          NIR_PASS_V(tgsi.ir.nir, nir_lower_clamp_color_outputs);
 
-      if (key->persample_shading) {
+      if (key->persample_shading && !cached) {
           nir_shader *shader = tgsi.ir.nir;
           nir_foreach_variable(var, &shader->inputs)
              var->data.sample = true;
@@ -1046,7 +1079,8 @@ st_create_fp_variant(struct st_context *st,
          options.sampler = variant->bitmap_sampler;
          options.swizzle_xxxx = (st->bitmap.tex_format == PIPE_FORMAT_L8_UNORM);
 
-         NIR_PASS_V(tgsi.ir.nir, nir_lower_bitmap, &options);
+         if (!cached)
+            NIR_PASS_V(tgsi.ir.nir, nir_lower_bitmap, &options);
       }
 
       /* glDrawPixels (color only) */
@@ -1079,24 +1113,30 @@ st_create_fp_variant(struct st_context *st,
          memcpy(options.texcoord_state_tokens, texcoord_state,
                 sizeof(options.texcoord_state_tokens));
 
-         NIR_PASS_V(tgsi.ir.nir, nir_lower_drawpixels, &options);
+         if (!cached)
+            NIR_PASS_V(tgsi.ir.nir, nir_lower_drawpixels, &options);
       }
 
-      if (unlikely(key->external.lower_nv12 || key->external.lower_iyuv)) {
-         nir_lower_tex_options options = {0};
-         options.lower_y_uv_external = key->external.lower_nv12;
-         options.lower_y_u_v_external = key->external.lower_iyuv;
-         NIR_PASS_V(tgsi.ir.nir, nir_lower_tex, &options);
-      }
+      if (!cached) {
+         if (unlikely(key->external.lower_nv12 || key->external.lower_iyuv)) {
+            nir_lower_tex_options options = {0};
+            options.lower_y_uv_external = key->external.lower_nv12;
+            options.lower_y_u_v_external = key->external.lower_iyuv;
+            NIR_PASS_V(tgsi.ir.nir, nir_lower_tex, &options);
+         }
 
-      st_finalize_nir(st, &stfp->Base, stfp->shader_program, tgsi.ir.nir);
+         st_finalize_nir(st, &stfp->Base, stfp->shader_program, tgsi.ir.nir);
 
-      if (unlikely(key->external.lower_nv12 || key->external.lower_iyuv)) {
-         /* This pass needs to happen *after* nir_lower_sampler */
-         NIR_PASS_V(tgsi.ir.nir, st_nir_lower_tex_src_plane,
-                    ~stfp->Base.SamplersUsed,
-                    key->external.lower_nv12,
-                    key->external.lower_iyuv);
+         if (unlikely(key->external.lower_nv12 || key->external.lower_iyuv)) {
+            /* This pass needs to happen *after* nir_lower_sampler */
+            NIR_PASS_V(tgsi.ir.nir, st_nir_lower_tex_src_plane,
+                       ~stfp->Base.SamplersUsed,
+                       key->external.lower_nv12,
+                       key->external.lower_iyuv);
+         }
+
+         st_store_variant_in_disk_cache(st, &stfp->Base, &cache_key,
+                                        sizeof(cache_key), &tgsi);
       }
 
       variant->driver_shader = pipe->create_fs_state(pipe, &tgsi);
@@ -1105,12 +1145,19 @@ st_create_fp_variant(struct st_context *st,
       return variant;
    }
 
-   tgsi.tokens = stfp->tgsi.tokens;
+   /* Variants that need no lowering use the program's tokens as they are. */
+   cached = (key->clamp_color || key->persample_shading || key->bitmap ||
+             key->drawpixels || key->external.lower_nv12 ||
+             key->external.lower_iyuv) &&
+            st_load_variant_from_disk_cache(st, &stfp->Base, &cache_key,
+                                            sizeof(cache_key), &tgsi);
+   if (!cached)
+      tgsi.tokens = stfp->tgsi.tokens;
 
    assert(!(key->bitmap && key->drawpixels));
 
    /* Fix texture targets and add fog for ATI_fs */
-   if (stfp->ati_fs) {
+   if (stfp->ati_fs && !cached) {
       const struct tgsi_token *tokens = st_fixup_atifs(tgsi.tokens, key);
 
       if (tokens)
@@ -1120,7 +1167,7 @@ st_create_fp_variant(struct st_context *st,
    }
 
    /* Emulate features. */
-   if (key->clamp_color || key->persample_shading) {
+   if ((key->clamp_color || key->persample_shading) && !cached) {
       const struct tgsi_token *tokens;
       unsigned flags =
          (key->clamp_color ? TGSI_EMU_CLAMP_COLOR_OUTPUTS : 0) |
@@ -1138,28 +1185,28 @@ st_create_fp_variant(struct st_context *st,
 
    /* glBitmap */
    if (key->bitmap) {
-      const struct tgsi_token *tokens;
-
       variant->bitmap_sampler = ffs(~stfp->Base.SamplersUsed) - 1;
 
-      tokens = st_get_bitmap_shader(tgsi.tokens,
-                                    st->internal_target,
-                                    variant->bitmap_sampler,
-                                    st->needs_texcoord_semantic,
-                                    st->bitmap.tex_format ==
-                                    PIPE_FORMAT_L8_UNORM);
-
-      if (tokens) {
-         if (tgsi.tokens != stfp->tgsi.tokens)
-            tgsi_free_tokens(tgsi.tokens);
-         tgsi.tokens = tokens;
-      } else
-         fprintf(stderr, "mesa: cannot create a shader for glBitmap\n");
+      if (!cached) {
+         const struct tgsi_token *tokens =
+            st_get_bitmap_shader(tgsi.tokens,
+                                 st->internal_target,
+                                 variant->bitmap_sampler,
+                                 st->needs_texcoord_semantic,
+                                 st->bitmap.tex_format ==
+                                 PIPE_FORMAT_L8_UNORM);
+
+         if (tokens) {
+            if (tgsi.tokens != stfp->tgsi.tokens)
+               tgsi_free_tokens(tgsi.tokens);
+            tgsi.tokens = tokens;
+         } else
+            fprintf(stderr, "mesa: cannot create a shader for glBitmap\n");
+      }
    }
 
    /* glDrawPixels (color only) */
    if (key->drawpixels) {
-      const struct tgsi_token *tokens;
       unsigned scale_const = 0, bias_const = 0, texcoord_const = 0;
 
       /* Find the first unused slot. */
@@ -1179,23 +1226,27 @@ st_create_fp_variant(struct st_context *st,
 
       texcoord_const = _mesa_add_state_reference(params, texcoord_state);
 
-      tokens = st_get_drawpix_shader(tgsi.tokens,
-                                     st->needs_texcoord_semantic,
-                                     key->scaleAndBias, scale_const,
-                                     bias_const, key->pixelMaps,
-                                     variant->drawpix_sampler,
-                                     variant->pixelmap_sampler,
-                                     texcoord_const, st->internal_target);
-
-      if (tokens) {
-         if (tgsi.tokens != stfp->tgsi.tokens)
-            tgsi_free_tokens(tgsi.tokens);
-         tgsi.tokens = tokens;
-      } else
-         fprintf(stderr, "mesa: cannot create a shader for glDrawPixels\n");
+      if (!cached) {
+         const struct tgsi_token *tokens =
+            st_get_drawpix_shader(tgsi.tokens,
+                                  st->needs_texcoord_semantic,
+                                  key->scaleAndBias, scale_const,
+                                  bias_const, key->pixelMaps,
+                                  variant->drawpix_sampler,
+                                  variant->pixelmap_sampler,
+                                  texcoord_const, st->internal_target);
+
+         if (tokens) {
+            if (tgsi.tokens != stfp->tgsi.tokens)
+               tgsi_free_tokens(tgsi.tokens);
+            tgsi.tokens = tokens;
+         } else
+            fprintf(stderr, "mesa: cannot create a shader for glDrawPixels\n");
+      }
    }
 
-   if (unlikely(key->external.lower_nv12 || key->external.lower_iyuv)) {
+   if (unlikely(key->external.lower_nv12 || key->external.lower_iyuv) &&
+       !cached) {
       const struct tgsi_token *tokens;
 
       /* samplers inserted would conflict, but this should be unpossible: */
@@ -1214,6 +1265,11 @@ st_create_fp_variant(struct st_context *st,
       }
    }
 
+   if (!cached && tgsi.tokens != stfp->tgsi.tokens) {
+      st_store_variant_in_disk_cache(st, &stfp->Base, &cache_key,
+                                     sizeof(cache_key), &tgsi);
+   }
+
    if (ST_DEBUG & DEBUG_TGSI) {
       tgsi_dump(tgsi.tokens, 0);
       debug_printf("\n");
@@ -1528,10 +1584,20 @@ st_get_basic_variant(struct st_context *st,
       if (v) {
 
 	 if (prog->tgsi.type == PIPE_SHADER_IR_NIR) {
+            struct st_basic_variant_key cache_key = key;
+
+            /* The variant IR is cached per program, not per context. */
+            cache_key.st = NULL;
+
 	    tgsi.type = PIPE_SHADER_IR_NIR;
-	    tgsi.ir.nir = nir_shader_clone(NULL, prog->tgsi.ir.nir);
-	    st_finalize_nir(st, &prog->Base, prog->shader_program,
-                            tgsi.ir.nir);
+            if (!st_load_variant_from_disk_cache(st, &prog->Base, &cache_key,
+                                                 sizeof(cache_key), &tgsi)) {
+               tgsi.ir.nir = nir_shader_clone(NULL, prog->tgsi.ir.nir);
+               st_finalize_nir(st, &prog->Base, prog->shader_program,
+                               tgsi.ir.nir);
+               st_store_variant_in_disk_cache(st, &prog->Base, &cache_key,
+                                              sizeof(cache_key), &tgsi);
+            }
             tgsi.stream_output = prog->tgsi.stream_output;
 	 } else
 	    tgsi = prog->tgsi;
@@ -1734,6 +1800,9 @@ destroy_program_variants(struct st_context *st, struct gl_program *target)
    if (!target || target == &_mesa_DummyProgram)
       return;
 
+   if (st_program_constants(target)->st == st)
+      st_release_program_constants(st_program_constants(target));
+
    switch (target->Target) {
    case GL_VERTEX_PROGRAM_ARB:
       {
@@ -135,6 +135,19 @@ struct st_fp_variant
 };
 
 
+/**
+ * Constant buffer 0 of a program, for drivers that prefer real buffers
+ * there.  The shadow copy holds what was last written to the buffer, so
+ * only the parameters that changed since are uploaded.
+ */
+struct st_program_constants
+{
+   struct st_context *st;          /**< context owning the buffer */
+   struct pipe_resource *buffer;
+   void *shadow;                   /**< buffer->width0 bytes */
+};
+
+
 /**
  * Derived from Mesa gl_program:
  */
@@ -151,6 +164,8 @@ struct st_fragment_program
 
    struct st_fp_variant *variants;
 
+   struct st_program_constants constants;
+
    /* Used by the shader cache and ARB_get_program_binary */
    unsigned num_tgsi_tokens;
 };
@@ -223,6 +238,8 @@ struct st_vertex_program
     */
    struct st_vp_variant *variants;
 
+   struct st_program_constants constants;
+
    /** SHA1 hash of linked tgsi shader program, used for on-disk cache */
    unsigned char sha1[20];
 
@@ -268,6 +285,8 @@ struct st_common_program
 
    struct st_basic_variant *variants;
 
+   struct st_program_constants constants;
+
    /** SHA1 hash of linked tgsi shader program, used for on-disk cache */
    unsigned char sha1[20];
 
@@ -291,6 +310,8 @@ struct st_compute_program
 
    struct st_basic_variant *variants;
 
+   struct st_program_constants constants;
+
    /** SHA1 hash of linked tgsi shader program, used for on-disk cache */
    unsigned char sha1[20];
 
@@ -324,6 +345,21 @@ st_compute_program( struct gl_program *cp )
    return (struct st_compute_program *)cp;
 }
 
+static inline struct st_program_constants *
+st_program_constants(struct gl_program *prog)
+{
+   switch (prog->info.stage) {
+   case MESA_SHADER_VERTEX:
+      return &st_vertex_program(prog)->constants;
+   case MESA_SHADER_FRAGMENT:
+      return &st_fragment_program(prog)->constants;
+   case MESA_SHADER_COMPUTE:
+      return &st_compute_program(prog)->constants;
+   default:
+      return &st_common_program(prog)->constants;
+   }
+}
+
 static inline void
 st_reference_vertprog(struct st_context *st,
                       struct st_vertex_program **ptr,
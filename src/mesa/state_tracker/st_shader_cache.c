@@ -30,6 +30,7 @@
 #include "compiler/nir/nir_serialize.h"
 #include "pipe/p_shader_tokens.h"
 #include "program/ir_to_mesa.h"
+#include "tgsi/tgsi_parse.h"
 #include "util/u_memory.h"
 
 void
@@ -55,11 +56,18 @@ copy_blob_to_driver_cache_blob(struct blob *blob, struct gl_program *prog)
 }
 
 static void
-write_tgsi_to_cache(struct blob *blob, const struct tgsi_token *tokens,
-                    struct gl_program *prog, unsigned num_tokens)
+write_tgsi_tokens(struct blob *blob, const struct tgsi_token *tokens,
+                  unsigned num_tokens)
 {
    blob_write_uint32(blob, num_tokens);
    blob_write_bytes(blob, tokens, num_tokens * sizeof(struct tgsi_token));
+}
+
+static void
+write_tgsi_to_cache(struct blob *blob, const struct tgsi_token *tokens,
+                    struct gl_program *prog, unsigned num_tokens)
+{
+   write_tgsi_tokens(blob, tokens, num_tokens);
    copy_blob_to_driver_cache_blob(blob, prog);
 }
 
@@ -428,3 +436,135 @@ st_deserialise_nir_program(struct gl_context *ctx,
 {
    st_deserialise_ir_program(ctx, shProg, prog, true);
 }
+
+static bool
+can_cache_variant(struct st_context *st, struct gl_program *prog)
+{
+   static const char zero[sizeof(prog->sh.data->sha1)] = {0};
+
+   /* Only GLSL programs have a sha1 to key the variants with. */
+   return st->ctx->Cache && prog->sh.data &&
+          memcmp(prog->sh.data->sha1, zero, sizeof(zero)) != 0;
+}
+
+/**
+ * The cache key of a variant is made of the program's, the variant key and
+ * the context state the variant lowering depends on.  The variant key must
+ * not contain pointers.
+ */
+static void
+compute_variant_cache_key(struct st_context *st, struct gl_program *prog,
+                          const void *key, size_t key_size,
+                          enum pipe_shader_ir ir_type, cache_key cache_key)
+{
+   struct blob blob;
+   blob_init(&blob);
+
+   blob_write_bytes(&blob, prog->sh.data->sha1, sizeof(prog->sh.data->sha1));
+   blob_write_uint32(&blob, prog->info.stage);
+   blob_write_uint32(&blob, ir_type);
+   blob_write_uint32(&blob, st->internal_target);
+   blob_write_uint32(&blob, st->needs_texcoord_semantic);
+   blob_write_uint32(&blob, st->bitmap.tex_format);
+   blob_write_bytes(&blob, key, key_size);
+
+   disk_cache_compute_key(st->ctx->Cache, blob.data, blob.size, cache_key);
+   blob_finish(&blob);
+}
+
+/**
+ * Load the lowered IR of a shader variant, as stored by
+ * st_store_variant_in_disk_cache(), into \p tgsi, whose type must be set.
+ *
+ * \return true if the IR was found, in which case the variant lowering can
+ *         be skipped.
+ */
+bool
+st_load_variant_from_disk_cache(struct st_context *st,
+                                struct gl_program *prog,
+                                const void *key, size_t key_size,
+                                struct pipe_shader_state *tgsi)
+{
+   if (!can_cache_variant(st, prog))
+      return false;
+
+   cache_key cache_key;
+   compute_variant_cache_key(st, prog, key, key_size, tgsi->type, cache_key);
+
+   size_t size;
+   uint8_t *buffer = (uint8_t *) disk_cache_get(st->ctx->Cache, cache_key,
+                                                &size);
+   if (!buffer)
+      return false;
+
+   struct blob_reader blob_reader;
+   blob_reader_init(&blob_reader, buffer, size);
+
+   if (tgsi->type == PIPE_SHADER_IR_NIR) {
+      const struct nir_shader_compiler_options *options =
+         st->ctx->Const.ShaderCompilerOptions[prog->info.stage].NirOptions;
+      nir_shader *nir = nir_deserialize(NULL, options, &blob_reader);
+
+      if (blob_reader.current != blob_reader.end || blob_reader.overrun) {
+         ralloc_free(nir);
+         free(buffer);
+         return false;
+      }
+      tgsi->ir.nir = nir;
+   } else {
+      const struct tgsi_token *tokens;
+      unsigned num_tokens;
+
+      read_tgsi_from_cache(&blob_reader, &tokens, &num_tokens);
+
+      if (blob_reader.current != blob_reader.end || blob_reader.overrun) {
+         tgsi_free_tokens(tokens);
+         free(buffer);
+         return false;
+      }
+      tgsi->tokens = tokens;
+   }
+
+   free(buffer);
+
+   if (st->ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+      fprintf(stderr, "%s variant IR retrieved from cache\n",
+              _mesa_shader_stage_to_string(prog->info.stage));
+   }
+
+   return true;
+}
+
+/**
+ * Store the lowered IR of a shader variant in the on-disk shader cache, so
+ * that creating the variant again, in this process or a later one, doesn't
+ * need to lower it again.
+ */
+void
+st_store_variant_in_disk_cache(struct st_context *st,
+                               struct gl_program *prog,
+                               const void *key, size_t key_size,
+                               const struct pipe_shader_state *tgsi)
+{
+   if (!can_cache_variant(st, prog))
+      return;
+
+   cache_key cache_key;
+   compute_variant_cache_key(st, prog, key, key_size, tgsi->type, cache_key);
+
+   struct blob blob;
+   blob_init(&blob);
+
+   if (tgsi->type == PIPE_SHADER_IR_NIR)
+      nir_serialize(&blob, tgsi->ir.nir);
+   else
+      write_tgsi_tokens(&blob, tgsi->tokens, tgsi_num_tokens(tgsi->tokens));
+
+   disk_cache_put(st->ctx->Cache, cache_key, blob.data, blob.size, NULL);
+   blob_finish(&blob);
+
+   if (st->ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+      fprintf(stderr, "putting %s variant IR in cache\n",
+              _mesa_shader_stage_to_string(prog->info.stage));
+   }
+}
@@ -60,6 +60,18 @@ void
 st_store_ir_in_disk_cache(struct st_context *st, struct gl_program *prog,
                           bool nir);
 
+bool
+st_load_variant_from_disk_cache(struct st_context *st,
+                                struct gl_program *prog,
+                                const void *key, size_t key_size,
+                                struct pipe_shader_state *tgsi);
+
+void
+st_store_variant_in_disk_cache(struct st_context *st,
+                               struct gl_program *prog,
+                               const void *key, size_t key_size,
+                               const struct pipe_shader_state *tgsi);
+
 #ifdef __cplusplus
 }
 #endif
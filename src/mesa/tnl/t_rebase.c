@@ -185,6 +185,8 @@ void t_rebase_prims( struct gl_context *ctx,
       tmp_ib.ptr = tmp_indices;
       tmp_ib.count = ib->count;
       tmp_ib.index_size = ib->index_size;
+      tmp_ib.primitive_restart = ib->primitive_restart;
+      tmp_ib.restart_index = ib->restart_index;
 
       ib = &tmp_ib;
    }
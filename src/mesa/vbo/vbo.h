@@ -73,6 +73,12 @@ struct _mesa_index_buffer
    unsigned index_size;
    struct gl_buffer_object *obj;
    const void *ptr;
+
+   /* Primitive restart, usually the context's state for index_size.  Draws
+    * made by the vbo module itself can use their own.
+    */
+   bool primitive_restart;
+   GLuint restart_index;
 };
 
 
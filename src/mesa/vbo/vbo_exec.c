@@ -243,6 +243,34 @@ vbo_merge_prims(struct _mesa_prim *p0, const struct _mesa_prim *p1)
 }
 
 
+/**
+ * Check whether any bound shader stage reads the primitive ID, which counts
+ * primitives from 0 in each draw.
+ */
+bool
+vbo_reads_primitive_id(const struct gl_context *ctx)
+{
+   const struct gl_program *progs[] = {
+      ctx->VertexProgram._Current,
+      ctx->TessCtrlProgram._Current,
+      ctx->TessEvalProgram._Current,
+      ctx->GeometryProgram._Current,
+      ctx->FragmentProgram._Current,
+   };
+
+   for (unsigned i = 0; i < ARRAY_SIZE(progs); i++) {
+      if (progs[i] && progs[i]->info.system_values_read &
+          BITFIELD64_BIT(SYSTEM_VALUE_PRIMITIVE_ID))
+         return true;
+   }
+
+   /* The fragment shader reads gl_PrimitiveID as an input. */
+   return ctx->FragmentProgram._Current &&
+          ctx->FragmentProgram._Current->info.inputs_read &
+          VARYING_BIT_PRIMITIVE_ID;
+}
+
+
 void
 _vbo_init_inputs(struct vbo_inputs *inputs)
 {
@@ -326,11 +326,12 @@ vbo_exec_wrap_upgrade_vertex(struct vbo_exec_context *exec,
    exec->vtx.enabled |= BITFIELD64_BIT(attr);
 
    if (unlikely(oldSize)) {
-      /* Size changed, recalculate all the attrptr[] values
+      /* Size changed, recalculate all the attrptr[] values.  The position
+       * goes last, see ATTR_UNION.
        */
       fi_type *tmp = exec->vtx.vertex;
 
-      for (i = 0 ; i < VBO_ATTRIB_MAX ; i++) {
+      for (i = VBO_ATTRIB_POS + 1 ; i < VBO_ATTRIB_MAX ; i++) {
          if (exec->vtx.attrsz[i]) {
             exec->vtx.attrptr[i] = tmp;
             tmp += exec->vtx.attrsz[i];
@@ -339,16 +340,34 @@ vbo_exec_wrap_upgrade_vertex(struct vbo_exec_context *exec,
             exec->vtx.attrptr[i] = NULL; /* will not be dereferenced */
       }
 
+      if (exec->vtx.attrsz[VBO_ATTRIB_POS])
+         exec->vtx.attrptr[VBO_ATTRIB_POS] = tmp;
+      else
+         exec->vtx.attrptr[VBO_ATTRIB_POS] = NULL;
+
       /* Copy from current to repopulate the vertex with correct
        * values.
        */
       vbo_exec_copy_from_current(exec);
    }
-   else {
+   else if (attr == VBO_ATTRIB_POS) {
       /* Just have to append the new attribute at the end */
       exec->vtx.attrptr[attr] = exec->vtx.vertex +
         exec->vtx.vertex_size - newSize;
    }
+   else {
+      /* Insert the new attribute before the position, which only has to
+       * move since its value isn't kept in the vertex.
+       */
+      const GLuint pos_size = exec->vtx.attrsz[VBO_ATTRIB_POS];
+
+      exec->vtx.attrptr[attr] = exec->vtx.vertex +
+        exec->vtx.vertex_size - pos_size - newSize;
+      if (pos_size) {
+         exec->vtx.attrptr[VBO_ATTRIB_POS] = exec->vtx.vertex +
+           exec->vtx.vertex_size - pos_size;
+      }
+   }
 
    /* Replay stored vertices to translate them
     * to new format here.
@@ -465,6 +484,13 @@ vbo_exec_begin_vertices(struct gl_context *ctx)
 /**
  * This macro is used to implement all the glVertex, glColor, glTexCoord,
  * glVertexAttrib, etc functions.
+ *
+ * The position is always the last attribute of the vertex.  Its value is
+ * never stored in exec->vtx.vertex: a glVertex call copies the other
+ * attributes to the vertex buffer and writes the position right after
+ * them.  If the position has more components than given, V1..V3 hold the
+ * default values of the missing ones.
+ *
  * \param A  VBO_ATTRIB_x attribute index
  * \param N  attribute size (1..4)
  * \param T  type (GL_FLOAT, GL_DOUBLE, GL_INT, GL_UNSIGNED_INT)
@@ -484,18 +510,22 @@ do {                                                                    \
       vbo_exec_fixup_vertex(ctx, A, N * sz, T);                         \
    }                                                                    \
                                                                         \
-   /* store vertex attribute in vertex buffer */                        \
-   {                                                                    \
+   if ((A) != 0) {                                                      \
+      /* store vertex attribute in the current vertex */                \
       C *dest = (C *)exec->vtx.attrptr[A];                              \
       if (N>0) dest[0] = V0;                                            \
       if (N>1) dest[1] = V1;                                            \
       if (N>2) dest[2] = V2;                                            \
       if (N>3) dest[3] = V3;                                            \
       assert(exec->vtx.attrtype[A] == T);                               \
-   }                                                                    \
                                                                         \
-   if ((A) == 0) {                                                      \
+      /* we now have accumulated per-vertex attributes */               \
+      ctx->Driver.NeedFlush |= FLUSH_UPDATE_CURRENT;                    \
+   } else {                                                             \
       /* This is a glVertex call */                                     \
+      GLuint pos_size, size_no_pos;                                     \
+      fi_type *dst;                                                     \
+      C *pos;                                                           \
       GLuint i;                                                         \
                                                                         \
       if (unlikely((ctx->Driver.NeedFlush & FLUSH_UPDATE_CURRENT) == 0)) { \
@@ -506,10 +536,29 @@ do {                                                                    \
          vbo_exec_vtx_map(exec);                                        \
       }                                                                 \
       assert(exec->vtx.buffer_ptr);                                     \
+      assert(exec->vtx.attrtype[A] == T);                               \
                                                                         \
-      /* copy 32-bit words */                                           \
-      for (i = 0; i < exec->vtx.vertex_size; i++)                       \
-         exec->vtx.buffer_ptr[i] = exec->vtx.vertex[i];                 \
+      /* copy the other attributes as 32-bit words; the layout is read  \
+       * only here so that it isn't kept live across the calls above    \
+       */                                                               \
+      pos_size = exec->vtx.attrsz[0] / sz;                              \
+      size_no_pos = exec->vtx.vertex_size - exec->vtx.attrsz[0];        \
+      dst = exec->vtx.buffer_ptr;                                       \
+      for (i = 0; i < size_no_pos; i++)                                 \
+         dst[i] = exec->vtx.vertex[i];                                  \
+                                                                        \
+      /* and store the position after them */                           \
+      pos = (C *)(dst + size_no_pos);                                   \
+      if (N>0) pos[0] = V0;                                             \
+      if (N>1) pos[1] = V1;                                             \
+      if (N>2) pos[2] = V2;                                             \
+      if (N>3) pos[3] = V3;                                             \
+      /* a shorter glVertex than earlier ones fills in the defaults */  \
+      if (unlikely(pos_size > N)) {                                     \
+         if (N<2) pos[1] = V1;                                          \
+         if (N<3 && pos_size>2) pos[2] = V2;                            \
+         if (N<4 && pos_size>3) pos[3] = V3;                            \
+      }                                                                 \
                                                                         \
       exec->vtx.buffer_ptr += exec->vtx.vertex_size;                    \
                                                                         \
@@ -519,9 +568,6 @@ do {                                                                    \
                                                                         \
       if (++exec->vtx.vert_count >= exec->vtx.max_vert)                 \
          vbo_exec_vtx_wrap(exec);                                       \
-   } else {                                                             \
-      /* we now have accumulated per-vertex attributes */               \
-      ctx->Driver.NeedFlush |= FLUSH_UPDATE_CURRENT;                    \
    }                                                                    \
 } while (0)
 
@@ -130,6 +130,17 @@ sizeof_ib_type(GLenum type)
    }
 }
 
+/**
+ * Set the primitive restart state of an index buffer from the context.
+ */
+static void
+set_index_buffer_restart(const struct gl_context *ctx,
+                         struct _mesa_index_buffer *ib)
+{
+   ib->primitive_restart = ctx->Array._PrimitiveRestart;
+   ib->restart_index = _mesa_primitive_restart_index(ctx, ib->index_size);
+}
+
 /**
  * Examine the array's data for NaNs, etc.
  * For debug purposes; not normally used.
@@ -250,6 +261,47 @@ skip_validated_draw(struct gl_context *ctx)
 }
 
 
+/**
+ * Coalesce consecutive primitives of a multi-draw that the driver can
+ * render as one, e.g. triangle lists whose vertices follow each other.
+ * The primitives must all have begin and end set.  This isn't done if a
+ * shader reads gl_DrawID or the primitive ID, which would see the merged
+ * draws as one, nor for indexed draws with primitive restart, since a
+ * restart index would realign the primitives of the draws that follow it.
+ *
+ * \return the number of primitives left in \p prim
+ */
+static GLuint
+merge_multidraw_prims(const struct gl_context *ctx, struct _mesa_prim *prim,
+                      GLuint nr_prims)
+{
+   const struct gl_program *vp = ctx->VertexProgram._Current;
+   GLuint i, n;
+
+   if (nr_prims < 2)
+      return nr_prims;
+
+   if (vp && vp->info.system_values_read &
+       BITFIELD64_BIT(SYSTEM_VALUE_DRAW_ID))
+      return nr_prims;
+
+   if (vbo_reads_primitive_id(ctx))
+      return nr_prims;
+
+   if (prim[0].indexed && ctx->Array._PrimitiveRestart)
+      return nr_prims;
+
+   for (i = 1, n = 1; i < nr_prims; i++) {
+      if (vbo_can_merge_prims(&prim[n - 1], &prim[i]))
+         vbo_merge_prims(&prim[n - 1], &prim[i]);
+      else
+         prim[n++] = prim[i];
+   }
+
+   return n;
+}
+
+
 /**
  * Print info/data for glDrawArrays(), for debugging.
  */
@@ -672,6 +724,11 @@ vbo_exec_MultiDrawArrays(GLenum mode, const GLint *first,
                          const GLsizei *count, GLsizei primcount)
 {
    GET_CURRENT_CONTEXT(ctx);
+   struct vbo_context *vbo = vbo_context(ctx);
+   const struct gl_vertex_array_object *vao = ctx->Array.VAO;
+   struct _mesa_prim *prim;
+   GLuint nr_prims = 0, min_index = ~0u, max_index = 0;
+   GLboolean contiguous = GL_TRUE;
    GLint i;
 
    if (MESA_VERBOSE & VERBOSE_DRAW)
@@ -693,11 +750,36 @@ vbo_exec_MultiDrawArrays(GLenum mode, const GLint *first,
          return;
    }
 
+   if (primcount <= 0 || skip_validated_draw(ctx))
+      return;
+
+   prim = calloc(primcount, sizeof(*prim));
+   if (prim == NULL) {
+      _mesa_error(ctx, GL_OUT_OF_MEMORY, "glMultiDrawArrays");
+      return;
+   }
+
+   /* Hand all the draws to the driver at once, so that the state is only
+    * validated once and consecutive ones can be merged.
+    */
    for (i = 0; i < primcount; i++) {
       if (count[i] > 0) {
+         struct _mesa_prim *p = &prim[nr_prims];
+
+         if (nr_prims > 0 && first[i] != p[-1].start + p[-1].count)
+            contiguous = GL_FALSE;
+         nr_prims++;
+
          if (0)
             check_draw_arrays_data(ctx, first[i], count[i]);
 
+         p->begin = 1;
+         p->end = 1;
+         p->mode = mode;
+         p->num_instances = 1;
+         p->start = first[i];
+         p->count = count[i];
+
          /* The GL_ARB_shader_draw_parameters spec adds the following after the
           * pseudo-code describing glMultiDrawArrays:
           *
@@ -705,12 +787,39 @@ vbo_exec_MultiDrawArrays(GLenum mode, const GLint *first,
           *     read by a vertex shader as <gl_DrawIDARB>, as described in
           *     Section 11.1.3.9."
           */
-         vbo_draw_arrays(ctx, mode, first[i], count[i], 1, 0, i);
+         p->draw_id = i;
+
+         min_index = MIN2(min_index, (GLuint) first[i]);
+         max_index = MAX2(max_index, (GLuint) (first[i] + count[i] - 1));
 
          if (0)
             print_draw_arrays(ctx, mode, first[i], count[i]);
       }
    }
+
+   if (nr_prims > 0) {
+      vbo_bind_arrays(ctx);
+
+      /* The driver uploads the whole index range of user arrays, so with
+       * gaps between the draws, each draw gets its own range instead.
+       */
+      if (contiguous || !(vao->_Enabled & ~vao->VertexAttribBufferMask)) {
+         nr_prims = merge_multidraw_prims(ctx, prim, nr_prims);
+         vbo->draw_prims(ctx, prim, nr_prims, NULL,
+                         GL_TRUE, min_index, max_index, NULL, 0, NULL);
+      } else {
+         for (i = 0; i < nr_prims; i++) {
+            vbo->draw_prims(ctx, &prim[i], 1, NULL, GL_TRUE, prim[i].start,
+                            prim[i].start + prim[i].count - 1, NULL, 0, NULL);
+         }
+      }
+
+      if (MESA_DEBUG_FLAGS & DEBUG_ALWAYS_FLUSH) {
+         _mesa_flush(ctx);
+      }
+   }
+
+   free(prim);
 }
 
 
@@ -826,6 +935,7 @@ vbo_validated_drawrangeelements(struct gl_context *ctx, GLenum mode,
    ib.index_size = sizeof_ib_type(type);
    ib.obj = ctx->Array.VAO->IndexBufferObj;
    ib.ptr = indices;
+   set_index_buffer_restart(ctx, &ib);
 
    prim.begin = 1;
    prim.end = 1;
@@ -1298,14 +1408,17 @@ vbo_validated_multidrawelements(struct gl_context *ctx, GLenum mode,
       fallback = GL_TRUE;
 
    if (!fallback) {
+      GLuint nr_prims;
+
       ib.count = (max_index_ptr - min_index_ptr) / index_type_size;
       ib.index_size = sizeof_ib_type(type);
       ib.obj = ctx->Array.VAO->IndexBufferObj;
       ib.ptr = (void *) min_index_ptr;
+      set_index_buffer_restart(ctx, &ib);
 
       for (i = 0; i < primcount; i++) {
-         prim[i].begin = (i == 0);
-         prim[i].end = (i == primcount - 1);
+         prim[i].begin = 1;
+         prim[i].end = 1;
          prim[i].weak = 0;
          prim[i].pad = 0;
          prim[i].mode = mode;
@@ -1323,7 +1436,13 @@ vbo_validated_multidrawelements(struct gl_context *ctx, GLenum mode,
             prim[i].basevertex = 0;
       }
 
-      vbo->draw_prims(ctx, prim, primcount, &ib,
+      nr_prims = merge_multidraw_prims(ctx, prim, primcount);
+      for (i = 0; i < nr_prims; i++) {
+         prim[i].begin = (i == 0);
+         prim[i].end = (i == nr_prims - 1);
+      }
+
+      vbo->draw_prims(ctx, prim, nr_prims, &ib,
                       false, 0, ~0, NULL, 0, NULL);
    }
    else {
@@ -1335,6 +1454,7 @@ vbo_validated_multidrawelements(struct gl_context *ctx, GLenum mode,
          ib.index_size = sizeof_ib_type(type);
          ib.obj = ctx->Array.VAO->IndexBufferObj;
          ib.ptr = indices[i];
+         set_index_buffer_restart(ctx, &ib);
 
          prim[0].begin = 1;
          prim[0].end = 1;
@@ -1611,6 +1731,7 @@ vbo_validated_drawelementsindirect(struct gl_context *ctx,
    ib.index_size = sizeof_ib_type(type);
    ib.obj = ctx->Array.VAO->IndexBufferObj;
    ib.ptr = NULL;
+   set_index_buffer_restart(ctx, &ib);
 
    vbo->draw_indirect_prims(ctx, mode,
                             ctx->DrawIndirectBuffer, (GLsizeiptr) indirect,
@@ -1643,6 +1764,7 @@ vbo_validated_multidrawelementsindirect(struct gl_context *ctx,
    ib.index_size = sizeof_ib_type(type);
    ib.obj = ctx->Array.VAO->IndexBufferObj;
    ib.ptr = NULL;
+   set_index_buffer_restart(ctx, &ib);
 
    vbo->draw_indirect_prims(ctx, mode,
                             ctx->DrawIndirectBuffer, offset,
@@ -1843,6 +1965,7 @@ vbo_validated_multidrawelementsindirectcount(struct gl_context *ctx,
    ib.index_size = sizeof_ib_type(type);
    ib.obj = ctx->Array.VAO->IndexBufferObj;
    ib.ptr = NULL;
+   set_index_buffer_restart(ctx, &ib);
 
    vbo->draw_indirect_prims(ctx, mode,
                             ctx->DrawIndirectBuffer, offset,
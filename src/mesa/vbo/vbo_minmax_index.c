@@ -240,9 +240,8 @@ vbo_get_minmax_index(struct gl_context *ctx,
                      GLuint *min_index, GLuint *max_index,
                      const GLuint count)
 {
-   const GLboolean restart = ctx->Array._PrimitiveRestart;
-   const GLuint restartIndex =
-      _mesa_primitive_restart_index(ctx, ib->index_size);
+   const GLboolean restart = ib->primitive_restart;
+   const GLuint restartIndex = ib->restart_index;
    const char *indices;
    GLuint i;
    GLintptr offset = 0;
@@ -175,6 +175,9 @@ vbo_can_merge_prims(const struct _mesa_prim *p0, const struct _mesa_prim *p1);
 void
 vbo_merge_prims(struct _mesa_prim *p0, const struct _mesa_prim *p1);
 
+bool
+vbo_reads_primitive_id(const struct gl_context *ctx);
+
 
 /**
  * Get the filter mask for vbo draws depending on the vertex_processing_mode.
@@ -76,6 +76,16 @@ struct vbo_save_vertex_list {
    GLuint prim_count;
 
    struct vbo_save_primitive_store *prim_store;
+
+   /* If the primitives are all strips or fans of the same mode, they are
+    * also stored as a single indexed primitive with the restart index
+    * between them, so that they can be replayed as one draw.
+    */
+   struct {
+      struct gl_buffer_object *ib;
+      GLuint index_size;
+      struct _mesa_prim prim;
+   } merged;
 };
 
 
@@ -518,6 +518,92 @@ update_vao(struct gl_context *ctx,
 }
 
 
+/**
+ * Build node->merged for a list made of several strips or fans of the same
+ * mode: their vertices are put in an index buffer with the fixed restart
+ * index between them, which draws exactly the same primitives.  Lists with
+ * other modes are left alone, since converting them to independent
+ * primitives would change the provoking vertex, line stipple and polygon
+ * edges.  The list is still replayed primitive by primitive while a shader
+ * reads the primitive ID, see vbo_save_playback_vertex_list.
+ */
+static void
+compile_merged_prims(struct gl_context *ctx,
+                     struct vbo_save_vertex_list *node)
+{
+   GLuint num_indices, max_index, index_size, i, j, n;
+   GLubyte mode;
+   void *indices;
+
+   node->merged.ib = NULL;
+
+   if (node->prim_count < 2 || !ctx->Extensions.NV_primitive_restart)
+      return;
+
+   mode = node->prims[0].mode;
+
+   if (mode != GL_LINE_STRIP &&
+       mode != GL_TRIANGLE_STRIP &&
+       mode != GL_TRIANGLE_FAN)
+      return;
+
+   num_indices = node->prim_count - 1;
+   for (i = 0; i < node->prim_count; i++) {
+      if (node->prims[i].mode != mode)
+         return;
+      num_indices += node->prims[i].count;
+   }
+
+   /* The largest index must not be the restart index. */
+   max_index = _vbo_save_get_max_index(node);
+   index_size = max_index < 0xffff ? 2 : 4;
+
+   indices = malloc(num_indices * index_size);
+   if (!indices)
+      return;
+
+   for (i = 0, n = 0; i < node->prim_count; i++) {
+      const struct _mesa_prim *prim = &node->prims[i];
+
+      if (i > 0) {
+         if (index_size == 2)
+            ((GLushort *)indices)[n++] = 0xffff;
+         else
+            ((GLuint *)indices)[n++] = 0xffffffff;
+      }
+
+      for (j = prim->start; j < prim->start + prim->count; j++) {
+         if (index_size == 2)
+            ((GLushort *)indices)[n++] = j;
+         else
+            ((GLuint *)indices)[n++] = j;
+      }
+   }
+   assert(n == num_indices);
+
+   node->merged.ib = ctx->Driver.NewBufferObject(ctx, VBO_BUF_ID);
+   if (!node->merged.ib ||
+       !ctx->Driver.BufferData(ctx, GL_ELEMENT_ARRAY_BUFFER_ARB,
+                               num_indices * index_size, indices,
+                               GL_STATIC_DRAW_ARB, GL_MAP_WRITE_BIT |
+                               GL_DYNAMIC_STORAGE_BIT, node->merged.ib)) {
+      /* Not fatal, the primitives are just drawn one by one. */
+      _mesa_reference_buffer_object(ctx, &node->merged.ib, NULL);
+      free(indices);
+      return;
+   }
+
+   free(indices);
+
+   node->merged.index_size = index_size;
+   node->merged.prim = node->prims[0];
+   node->merged.prim.end = node->prims[node->prim_count - 1].end;
+   node->merged.prim.start = 0;
+   node->merged.prim.count = num_indices;
+   node->merged.prim.indexed = 1;
+}
+
+
 /**
  * Insert the active immediate struct onto the display list currently
  * being built.
@@ -647,6 +733,8 @@ compile_vertex_list(struct gl_context *ctx)
       node->prims[i].start += start_offset;
    }
 
+   compile_merged_prims(ctx, node);
+
    /* Deal with GL_COMPILE_AND_EXECUTE:
     */
    if (ctx->ExecuteFlag) {
@@ -1816,6 +1904,8 @@ vbo_destroy_vertex_list(struct gl_context *ctx, void *data)
 
    free(node->current_data);
    node->current_data = NULL;
+
+   _mesa_reference_buffer_object(ctx, &node->merged.ib, NULL);
 }
 
 
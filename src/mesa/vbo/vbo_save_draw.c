@@ -212,7 +212,30 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data)
 
       assert(ctx->NewState == 0);
 
-      if (node->vertex_count > 0) {
+      /* The primitive ID isn't reset at restart indices, so shaders that
+       * read it need the primitives drawn one by one.
+       */
+      if (node->vertex_count > 0 && node->merged.ib &&
+          !vbo_reads_primitive_id(ctx)) {
+         GLuint min_index = _vbo_save_get_min_index(node);
+         GLuint max_index = _vbo_save_get_max_index(node);
+         struct _mesa_index_buffer ib;
+
+         ib.count = node->merged.prim.count;
+         ib.index_size = node->merged.index_size;
+         ib.obj = node->merged.ib;
+         ib.ptr = NULL;
+
+         /* The merged primitive is separated by the fixed restart index,
+          * whatever the application's primitive restart state is.
+          */
+         ib.primitive_restart = true;
+         ib.restart_index = 0xffffffffu >> 8 * (4 - ib.index_size);
+
+         vbo->draw_prims(ctx, &node->merged.prim, 1, &ib,
+                         GL_TRUE, min_index, max_index, NULL, 0, NULL);
+      }
+      else if (node->vertex_count > 0) {
          GLuint min_index = _vbo_save_get_min_index(node);
          GLuint max_index = _vbo_save_get_max_index(node);
          vbo->draw_prims(ctx,
@@ -556,6 +556,8 @@ replay_init(struct copy_context *copy)
    copy->dstib.index_size = 4;
    copy->dstib.obj = ctx->Shared->NullBufferObj;
    copy->dstib.ptr = copy->dstelt;
+   copy->dstib.primitive_restart = false;
+   copy->dstib.restart_index = 0;
 }
 
 
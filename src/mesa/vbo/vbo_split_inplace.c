@@ -231,6 +231,8 @@ split_prims(struct split_context *split)
          ib.index_size = 4;
          ib.obj = split->ctx->Shared->NullBufferObj;
          ib.ptr = elts;
+         ib.primitive_restart = false;
+         ib.restart_index = 0;
 
          tmpprim = *prim;
          tmpprim.indexed = 1;
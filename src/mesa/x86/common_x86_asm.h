@@ -42,6 +42,10 @@
  */
 #include "common_x86_features.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 extern int _mesa_x86_cpu_features;
 
 extern void _mesa_get_x86_features(void);
@@ -50,4 +54,8 @@ extern void _mesa_check_os_sse_support(void);
 
 extern void _mesa_init_all_x86_transform_asm( void );
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
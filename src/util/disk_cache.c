@@ -374,7 +374,9 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
     * to disk quickly just that it's not blocking other tasks.
     *
     * The queue will resize automatically when it's full, so adding new jobs
-    * doesn't stall.
+    * doesn't stall. The queue keeps its own thread, because only a private
+    * pool can run it at SCHED_IDLE; on the shared pool, the jobs would
+    * compete with the application for CPU time.
     */
    util_queue_init(&cache->cache_queue, "disk_cache", 32, 1,
                    UTIL_QUEUE_INIT_RESIZE_IF_FULL |
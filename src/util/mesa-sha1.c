@@ -24,9 +24,210 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <string.h>
+
+#include "c11/threads.h"
 #include "sha1/sha1.h"
+#include "macros.h"
 #include "mesa-sha1.h"
 
+/* The SHA extensions code path is built with a function target attribute,
+ * so that the rest of the file doesn't need any special flags, and picked at
+ * run time.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define HAVE_SHA1_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+typedef void (*sha1_blocks_func)(uint32_t state[5], const uint8_t *data,
+                                 size_t blocks);
+
+static void
+sha1_blocks_c(uint32_t state[5], const uint8_t *data, size_t blocks)
+{
+   for (; blocks; blocks--, data += SHA1_BLOCK_LENGTH)
+      SHA1Transform(state, data);
+}
+
+#ifdef HAVE_SHA1_X86
+
+/* Four rounds with the SHA extensions, also feeding the message schedule of
+ * the next groups of four rounds from the current one.
+ */
+#define SHA1_NI_ROUNDS(e_in, e_out, f, m0, m1, m2, m3)   \
+   e_in = _mm_sha1nexte_epu32(e_in, m0);                 \
+   e_out = abcd;                                         \
+   m1 = _mm_sha1msg2_epu32(m1, m0);                      \
+   abcd = _mm_sha1rnds4_epu32(abcd, e_in, f);            \
+   m3 = _mm_sha1msg1_epu32(m3, m0);                      \
+   m2 = _mm_xor_si128(m2, m0)
+
+__attribute__((target("sha,sse4.1")))
+static void
+sha1_blocks_sha_ni(uint32_t state[5], const uint8_t *data, size_t blocks)
+{
+   const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL,
+                                        0x08090a0b0c0d0e0fULL);
+   __m128i abcd, e0, e1, msg0, msg1, msg2, msg3;
+
+   abcd = _mm_loadu_si128((const __m128i *)state);
+   abcd = _mm_shuffle_epi32(abcd, 0x1b);
+   e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+   for (; blocks; blocks--, data += SHA1_BLOCK_LENGTH) {
+      const __m128i abcd_save = abcd;
+      const __m128i e_save = e0;
+
+      msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), bswap);
+      msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)),
+                              bswap);
+      msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)),
+                              bswap);
+      msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)),
+                              bswap);
+
+      /* Rounds 0-11, while the schedule fills up. */
+      e0 = _mm_add_epi32(e0, msg0);
+      e1 = abcd;
+      abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+      e1 = _mm_sha1nexte_epu32(e1, msg1);
+      e0 = abcd;
+      abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+      msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+      e0 = _mm_sha1nexte_epu32(e0, msg2);
+      e1 = abcd;
+      abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+      msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+      msg0 = _mm_xor_si128(msg0, msg2);
+
+      /* Rounds 12-67. */
+      SHA1_NI_ROUNDS(e1, e0, 0, msg3, msg0, msg1, msg2);
+      SHA1_NI_ROUNDS(e0, e1, 0, msg0, msg1, msg2, msg3);
+      SHA1_NI_ROUNDS(e1, e0, 1, msg1, msg2, msg3, msg0);
+      SHA1_NI_ROUNDS(e0, e1, 1, msg2, msg3, msg0, msg1);
+      SHA1_NI_ROUNDS(e1, e0, 1, msg3, msg0, msg1, msg2);
+      SHA1_NI_ROUNDS(e0, e1, 1, msg0, msg1, msg2, msg3);
+      SHA1_NI_ROUNDS(e1, e0, 1, msg1, msg2, msg3, msg0);
+      SHA1_NI_ROUNDS(e0, e1, 2, msg2, msg3, msg0, msg1);
+      SHA1_NI_ROUNDS(e1, e0, 2, msg3, msg0, msg1, msg2);
+      SHA1_NI_ROUNDS(e0, e1, 2, msg0, msg1, msg2, msg3);
+      SHA1_NI_ROUNDS(e1, e0, 2, msg1, msg2, msg3, msg0);
+      SHA1_NI_ROUNDS(e0, e1, 2, msg2, msg3, msg0, msg1);
+      SHA1_NI_ROUNDS(e1, e0, 3, msg3, msg0, msg1, msg2);
+      SHA1_NI_ROUNDS(e0, e1, 3, msg0, msg1, msg2, msg3);
+
+      /* Rounds 68-79, while the schedule drains. */
+      e1 = _mm_sha1nexte_epu32(e1, msg1);
+      e0 = abcd;
+      msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+      abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+      msg3 = _mm_xor_si128(msg3, msg1);
+
+      e0 = _mm_sha1nexte_epu32(e0, msg2);
+      e1 = abcd;
+      msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+      abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+      e1 = _mm_sha1nexte_epu32(e1, msg3);
+      e0 = abcd;
+      abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+      e0 = _mm_sha1nexte_epu32(e0, e_save);
+      abcd = _mm_add_epi32(abcd, abcd_save);
+   }
+
+   abcd = _mm_shuffle_epi32(abcd, 0x1b);
+   _mm_storeu_si128((__m128i *)state, abcd);
+   state[4] = _mm_extract_epi32(e0, 3);
+}
+
+#endif /* HAVE_SHA1_X86 */
+
+static sha1_blocks_func sha1_blocks = sha1_blocks_c;
+static once_flag sha1_once_flag = ONCE_FLAG_INIT;
+
+static void
+sha1_select_blocks_func(void)
+{
+#ifdef HAVE_SHA1_X86
+   unsigned int eax, ebx, ecx, edx;
+
+   if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1))
+      return;
+
+   if (__get_cpuid_max(0, NULL) < 7)
+      return;
+
+   /* CPUID.(EAX=7, ECX=0):EBX[bit 29] is the SHA extensions bit. */
+   __cpuid_count(7, 0, eax, ebx, ecx, edx);
+   if (ebx & (1 << 29))
+      sha1_blocks = sha1_blocks_sha_ni;
+#endif
+}
+
+void
+_mesa_sha1_init(struct mesa_sha1 *ctx)
+{
+   call_once(&sha1_once_flag, sha1_select_blocks_func);
+   SHA1Init(ctx);
+}
+
+void
+_mesa_sha1_update(struct mesa_sha1 *ctx, const void *data, size_t size)
+{
+   const uint8_t *p = (const uint8_t *)data;
+   size_t used = (ctx->count >> 3) & (SHA1_BLOCK_LENGTH - 1);
+
+   ctx->count += (uint64_t)size << 3;
+
+   if (used) {
+      const size_t n = MIN2(size, SHA1_BLOCK_LENGTH - used);
+
+      memcpy(&ctx->buffer[used], p, n);
+      p += n;
+      size -= n;
+      if (used + n < SHA1_BLOCK_LENGTH)
+         return;
+
+      sha1_blocks(ctx->state, ctx->buffer, 1);
+   }
+
+   /* Hash whole blocks straight from the caller's data. */
+   if (size >= SHA1_BLOCK_LENGTH) {
+      sha1_blocks(ctx->state, p, size / SHA1_BLOCK_LENGTH);
+      p += size & ~(size_t)(SHA1_BLOCK_LENGTH - 1);
+      size &= SHA1_BLOCK_LENGTH - 1;
+   }
+
+   memcpy(ctx->buffer, p, size);
+}
+
+void
+_mesa_sha1_final(struct mesa_sha1 *ctx, unsigned char result[20])
+{
+   static const uint8_t padding[SHA1_BLOCK_LENGTH] = { 0x80 };
+   const uint64_t count = ctx->count;
+   const size_t used = (count >> 3) & (SHA1_BLOCK_LENGTH - 1);
+   uint8_t length[8];
+   int i;
+
+   for (i = 0; i < 8; i++)
+      length[i] = count >> ((7 - i) * 8);
+
+   /* Pad to 56 bytes modulo the block size, then append the length. */
+   _mesa_sha1_update(ctx, padding,
+                     used < 56 ? 56 - used : SHA1_BLOCK_LENGTH + 56 - used);
+   _mesa_sha1_update(ctx, length, sizeof(length));
+
+   for (i = 0; i < SHA1_DIGEST_LENGTH; i++)
+      result[i] = ctx->state[i >> 2] >> ((3 - (i & 3)) * 8);
+}
+
 void
 _mesa_sha1_compute(const void *data, size_t size, unsigned char result[20])
 {
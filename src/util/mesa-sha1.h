@@ -33,23 +33,14 @@ extern "C" {
 
 #define mesa_sha1 _SHA1_CTX
 
-static inline void
-_mesa_sha1_init(struct mesa_sha1 *ctx)
-{
-   SHA1Init(ctx);
-}
+void
+_mesa_sha1_init(struct mesa_sha1 *ctx);
 
-static inline void
-_mesa_sha1_update(struct mesa_sha1 *ctx, const void *data, size_t size)
-{
-   SHA1Update(ctx, (const unsigned char *)data, size);
-}
+void
+_mesa_sha1_update(struct mesa_sha1 *ctx, const void *data, size_t size);
 
-static inline void
-_mesa_sha1_final(struct mesa_sha1 *ctx, unsigned char result[20])
-{
-   SHA1Final(result, ctx);
-}
+void
+_mesa_sha1_final(struct mesa_sha1 *ctx, unsigned char result[20]);
 
 void
 _mesa_sha1_format(char *buf, const unsigned char *sha1);
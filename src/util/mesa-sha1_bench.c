@@ -0,0 +1,87 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Measures the SHA-1 throughput for data sizes ranging from cache keys to
+ * large serialized shaders, for the implementation picked for this CPU
+ * and for the portable code.
+ *
+ * Usage: mesa-sha1_bench [total MiB per size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "macros.h"
+#include "mesa-sha1.h"
+#include "os_time.h"
+
+static void
+hash_portable(const unsigned char *data, size_t size, unsigned char *result)
+{
+   SHA1_CTX ctx;
+
+   SHA1Init(&ctx);
+   SHA1Update(&ctx, data, size);
+   SHA1Final(result, &ctx);
+}
+
+static double
+measure(void (*hash)(const void *, size_t, unsigned char *),
+        const unsigned char *data, size_t size, size_t total)
+{
+   unsigned char result[20];
+   size_t iterations = MAX2(total / size, 1);
+
+   int64_t start = os_time_get_nano();
+   for (size_t i = 0; i < iterations; i++)
+      hash(data, size, result);
+   int64_t end = os_time_get_nano();
+
+   return (double)(iterations * size) / (1 << 20) / ((end - start) / 1e9);
+}
+
+int
+main(int argc, char **argv)
+{
+   static const size_t sizes[] = { 20, 64, 256, 4096, 65536, 1 << 20 };
+   size_t total = (argc > 1 ? strtoul(argv[1], NULL, 0) : 256) << 20;
+   unsigned char *data = malloc(sizes[ARRAY_SIZE(sizes) - 1]);
+
+   for (size_t i = 0; i < sizes[ARRAY_SIZE(sizes) - 1]; i++)
+      data[i] = i * 7;
+
+   printf("%10s %14s %14s\n", "size", "mesa (MiB/s)", "portable (MiB/s)");
+
+   for (unsigned i = 0; i < ARRAY_SIZE(sizes); i++) {
+      double mesa = measure(_mesa_sha1_compute, data, sizes[i], total);
+      double portable =
+         measure((void (*)(const void *, size_t, unsigned char *))hash_portable,
+                 data, sizes[i], total);
+
+      printf("%10zu %14.1f %14.1f\n", sizes[i], mesa, portable);
+   }
+
+   free(data);
+   return 0;
+}
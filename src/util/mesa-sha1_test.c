@@ -23,12 +23,49 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "macros.h"
 #include "mesa-sha1.h"
 
 #define SHA1_LENGTH 40
+#define DATA_SIZE 4096
+
+/* Hashes data in chunks of random sizes and compares the result with the
+ * one of the portable SHA-1 code, whatever implementation got picked for
+ * this CPU.
+ */
+static bool
+check_against_reference(const unsigned char *data, size_t size)
+{
+   unsigned char expected[20], result[20];
+   struct mesa_sha1 ctx;
+   SHA1_CTX ref;
+   size_t offset = 0;
+
+   SHA1Init(&ref);
+   SHA1Update(&ref, data, size);
+   SHA1Final(expected, &ref);
+
+   _mesa_sha1_init(&ctx);
+   while (offset < size) {
+      size_t chunk = rand() % 200;
+
+      chunk = MIN2(chunk, size - offset);
+
+      _mesa_sha1_update(&ctx, data + offset, chunk);
+      offset += chunk;
+   }
+   _mesa_sha1_final(&ctx, result);
+
+   if (memcmp(expected, result, sizeof(result)) != 0) {
+      printf("Mismatch with the portable code for length %zu\n", size);
+      return false;
+   }
+
+   return true;
+}
 
 int main(int argc, char *argv[])
 {
@@ -61,5 +98,17 @@ int main(int argc, char *argv[])
       }
    }
 
+   unsigned char *data = malloc(DATA_SIZE);
+
+   srand(0);
+   for (i = 0; i < DATA_SIZE; i++)
+      data[i] = rand();
+
+   for (i = 0; i < 300; i++)
+      failed |= !check_against_reference(data, i);
+   failed |= !check_against_reference(data, DATA_SIZE);
+
+   free(data);
+
    return failed;
 }
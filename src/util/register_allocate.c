@@ -71,6 +71,8 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "ralloc.h"
 #include "main/imports.h"
@@ -127,7 +129,6 @@ struct ra_node {
     * List of which nodes this node interferes with.  This should be
     * symmetric with the other node.
     */
-   BITSET_WORD *adjacency;
    unsigned int *adjacency_list;
    unsigned int adjacency_list_size;
    unsigned int adjacency_count;
@@ -152,6 +153,15 @@ struct ra_node {
     */
    unsigned int q_total;
 
+   /**
+    * The q total for all the interfering nodes, whether they're in the stack
+    * or not.  This is what spilling the node would save.
+    */
+   unsigned int adjacency_q_total;
+
+   /** Position of the node in the optimistic heap, or NO_REG. */
+   unsigned int heap_index;
+
    /* For an implementation that needs register spilling, this is the
     * approximate cost of spilling this node.
     */
@@ -166,6 +176,12 @@ struct ra_graph {
    struct ra_node *nodes;
    unsigned int count; /**< count of nodes. */
 
+   /**
+    * Lower triangle of the interference matrix, used to avoid adding the
+    * same edge twice.  See ra_adjacency_bit().
+    */
+   BITSET_WORD *adjacency;
+
    unsigned int *stack;
    unsigned int stack_count;
 
@@ -175,6 +191,14 @@ struct ra_graph {
     */
    unsigned int stack_optimistic_start;
 
+   /**
+    * Min-heap on q_total of the nodes that weren't trivially colorable
+    * when simplification started, from which the optimistic nodes are
+    * picked.
+    */
+   unsigned int *heap;
+   unsigned int heap_count;
+
    unsigned int (*select_reg_callback)(struct ra_graph *g, BITSET_WORD *regs,
                                        void *data);
    void *select_reg_callback_data;
@@ -391,16 +415,150 @@ ra_set_finalize(struct ra_regs *regs, unsigned int **q_values)
    }
 }
 
+#define RA_SET_SERIALIZE_MAGIC 0x72617331 /* "ras1" */
+#define RA_SET_HEADER_WORDS 4
+
+static size_t
+ra_set_serialized_words(unsigned int count, unsigned int class_count)
+{
+   size_t words = BITSET_WORDS(count);
+
+   return RA_SET_HEADER_WORDS + (size_t)count * words +
+          (size_t)class_count * (1 + words + class_count);
+}
+
+/**
+ * Serializes a finalized register set.
+ *
+ * Returns a buffer allocated out of mem_ctx and stores its size in bytes in
+ * \p size.  The buffer can later be handed to ra_set_deserialize(), for
+ * example after storing it in a cache or generating it at build time, to
+ * recreate the set without recomputing the conflicts and q values.
+ */
+void *
+ra_set_serialize(const struct ra_regs *regs, void *mem_ctx, size_t *size)
+{
+   const unsigned int words = BITSET_WORDS(regs->count);
+   const size_t num = ra_set_serialized_words(regs->count, regs->class_count);
+   uint32_t *data = ralloc_array(mem_ctx, uint32_t, num);
+   uint32_t *p = data;
+   unsigned int i;
+
+   if (!data)
+      return NULL;
+
+   *p++ = RA_SET_SERIALIZE_MAGIC;
+   *p++ = regs->count;
+   *p++ = regs->class_count;
+   *p++ = regs->round_robin;
+
+   for (i = 0; i < regs->count; i++) {
+      memcpy(p, regs->regs[i].conflicts, words * sizeof(BITSET_WORD));
+      p += words;
+   }
+
+   for (i = 0; i < regs->class_count; i++) {
+      const struct ra_class *class = regs->classes[i];
+
+      assert(class->q && "ra_set_serialize() needs a finalized set");
+
+      *p++ = class->p;
+      memcpy(p, class->regs, words * sizeof(BITSET_WORD));
+      p += words;
+      memcpy(p, class->q, regs->class_count * sizeof(unsigned int));
+      p += regs->class_count;
+   }
+
+   assert(p == data + num);
+   *size = num * sizeof(uint32_t);
+   return data;
+}
+
+/**
+ * Creates a finalized register set from the output of ra_set_serialize().
+ *
+ * Returns NULL if the data isn't a serialized register set.
+ */
+struct ra_regs *
+ra_set_deserialize(void *mem_ctx, const void *data, size_t size)
+{
+   const uint32_t *p = (const uint32_t *)data;
+   struct ra_regs *regs;
+   BITSET_WORD *conflicts;
+   unsigned int count, class_count, words, i;
+
+   if (size < RA_SET_HEADER_WORDS * sizeof(uint32_t) ||
+       p[0] != RA_SET_SERIALIZE_MAGIC)
+      return NULL;
+
+   count = p[1];
+   class_count = p[2];
+   words = BITSET_WORDS(count);
+   if (size != ra_set_serialized_words(count, class_count) * sizeof(uint32_t))
+      return NULL;
+
+   regs = rzalloc(mem_ctx, struct ra_regs);
+   regs->count = count;
+   regs->class_count = class_count;
+   regs->round_robin = p[3];
+   p += RA_SET_HEADER_WORDS;
+
+   /* All the conflict bitsets are loaded with a single copy. */
+   regs->regs = rzalloc_array(regs, struct ra_reg, count);
+   conflicts = ralloc_array(regs->regs, BITSET_WORD, (size_t)count * words);
+   memcpy(conflicts, p, (size_t)count * words * sizeof(BITSET_WORD));
+   p += (size_t)count * words;
+
+   for (i = 0; i < count; i++) {
+      regs->regs[i].conflicts = conflicts + (size_t)i * words;
+      regs->regs[i].num_conflicts = 1;
+   }
+
+   regs->classes = ralloc_array(regs->regs, struct ra_class *, class_count);
+   for (i = 0; i < class_count; i++) {
+      struct ra_class *class = rzalloc(regs, struct ra_class);
+
+      class->p = *p++;
+      class->regs = ralloc_array(class, BITSET_WORD, words);
+      memcpy(class->regs, p, words * sizeof(BITSET_WORD));
+      p += words;
+      class->q = ralloc_array(regs, unsigned int, class_count);
+      memcpy(class->q, p, class_count * sizeof(unsigned int));
+      p += class_count;
+
+      regs->classes[i] = class;
+   }
+
+   return regs;
+}
+
+/**
+ * Returns the bit of the interference matrix for the edge between n1 and n2.
+ *
+ * The matrix is symmetric, so only the lower triangle is stored, which halves
+ * its size for the large graphs of compute shaders.
+ */
+static size_t
+ra_adjacency_bit(unsigned int n1, unsigned int n2)
+{
+   if (n1 < n2) {
+      unsigned int tmp = n1;
+      n1 = n2;
+      n2 = tmp;
+   }
+
+   return (size_t)n1 * (n1 - 1) / 2 + n2;
+}
+
 static void
 ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
 {
-   BITSET_SET(g->nodes[n1].adjacency, n2);
-
    assert(n1 != n2);
 
    int n1_class = g->nodes[n1].class;
    int n2_class = g->nodes[n2].class;
    g->nodes[n1].q_total += g->regs->classes[n1_class]->q[n2_class];
+   g->nodes[n1].adjacency_q_total += g->regs->classes[n1_class]->q[n2_class];
 
    if (g->nodes[n1].adjacency_count >=
        g->nodes[n1].adjacency_list_size) {
@@ -426,11 +584,10 @@ ra_alloc_interference_graph(struct ra_regs *regs, unsigned int count)
    g->count = count;
 
    g->stack = rzalloc_array(g, unsigned int, count);
+   g->adjacency = rzalloc_array(g, BITSET_WORD,
+                                BITSET_WORDS((size_t)count * count / 2));
 
    for (i = 0; i < count; i++) {
-      int bitset_count = BITSET_WORDS(count);
-      g->nodes[i].adjacency = rzalloc_array(g, BITSET_WORD, bitset_count);
-
       g->nodes[i].adjacency_list_size = 4;
       g->nodes[i].adjacency_list =
          ralloc_array(g, unsigned int, g->nodes[i].adjacency_list_size);
@@ -464,7 +621,8 @@ void
 ra_add_node_interference(struct ra_graph *g,
                          unsigned int n1, unsigned int n2)
 {
-   if (n1 != n2 && !BITSET_TEST(g->nodes[n1].adjacency, n2)) {
+   if (n1 != n2 && !BITSET_TEST(g->adjacency, ra_adjacency_bit(n1, n2))) {
+      BITSET_SET(g->adjacency, ra_adjacency_bit(n1, n2));
       ra_add_node_adjacency(g, n1, n2);
       ra_add_node_adjacency(g, n2, n1);
    }
@@ -478,6 +636,99 @@ pq_test(struct ra_graph *g, unsigned int n)
    return g->nodes[n].q_total < g->regs->classes[n_class]->p;
 }
 
+static bool
+ra_heap_less(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   /* Among nodes with the same q total, prefer the highest-numbered one. */
+   return g->nodes[n1].q_total < g->nodes[n2].q_total ||
+          (g->nodes[n1].q_total == g->nodes[n2].q_total && n1 > n2);
+}
+
+static void
+ra_heap_set(struct ra_graph *g, unsigned int i, unsigned int n)
+{
+   g->heap[i] = n;
+   g->nodes[n].heap_index = i;
+}
+
+static void
+ra_heap_sift_up(struct ra_graph *g, unsigned int i)
+{
+   unsigned int n = g->heap[i];
+
+   while (i > 0) {
+      unsigned int parent = (i - 1) / 2;
+
+      if (!ra_heap_less(g, n, g->heap[parent]))
+         break;
+
+      ra_heap_set(g, i, g->heap[parent]);
+      i = parent;
+   }
+
+   ra_heap_set(g, i, n);
+}
+
+static void
+ra_heap_sift_down(struct ra_graph *g, unsigned int i)
+{
+   unsigned int n = g->heap[i];
+
+   for (;;) {
+      unsigned int child = 2 * i + 1;
+
+      if (child >= g->heap_count)
+         break;
+
+      if (child + 1 < g->heap_count &&
+          ra_heap_less(g, g->heap[child + 1], g->heap[child]))
+         child++;
+
+      if (!ra_heap_less(g, g->heap[child], n))
+         break;
+
+      ra_heap_set(g, i, g->heap[child]);
+      i = child;
+   }
+
+   ra_heap_set(g, i, n);
+}
+
+/**
+ * Removes and returns the node with the lowest q total from the heap, or
+ * NO_REG if it is empty.
+ */
+static unsigned int
+ra_heap_pop(struct ra_graph *g)
+{
+   if (g->heap_count == 0)
+      return NO_REG;
+
+   unsigned int n = g->heap[0];
+   g->nodes[n].heap_index = NO_REG;
+
+   g->heap_count--;
+   if (g->heap_count > 0) {
+      g->heap[0] = g->heap[g->heap_count];
+      ra_heap_sift_down(g, 0);
+   }
+
+   return n;
+}
+
+static void
+ra_push_stack(struct ra_graph *g, unsigned int n)
+{
+   g->stack[g->stack_count] = n;
+   g->stack_count++;
+   g->nodes[n].in_stack = true;
+}
+
+/**
+ * Removes the edges of node n, which was pushed to the stack, from the q
+ * totals of its neighbors, and pushes the neighbors that become trivially
+ * colorable to the stack as well.
+ */
 static void
 decrement_q(struct ra_graph *g, unsigned int n)
 {
@@ -491,6 +742,16 @@ decrement_q(struct ra_graph *g, unsigned int n)
       if (!g->nodes[n2].in_stack) {
          assert(g->nodes[n2].q_total >= g->regs->classes[n2_class]->q[n_class]);
          g->nodes[n2].q_total -= g->regs->classes[n2_class]->q[n_class];
+
+         if (g->nodes[n2].reg != NO_REG)
+            continue;
+
+         if (pq_test(g, n2)) {
+            /* It's left in the heap, and skipped once it gets popped. */
+            ra_push_stack(g, n2);
+         } else if (g->nodes[n2].heap_index != NO_REG) {
+            ra_heap_sift_up(g, g->nodes[n2].heap_index);
+         }
       }
    }
 }
@@ -500,73 +761,91 @@ decrement_q(struct ra_graph *g, unsigned int n)
  * trivially-colorable nodes into a stack of nodes to be colored,
  * removing them from the graph, and rinsing and repeating.
  *
+ * The stack doubles as the worklist: nodes are pushed as soon as they pass
+ * the pq test, and their edges are removed from the graph as the stack is
+ * walked, so each node and edge is only visited once.
+ *
  * If we encounter a case where we can't push any nodes on the stack, then
  * we optimistically choose a node and push it on the stack. We heuristically
  * push the node with the lowest total q value, since it has the fewest
- * neighbors and therefore is most likely to be allocated.
+ * neighbors and therefore is most likely to be allocated.  The candidates are
+ * kept in a heap that is updated as their q totals decrease.
  */
 static void
 ra_simplify(struct ra_graph *g)
 {
-   bool progress = true;
    unsigned int stack_optimistic_start = UINT_MAX;
+   unsigned int processed = 0;
    int i;
 
-   while (progress) {
-      unsigned int best_optimistic_node = ~0;
-      unsigned int lowest_q_total = ~0;
-
-      progress = false;
-
-      for (i = g->count - 1; i >= 0; i--) {
-	 if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
-	    continue;
-
-	 if (pq_test(g, i)) {
-	    decrement_q(g, i);
-	    g->stack[g->stack_count] = i;
-	    g->stack_count++;
-	    g->nodes[i].in_stack = true;
-	    progress = true;
-	 } else {
-	    unsigned int new_q_total = g->nodes[i].q_total;
-	    if (new_q_total < lowest_q_total) {
-	       best_optimistic_node = i;
-	       lowest_q_total = new_q_total;
-	    }
-	 }
-      }
+   g->heap = ralloc_array(g, unsigned int, g->count);
+   g->heap_count = 0;
 
-      if (!progress && best_optimistic_node != ~0U) {
-         if (stack_optimistic_start == UINT_MAX)
-            stack_optimistic_start = g->stack_count;
+   for (i = g->count - 1; i >= 0; i--) {
+      g->nodes[i].heap_index = NO_REG;
 
-	 decrement_q(g, best_optimistic_node);
-	 g->stack[g->stack_count] = best_optimistic_node;
-	 g->stack_count++;
-	 g->nodes[best_optimistic_node].in_stack = true;
-	 progress = true;
+      if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
+         continue;
+
+      if (pq_test(g, i)) {
+         ra_push_stack(g, i);
+      } else {
+         g->heap[g->heap_count] = i;
+         g->nodes[i].heap_index = g->heap_count;
+         g->heap_count++;
       }
    }
 
+   for (i = g->heap_count / 2 - 1; i >= 0; i--)
+      ra_heap_sift_down(g, i);
+
+   for (;;) {
+      while (processed < g->stack_count)
+         decrement_q(g, g->stack[processed++]);
+
+      unsigned int n;
+      do {
+         n = ra_heap_pop(g);
+      } while (n != NO_REG && g->nodes[n].in_stack);
+
+      if (n == NO_REG)
+         break;
+
+      if (stack_optimistic_start == UINT_MAX)
+         stack_optimistic_start = g->stack_count;
+
+      ra_push_stack(g, n);
+   }
+
+   ralloc_free(g->heap);
+   g->heap = NULL;
+
    g->stack_optimistic_start = stack_optimistic_start;
 }
 
-static bool
-ra_any_neighbors_conflict(struct ra_graph *g, unsigned int n, unsigned int r)
+/**
+ * Returns the first register set in \p regs, starting the search at register
+ * \p start and wrapping around, or NO_REG if there is none.
+ */
+static unsigned int
+ra_find_reg(struct ra_graph *g, const BITSET_WORD *regs, unsigned int start)
 {
-   unsigned int i;
+   const unsigned int words = BITSET_WORDS(g->regs->count);
+   unsigned int w, word;
 
-   for (i = 0; i < g->nodes[n].adjacency_count; i++) {
-      unsigned int n2 = g->nodes[n].adjacency_list[i];
+   start %= g->regs->count;
+   w = BITSET_BITWORD(start);
+   word = regs[w] & (~0u << (start % BITSET_WORDBITS));
 
-      if (!g->nodes[n2].in_stack &&
-          BITSET_TEST(g->regs->regs[r].conflicts, g->nodes[n2].reg)) {
-         return true;
-      }
+   for (unsigned int i = 0; i <= words; i++) {
+      if (word)
+         return (w * BITSET_WORDBITS + ffs(word) - 1);
+
+      w = (w + 1) % words;
+      word = regs[w];
    }
 
-   return false;
+   return NO_REG;
 }
 
 /* Computes a bitfield of what regs are available for a given register
@@ -615,44 +894,31 @@ static bool
 ra_select(struct ra_graph *g)
 {
    int start_search_reg = 0;
-   BITSET_WORD *select_regs = NULL;
-
-   if (g->select_reg_callback)
-      select_regs = malloc(BITSET_WORDS(g->regs->count) * sizeof(BITSET_WORD));
+   BITSET_WORD *select_regs =
+      malloc(BITSET_WORDS(g->regs->count) * sizeof(BITSET_WORD));
 
    while (g->stack_count != 0) {
-      unsigned int ri;
-      unsigned int r = -1;
+      unsigned int r;
       int n = g->stack[g->stack_count - 1];
-      struct ra_class *c = g->regs->classes[g->nodes[n].class];
 
       /* set this to false even if we return here so that
        * ra_get_best_spill_node() considers this node later.
        */
       g->nodes[n].in_stack = false;
 
-      if (g->select_reg_callback) {
-         if (!ra_compute_available_regs(g, n, select_regs)) {
-            free(select_regs);
-            return false;
-         }
+      if (!ra_compute_available_regs(g, n, select_regs)) {
+         free(select_regs);
+         return false;
+      }
 
+      if (g->select_reg_callback) {
          r = g->select_reg_callback(g, select_regs, g->select_reg_callback_data);
       } else {
          /* Find the lowest-numbered reg which is not used by a member
           * of the graph adjacent to us.
           */
-         for (ri = 0; ri < g->regs->count; ri++) {
-            r = (start_search_reg + ri) % g->regs->count;
-            if (!reg_belongs_to_class(r, c))
-               continue;
-
-            if (!ra_any_neighbors_conflict(g, n, r))
-               break;
-         }
-
-         if (ri >= g->regs->count)
-            return false;
+         r = ra_find_reg(g, select_regs, start_search_reg);
+         assert(r != NO_REG);
       }
 
       g->nodes[n].reg = r;
@@ -713,23 +979,16 @@ ra_set_node_reg(struct ra_graph *g, unsigned int n, unsigned int reg)
 static float
 ra_get_spill_benefit(struct ra_graph *g, unsigned int n)
 {
-   unsigned int j;
-   float benefit = 0;
    int n_class = g->nodes[n].class;
 
    /* Define the benefit of eliminating an interference between n, n2
     * through spilling as q(C, B) / p(C).  This is similar to the
     * "count number of edges" approach of traditional graph coloring,
-    * but takes classes into account.
+    * but takes classes into account.  The sum of q(C, B) over all the
+    * neighbors is kept up to date as interferences are added.
     */
-   for (j = 0; j < g->nodes[n].adjacency_count; j++) {
-      unsigned int n2 = g->nodes[n].adjacency_list[j];
-      unsigned int n2_class = g->nodes[n2].class;
-      benefit += ((float)g->regs->classes[n_class]->q[n2_class] /
-                  g->regs->classes[n_class]->p);
-   }
-
-   return benefit;
+   return ((float)g->nodes[n].adjacency_q_total /
+           g->regs->classes[n_class]->p);
 }
 
 /**
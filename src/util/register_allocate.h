@@ -29,6 +29,7 @@
 #define REGISTER_ALLOCATE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "util/bitset.h"
 
 #ifdef __cplusplus
@@ -62,6 +63,17 @@ void ra_set_num_conflicts(struct ra_regs *regs, unsigned int class_a,
 void ra_set_finalize(struct ra_regs *regs, unsigned int **conflicts);
 /** @} */
 
+/** @{ Register set serialization.
+ *
+ * A finalized register set can be serialized and later loaded again
+ * without any of the set-up cost above.
+ */
+void *ra_set_serialize(const struct ra_regs *regs, void *mem_ctx,
+                       size_t *size);
+struct ra_regs *ra_set_deserialize(void *mem_ctx, const void *data,
+                                   size_t size);
+/** @} */
+
 /** @{ Interference graph setup.
  *
  * Each interference graph node is a virtual variable in the IL.  It
@@ -0,0 +1,186 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Times ra_allocate() on large synthetic interference graphs.
+ *
+ * The graphs are built from random live ranges over a register file shaped
+ * like the Intel one (128 registers, with classes of 1 to 4 contiguous
+ * registers).  Nodes that can't be colored are spilled one at a time, the
+ * way backends do, so the numbers include the retries.
+ *
+ * Usage: register_allocate_bench [nodes...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "macros.h"
+#include "os_time.h"
+#include "ralloc.h"
+#include "register_allocate.h"
+
+#define BASE_REGS 128
+#define CLASS_COUNT 4
+
+struct live_range {
+   unsigned int start;
+   unsigned int end;
+   unsigned int class;
+};
+
+static struct ra_regs *
+build_reg_set(void *mem_ctx, unsigned int *classes)
+{
+   unsigned int count = 0;
+
+   for (unsigned int c = 0; c < CLASS_COUNT; c++)
+      count += BASE_REGS - c;
+
+   struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, count, true);
+   ra_set_allocate_round_robin(regs);
+
+   unsigned int reg = 0;
+   for (unsigned int c = 0; c < CLASS_COUNT; c++) {
+      classes[c] = ra_alloc_reg_class(regs);
+
+      for (unsigned int base = 0; base < BASE_REGS - c; base++) {
+         ra_class_add_reg(regs, classes[c], reg);
+         for (unsigned int i = base; i <= base + c; i++)
+            ra_add_reg_conflict(regs, i, reg);
+         reg++;
+      }
+   }
+
+   for (unsigned int r = 0; r < BASE_REGS; r++)
+      ra_make_reg_conflicts_transitive(regs, r);
+
+   ra_set_finalize(regs, NULL);
+   return regs;
+}
+
+/* Mostly short live ranges, with a few long ones like loop-carried values,
+ * so that the register pressure goes above the size of the register file.
+ */
+static void
+make_live_ranges(struct live_range *ranges, unsigned int count)
+{
+   for (unsigned int n = 0; n < count; n++) {
+      unsigned int len = rand() % 100 == 0 ? 50 + rand() % 2000 :
+                                             1 + rand() % 140;
+
+      ranges[n].start = n;
+      ranges[n].end = n + len;
+      ranges[n].class = rand() % 8 == 0 ? 1 + rand() % (CLASS_COUNT - 1) : 0;
+   }
+}
+
+static struct ra_graph *
+build_graph(struct ra_regs *regs, const unsigned int *classes,
+            const struct live_range *ranges, unsigned int count,
+            const bool *spilled)
+{
+   struct ra_graph *g = ra_alloc_interference_graph(regs, count);
+
+   for (unsigned int n = 0; n < count; n++) {
+      ra_set_node_class(g, n, classes[ranges[n].class]);
+      ra_set_node_spill_cost(g, n, spilled[n] ? 0.0f :
+                             1.0f + (float)(ranges[n].end - ranges[n].start));
+   }
+
+   /* Ranges are sorted by start, so each one interferes with the following
+    * ones that start before it ends.  Spilled nodes only live for an
+    * instruction around each use, so their interference is dropped.
+    */
+   for (unsigned int n = 0; n < count; n++) {
+      if (spilled[n])
+         continue;
+
+      for (unsigned int m = n + 1; m < count && ranges[m].start < ranges[n].end;
+           m++) {
+         if (!spilled[m])
+            ra_add_node_interference(g, n, m);
+      }
+   }
+
+   return g;
+}
+
+static void
+run(struct ra_regs *regs, const unsigned int *classes, unsigned int count)
+{
+   struct live_range *ranges = malloc(count * sizeof(*ranges));
+   bool *spilled = calloc(count, sizeof(*spilled));
+   unsigned int spills = 0;
+   int64_t build_time = 0, alloc_time = 0;
+
+   make_live_ranges(ranges, count);
+
+   for (;;) {
+      int64_t start = os_time_get_nano();
+      struct ra_graph *g = build_graph(regs, classes, ranges, count, spilled);
+      int64_t built = os_time_get_nano();
+
+      bool success = ra_allocate(g);
+      int node = success ? -1 : ra_get_best_spill_node(g);
+      int64_t end = os_time_get_nano();
+
+      build_time += built - start;
+      alloc_time += end - built;
+      ralloc_free(g);
+
+      if (success || node < 0)
+         break;
+
+      spilled[node] = true;
+      spills++;
+   }
+
+   printf("%8u nodes: %4u spills, build %8.2f ms, allocate %8.2f ms\n",
+          count, spills, build_time / 1e6, alloc_time / 1e6);
+
+   free(ranges);
+   free(spilled);
+}
+
+int
+main(int argc, char **argv)
+{
+   static const unsigned int default_counts[] = { 1000, 4000, 16000 };
+   void *mem_ctx = ralloc_context(NULL);
+   unsigned int classes[CLASS_COUNT];
+   struct ra_regs *regs = build_reg_set(mem_ctx, classes);
+
+   srand(0);
+
+   if (argc > 1) {
+      for (int i = 1; i < argc; i++)
+         run(regs, classes, strtoul(argv[i], NULL, 0));
+   } else {
+      for (unsigned int i = 0; i < ARRAY_SIZE(default_counts); i++)
+         run(regs, classes, default_counts[i]);
+   }
+
+   ralloc_free(mem_ctx);
+   return 0;
+}
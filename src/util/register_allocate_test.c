@@ -0,0 +1,188 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Force assertions, even on release builds. */
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ralloc.h"
+#include "register_allocate.h"
+
+#define BASE_REGS 16
+#define NUM_NODES 24
+
+/* A set of single registers and of unaligned register pairs, like the
+ * ones backends build at start-up.
+ */
+static struct ra_regs *
+build_reg_set(void *mem_ctx, unsigned int *single, unsigned int *pair)
+{
+   struct ra_regs *regs =
+      ra_alloc_reg_set(mem_ctx, BASE_REGS + BASE_REGS - 1, true);
+
+   *single = ra_alloc_reg_class(regs);
+   *pair = ra_alloc_reg_class(regs);
+
+   for (unsigned int i = 0; i < BASE_REGS; i++)
+      ra_class_add_reg(regs, *single, i);
+
+   for (unsigned int i = 0; i < BASE_REGS - 1; i++) {
+      unsigned int reg = BASE_REGS + i;
+
+      ra_class_add_reg(regs, *pair, reg);
+      ra_add_transitive_reg_conflict(regs, i, reg);
+      ra_add_transitive_reg_conflict(regs, i + 1, reg);
+   }
+
+   ra_set_finalize(regs, NULL);
+   return regs;
+}
+
+static void
+allocate(struct ra_regs *regs, unsigned int single, unsigned int pair,
+         unsigned int *result)
+{
+   struct ra_graph *g = ra_alloc_interference_graph(regs, NUM_NODES);
+
+   for (unsigned int n = 0; n < NUM_NODES; n++)
+      ra_set_node_class(g, n, n % 3 ? single : pair);
+
+   /* Each node interferes with the next few ones. */
+   for (unsigned int n = 0; n < NUM_NODES; n++) {
+      for (unsigned int m = n + 1; m < NUM_NODES && m < n + 5; m++)
+         ra_add_node_interference(g, n, m);
+   }
+
+   assert(ra_allocate(g));
+
+   for (unsigned int n = 0; n < NUM_NODES; n++)
+      result[n] = ra_get_node_reg(g, n);
+
+   ralloc_free(g);
+}
+
+/* Returns the first and last base register used by reg. */
+static void
+reg_range(unsigned int reg, unsigned int *first, unsigned int *last)
+{
+   if (reg < BASE_REGS) {
+      *first = *last = reg;
+   } else {
+      *first = reg - BASE_REGS;
+      *last = *first + 1;
+   }
+}
+
+/* Random graphs, most of which need optimistic coloring, either get a valid
+ * coloring or a node to spill.
+ */
+static void
+test_random_graphs(struct ra_regs *regs, unsigned int single,
+                   unsigned int pair)
+{
+   const unsigned int count = 200;
+
+   srand(0);
+
+   for (unsigned int iter = 0; iter < 50; iter++) {
+      struct ra_graph *g = ra_alloc_interference_graph(regs, count);
+      bool *adjacent = calloc(count * count, sizeof(bool));
+
+      for (unsigned int n = 0; n < count; n++) {
+         ra_set_node_class(g, n, rand() % 4 ? single : pair);
+         ra_set_node_spill_cost(g, n, 1.0f + rand() % 10);
+      }
+
+      for (unsigned int n = 0; n < count; n++) {
+         for (unsigned int m = n + 1; m < count && m < n + 26; m++) {
+            if (rand() % 2 == 0) {
+               ra_add_node_interference(g, n, m);
+               adjacent[n * count + m] = true;
+            }
+         }
+      }
+
+      if (!ra_allocate(g)) {
+         assert(ra_get_best_spill_node(g) >= 0);
+      } else {
+         for (unsigned int n = 0; n < count; n++) {
+            for (unsigned int m = n + 1; m < count; m++) {
+               unsigned int n_first, n_last, m_first, m_last;
+
+               if (!adjacent[n * count + m])
+                  continue;
+
+               reg_range(ra_get_node_reg(g, n), &n_first, &n_last);
+               reg_range(ra_get_node_reg(g, m), &m_first, &m_last);
+               assert(n_last < m_first || m_last < n_first);
+            }
+         }
+      }
+
+      free(adjacent);
+      ralloc_free(g);
+   }
+}
+
+int
+main(int argc, char **argv)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   unsigned int single, pair;
+   unsigned int expected[NUM_NODES], result[NUM_NODES];
+   size_t size, size2;
+
+   struct ra_regs *regs = build_reg_set(mem_ctx, &single, &pair);
+   void *data = ra_set_serialize(regs, mem_ctx, &size);
+   assert(data && size > 0);
+
+   struct ra_regs *loaded = ra_set_deserialize(mem_ctx, data, size);
+   assert(loaded);
+
+   /* Serializing the loaded set gives back the same data. */
+   void *data2 = ra_set_serialize(loaded, mem_ctx, &size2);
+   assert(size2 == size);
+   assert(memcmp(data, data2, size) == 0);
+
+   /* Both sets allocate identically. */
+   allocate(regs, single, pair, expected);
+   allocate(loaded, single, pair, result);
+   assert(memcmp(expected, result, sizeof(result)) == 0);
+
+   /* Truncated or foreign data is rejected. */
+   assert(ra_set_deserialize(mem_ctx, data, size - 4) == NULL);
+   memset(data2, 0, size);
+   assert(ra_set_deserialize(mem_ctx, data2, size) == NULL);
+
+   test_random_graphs(regs, single, pair);
+   test_random_graphs(loaded, single, pair);
+
+   ralloc_free(mem_ctx);
+
+   printf("All tests passed.\n");
+   return 0;
+}
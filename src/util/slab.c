@@ -41,17 +41,16 @@
 #define CHECK_MAGIC(element, value)
 #endif
 
+/* Value of slab_page_header::remote_free once the page is orphaned. */
+#define SLAB_PAGE_ORPHANED ((struct slab_element_header *)(intptr_t)1)
+
 /* One array element within a big buffer. */
 struct slab_element_header {
-   /* The next element in the free or migrated list. */
+   /* The next element in the free or remote free list. */
    struct slab_element_header *next;
 
-   /* This is either
-    * - a pointer to the child pool to which this element belongs, or
-    * - a pointer to the orphaned page of the element, with the least
-    *   significant bit set to 1.
-    */
-   intptr_t owner;
+   /* The page of this element. */
+   struct slab_page_header *page;
 
 #ifdef DEBUG
    intptr_t magic;
@@ -67,6 +66,29 @@ struct slab_page_header {
       /* Number of remaining, non-freed elements (for orphaned pages). */
       unsigned num_remaining;
    } u;
+
+   /* The child pool that owns the page, or NULL once it is orphaned. */
+   struct slab_child_pool *owner;
+
+   /* Elements of the page that were freed with a different child pool as
+    * the argument to slab_free.  Other threads push to this list without
+    * locking, and the owner takes the whole list at once when it runs out
+    * of free elements.  It is set to SLAB_PAGE_ORPHANED when the owner is
+    * destroyed.
+    */
+   struct slab_element_header *remote_free;
+
+   /* Next page in the owner's remote_pages list.  The free that makes
+    * remote_free non-empty pushes the page onto that list.
+    */
+   struct slab_page_header *remote_next;
+
+   /* Number of frees from other child pools that may still push the page
+    * onto the owner's remote_pages list.  Destroying the owner waits for
+    * them.
+    */
+   int pins;
+
    /* Memory after the last member is dedicated to the page itself.
     * The allocated size is always larger than this structure.
     */
@@ -81,20 +103,44 @@ slab_get_element(struct slab_parent_pool *parent,
           ((uint8_t*)&page[1] + (parent->element_size * index));
 }
 
-/* The given object/element belongs to an orphaned page (i.e. the owning child
- * pool has been destroyed). Mark the element as freed and free the whole page
- * when no elements are left in it.
+/* An element of the page was freed after the owning child pool was
+ * destroyed. Free the whole page when no elements are left in it.
+ */
+static void
+slab_free_orphaned(struct slab_page_header *page)
+{
+   if (!p_atomic_dec_return(&page->u.num_remaining))
+      free(page);
+}
+
+/* Takes the elements that were freed by other child pools, from the pages
+ * on the remote_pages list.
  */
 static void
-slab_free_orphaned(struct slab_element_header *elt)
+slab_reclaim_remote_free(struct slab_child_pool *pool)
 {
    struct slab_page_header *page;
 
-   assert(elt->owner & 1);
+   if (!p_atomic_read(&pool->remote_pages))
+      return;
 
-   page = (struct slab_page_header *)(elt->owner & ~(intptr_t)1);
-   if (!p_atomic_dec_return(&page->u.num_remaining))
-      free(page);
+   page = p_atomic_xchg_ptr(&pool->remote_pages, NULL);
+
+   while (page) {
+      /* The page can be pushed again as soon as remote_free is empty. */
+      struct slab_page_header *next = page->remote_next;
+      struct slab_element_header *list, *tail;
+
+      list = p_atomic_xchg_ptr(&page->remote_free, NULL);
+      if (list) {
+         for (tail = list; tail->next; tail = tail->next)
+            ;
+         tail->next = pool->free;
+         pool->free = list;
+      }
+
+      page = next;
+   }
 }
 
 /**
@@ -108,7 +154,6 @@ slab_create_parent(struct slab_parent_pool *parent,
                    unsigned item_size,
                    unsigned num_items)
 {
-   mtx_init(&parent->mutex, mtx_plain);
    parent->element_size = ALIGN(sizeof(struct slab_element_header) + item_size,
                                 sizeof(intptr_t));
    parent->num_elements = num_items;
@@ -117,7 +162,6 @@ slab_create_parent(struct slab_parent_pool *parent,
 void
 slab_destroy_parent(struct slab_parent_pool *parent)
 {
-   mtx_destroy(&parent->mutex);
 }
 
 /**
@@ -129,7 +173,7 @@ void slab_create_child(struct slab_child_pool *pool,
    pool->parent = parent;
    pool->pages = NULL;
    pool->free = NULL;
-   pool->migrated = NULL;
+   pool->remote_pages = NULL;
 }
 
 /**
@@ -143,31 +187,37 @@ void slab_destroy_child(struct slab_child_pool *pool)
    if (!pool->parent)
       return; /* the slab probably wasn't even created */
 
-   mtx_lock(&pool->parent->mutex);
-
+   /* Count the free elements before any page can be freed. */
    while (pool->pages) {
       struct slab_page_header *page = pool->pages;
+      struct slab_element_header *remote;
+
       pool->pages = page->u.next;
       p_atomic_set(&page->u.num_remaining, pool->parent->num_elements);
 
-      for (unsigned i = 0; i < pool->parent->num_elements; ++i) {
-         struct slab_element_header *elt = slab_get_element(pool->parent, page, i);
-         p_atomic_set(&elt->owner, (intptr_t)page | 1);
-      }
-   }
+      /* Elements freed by other pools from now on see the orphaned page. */
+      remote = p_atomic_xchg_ptr(&page->remote_free, SLAB_PAGE_ORPHANED);
 
-   while (pool->migrated) {
-      struct slab_element_header *elt = pool->migrated;
-      pool->migrated = elt->next;
-      slab_free_orphaned(elt);
-   }
+      /* Earlier frees may still be pushing the page onto remote_pages.
+       * They are only a few instructions away from done.
+       */
+      while (p_atomic_read(&page->pins))
+         thrd_yield();
+
+      /* Only now, since those frees still look up the owner. */
+      p_atomic_set(&page->owner, NULL);
 
-   mtx_unlock(&pool->parent->mutex);
+      while (remote) {
+         struct slab_element_header *elt = remote;
+         remote = elt->next;
+         slab_free_orphaned(page);
+      }
+   }
 
    while (pool->free) {
       struct slab_element_header *elt = pool->free;
       pool->free = elt->next;
-      slab_free_orphaned(elt);
+      slab_free_orphaned(elt->page);
    }
 
    /* Guard against use-after-free. */
@@ -183,10 +233,14 @@ slab_add_new_page(struct slab_child_pool *pool)
    if (!page)
       return false;
 
+   page->owner = pool;
+   page->remote_free = NULL;
+   page->remote_next = NULL;
+   page->pins = 0;
+
    for (unsigned i = 0; i < pool->parent->num_elements; ++i) {
       struct slab_element_header *elt = slab_get_element(pool->parent, page, i);
-      elt->owner = (intptr_t)pool;
-      assert(!(elt->owner & 1));
+      elt->page = page;
 
       elt->next = pool->free;
       pool->free = elt;
@@ -213,10 +267,7 @@ slab_alloc(struct slab_child_pool *pool)
       /* First, collect elements that belong to us but were freed from a
        * different child pool.
        */
-      mtx_lock(&pool->parent->mutex);
-      pool->free = pool->migrated;
-      pool->migrated = NULL;
-      mtx_unlock(&pool->parent->mutex);
+      slab_reclaim_remote_free(pool);
 
       /* Now allocate a new page. */
       if (!pool->free && !slab_add_new_page(pool))
@@ -239,17 +290,19 @@ slab_alloc(struct slab_child_pool *pool)
  *
  * Freeing an object in a different child pool from the one where it was
  * allocated is allowed, as long the pool belong to the same parent. No
- * additional locking is required in this case.
+ * locking is involved in this case either.
  */
 void slab_free(struct slab_child_pool *pool, void *ptr)
 {
    struct slab_element_header *elt = ((struct slab_element_header*)ptr - 1);
-   intptr_t owner_int;
+   struct slab_page_header *page = elt->page;
+   struct slab_element_header *head;
+   bool pinned = false;
 
    CHECK_MAGIC(elt, SLAB_MAGIC_ALLOCATED);
    SET_MAGIC(elt, SLAB_MAGIC_FREE);
 
-   if (p_atomic_read(&elt->owner) == (intptr_t)pool) {
+   if (p_atomic_read(&page->owner) == pool) {
       /* This is the simple case: The caller guarantees that we can safely
        * access the free list.
        */
@@ -258,24 +311,60 @@ void slab_free(struct slab_child_pool *pool, void *ptr)
       return;
    }
 
-   /* The slow case: migration or an orphaned page. */
-   mtx_lock(&pool->parent->mutex);
-
-   /* Note: we _must_ re-read elt->owner here because the owning child pool
-    * may have been destroyed by another thread in the meantime.
+   /* The slow case: push the element to the remote free list of its page,
+    * unless the owning child pool was destroyed in the meantime.  Only the
+    * page is touched, since it can't go away while the element is
+    * allocated, unlike the owning pool.
+    *
+    * The free that makes the list non-empty also pushes the page onto the
+    * owner's remote_pages list.  It pins the page first, which keeps the
+    * owner from being destroyed until then, since the page may be freed as
+    * soon as the element is on the remote free list.
     */
-   owner_int = p_atomic_read(&elt->owner);
+   head = p_atomic_read(&page->remote_free);
+   for (;;) {
+      struct slab_element_header *old;
+
+      if (head == SLAB_PAGE_ORPHANED) {
+         if (pinned)
+            p_atomic_dec(&page->pins);
+         slab_free_orphaned(page);
+         return;
+      }
 
-   if (!(owner_int & 1)) {
-      struct slab_child_pool *owner = (struct slab_child_pool *)owner_int;
-      elt->next = owner->migrated;
-      owner->migrated = elt;
-      mtx_unlock(&pool->parent->mutex);
-   } else {
-      mtx_unlock(&pool->parent->mutex);
+      if (!head && !pinned) {
+         p_atomic_inc(&page->pins);
+         pinned = true;
+         head = p_atomic_read(&page->remote_free);
+         continue;
+      }
 
-      slab_free_orphaned(elt);
+      elt->next = head;
+      old = p_atomic_cmpxchg_ptr(&page->remote_free, head, elt);
+      if (old == head)
+         break;
+      head = old;
    }
+
+   if (!pinned)
+      return;
+
+   if (!head) {
+      struct slab_child_pool *owner = p_atomic_read(&page->owner);
+      struct slab_page_header *first = p_atomic_read(&owner->remote_pages);
+
+      for (;;) {
+         struct slab_page_header *old;
+
+         page->remote_next = first;
+         old = p_atomic_cmpxchg_ptr(&owner->remote_pages, first, page);
+         if (old == first)
+            break;
+         first = old;
+      }
+   }
+
+   p_atomic_dec(&page->pins);
 }
 
 /**
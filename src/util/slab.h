@@ -32,8 +32,10 @@
  *
  * Allocations obtained from one child pool should usually be freed in the
  * same child pool. Freeing an allocation in a different child pool associated
- * to the same parent is allowed (and requires no locking by the caller), but
- * it is discouraged because it implies a performance penalty.
+ * to the same parent is allowed (and requires no locking by the caller). It
+ * is slower, but lock-free: the allocation is pushed to a list of its page
+ * with an atomic operation, and the owning pool takes the whole list back
+ * when it runs out of free allocations.
  *
  * For convenience and to ease the transition, there is also a set of wrapper
  * functions around a single parent-child pair.
@@ -48,7 +50,6 @@ struct slab_element_header;
 struct slab_page_header;
 
 struct slab_parent_pool {
-   mtx_t mutex;
    unsigned element_size;
    unsigned num_elements;
 };
@@ -61,12 +62,10 @@ struct slab_child_pool {
    /* Free elements. */
    struct slab_element_header *free;
 
-   /* Elements that are owned by this pool but were freed with a different
-    * pool as the argument to slab_free.
-    *
-    * This list is protected by the parent mutex.
+   /* Pages that other child pools freed elements of since they were last
+    * reclaimed.  Other threads push to this list without locking.
     */
-   struct slab_element_header *migrated;
+   struct slab_page_header *remote_pages;
 };
 
 void slab_create_parent(struct slab_parent_pool *parent,
@@ -0,0 +1,170 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Measures slab allocations that are freed by another thread, like the
+ * transfers of u_threaded_context.
+ *
+ * Two threads each allocate objects from their own child pool and pass them
+ * to the other thread through a ring buffer, and free the objects they
+ * receive from the other thread.  Each thread can also keep a number of
+ * objects allocated throughout, so that its pool has many pages.
+ *
+ * Usage: slab_bench [objects per thread] [resident objects per thread]
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "c11/threads.h"
+#include "os_time.h"
+#include "slab.h"
+#include "u_atomic.h"
+
+#define RING_SIZE 1024
+
+struct ring {
+   void *items[RING_SIZE];
+   unsigned head; /* written by the producer */
+   unsigned tail; /* written by the consumer */
+};
+
+struct bench_thread {
+   struct slab_child_pool pool;
+   struct ring *send;
+   struct ring *receive;
+   unsigned count;
+   unsigned num_resident;
+   void **resident;
+};
+
+static struct slab_parent_pool parent;
+
+static bool
+ring_push(struct ring *ring, void *item)
+{
+   unsigned head = ring->head;
+
+   if (head - p_atomic_read(&ring->tail) == RING_SIZE)
+      return false;
+
+   ring->items[head % RING_SIZE] = item;
+   p_atomic_set(&ring->head, head + 1);
+   return true;
+}
+
+static void *
+ring_pop(struct ring *ring)
+{
+   unsigned tail = ring->tail;
+   void *item;
+
+   if (p_atomic_read(&ring->head) == tail)
+      return NULL;
+
+   item = ring->items[tail % RING_SIZE];
+   p_atomic_set(&ring->tail, tail + 1);
+   return item;
+}
+
+static int
+bench_thread_run(void *data)
+{
+   struct bench_thread *thread = (struct bench_thread *)data;
+   unsigned sent = 0, received = 0;
+   void *item = NULL;
+
+   for (unsigned i = 0; i < thread->num_resident; i++)
+      thread->resident[i] = slab_alloc(&thread->pool);
+
+   while (sent < thread->count || received < thread->count) {
+      bool progress = false;
+
+      if (sent < thread->count) {
+         if (!item)
+            item = slab_alloc(&thread->pool);
+         if (ring_push(thread->send, item)) {
+            item = NULL;
+            sent++;
+            progress = true;
+         }
+      }
+
+      void *other = ring_pop(thread->receive);
+      if (other) {
+         slab_free(&thread->pool, other);
+         received++;
+         progress = true;
+      }
+
+      /* Don't spin against the other thread on a single CPU. */
+      if (!progress)
+         thrd_yield();
+   }
+
+   for (unsigned i = 0; i < thread->num_resident; i++)
+      slab_free(&thread->pool, thread->resident[i]);
+
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned count = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000000;
+   unsigned num_resident = argc > 2 ? strtoul(argv[2], NULL, 0) : 0;
+   struct ring *rings = calloc(2, sizeof(*rings));
+   struct bench_thread threads[2];
+   thrd_t handles[2];
+
+   slab_create_parent(&parent, 64, 64);
+
+   for (unsigned i = 0; i < 2; i++) {
+      slab_create_child(&threads[i].pool, &parent);
+      threads[i].send = &rings[i];
+      threads[i].receive = &rings[1 - i];
+      threads[i].count = count;
+      threads[i].num_resident = num_resident;
+      threads[i].resident = calloc(num_resident, sizeof(void *));
+   }
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < 2; i++)
+      thrd_create(&handles[i], bench_thread_run, &threads[i]);
+   for (unsigned i = 0; i < 2; i++)
+      thrd_join(handles[i], NULL);
+   int64_t end = os_time_get_nano();
+
+   printf("%u cross-thread alloc/free pairs per thread, %u resident: "
+          "%.2f ms, %.1f ns per pair\n", count, num_resident,
+          (end - start) / 1e6, (double)(end - start) / count);
+
+   for (unsigned i = 0; i < 2; i++) {
+      slab_destroy_child(&threads[i].pool);
+      free(threads[i].resident);
+   }
+   slab_destroy_parent(&parent);
+   free(rings);
+   return 0;
+}
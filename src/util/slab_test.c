@@ -0,0 +1,153 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Force assertions, even on release builds. */
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "c11/threads.h"
+#include "slab.h"
+#include "u_atomic.h"
+
+#define NUM_ITEMS 16
+#define NUM_OBJECTS 1024
+
+static struct slab_parent_pool parent;
+
+/* Objects freed in another pool come back to the owner once its free list
+ * runs out, without new pages.
+ */
+static void
+test_remote_free(void)
+{
+   struct slab_child_pool owner, other;
+   void *objects[NUM_OBJECTS];
+
+   slab_create_child(&owner, &parent);
+   slab_create_child(&other, &parent);
+
+   for (unsigned i = 0; i < NUM_OBJECTS; i++)
+      objects[i] = slab_alloc(&owner);
+
+   for (unsigned i = 0; i < NUM_OBJECTS; i++)
+      slab_free(&other, objects[i]);
+
+   /* NUM_OBJECTS fills whole pages, so all the allocations must be
+    * reclaimed ones.
+    */
+   for (unsigned i = 0; i < NUM_OBJECTS; i++) {
+      void *ptr = slab_alloc(&owner);
+      bool found = false;
+
+      for (unsigned j = i; j < NUM_OBJECTS; j++) {
+         if (objects[j] == ptr) {
+            objects[j] = objects[i];
+            objects[i] = ptr;
+            found = true;
+            break;
+         }
+      }
+      assert(found);
+   }
+
+   for (unsigned i = 0; i < NUM_OBJECTS; i++)
+      slab_free(&owner, objects[i]);
+
+   slab_destroy_child(&owner);
+   slab_destroy_child(&other);
+}
+
+struct free_thread {
+   struct slab_child_pool *pool;
+   void **objects;
+   unsigned count;
+   int *started;
+};
+
+static int
+free_thread_run(void *data)
+{
+   struct free_thread *thread = (struct free_thread *)data;
+
+   p_atomic_set(thread->started, 1);
+   for (unsigned i = 0; i < thread->count; i++)
+      slab_free(thread->pool, thread->objects[i]);
+
+   return 0;
+}
+
+/* Objects can be freed by another thread while their pool is destroyed.
+ * Every page must still be freed exactly once, which a leak checker or a
+ * memory error checker will notice.
+ */
+static void
+test_free_during_destroy(void)
+{
+   struct slab_child_pool owner, other;
+   struct free_thread thread;
+   void **objects = malloc(NUM_OBJECTS * sizeof(void *));
+   int started = 0;
+   thrd_t handle;
+
+   slab_create_child(&owner, &parent);
+   slab_create_child(&other, &parent);
+
+   for (unsigned i = 0; i < NUM_OBJECTS; i++)
+      objects[i] = slab_alloc(&owner);
+
+   thread.pool = &other;
+   thread.objects = objects;
+   thread.count = NUM_OBJECTS / 2;
+   thread.started = &started;
+   thrd_create(&handle, free_thread_run, &thread);
+
+   while (!p_atomic_read(&started))
+      thrd_yield();
+   slab_destroy_child(&owner);
+   thrd_join(handle, NULL);
+
+   for (unsigned i = NUM_OBJECTS / 2; i < NUM_OBJECTS; i++)
+      slab_free(&other, objects[i]);
+
+   slab_destroy_child(&other);
+   free(objects);
+}
+
+int
+main(int argc, char **argv)
+{
+   slab_create_parent(&parent, 24, NUM_ITEMS);
+
+   test_remote_free();
+   for (unsigned i = 0; i < 100; i++)
+      test_free_during_destroy();
+
+   slab_destroy_parent(&parent);
+
+   printf("All tests passed.\n");
+   return 0;
+}
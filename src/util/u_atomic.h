@@ -49,6 +49,7 @@
 #define p_atomic_inc_return(v) __atomic_add_fetch((v), 1, __ATOMIC_ACQ_REL)
 #define p_atomic_dec_return(v) __atomic_sub_fetch((v), 1, __ATOMIC_ACQ_REL)
 #define p_atomic_xchg(v, i) __atomic_exchange_n((v), (i), __ATOMIC_ACQ_REL)
+#define p_atomic_xchg_ptr(v, i) __atomic_exchange_n((v), (i), __ATOMIC_ACQ_REL)
 #define PIPE_NATIVE_ATOMIC_XCHG
 
 #else
@@ -70,6 +71,8 @@
  */
 #define p_atomic_cmpxchg(v, old, _new) \
    __sync_val_compare_and_swap((v), (old), (_new))
+#define p_atomic_cmpxchg_ptr(v, old, _new) \
+   __sync_val_compare_and_swap((v), (old), (_new))
 
 #endif
 
@@ -91,6 +94,7 @@
 #define p_atomic_inc_return(_v) (++(*(_v)))
 #define p_atomic_dec_return(_v) (--(*(_v)))
 #define p_atomic_cmpxchg(_v, _old, _new) (*(_v) == (_old) ? (*(_v) = (_new), (_old)) : *(_v))
+#define p_atomic_cmpxchg_ptr(_v, _old, _new) p_atomic_cmpxchg(_v, _old, _new)
 
 #endif
 
@@ -156,6 +160,11 @@
    sizeof *(_v) == sizeof(__int64) ? InterlockedCompareExchange64 ((__int64 *)(_v), (__int64)(_new), (__int64)(_old)) : \
                                      (assert(!"should not get here"), 0))
 
+#define p_atomic_cmpxchg_ptr(_v, _old, _new) \
+   InterlockedCompareExchangePointer((PVOID volatile *)(_v), (PVOID)(_new), (PVOID)(_old))
+#define p_atomic_xchg_ptr(_v, _i) \
+   InterlockedExchangePointer((PVOID volatile *)(_v), (PVOID)(_i))
+
 #endif
 
 #if defined(PIPE_ATOMIC_OS_SOLARIS)
@@ -217,6 +226,10 @@
    sizeof(*v) == sizeof(uint64_t) ? atomic_cas_64((uint64_t *)(v), (uint64_t)(old), (uint64_t)(_new)) : \
                                     (assert(!"should not get here"), 0))
 
+#define p_atomic_cmpxchg_ptr(v, old, _new) \
+   atomic_cas_ptr((void *)(v), (void *)(old), (void *)(_new))
+#define p_atomic_xchg_ptr(v, i) atomic_swap_ptr((void *)(v), (void *)(i))
+
 #endif
 
 #ifndef PIPE_ATOMIC
@@ -252,4 +265,23 @@ static inline uint64_t p_atomic_xchg_64(uint64_t *v, uint64_t i)
                                       (assert(!"should not get here"), 0))
 #endif
 
+/* p_atomic_cmpxchg_ptr and p_atomic_xchg_ptr work on pointers to pointers
+ * of any type.  Unlike p_atomic_cmpxchg and p_atomic_xchg, they don't go
+ * through integer types, which not every implementation can do for pointers.
+ */
+#ifndef p_atomic_xchg_ptr
+static inline void *p_atomic_xchg_ptr_loop(void **v, void *i)
+{
+   void *actual = p_atomic_read(v);
+   void *expected;
+   do {
+      expected = actual;
+      actual = p_atomic_cmpxchg_ptr(v, expected, i);
+   } while (expected != actual);
+   return actual;
+}
+
+#define p_atomic_xchg_ptr(v, i) p_atomic_xchg_ptr_loop((void **)(v), (void *)(i))
+#endif
+
 #endif /* U_ATOMIC_H */
@@ -26,13 +26,18 @@
 
 #include "u_queue.h"
 
+#include <stdlib.h>
 #include <time.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #include "util/os_time.h"
 #include "util/u_string.h"
 #include "util/u_thread.h"
 
 static void util_queue_killall_and_wait(struct util_queue *queue);
+static void util_queue_shared_pool_kill(void);
 
 /****************************************************************************
  * Wait for all queues to assert idle when exit() is called.
@@ -56,6 +61,8 @@ atexit_handler(void)
       util_queue_killall_and_wait(iter);
    }
    mtx_unlock(&exit_mutex);
+
+   util_queue_shared_pool_kill();
 }
 
 static void
@@ -220,129 +227,283 @@ util_queue_fence_destroy(struct util_queue_fence *fence)
    mtx_destroy(&fence->mutex);
 }
 #endif
-
 /****************************************************************************
- * util_queue implementation
+ * Thread pool
+ *
+ * The pool doesn't see individual jobs. Its threads pass around tokens,
+ * which are references to queues that have a queued job and haven't reached
+ * their concurrency limit yet. The thread that takes a token executes the
+ * highest-priority job of the referenced queue.
+ *
+ * Every thread has its own token deque per priority level. New tokens are
+ * distributed round-robin, or pushed to the deque of the current thread if
+ * they are created by a pool thread. A thread takes the newest token of its
+ * own deque, and if that's empty, steals the oldest token of a sibling.
+ *
+ * Lock order: pool->lock, queue->lock, worker->lock, pool->sleep_lock.
  */
 
-struct thread_input {
+struct util_queue_deque {
+   struct util_queue **tokens;
+   unsigned size; /* power of two */
+   unsigned read_idx, write_idx;
+};
+
+struct util_queue_worker {
+   struct util_queue_pool *pool;
+   unsigned index;
+   mtx_t lock;
+   int num_tokens[UTIL_QUEUE_NUM_PRIORITIES]; /* atomic, for lockless peeking */
+   struct util_queue_deque deques[UTIL_QUEUE_NUM_PRIORITIES];
+};
+
+struct util_queue_pool {
+   const char *name;
+   unsigned num_workers;
+   unsigned num_threads; /* number of threads that still need to be joined */
+   struct util_queue_worker *workers;
+   thrd_t *threads;
+   unsigned next_worker; /* atomic */
+
+   /* Jobs waiting for their dependencies, protected by lock. num_blocked
+    * is only modified with lock held, and lets pool threads skip the lock
+    * when nothing waits.
+    */
+   mtx_t lock;
+   struct list_head blocked_jobs;
+   int num_blocked; /* atomic */
+
+   /* Idle threads wait on has_work_cond. num_tokens is only incremented
+    * with sleep_lock held.
+    */
+   mtx_t sleep_lock;
+   cnd_t has_work_cond;
+   int num_tokens;
+   int kill;
+};
+
+struct util_queue_blocked_job {
+   struct list_head head;
    struct util_queue *queue;
-   int thread_index;
+   struct util_queue_job job;
+   enum util_queue_priority priority;
+   unsigned num_deps;
+   struct util_queue_fence **deps;
 };
 
-static int
-util_queue_thread_func(void *input)
+static void
+util_queue_run_token(struct util_queue *queue, unsigned worker_index);
+
+static void
+util_queue_deque_push(struct util_queue_deque *deque, struct util_queue *queue)
+{
+   if (deque->write_idx - deque->read_idx == deque->size) {
+      unsigned new_size = MAX2(deque->size * 2, 16);
+      struct util_queue **tokens =
+         (struct util_queue **)malloc(new_size * sizeof(*tokens));
+      unsigned num = 0;
+
+      assert(tokens);
+
+      for (unsigned i = deque->read_idx; i != deque->write_idx; i++)
+         tokens[num++] = deque->tokens[i & (deque->size - 1)];
+
+      free(deque->tokens);
+      deque->tokens = tokens;
+      deque->size = new_size;
+      deque->read_idx = 0;
+      deque->write_idx = num;
+   }
+
+   deque->tokens[deque->write_idx++ & (deque->size - 1)] = queue;
+}
+
+/* Remove all tokens referencing \p queue and return how many there were. */
+static unsigned
+util_queue_deque_purge(struct util_queue_deque *deque, struct util_queue *queue)
 {
-   struct util_queue *queue = ((struct thread_input*)input)->queue;
-   int thread_index = ((struct thread_input*)input)->thread_index;
+   unsigned write_idx = deque->read_idx;
 
-   free(input);
+   for (unsigned i = deque->read_idx; i != deque->write_idx; i++) {
+      struct util_queue *token = deque->tokens[i & (deque->size - 1)];
 
-   if (queue->name) {
-      char name[16];
-      util_snprintf(name, sizeof(name), "%s:%i", queue->name, thread_index);
-      u_thread_setname(name);
+      if (token != queue)
+         deque->tokens[write_idx++ & (deque->size - 1)] = token;
    }
 
-   while (1) {
-      struct util_queue_job job;
+   unsigned removed = deque->write_idx - write_idx;
+   deque->write_idx = write_idx;
+   return removed;
+}
 
-      mtx_lock(&queue->lock);
-      assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
+static void
+util_queue_pool_push_token(struct util_queue_pool *pool,
+                           struct util_queue *queue,
+                           enum util_queue_priority priority,
+                           int worker_index)
+{
+   struct util_queue_worker *worker;
 
-      /* wait if the queue is empty */
-      while (!queue->kill_threads && queue->num_queued == 0)
-         cnd_wait(&queue->has_queued_cond, &queue->lock);
+   if (worker_index < 0) {
+      worker_index = p_atomic_inc_return(&pool->next_worker) %
+                     pool->num_workers;
+   }
+   worker = &pool->workers[worker_index];
 
-      if (queue->kill_threads) {
-         mtx_unlock(&queue->lock);
-         break;
-      }
+   mtx_lock(&worker->lock);
+   util_queue_deque_push(&worker->deques[priority], queue);
+   p_atomic_inc(&worker->num_tokens[priority]);
+   mtx_unlock(&worker->lock);
 
-      job = queue->jobs[queue->read_idx];
-      memset(&queue->jobs[queue->read_idx], 0, sizeof(struct util_queue_job));
-      queue->read_idx = (queue->read_idx + 1) % queue->max_jobs;
+   mtx_lock(&pool->sleep_lock);
+   p_atomic_inc(&pool->num_tokens);
+   cnd_signal(&pool->has_work_cond);
+   mtx_unlock(&pool->sleep_lock);
+}
 
-      queue->num_queued--;
-      cnd_signal(&queue->has_space_cond);
-      mtx_unlock(&queue->lock);
+static struct util_queue *
+util_queue_pool_take_token(struct util_queue_pool *pool, unsigned self)
+{
+   for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+      for (unsigned i = 0; i < pool->num_workers; i++) {
+         struct util_queue_worker *worker =
+            &pool->workers[(self + i) % pool->num_workers];
+         struct util_queue_deque *deque = &worker->deques[prio];
+         struct util_queue *queue = NULL;
+
+         if (!p_atomic_read(&worker->num_tokens[prio]))
+            continue;
+
+         mtx_lock(&worker->lock);
+         if (deque->read_idx != deque->write_idx) {
+            if (i == 0) {
+               /* Our own deque: take the newest token. */
+               queue = deque->tokens[--deque->write_idx & (deque->size - 1)];
+            } else {
+               /* Steal the oldest token. */
+               queue = deque->tokens[deque->read_idx++ & (deque->size - 1)];
+            }
+            p_atomic_dec(&worker->num_tokens[prio]);
+            p_atomic_dec(&pool->num_tokens);
+         }
+         mtx_unlock(&worker->lock);
 
-      if (job.job) {
-         job.execute(job.job, thread_index);
-         util_queue_fence_signal(job.fence);
-         if (job.cleanup)
-            job.cleanup(job.job, thread_index);
+         if (queue)
+            return queue;
       }
    }
+   return NULL;
+}
 
-   /* signal remaining jobs before terminating */
-   mtx_lock(&queue->lock);
-   for (unsigned i = queue->read_idx; i != queue->write_idx;
-        i = (i + 1) % queue->max_jobs) {
-      if (queue->jobs[i].job) {
-         util_queue_fence_signal(queue->jobs[i].fence);
-         queue->jobs[i].job = NULL;
+static int
+util_queue_pool_thread_func(void *input)
+{
+   struct util_queue_worker *worker = (struct util_queue_worker *)input;
+   struct util_queue_pool *pool = worker->pool;
+
+   if (pool->name) {
+      char name[16];
+      util_snprintf(name, sizeof(name), "%s:%i", pool->name, worker->index);
+      u_thread_setname(name);
+   }
+
+   while (!p_atomic_read(&pool->kill)) {
+      struct util_queue *queue =
+         util_queue_pool_take_token(pool, worker->index);
+
+      if (queue) {
+         util_queue_run_token(queue, worker->index);
+         continue;
       }
+
+      /* wait if there is nothing to do */
+      mtx_lock(&pool->sleep_lock);
+      while (!pool->kill && p_atomic_read(&pool->num_tokens) <= 0)
+         cnd_wait(&pool->has_work_cond, &pool->sleep_lock);
+      mtx_unlock(&pool->sleep_lock);
    }
-   queue->read_idx = queue->write_idx;
-   queue->num_queued = 0;
-   mtx_unlock(&queue->lock);
+
    return 0;
 }
 
-bool
-util_queue_init(struct util_queue *queue,
-                const char *name,
-                unsigned max_jobs,
-                unsigned num_threads,
-                unsigned flags)
+static void
+util_queue_pool_kill(struct util_queue_pool *pool)
 {
-   unsigned i;
+   mtx_lock(&pool->sleep_lock);
+   p_atomic_set(&pool->kill, 1);
+   cnd_broadcast(&pool->has_work_cond);
+   mtx_unlock(&pool->sleep_lock);
+
+   for (unsigned i = 0; i < pool->num_threads; i++)
+      thrd_join(pool->threads[i], NULL);
+   pool->num_threads = 0;
+}
 
-   memset(queue, 0, sizeof(*queue));
-   queue->name = name;
-   queue->flags = flags;
-   queue->num_threads = num_threads;
-   queue->max_jobs = max_jobs;
+static void
+util_queue_pool_destroy(struct util_queue_pool *pool)
+{
+   util_queue_pool_kill(pool);
 
-   queue->jobs = (struct util_queue_job*)
-                 calloc(max_jobs, sizeof(struct util_queue_job));
-   if (!queue->jobs)
-      goto fail;
+   for (unsigned i = 0; i < pool->num_workers; i++) {
+      for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++)
+         free(pool->workers[i].deques[prio].tokens);
+      mtx_destroy(&pool->workers[i].lock);
+   }
 
-   (void) mtx_init(&queue->lock, mtx_plain);
+   cnd_destroy(&pool->has_work_cond);
+   mtx_destroy(&pool->sleep_lock);
+   mtx_destroy(&pool->lock);
+   free(pool->workers);
+   free(pool->threads);
+   free(pool);
+}
 
-   queue->num_queued = 0;
-   cnd_init(&queue->has_queued_cond);
-   cnd_init(&queue->has_space_cond);
+static struct util_queue_pool *
+util_queue_pool_create(const char *name, unsigned num_threads,
+                       bool minimum_priority)
+{
+   struct util_queue_pool *pool =
+      (struct util_queue_pool *)calloc(1, sizeof(*pool));
+   unsigned i;
+
+   if (!pool)
+      return NULL;
 
-   queue->threads = (thrd_t*) calloc(num_threads, sizeof(thrd_t));
-   if (!queue->threads)
+   pool->name = name;
+   pool->num_workers = num_threads;
+   (void) mtx_init(&pool->lock, mtx_plain);
+   (void) mtx_init(&pool->sleep_lock, mtx_plain);
+   cnd_init(&pool->has_work_cond);
+   LIST_INITHEAD(&pool->blocked_jobs);
+
+   pool->workers = (struct util_queue_worker *)
+                   calloc(num_threads, sizeof(*pool->workers));
+   pool->threads = (thrd_t *)calloc(num_threads, sizeof(thrd_t));
+   if (!pool->workers || !pool->threads)
       goto fail;
 
-   /* start threads */
    for (i = 0; i < num_threads; i++) {
-      struct thread_input *input =
-         (struct thread_input *) malloc(sizeof(struct thread_input));
-      input->queue = queue;
-      input->thread_index = i;
-
-      queue->threads[i] = u_thread_create(util_queue_thread_func, input);
+      pool->workers[i].pool = pool;
+      pool->workers[i].index = i;
+      (void) mtx_init(&pool->workers[i].lock, mtx_plain);
+   }
 
-      if (!queue->threads[i]) {
-         free(input);
+   /* start threads */
+   for (i = 0; i < num_threads; i++) {
+      pool->threads[i] = u_thread_create(util_queue_pool_thread_func,
+                                         &pool->workers[i]);
 
-         if (i == 0) {
-            /* no threads created, fail */
+      if (!pool->threads[i]) {
+         /* If at least one thread was created, use it. The deques of the
+          * missing threads are still drained by stealing.
+          */
+         if (i == 0)
             goto fail;
-         } else {
-            /* at least one thread created, so use it */
-            queue->num_threads = i;
-            break;
-         }
+         break;
       }
+      pool->num_threads++;
 
-      if (flags & UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY) {
+      if (minimum_priority) {
    #if defined(__linux__) && defined(SCHED_IDLE)
          struct sched_param sched_param = {0};
 
@@ -352,42 +513,371 @@ util_queue_init(struct util_queue *queue,
           * Note that Linux only allows decreasing the priority. The original
           * priority can't be restored.
           */
-         pthread_setschedparam(queue->threads[i], SCHED_IDLE, &sched_param);
+         pthread_setschedparam(pool->threads[i], SCHED_IDLE, &sched_param);
    #endif
       }
    }
 
-   add_to_atexit_list(queue);
-   return true;
+   return pool;
 
 fail:
-   free(queue->threads);
+   if (pool->workers) {
+      for (i = 0; i < num_threads; i++)
+         mtx_destroy(&pool->workers[i].lock);
+   }
+   cnd_destroy(&pool->has_work_cond);
+   mtx_destroy(&pool->sleep_lock);
+   mtx_destroy(&pool->lock);
+   free(pool->workers);
+   free(pool->threads);
+   free(pool);
+   return NULL;
+}
+
+/****************************************************************************
+ * The process-wide pool used by UTIL_QUEUE_INIT_SHARED_POOL queues
+ */
+
+static once_flag shared_pool_once_flag = ONCE_FLAG_INIT;
+static struct util_queue_pool *shared_pool;
+
+static unsigned
+util_queue_get_num_cpus(void)
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+   long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+   if (num_cpus > 0)
+      return num_cpus;
+#endif
+   return 1;
+}
+
+static void
+shared_pool_init(void)
+{
+   const char *str = getenv("MESA_SHARED_QUEUE_THREADS");
+   unsigned num_threads = str ? strtoul(str, NULL, 10) : 0;
 
-   if (queue->jobs) {
-      cnd_destroy(&queue->has_space_cond);
-      cnd_destroy(&queue->has_queued_cond);
-      mtx_destroy(&queue->lock);
-      free(queue->jobs);
+   if (!num_threads)
+      num_threads = util_queue_get_num_cpus();
+
+   shared_pool = util_queue_pool_create("mesa_pool", num_threads, false);
+}
+
+static void
+util_queue_shared_pool_kill(void)
+{
+   if (shared_pool)
+      util_queue_pool_kill(shared_pool);
+}
+
+/****************************************************************************
+ * util_queue implementation
+ */
+
+static void
+util_queue_ring_push(struct util_queue_ring *ring,
+                     const struct util_queue_job *job)
+{
+   if (ring->write_idx - ring->read_idx == ring->size) {
+      unsigned new_size = MAX2(ring->size * 2, 8);
+      struct util_queue_job *jobs =
+         (struct util_queue_job*)malloc(new_size * sizeof(*jobs));
+      unsigned num_jobs = 0;
+
+      assert(jobs);
+
+      /* Copy all queued jobs into the new ring. */
+      for (unsigned i = ring->read_idx; i != ring->write_idx; i++)
+         jobs[num_jobs++] = ring->jobs[i & (ring->size - 1)];
+
+      free(ring->jobs);
+      ring->jobs = jobs;
+      ring->size = new_size;
+      ring->read_idx = 0;
+      ring->write_idx = num_jobs;
+   }
+
+   ring->jobs[ring->write_idx++ & (ring->size - 1)] = *job;
+}
+
+/* Return the highest priority with a queued job. The rings can contain
+ * dropped jobs, so this is only a hint for the token priority.
+ */
+static enum util_queue_priority
+util_queue_top_priority(struct util_queue *queue)
+{
+   for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+      if (queue->rings[prio].read_idx != queue->rings[prio].write_idx)
+         return (enum util_queue_priority)prio;
+   }
+   return UTIL_QUEUE_PRIORITY_LOW;
+}
+
+static bool
+util_queue_pop_job(struct util_queue *queue, struct util_queue_job *job)
+{
+   for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+      struct util_queue_ring *ring = &queue->rings[prio];
+
+      while (ring->read_idx != ring->write_idx) {
+         *job = ring->jobs[ring->read_idx++ & (ring->size - 1)];
+
+         /* Dropped jobs are cleared and treated as no-ops. */
+         if (job->job) {
+            queue->num_queued--;
+            return true;
+         }
+      }
    }
-   /* also util_queue_is_initialized can be used to check for success */
-   memset(queue, 0, sizeof(*queue));
    return false;
 }
 
+/* Make sure enough tokens are in flight for the queued jobs, up to the
+ * concurrency limit of the queue. Must be called with queue->lock held.
+ */
 static void
-util_queue_killall_and_wait(struct util_queue *queue)
+util_queue_schedule(struct util_queue *queue, int worker_index)
 {
-   unsigned i;
+   while (!queue->kill_threads &&
+          queue->num_tokens < queue->num_queued &&
+          queue->num_running + queue->num_tokens < (int)queue->num_threads) {
+      queue->num_tokens++;
+      util_queue_pool_push_token(queue->pool, queue,
+                                 util_queue_top_priority(queue),
+                                 worker_index);
+   }
+}
+
+static bool
+util_queue_deps_signalled(struct util_queue_fence **deps, unsigned num_deps)
+{
+   for (unsigned i = 0; i < num_deps; i++) {
+      if (!util_queue_fence_is_signalled(deps[i]))
+         return false;
+   }
+   return true;
+}
+
+/* Move the jobs whose dependencies are signalled to their queues. */
+static void
+util_queue_pool_release_blocked(struct util_queue_pool *pool, int worker_index)
+{
+   struct util_queue_blocked_job *iter, *tmp;
+
+   if (!p_atomic_read(&pool->num_blocked))
+      return;
+
+   mtx_lock(&pool->lock);
+   LIST_FOR_EACH_ENTRY_SAFE(iter, tmp, &pool->blocked_jobs, head) {
+      struct util_queue *queue = iter->queue;
+
+      if (!util_queue_deps_signalled(iter->deps, iter->num_deps))
+         continue;
+
+      LIST_DEL(&iter->head);
+      p_atomic_dec(&pool->num_blocked);
+
+      mtx_lock(&queue->lock);
+      queue->num_blocked--;
+      util_queue_ring_push(&queue->rings[iter->priority], &iter->job);
+      queue->num_queued++;
+      util_queue_schedule(queue, worker_index);
+      mtx_unlock(&queue->lock);
+
+      free(iter);
+   }
+   mtx_unlock(&pool->lock);
+}
+
+static void
+util_queue_run_token(struct util_queue *queue, unsigned worker_index)
+{
+   struct util_queue_job job;
+   unsigned thread_index;
 
-   /* Signal all threads to terminate. */
+   mtx_lock(&queue->lock);
+   queue->num_tokens--;
+
+   if (queue->kill_threads || !util_queue_pop_job(queue, &job)) {
+      if (!queue->num_running)
+         cnd_broadcast(&queue->idle_cond);
+      mtx_unlock(&queue->lock);
+      return;
+   }
+
+   assert(queue->num_free_slots > 0);
+   thread_index = queue->free_slots[--queue->num_free_slots];
+   queue->slots[thread_index].seqno = job.seqno;
+   queue->slots[thread_index].worker = worker_index;
+   queue->num_running++;
+   cnd_signal(&queue->has_space_cond);
+   mtx_unlock(&queue->lock);
+
+   job.execute(job.job, thread_index);
+   util_queue_fence_signal(job.fence);
+   if (job.cleanup)
+      job.cleanup(job.job, thread_index);
+
+   util_queue_pool_release_blocked(queue->pool, worker_index);
+
+   mtx_lock(&queue->lock);
+   queue->slots[thread_index].seqno = UINT64_MAX;
+   queue->free_slots[queue->num_free_slots++] = thread_index;
+   queue->num_running--;
+   util_queue_schedule(queue, worker_index);
+   if (!queue->num_running || queue->num_finish_waiters)
+      cnd_broadcast(&queue->idle_cond);
+   mtx_unlock(&queue->lock);
+}
+
+/* Stop executing jobs of the queue. Jobs that haven't started are signalled
+ * without being executed, and running jobs are waited for.
+ */
+static void
+util_queue_kill(struct util_queue *queue)
+{
+   struct util_queue_pool *pool = queue->pool;
+   struct util_queue_blocked_job *iter, *tmp;
+
+   mtx_lock(&pool->lock);
    mtx_lock(&queue->lock);
    queue->kill_threads = 1;
-   cnd_broadcast(&queue->has_queued_cond);
+
+   /* signal remaining jobs */
+   LIST_FOR_EACH_ENTRY_SAFE(iter, tmp, &pool->blocked_jobs, head) {
+      if (iter->queue == queue) {
+         LIST_DEL(&iter->head);
+         p_atomic_dec(&pool->num_blocked);
+         util_queue_fence_signal(iter->job.fence);
+         free(iter);
+      }
+   }
+   queue->num_blocked = 0;
+   mtx_unlock(&pool->lock);
+   cnd_broadcast(&queue->idle_cond);
+
+   for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+      struct util_queue_ring *ring = &queue->rings[prio];
+
+      for (unsigned i = ring->read_idx; i != ring->write_idx; i++) {
+         struct util_queue_job *job = &ring->jobs[i & (ring->size - 1)];
+
+         if (job->job)
+            util_queue_fence_signal(job->fence);
+      }
+      ring->read_idx = ring->write_idx;
+   }
+   queue->num_queued = 0;
+   cnd_broadcast(&queue->has_space_cond);
+
+   /* Remove our tokens from the pool. Tokens that have already been taken
+    * are accounted for when the pool thread gets to them.
+    */
+   for (unsigned i = 0; i < pool->num_workers; i++) {
+      struct util_queue_worker *worker = &pool->workers[i];
+
+      mtx_lock(&worker->lock);
+      for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+         unsigned removed =
+            util_queue_deque_purge(&worker->deques[prio], queue);
+
+         p_atomic_add(&worker->num_tokens[prio], -(int)removed);
+         p_atomic_add(&pool->num_tokens, -(int)removed);
+         queue->num_tokens -= removed;
+      }
+      mtx_unlock(&worker->lock);
+   }
+
+   while (queue->num_running || queue->num_tokens)
+      cnd_wait(&queue->idle_cond, &queue->lock);
    mtx_unlock(&queue->lock);
 
-   for (i = 0; i < queue->num_threads; i++)
-      thrd_join(queue->threads[i], NULL);
-   queue->num_threads = 0;
+   /* Jobs of other queues can depend on the fences signalled above. */
+   util_queue_pool_release_blocked(pool, -1);
+}
+
+bool
+util_queue_init(struct util_queue *queue,
+                const char *name,
+                unsigned max_jobs,
+                unsigned num_threads,
+                unsigned flags)
+{
+   memset(queue, 0, sizeof(*queue));
+   queue->name = name;
+   queue->flags = flags;
+   queue->num_threads = num_threads;
+   queue->max_jobs = max_jobs;
+   queue->default_priority = UTIL_QUEUE_PRIORITY_NORMAL;
+
+   (void) mtx_init(&queue->lock, mtx_plain);
+   cnd_init(&queue->has_space_cond);
+   cnd_init(&queue->idle_cond);
+
+   if (flags & UTIL_QUEUE_INIT_SHARED_POOL) {
+      call_once(&shared_pool_once_flag, shared_pool_init);
+      if (!shared_pool)
+         goto fail;
+
+      queue->pool = shared_pool;
+      if (flags & UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY)
+         queue->default_priority = UTIL_QUEUE_PRIORITY_LOW;
+
+      /* No more jobs than the pool has threads can run at once. */
+      queue->num_threads = MIN2(num_threads, shared_pool->num_workers);
+   } else {
+      queue->pool = util_queue_pool_create(name, num_threads,
+                                           flags & UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY);
+      if (!queue->pool)
+         goto fail;
+
+      /* at least one thread created, so use it */
+      queue->threads = queue->pool->threads;
+      queue->num_threads = queue->pool->num_threads;
+   }
+
+   queue->free_slots = (unsigned*)calloc(queue->num_threads, sizeof(unsigned));
+   queue->slots = (struct util_queue_slot*)
+                  calloc(queue->num_threads, sizeof(*queue->slots));
+   if (!queue->free_slots || !queue->slots)
+      goto fail;
+
+   /* Hand out the lowest thread indices first. */
+   for (unsigned i = 0; i < queue->num_threads; i++) {
+      queue->free_slots[i] = queue->num_threads - 1 - i;
+      queue->slots[i].seqno = UINT64_MAX;
+      queue->slots[i].worker = i % queue->pool->num_workers;
+   }
+   queue->num_free_slots = queue->num_threads;
+
+   add_to_atexit_list(queue);
+   return true;
+
+fail:
+   if (queue->pool && !(flags & UTIL_QUEUE_INIT_SHARED_POOL)) {
+      util_queue_pool_kill(queue->pool);
+      util_queue_pool_destroy(queue->pool);
+   }
+   free(queue->free_slots);
+   free(queue->slots);
+   cnd_destroy(&queue->idle_cond);
+   cnd_destroy(&queue->has_space_cond);
+   mtx_destroy(&queue->lock);
+
+   /* also util_queue_is_initialized can be used to check for success */
+   memset(queue, 0, sizeof(*queue));
+   return false;
+}
+
+static void
+util_queue_killall_and_wait(struct util_queue *queue)
+{
+   util_queue_kill(queue);
+
+   if (!(queue->flags & UTIL_QUEUE_INIT_SHARED_POOL))
+      util_queue_pool_kill(queue->pool);
 }
 
 void
@@ -396,21 +886,30 @@ util_queue_destroy(struct util_queue *queue)
    util_queue_killall_and_wait(queue);
    remove_from_atexit_list(queue);
 
+   if (!(queue->flags & UTIL_QUEUE_INIT_SHARED_POOL))
+      util_queue_pool_destroy(queue->pool);
+
+   for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++)
+      free(queue->rings[prio].jobs);
+
+   cnd_destroy(&queue->idle_cond);
    cnd_destroy(&queue->has_space_cond);
-   cnd_destroy(&queue->has_queued_cond);
    mtx_destroy(&queue->lock);
-   free(queue->jobs);
-   free(queue->threads);
+   free(queue->free_slots);
+   free(queue->slots);
 }
 
 void
-util_queue_add_job(struct util_queue *queue,
-                   void *job,
-                   struct util_queue_fence *fence,
-                   util_queue_execute_func execute,
-                   util_queue_execute_func cleanup)
+util_queue_add_job_with_priority(struct util_queue *queue,
+                                 void *job,
+                                 struct util_queue_fence *fence,
+                                 util_queue_execute_func execute,
+                                 util_queue_execute_func cleanup,
+                                 enum util_queue_priority priority)
 {
-   struct util_queue_job *ptr;
+   struct util_queue_job entry;
+
+   assert(priority < UTIL_QUEUE_NUM_PRIORITIES);
 
    mtx_lock(&queue->lock);
    if (queue->kill_threads) {
@@ -423,53 +922,111 @@ util_queue_add_job(struct util_queue *queue,
 
    util_queue_fence_reset(fence);
 
-   assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
+   assert(queue->num_queued >= 0);
 
-   if (queue->num_queued == queue->max_jobs) {
-      if (queue->flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL) {
-         /* If the queue is full, make it larger to avoid waiting for a free
-          * slot.
-          */
-         unsigned new_max_jobs = queue->max_jobs + 8;
-         struct util_queue_job *jobs =
-            (struct util_queue_job*)calloc(new_max_jobs,
-                                           sizeof(struct util_queue_job));
-         assert(jobs);
-
-         /* Copy all queued jobs into the new list. */
-         unsigned num_jobs = 0;
-         unsigned i = queue->read_idx;
-
-         do {
-            jobs[num_jobs++] = queue->jobs[i];
-            i = (i + 1) % queue->max_jobs;
-         } while (i != queue->write_idx);
-
-         assert(num_jobs == queue->num_queued);
-
-         free(queue->jobs);
-         queue->jobs = jobs;
-         queue->read_idx = 0;
-         queue->write_idx = num_jobs;
-         queue->max_jobs = new_max_jobs;
-      } else {
-         /* Wait until there is a free slot. */
-         while (queue->num_queued == queue->max_jobs)
-            cnd_wait(&queue->has_space_cond, &queue->lock);
+   if (!(queue->flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL)) {
+      /* Wait until there is a free slot. */
+      while (queue->num_queued >= queue->max_jobs && !queue->kill_threads)
+         cnd_wait(&queue->has_space_cond, &queue->lock);
+
+      if (queue->kill_threads) {
+         mtx_unlock(&queue->lock);
+         util_queue_fence_signal(fence);
+         return;
       }
    }
 
-   ptr = &queue->jobs[queue->write_idx];
-   assert(ptr->job == NULL);
-   ptr->job = job;
-   ptr->fence = fence;
-   ptr->execute = execute;
-   ptr->cleanup = cleanup;
-   queue->write_idx = (queue->write_idx + 1) % queue->max_jobs;
-
+   entry.job = job;
+   entry.fence = fence;
+   entry.execute = execute;
+   entry.cleanup = cleanup;
+   entry.seqno = queue->next_seqno++;
+   util_queue_ring_push(&queue->rings[priority], &entry);
    queue->num_queued++;
-   cnd_signal(&queue->has_queued_cond);
+
+   util_queue_schedule(queue, -1);
+   mtx_unlock(&queue->lock);
+}
+
+void
+util_queue_add_job(struct util_queue *queue,
+                   void *job,
+                   struct util_queue_fence *fence,
+                   util_queue_execute_func execute,
+                   util_queue_execute_func cleanup)
+{
+   util_queue_add_job_with_priority(queue, job, fence, execute, cleanup,
+                                    queue->default_priority);
+}
+
+/**
+ * Add a job that isn't started before all fences in \p deps are signalled.
+ *
+ * The dependencies must be fences of jobs that were added to a queue sharing
+ * the pool of \p queue (or to \p queue itself), or already signalled.
+ * Dependencies on other fences are only noticed when a job of the pool
+ * completes.
+ */
+void
+util_queue_add_job_with_deps(struct util_queue *queue,
+                             void *job,
+                             struct util_queue_fence *fence,
+                             util_queue_execute_func execute,
+                             util_queue_execute_func cleanup,
+                             enum util_queue_priority priority,
+                             struct util_queue_fence **deps,
+                             unsigned num_deps)
+{
+   struct util_queue_pool *pool = queue->pool;
+   struct util_queue_blocked_job *blocked;
+
+   assert(priority < UTIL_QUEUE_NUM_PRIORITIES);
+
+   /* Pool threads check num_blocked after signalling a fence, and take
+    * pool->lock to release the blocked jobs if it's nonzero. Counting the
+    * job before checking its dependencies makes sure that either the check
+    * sees the fence signalled or the pool thread sees the job.
+    */
+   mtx_lock(&pool->lock);
+   p_atomic_inc(&pool->num_blocked);
+   if (util_queue_deps_signalled(deps, num_deps)) {
+      p_atomic_dec(&pool->num_blocked);
+      mtx_unlock(&pool->lock);
+      util_queue_add_job_with_priority(queue, job, fence, execute, cleanup,
+                                       priority);
+      return;
+   }
+
+   blocked = (struct util_queue_blocked_job *)
+             malloc(sizeof(*blocked) + num_deps * sizeof(*blocked->deps));
+   assert(blocked);
+
+   blocked->queue = queue;
+   blocked->job.job = job;
+   blocked->job.fence = fence;
+   blocked->job.execute = execute;
+   blocked->job.cleanup = cleanup;
+   blocked->priority = priority;
+   blocked->num_deps = num_deps;
+   blocked->deps = (struct util_queue_fence **)(blocked + 1);
+   memcpy(blocked->deps, deps, num_deps * sizeof(*deps));
+
+   mtx_lock(&queue->lock);
+   if (queue->kill_threads) {
+      p_atomic_dec(&pool->num_blocked);
+      mtx_unlock(&queue->lock);
+      mtx_unlock(&pool->lock);
+      free(blocked);
+      return;
+   }
+
+   util_queue_fence_reset(fence);
+   blocked->job.seqno = queue->next_seqno++;
+   queue->num_blocked++;
    mtx_unlock(&queue->lock);
+
+   LIST_ADDTAIL(&blocked->head, &pool->blocked_jobs);
+   mtx_unlock(&pool->lock);
 }
 
 /**
@@ -485,71 +1042,161 @@ util_queue_add_job(struct util_queue *queue,
 void
 util_queue_drop_job(struct util_queue *queue, struct util_queue_fence *fence)
 {
+   struct util_queue_blocked_job *iter, *tmp;
    bool removed = false;
 
    if (util_queue_fence_is_signalled(fence))
       return;
 
+   mtx_lock(&queue->pool->lock);
    mtx_lock(&queue->lock);
-   for (unsigned i = queue->read_idx; i != queue->write_idx;
-        i = (i + 1) % queue->max_jobs) {
-      if (queue->jobs[i].fence == fence) {
-         if (queue->jobs[i].cleanup)
-            queue->jobs[i].cleanup(queue->jobs[i].job, -1);
-
-         /* Just clear it. The threads will treat as a no-op job. */
-         memset(&queue->jobs[i], 0, sizeof(queue->jobs[i]));
+
+   LIST_FOR_EACH_ENTRY_SAFE(iter, tmp, &queue->pool->blocked_jobs, head) {
+      if (iter->queue == queue && iter->job.fence == fence) {
+         if (iter->job.cleanup)
+            iter->job.cleanup(iter->job.job, -1);
+
+         LIST_DEL(&iter->head);
+         p_atomic_dec(&queue->pool->num_blocked);
+         free(iter);
+         queue->num_blocked--;
          removed = true;
          break;
       }
    }
+
+   for (unsigned prio = 0;
+        prio < UTIL_QUEUE_NUM_PRIORITIES && !removed; prio++) {
+      struct util_queue_ring *ring = &queue->rings[prio];
+
+      for (unsigned i = ring->read_idx; i != ring->write_idx; i++) {
+         struct util_queue_job *job = &ring->jobs[i & (ring->size - 1)];
+
+         if (job->job && job->fence == fence) {
+            if (job->cleanup)
+               job->cleanup(job->job, -1);
+
+            /* Just clear it. The threads will treat as a no-op job. */
+            memset(job, 0, sizeof(*job));
+            queue->num_queued--;
+            cnd_signal(&queue->has_space_cond);
+            removed = true;
+            break;
+         }
+      }
+   }
+
+   if (removed && ((!queue->num_queued && !queue->num_blocked &&
+                    !queue->num_running) || queue->num_finish_waiters))
+      cnd_broadcast(&queue->idle_cond);
+
    mtx_unlock(&queue->lock);
+   mtx_unlock(&queue->pool->lock);
 
-   if (removed)
+   if (removed) {
       util_queue_fence_signal(fence);
-   else
+
+      /* Jobs waiting for the dropped one can run now. */
+      util_queue_pool_release_blocked(queue->pool, -1);
+   } else {
       util_queue_fence_wait(fence);
+   }
 }
 
-static void
-util_queue_finish_execute(void *data, int num_thread)
+/* Return the lowest sequence number of the jobs that haven't completed, or
+ * UINT64_MAX if there are none. Must be called with pool->lock and
+ * queue->lock held.
+ */
+static uint64_t
+util_queue_oldest_seqno(struct util_queue *queue)
 {
-   util_barrier *barrier = data;
-   util_barrier_wait(barrier);
+   struct util_queue_blocked_job *iter;
+   uint64_t oldest = UINT64_MAX;
+
+   /* Rings aren't sorted, because jobs whose dependencies were resolved are
+    * queued after newer jobs. Dropped jobs are cleared and don't count.
+    */
+   for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+      struct util_queue_ring *ring = &queue->rings[prio];
+
+      for (unsigned i = ring->read_idx; i != ring->write_idx; i++) {
+         struct util_queue_job *job = &ring->jobs[i & (ring->size - 1)];
+
+         if (job->job)
+            oldest = MIN2(oldest, job->seqno);
+      }
+   }
+
+   LIST_FOR_EACH_ENTRY(iter, &queue->pool->blocked_jobs, head) {
+      if (iter->queue == queue)
+         oldest = MIN2(oldest, iter->job.seqno);
+   }
+
+   for (unsigned i = 0; i < queue->num_threads; i++)
+      oldest = MIN2(oldest, queue->slots[i].seqno);
+
+   return oldest;
 }
 
 /**
  * Wait until all previously added jobs have completed.
+ *
+ * Jobs that are still waiting for dependencies are waited for as well. Jobs
+ * added after the call started aren't waited for, so other threads that
+ * keep adding jobs can't delay the return indefinitely.
  */
 void
 util_queue_finish(struct util_queue *queue)
 {
-   util_barrier barrier;
-   struct util_queue_fence *fences = malloc(queue->num_threads * sizeof(*fences));
-
-   util_barrier_init(&barrier, queue->num_threads);
+   uint64_t end;
 
-   for (unsigned i = 0; i < queue->num_threads; ++i) {
-      util_queue_fence_init(&fences[i]);
-      util_queue_add_job(queue, &barrier, &fences[i], util_queue_finish_execute, NULL);
-   }
+   mtx_lock(&queue->lock);
+   end = queue->next_seqno;
+   mtx_unlock(&queue->lock);
 
-   for (unsigned i = 0; i < queue->num_threads; ++i) {
-      util_queue_fence_wait(&fences[i]);
-      util_queue_fence_destroy(&fences[i]);
-   }
+   for (;;) {
+      /* The blocked jobs are protected by the pool lock, which has to be
+       * taken first.
+       */
+      mtx_lock(&queue->pool->lock);
+      mtx_lock(&queue->lock);
+      bool done = util_queue_oldest_seqno(queue) >= end;
+      mtx_unlock(&queue->pool->lock);
 
-   util_barrier_destroy(&barrier);
+      if (done) {
+         mtx_unlock(&queue->lock);
+         return;
+      }
 
-   free(fences);
+      /* Completions and dropped jobs broadcast idle_cond while there are
+       * waiters, and both need queue->lock, so none can be missed.
+       */
+      queue->num_finish_waiters++;
+      cnd_wait(&queue->idle_cond, &queue->lock);
+      queue->num_finish_waiters--;
+      mtx_unlock(&queue->lock);
+   }
 }
 
 int64_t
 util_queue_get_thread_time_nano(struct util_queue *queue, unsigned thread_index)
 {
+   unsigned worker;
+
    /* Allow some flexibility by not raising an error. */
    if (thread_index >= queue->num_threads)
       return 0;
 
-   return u_thread_get_time_nano(queue->threads[thread_index]);
+   /* thread_index only identifies the job's slot. Report the pool thread
+    * that ran the last job using the slot. Threads of the shared pool also
+    * run jobs of other queues, which are included in their time.
+    */
+   mtx_lock(&queue->lock);
+   worker = queue->slots[thread_index].worker;
+   mtx_unlock(&queue->lock);
+
+   if (worker >= queue->pool->num_threads)
+      return 0;
+
+   return u_thread_get_time_nano(queue->pool->threads[worker]);
 }
@@ -28,6 +28,20 @@
  *
  * Jobs can be added from any thread. After that, the wait call can be used
  * to wait for completion of the job.
+ *
+ * Every queue is a client of a thread pool. By default the queue owns a
+ * private pool with num_threads threads. Queues created with
+ * UTIL_QUEUE_INIT_SHARED_POOL instead share one process-wide pool sized to
+ * the number of CPUs, so that several compiler queues don't oversubscribe
+ * the machine; their num_threads is clamped to the size of the pool. In both
+ * cases, num_threads is the maximum number of jobs of the queue that execute
+ * concurrently, and the thread_index passed to the job callbacks is in
+ * [0, num_threads) and unique among the queue's running jobs.
+ *
+ * Each pool thread has its own deque of runnable work per priority level and
+ * steals from its siblings when it runs dry. Jobs can be given a priority and
+ * a list of fences they depend on; such a job isn't started before all its
+ * dependencies are signalled.
  */
 
 #ifndef U_QUEUE_H
@@ -48,6 +62,11 @@ extern "C" {
 
 #define UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY      (1 << 0)
 #define UTIL_QUEUE_INIT_RESIZE_IF_FULL            (1 << 1)
+/* Run the jobs on the process-wide pool instead of private threads. For such
+ * queues, UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY lowers the default job
+ * priority instead of the OS thread priority.
+ */
+#define UTIL_QUEUE_INIT_SHARED_POOL               (1 << 2)
 
 #if defined(__GNUC__) && defined(HAVE_LINUX_FUTEX_H)
 #define UTIL_QUEUE_FENCE_FUTEX
@@ -190,27 +209,66 @@ util_queue_fence_wait_timeout(struct util_queue_fence *fence,
 
 typedef void (*util_queue_execute_func)(void *job, int thread_index);
 
+/* Jobs of a higher priority (lower value) are always started before
+ * runnable jobs of a lower priority. Jobs of the same priority are started
+ * in the order they were added.
+ */
+enum util_queue_priority {
+   UTIL_QUEUE_PRIORITY_HIGH,
+   UTIL_QUEUE_PRIORITY_NORMAL,
+   UTIL_QUEUE_PRIORITY_LOW,
+   UTIL_QUEUE_NUM_PRIORITIES,
+};
+
 struct util_queue_job {
    void *job;
    struct util_queue_fence *fence;
    util_queue_execute_func execute;
    util_queue_execute_func cleanup;
+   uint64_t seqno; /* order in which the job was added to the queue */
+};
+
+/* State of a thread_index value while a job uses it. */
+struct util_queue_slot {
+   uint64_t seqno;  /* of the running job, UINT64_MAX if the slot is free */
+   unsigned worker; /* index of the pool thread that last used the slot */
 };
 
+/* FIFO of jobs of one priority level. */
+struct util_queue_ring {
+   struct util_queue_job *jobs;
+   unsigned size;
+   unsigned read_idx, write_idx; /* ring buffer pointers */
+};
+
+struct util_queue_pool;
+
 /* Put this into your context. */
 struct util_queue {
    const char *name;
    mtx_t lock;
-   cnd_t has_queued_cond;
    cnd_t has_space_cond;
-   thrd_t *threads;
+   cnd_t idle_cond;
+   struct util_queue_pool *pool;
+   thrd_t *threads; /* the pool threads if the pool is private, else NULL */
    unsigned flags;
-   int num_queued;
+   enum util_queue_priority default_priority;
    unsigned num_threads;
    int kill_threads;
    int max_jobs;
-   int write_idx, read_idx; /* ring buffer pointers */
-   struct util_queue_job *jobs;
+   int num_queued;   /* jobs in the rings, not including dropped ones */
+   int num_blocked;  /* jobs waiting for their dependencies */
+   int num_running;
+   int num_tokens;   /* queue references in the pool's deques */
+   struct util_queue_ring rings[UTIL_QUEUE_NUM_PRIORITIES];
+
+   /* thread_index values not used by running jobs */
+   unsigned num_free_slots;
+   unsigned *free_slots;
+   struct util_queue_slot *slots; /* indexed by thread_index */
+
+   uint64_t next_seqno;
+   int num_finish_waiters; /* threads in util_queue_finish, on idle_cond */
 
    /* for cleanup at exit(), protected by exit_mutex */
    struct list_head head;
@@ -229,6 +287,20 @@ void util_queue_add_job(struct util_queue *queue,
                         struct util_queue_fence *fence,
                         util_queue_execute_func execute,
                         util_queue_execute_func cleanup);
+void util_queue_add_job_with_priority(struct util_queue *queue,
+                                      void *job,
+                                      struct util_queue_fence *fence,
+                                      util_queue_execute_func execute,
+                                      util_queue_execute_func cleanup,
+                                      enum util_queue_priority priority);
+void util_queue_add_job_with_deps(struct util_queue *queue,
+                                  void *job,
+                                  struct util_queue_fence *fence,
+                                  util_queue_execute_func execute,
+                                  util_queue_execute_func cleanup,
+                                  enum util_queue_priority priority,
+                                  struct util_queue_fence **deps,
+                                  unsigned num_deps);
 void util_queue_drop_job(struct util_queue *queue,
                          struct util_queue_fence *fence);
 
@@ -241,7 +313,7 @@ int64_t util_queue_get_thread_time_nano(struct util_queue *queue,
 static inline bool
 util_queue_is_initialized(struct util_queue *queue)
 {
-   return queue->threads != NULL;
+   return queue->pool != NULL;
 }
 
 /* Convenient structure for monitoring the queue externally and passing
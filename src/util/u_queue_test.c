@@ -0,0 +1,408 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Force assertions, even on release builds. */
+#undef NDEBUG
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "macros.h"
+#include "u_atomic.h"
+#include "u_queue.h"
+#include "u_thread.h"
+
+#define NUM_JOBS 256
+
+struct test_job {
+   struct util_queue_fence fence;
+   struct util_queue_fence *gate;
+   int *counter;
+   int *running;
+   int *max_running;
+   int order;
+   int thread_index;
+};
+
+static void
+test_job_execute(void *data, int thread_index)
+{
+   struct test_job *job = (struct test_job *)data;
+
+   if (job->gate)
+      util_queue_fence_wait(job->gate);
+
+   if (job->running) {
+      int running = p_atomic_inc_return(job->running);
+      int max = p_atomic_read(job->max_running);
+
+      while (running > max) {
+         int old = p_atomic_cmpxchg(job->max_running, max, running);
+         if (old == max)
+            break;
+         max = old;
+      }
+      os_time_sleep(100);
+      p_atomic_dec(job->running);
+   }
+
+   job->thread_index = thread_index;
+   job->order = p_atomic_inc_return(job->counter);
+}
+
+static void
+test_job_init(struct test_job *job, int *counter)
+{
+   memset(job, 0, sizeof(*job));
+   util_queue_fence_init(&job->fence);
+   job->counter = counter;
+}
+
+/* Jobs of a higher priority overtake queued jobs of a lower priority. */
+static void
+test_priorities(void)
+{
+   struct util_queue queue;
+   struct util_queue_fence gate;
+   struct test_job blocker, jobs[UTIL_QUEUE_NUM_PRIORITIES];
+   int counter = 0;
+
+   assert(util_queue_init(&queue, "test", 8, 1, 0));
+
+   util_queue_fence_init(&gate);
+   util_queue_fence_reset(&gate);
+
+   test_job_init(&blocker, &counter);
+   blocker.gate = &gate;
+   util_queue_add_job_with_priority(&queue, &blocker, &blocker.fence,
+                                    test_job_execute, NULL,
+                                    UTIL_QUEUE_PRIORITY_HIGH);
+
+   for (int prio = UTIL_QUEUE_NUM_PRIORITIES - 1; prio >= 0; prio--) {
+      test_job_init(&jobs[prio], &counter);
+      util_queue_add_job_with_priority(&queue, &jobs[prio], &jobs[prio].fence,
+                                       test_job_execute, NULL,
+                                       (enum util_queue_priority)prio);
+   }
+
+   util_queue_fence_signal(&gate);
+   util_queue_finish(&queue);
+
+   assert(blocker.order == 1);
+   for (int prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+      assert(util_queue_fence_is_signalled(&jobs[prio].fence));
+      assert(jobs[prio].order == prio + 2);
+   }
+
+   util_queue_destroy(&queue);
+}
+
+/* A job with dependencies starts after all of them completed. */
+static void
+test_dependencies(unsigned flags)
+{
+   struct util_queue queue;
+   struct util_queue_fence gate;
+   struct test_job first, second, last;
+   struct util_queue_fence *deps[2];
+   int counter = 0;
+
+   assert(util_queue_init(&queue, "test", 8, 4, flags));
+
+   util_queue_fence_init(&gate);
+   util_queue_fence_reset(&gate);
+
+   test_job_init(&first, &counter);
+   first.gate = &gate;
+   util_queue_add_job(&queue, &first, &first.fence, test_job_execute, NULL);
+
+   test_job_init(&second, &counter);
+   deps[0] = &first.fence;
+   util_queue_add_job_with_deps(&queue, &second, &second.fence,
+                                test_job_execute, NULL,
+                                UTIL_QUEUE_PRIORITY_HIGH, deps, 1);
+
+   test_job_init(&last, &counter);
+   deps[1] = &second.fence;
+   util_queue_add_job_with_deps(&queue, &last, &last.fence,
+                                test_job_execute, NULL,
+                                UTIL_QUEUE_PRIORITY_HIGH, deps, 2);
+
+   os_time_sleep(1000);
+   assert(!util_queue_fence_is_signalled(&second.fence));
+   assert(!util_queue_fence_is_signalled(&last.fence));
+
+   util_queue_fence_signal(&gate);
+   util_queue_fence_wait(&last.fence);
+
+   assert(first.order == 1);
+   assert(second.order == 2);
+   assert(last.order == 3);
+
+   util_queue_destroy(&queue);
+}
+
+/* No more than num_threads jobs of a queue run at the same time, and their
+ * thread indices are in range.
+ */
+static void
+test_concurrency_limit(unsigned flags, unsigned num_threads)
+{
+   struct util_queue queue;
+   struct test_job *jobs = calloc(NUM_JOBS, sizeof(*jobs));
+   int counter = 0, running = 0, max_running = 0;
+
+   assert(util_queue_init(&queue, "test", 8, num_threads,
+                          flags | UTIL_QUEUE_INIT_RESIZE_IF_FULL));
+
+   for (unsigned i = 0; i < NUM_JOBS; i++) {
+      test_job_init(&jobs[i], &counter);
+      jobs[i].running = &running;
+      jobs[i].max_running = &max_running;
+      util_queue_add_job(&queue, &jobs[i], &jobs[i].fence,
+                         test_job_execute, NULL);
+   }
+
+   util_queue_finish(&queue);
+
+   assert(counter == NUM_JOBS);
+   assert(max_running >= 1 && max_running <= (int)num_threads);
+   for (unsigned i = 0; i < NUM_JOBS; i++) {
+      assert(util_queue_fence_is_signalled(&jobs[i].fence));
+      assert(jobs[i].thread_index >= 0 &&
+             jobs[i].thread_index < (int)num_threads);
+   }
+
+   util_queue_destroy(&queue);
+   free(jobs);
+}
+
+/* Shared-pool queues can ask for any number of threads; they get at most
+ * as many as the pool has.
+ */
+static void
+test_shared_pool_clamp(void)
+{
+   struct util_queue queue;
+   struct test_job job;
+   int counter = 0;
+
+   assert(util_queue_init(&queue, "test", 8, UINT_MAX,
+                          UTIL_QUEUE_INIT_SHARED_POOL));
+   assert(queue.num_threads >= 1 && queue.num_threads < UINT_MAX);
+
+   test_job_init(&job, &counter);
+   util_queue_add_job(&queue, &job, &job.fence, test_job_execute, NULL);
+   util_queue_fence_wait(&job.fence);
+
+   assert(counter == 1);
+   assert(job.thread_index >= 0 && job.thread_index < (int)queue.num_threads);
+
+   util_queue_destroy(&queue);
+}
+
+/* Dropped jobs are signalled without being executed. */
+static void
+test_drop_job(void)
+{
+   struct util_queue queue;
+   struct util_queue_fence gate;
+   struct test_job blocker, dropped, blocked;
+   struct util_queue_fence *deps[1];
+   int counter = 0;
+
+   assert(util_queue_init(&queue, "test", 8, 1,
+                          UTIL_QUEUE_INIT_SHARED_POOL));
+
+   util_queue_fence_init(&gate);
+   util_queue_fence_reset(&gate);
+
+   test_job_init(&blocker, &counter);
+   blocker.gate = &gate;
+   util_queue_add_job(&queue, &blocker, &blocker.fence,
+                      test_job_execute, NULL);
+
+   test_job_init(&dropped, &counter);
+   util_queue_add_job(&queue, &dropped, &dropped.fence,
+                      test_job_execute, NULL);
+
+   test_job_init(&blocked, &counter);
+   deps[0] = &dropped.fence;
+   util_queue_add_job_with_deps(&queue, &blocked, &blocked.fence,
+                                test_job_execute, NULL,
+                                UTIL_QUEUE_PRIORITY_NORMAL, deps, 1);
+
+   util_queue_drop_job(&queue, &blocked.fence);
+   util_queue_drop_job(&queue, &dropped.fence);
+   assert(util_queue_fence_is_signalled(&dropped.fence));
+   assert(util_queue_fence_is_signalled(&blocked.fence));
+
+   util_queue_fence_signal(&gate);
+   util_queue_finish(&queue);
+
+   assert(counter == 1);
+   assert(dropped.order == 0);
+   assert(blocked.order == 0);
+
+   util_queue_destroy(&queue);
+}
+
+/* Dropping a job releases the jobs that depend on it. */
+static void
+test_drop_job_releases_dependents(void)
+{
+   struct util_queue queue;
+   struct util_queue_fence gate;
+   struct test_job blocker, dropped, dependent;
+   struct util_queue_fence *deps[1];
+   int counter = 0;
+
+   assert(util_queue_init(&queue, "test", 8, 1,
+                          UTIL_QUEUE_INIT_SHARED_POOL));
+
+   util_queue_fence_init(&gate);
+   util_queue_fence_reset(&gate);
+
+   test_job_init(&blocker, &counter);
+   blocker.gate = &gate;
+   util_queue_add_job(&queue, &blocker, &blocker.fence,
+                      test_job_execute, NULL);
+
+   test_job_init(&dropped, &counter);
+   util_queue_add_job(&queue, &dropped, &dropped.fence,
+                      test_job_execute, NULL);
+
+   test_job_init(&dependent, &counter);
+   deps[0] = &dropped.fence;
+   util_queue_add_job_with_deps(&queue, &dependent, &dependent.fence,
+                                test_job_execute, NULL,
+                                UTIL_QUEUE_PRIORITY_NORMAL, deps, 1);
+
+   /* The dependent job is queued before any job completes. */
+   util_queue_drop_job(&queue, &dropped.fence);
+   mtx_lock(&queue.lock);
+   assert(queue.num_blocked == 0);
+   mtx_unlock(&queue.lock);
+
+   util_queue_fence_signal(&gate);
+   util_queue_finish(&queue);
+
+   assert(counter == 2);
+   assert(dropped.order == 0);
+   assert(dependent.order == 2);
+
+   util_queue_destroy(&queue);
+}
+
+/* util_queue_finish waits for the jobs added before it was called, but not
+ * for the ones added while it waits.
+ */
+struct finish_test {
+   struct util_queue queue;
+   struct util_queue_fence gate;
+   struct test_job first, second;
+   int counter;
+};
+
+static void
+test_finish_add_job(void *data, int thread_index)
+{
+   struct finish_test *test = (struct finish_test *)data;
+
+   util_queue_fence_wait(&test->gate);
+   util_queue_add_job(&test->queue, &test->second, &test->second.fence,
+                      test_job_execute, NULL);
+   test_job_execute(&test->first, thread_index);
+}
+
+static int
+test_finish_open_gate(void *data)
+{
+   struct finish_test *test = (struct finish_test *)data;
+
+   /* Once util_queue_finish waits, it has chosen the jobs to wait for. */
+   while (!p_atomic_read(&test->queue.num_finish_waiters))
+      os_time_sleep(100);
+
+   util_queue_fence_signal(&test->gate);
+   return 0;
+}
+
+static void
+test_finish(unsigned flags)
+{
+   struct finish_test test;
+   struct util_queue_fence second_gate;
+   thrd_t thread;
+
+   memset(&test, 0, sizeof(test));
+   assert(util_queue_init(&test.queue, "test", 8, 1, flags));
+
+   util_queue_fence_init(&test.gate);
+   util_queue_fence_reset(&test.gate);
+   util_queue_fence_init(&second_gate);
+   util_queue_fence_reset(&second_gate);
+
+   test_job_init(&test.first, &test.counter);
+   test_job_init(&test.second, &test.counter);
+   test.second.gate = &second_gate;
+
+   util_queue_add_job(&test.queue, &test, &test.first.fence,
+                      test_finish_add_job, NULL);
+
+   thread = u_thread_create(test_finish_open_gate, &test);
+   util_queue_finish(&test.queue);
+   thrd_join(thread, NULL);
+
+   /* The second job was added by the first one and is still gated. */
+   assert(util_queue_fence_is_signalled(&test.first.fence));
+   assert(test.first.order == 1);
+   assert(!util_queue_fence_is_signalled(&test.second.fence));
+
+   util_queue_fence_signal(&second_gate);
+   util_queue_finish(&test.queue);
+   assert(test.second.order == 2);
+
+   util_queue_destroy(&test.queue);
+}
+
+int
+main(int argc, char **argv)
+{
+   test_priorities();
+   test_dependencies(0);
+   test_dependencies(UTIL_QUEUE_INIT_SHARED_POOL);
+   test_concurrency_limit(0, 3);
+   test_concurrency_limit(UTIL_QUEUE_INIT_SHARED_POOL, 1);
+   test_concurrency_limit(UTIL_QUEUE_INIT_SHARED_POOL, 2);
+   test_shared_pool_clamp();
+   test_drop_job();
+   test_drop_job_releases_dependents();
+   test_finish(0);
+   test_finish(UTIL_QUEUE_INIT_SHARED_POOL);
+
+   printf("All tests passed.\n");
+   return 0;
+}